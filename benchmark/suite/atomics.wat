@@ -0,0 +1,36 @@
+;; atomics: atomic rmw and load on a shared memory.
+(module
+  (memory 1 1 shared)
+  (func (export "run") (param $n i32) (result i32)
+    (local $acc i32)
+    (local $addr i32)
+    loop $loop
+      ;; addr = (n & 0xff) << 2
+      local.get $n
+      i32.const 0xff
+      i32.and
+      i32.const 2
+      i32.shl
+      local.set $addr
+      ;; acc += atomic_fetch_add(mem[addr], n)
+      local.get $acc
+      local.get $addr
+      local.get $n
+      i32.atomic.rmw.add
+      i32.add
+      ;; acc ^= atomic_load(mem[addr ^ 4])
+      local.get $addr
+      i32.const 4
+      i32.xor
+      i32.atomic.load
+      i32.xor
+      local.set $acc
+      local.get $n
+      i32.const 1
+      i32.sub
+      local.tee $n
+      br_if $loop
+    end
+    local.get $acc
+  )
+)
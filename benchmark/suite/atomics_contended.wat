@@ -0,0 +1,21 @@
+;; atomics_contended: a counter shared by threads.
+;; toywasm-bench runs this on --threads threads at once.
+(module
+  (memory 1 1 shared)
+  (func (export "run") (param $n i32) (result i32)
+    loop $loop
+      ;; atomic_fetch_add(mem[0], 1)
+      i32.const 0
+      i32.const 1
+      i32.atomic.rmw.add
+      drop
+      local.get $n
+      i32.const 1
+      i32.sub
+      local.tee $n
+      br_if $loop
+    end
+    i32.const 0
+    i32.atomic.load
+  )
+)
@@ -0,0 +1,670 @@
+/*
+ * toywasm-bench: run the benchmark kernels in this directory
+ * with the toywasm library.
+ *
+ * for each kernel, it reports:
+ *
+ *   ns_per_op      the best of --repeat measurements.
+ *   insn_per_sec   wasm instructions executed per second.
+ *                  only available with TOYWASM_ENABLE_INSN_STATS.
+ *                  (note that the counters themselves slow down
+ *                  the execution.)
+ *   peak_heap      the peak of mem_context allocations for the kernel,
+ *                  including the module.
+ *                  only available with TOYWASM_ENABLE_HEAP_TRACKING_PEAK.
+ *
+ * the results are printed as a table. --output writes them in JSON
+ * as well. see compare.py.
+ *
+ * a KERNEL_RUN_THREADS kernel is run on --threads threads at once.
+ * its ns_per_op is the wall-clock time divided by the total number
+ * of ops of all the threads.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "endian.h"
+#include "exec_context.h"
+#include "fileio.h"
+#include "instance.h"
+#include "load_context.h"
+#include "mem.h"
+#include "module.h"
+#include "report.h"
+#include "timeutil.h"
+#include "toywasm_config.h"
+#include "toywasm_version.h"
+#include "type.h"
+#include "util.h"
+#include "xlog.h"
+#if defined(TOYWASM_ENABLE_WASI)
+#include "cconv.h"
+#include "wasi.h"
+#endif
+#if defined(TOYWASM_ENABLE_WASM_THREADS) && !defined(TOYWASM_USE_USER_SCHED)
+#include <pthread.h>
+#define HAVE_BENCH_THREADS
+#endif
+
+enum kernel_type {
+        /* call the exported "run" function with the number of ops */
+        KERNEL_RUN,
+        /* an op is instance_create + instance_destroy */
+        KERNEL_INSTANTIATE,
+        /* KERNEL_RUN on multiple threads sharing an instance */
+        KERNEL_RUN_THREADS,
+};
+
+struct kernel {
+        const char *name;
+        enum kernel_type type;
+        uint32_t n; /* the default number of ops for a measurement */
+        bool needs_wasi;
+};
+
+static const struct kernel kernels[] = {
+        {"call", KERNEL_RUN, 2000000, false},
+        {"branch", KERNEL_RUN, 1000000, false},
+        {"memory", KERNEL_RUN, 1000000, false},
+        {"simd", KERNEL_RUN, 1000000, false},
+        {"call_indirect", KERNEL_RUN, 1000000, false},
+        {"atomics", KERNEL_RUN, 1000000, false},
+        {"wasi", KERNEL_RUN, 200000, true},
+        {"instantiate", KERNEL_INSTANTIATE, 5000, false},
+        {"atomics_contended", KERNEL_RUN_THREADS, 1000000, false},
+};
+
+struct result {
+        const struct kernel *kernel;
+        const char *skipped; /* non-NULL if skipped */
+        uint32_t n;
+        uint64_t best_ns;
+        uint64_t insns; /* for the best run */
+        size_t peak_heap;
+        uint32_t checksum;
+};
+
+static uint64_t
+now_ns(void)
+{
+        struct timespec ts;
+        if (timespec_now(CLOCK_MONOTONIC, &ts) != 0) {
+                return 0;
+        }
+        return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+#if defined(TOYWASM_ENABLE_INSN_STATS)
+static uint64_t
+count_insns(const struct exec_stat *st)
+{
+        uint64_t total = 0;
+        uint32_t i;
+        for (i = 0; i < INSN_STAT_NSLOTS; i++) {
+                /* prefixes are counted separately */
+                if (i == 0xfc || i == 0xfd || i == 0xfe) {
+                        continue;
+                }
+                total += st->insn[i];
+        }
+        return total;
+}
+#endif
+
+/* find the "run" function, which takes and returns an i32 */
+static int
+find_run_func(const struct module *m, const struct kernel *k,
+              uint32_t *funcidxp)
+{
+        uint32_t funcidx;
+        struct name name = NAME_FROM_CSTR_LITERAL("run");
+        int ret;
+        ret = module_find_export_func(m, &name, &funcidx);
+        if (ret != 0) {
+                xlog_error("%s: no run function", k->name);
+                return ret;
+        }
+        const struct functype *ft = module_functype(m, funcidx);
+        const struct resulttype *pt = &ft->parameter;
+        const struct resulttype *rt = &ft->result;
+        if (pt->ntypes != 1 || pt->types[0] != TYPE_i32 ||
+            rt->ntypes != 1 || rt->types[0] != TYPE_i32) {
+                xlog_error("%s: unexpected type of the run function",
+                           k->name);
+                return EINVAL;
+        }
+        *funcidxp = funcidx;
+        return 0;
+}
+
+static int
+bench_run(struct mem_context *mctx, const struct module *m,
+          const struct kernel *k, unsigned int repeat, struct result *r)
+{
+        struct import_object *imports = NULL;
+        struct instance *inst = NULL;
+        struct exec_context ectx;
+        struct exec_context *ctx = NULL;
+        struct report report;
+        int ret;
+#if defined(TOYWASM_ENABLE_WASI)
+        struct wasi_instance *wasi = NULL;
+        if (k->needs_wasi) {
+                ret = wasi_instance_create(mctx, &wasi);
+                if (ret != 0) {
+                        goto fail;
+                }
+                ret = import_object_create_for_wasi(mctx, wasi, &imports);
+                if (ret != 0) {
+                        goto fail;
+                }
+        }
+#endif
+        report_init(&report);
+        ret = instance_create(mctx, m, &inst, imports, &report);
+        if (ret != 0) {
+                xlog_error("instance_create failed with %d: %s", ret,
+                           report_getmessage(&report));
+                report_clear(&report);
+                goto fail;
+        }
+        report_clear(&report);
+#if defined(TOYWASM_ENABLE_WASI)
+        if (wasi != NULL) {
+                wasi_instance_set_memory(wasi, cconv_memory(inst));
+        }
+#endif
+
+        uint32_t funcidx;
+        ret = find_run_func(m, k, &funcidx);
+        if (ret != 0) {
+                goto fail;
+        }
+        const struct functype *ft = module_functype(m, funcidx);
+        const struct resulttype *pt = &ft->parameter;
+        const struct resulttype *rt = &ft->result;
+
+        ctx = &ectx;
+        exec_context_init(ctx, inst, mctx);
+        /* the first run is a warm-up */
+        unsigned int i;
+        for (i = 0; i <= repeat; i++) {
+                struct val val;
+                memset(&ctx->stats, 0, sizeof(ctx->stats));
+                val.u.i32 = r->n;
+                ret = exec_push_vals(ctx, pt, &val);
+                if (ret != 0) {
+                        goto fail;
+                }
+                const uint64_t start = now_ns();
+                ret = instance_execute_func(ctx, funcidx, pt, rt);
+                ret = instance_execute_handle_restart(ctx, ret);
+                const uint64_t elapsed = now_ns() - start;
+                if (ret != 0) {
+                        xlog_error("%s: execution failed with %d: %s",
+                                   k->name, ret,
+                                   report_getmessage(ctx->report));
+                        goto fail;
+                }
+                exec_pop_vals(ctx, rt, &val);
+                r->checksum = val.u.i32;
+                if (i == 0) {
+                        continue;
+                }
+                if (i == 1 || elapsed < r->best_ns) {
+                        r->best_ns = elapsed;
+#if defined(TOYWASM_ENABLE_INSN_STATS)
+                        r->insns = count_insns(&ctx->stats);
+#endif
+                }
+        }
+        ret = 0;
+fail:
+        if (ctx != NULL) {
+                exec_context_clear(ctx);
+        }
+        if (inst != NULL) {
+                instance_destroy(inst);
+        }
+        if (imports != NULL) {
+                import_object_destroy(mctx, imports);
+        }
+#if defined(TOYWASM_ENABLE_WASI)
+        if (wasi != NULL) {
+                wasi_instance_destroy(wasi);
+        }
+#endif
+        return ret;
+}
+
+static int
+bench_instantiate(struct mem_context *mctx, const struct module *m,
+                  const struct kernel *k, unsigned int repeat,
+                  struct result *r)
+{
+        unsigned int i;
+        for (i = 0; i <= repeat; i++) {
+                const uint64_t start = now_ns();
+                uint32_t j;
+                for (j = 0; j < r->n; j++) {
+                        struct instance *inst;
+                        struct report report;
+                        int ret;
+                        report_init(&report);
+                        ret = instance_create(mctx, m, &inst, NULL, &report);
+                        if (ret != 0) {
+                                xlog_error("%s: instance_create failed with "
+                                           "%d: %s",
+                                           k->name, ret,
+                                           report_getmessage(&report));
+                                report_clear(&report);
+                                return ret;
+                        }
+                        report_clear(&report);
+                        instance_destroy(inst);
+                }
+                const uint64_t elapsed = now_ns() - start;
+                if (i == 0) {
+                        continue;
+                }
+                if (i == 1 || elapsed < r->best_ns) {
+                        r->best_ns = elapsed;
+                }
+        }
+        return 0;
+}
+
+#if defined(HAVE_BENCH_THREADS)
+struct bench_thread {
+        pthread_t thread;
+        struct mem_context *mctx;
+        struct instance *inst;
+        uint32_t funcidx;
+        uint32_t n;
+        int ret;
+};
+
+static void *
+bench_thread_main(void *vp)
+{
+        struct bench_thread *t = vp;
+        const struct functype *ft =
+                module_functype(t->inst->module, t->funcidx);
+        const struct resulttype *pt = &ft->parameter;
+        const struct resulttype *rt = &ft->result;
+        struct exec_context ectx;
+        struct exec_context *ctx = &ectx;
+        struct val val;
+        int ret;
+
+        exec_context_init(ctx, t->inst, t->mctx);
+        val.u.i32 = t->n;
+        ret = exec_push_vals(ctx, pt, &val);
+        if (ret == 0) {
+                ret = instance_execute_func(ctx, t->funcidx, pt, rt);
+                ret = instance_execute_handle_restart(ctx, ret);
+        }
+        if (ret != 0) {
+                xlog_error("execution failed with %d: %s", ret,
+                           report_getmessage(ctx->report));
+        } else {
+                exec_pop_vals(ctx, rt, &val);
+        }
+        exec_context_clear(ctx);
+        t->ret = ret;
+        return NULL;
+}
+
+/*
+ * run the "run" function on nthreads threads at once, sharing
+ * an instance. each thread does r->n / nthreads ops.
+ * the checksum is the first i32 of the memory after a run.
+ * (the counter for atomics_contended)
+ */
+static int
+bench_run_threads(struct mem_context *mctx, const struct module *m,
+                  const struct kernel *k, unsigned int repeat,
+                  unsigned int nthreads, struct result *r)
+{
+        struct bench_thread *threads = NULL;
+        struct instance *inst = NULL;
+        struct report report;
+        uint32_t funcidx;
+        int ret;
+
+        ret = find_run_func(m, k, &funcidx);
+        if (ret != 0) {
+                return ret;
+        }
+        if (m->nimportedmems + m->nmems == 0) {
+                xlog_error("%s: no memory", k->name);
+                return EINVAL;
+        }
+        threads = calloc(nthreads, sizeof(*threads));
+        if (threads == NULL) {
+                return ENOMEM;
+        }
+        report_init(&report);
+        ret = instance_create(mctx, m, &inst, NULL, &report);
+        if (ret != 0) {
+                xlog_error("instance_create failed with %d: %s", ret,
+                           report_getmessage(&report));
+                report_clear(&report);
+                goto fail;
+        }
+        report_clear(&report);
+        struct meminst *mi = VEC_ELEM(inst->mems, 0);
+        r->n -= r->n % nthreads;
+        /* the first run is a warm-up */
+        unsigned int i;
+        for (i = 0; i <= repeat; i++) {
+                le32_encode(mi->data, 0);
+                const uint64_t start = now_ns();
+                unsigned int j;
+                unsigned int nstarted;
+                for (nstarted = 0; nstarted < nthreads; nstarted++) {
+                        struct bench_thread *t = &threads[nstarted];
+                        t->mctx = mctx;
+                        t->inst = inst;
+                        t->funcidx = funcidx;
+                        t->n = r->n / nthreads;
+                        t->ret = 0;
+                        ret = pthread_create(&t->thread, NULL,
+                                             bench_thread_main, t);
+                        if (ret != 0) {
+                                break;
+                        }
+                }
+                for (j = 0; j < nstarted; j++) {
+                        pthread_join(threads[j].thread, NULL);
+                        if (ret == 0) {
+                                ret = threads[j].ret;
+                        }
+                }
+                const uint64_t elapsed = now_ns() - start;
+                if (ret != 0) {
+                        xlog_error("%s: failed with %d", k->name, ret);
+                        goto fail;
+                }
+                r->checksum = le32_decode(mi->data);
+                if (i == 0) {
+                        continue;
+                }
+                if (i == 1 || elapsed < r->best_ns) {
+                        r->best_ns = elapsed;
+                }
+        }
+        ret = 0;
+fail:
+        if (inst != NULL) {
+                instance_destroy(inst);
+        }
+        free(threads);
+        return ret;
+}
+#endif
+
+static int
+bench_kernel(const char *dir, const struct kernel *k, unsigned int repeat,
+             unsigned int scale, unsigned int nthreads, struct result *r)
+{
+        struct mem_context mctx0;
+        struct mem_context *mctx = &mctx0;
+        struct module *m = NULL;
+        uint8_t *bin = NULL;
+        size_t binsz;
+        char path[1024];
+        int ret;
+
+        memset(r, 0, sizeof(*r));
+        r->kernel = k;
+        r->n = k->n * scale;
+#if !defined(TOYWASM_ENABLE_WASI)
+        if (k->needs_wasi) {
+                r->skipped = "wasi is disabled";
+                return 0;
+        }
+#endif
+#if !defined(HAVE_BENCH_THREADS)
+        if (k->type == KERNEL_RUN_THREADS) {
+                r->skipped = "threads are disabled";
+                return 0;
+        }
+#endif
+        ret = snprintf(path, sizeof(path), "%s/%s.wasm", dir, k->name);
+        if (ret < 0 || (size_t)ret >= sizeof(path)) {
+                return ENAMETOOLONG;
+        }
+        ret = map_file(path, (void **)&bin, &binsz);
+        if (ret != 0) {
+                xlog_error("failed to map %s: %d", path, ret);
+                return ret;
+        }
+        mem_context_init(mctx);
+        struct load_context lctx;
+        load_context_init(&lctx, mctx);
+        ret = module_create(&m, bin, bin + binsz, &lctx);
+        if (ret != 0) {
+                /* eg. the feature (simd, threads) is disabled */
+                xlog_printf("%s: skipped (module_create failed with %d: "
+                            "%s)\n",
+                            k->name, ret, report_getmessage(&lctx.report));
+                load_context_clear(&lctx);
+                r->skipped = "failed to load";
+                ret = 0;
+                goto fail;
+        }
+        load_context_clear(&lctx);
+
+        switch (k->type) {
+        case KERNEL_RUN:
+                ret = bench_run(mctx, m, k, repeat, r);
+                break;
+        case KERNEL_INSTANTIATE:
+                ret = bench_instantiate(mctx, m, k, repeat, r);
+                break;
+        case KERNEL_RUN_THREADS:
+#if defined(HAVE_BENCH_THREADS)
+                ret = bench_run_threads(mctx, m, k, repeat, nthreads, r);
+#endif
+                break;
+        }
+#if defined(TOYWASM_ENABLE_HEAP_TRACKING_PEAK)
+        r->peak_heap = mctx->peak;
+#endif
+fail:
+        if (m != NULL) {
+                module_destroy(mctx, m);
+        }
+        mem_context_clear(mctx);
+        unmap_file(bin, binsz);
+        return ret;
+}
+
+static void
+print_table(const struct result *results, unsigned int nresults)
+{
+        unsigned int i;
+        printf("%-16s %10s %12s %14s %12s\n", "kernel", "n", "ns/op",
+               "insn/s", "peak heap");
+        for (i = 0; i < nresults; i++) {
+                const struct result *r = &results[i];
+                if (r->skipped != NULL) {
+                        printf("%-16s (skipped: %s)\n", r->kernel->name,
+                               r->skipped);
+                        continue;
+                }
+                printf("%-16s %10" PRIu32 " %12.2f", r->kernel->name, r->n,
+                       (double)r->best_ns / r->n);
+#if defined(TOYWASM_ENABLE_INSN_STATS)
+                if (r->insns > 0) {
+                        printf(" %14.4g",
+                               (double)r->insns * 1e9 / r->best_ns);
+                } else
+#endif
+                {
+                        printf(" %14s", "-");
+                }
+#if defined(TOYWASM_ENABLE_HEAP_TRACKING_PEAK)
+                printf(" %12zu\n", r->peak_heap);
+#else
+                printf(" %12s\n", "-");
+#endif
+        }
+}
+
+static int
+write_json(const char *filename, const struct result *results,
+           unsigned int nresults, unsigned int repeat)
+{
+        FILE *fp = fopen(filename, "w");
+        if (fp == NULL) {
+                return errno;
+        }
+        fprintf(fp, "{\n");
+        fprintf(fp, "  \"version\": \"%s\",\n", TOYWASM_VERSION);
+        fprintf(fp, "  \"repeat\": %u,\n", repeat);
+        fprintf(fp, "  \"results\": [\n");
+        unsigned int i;
+        for (i = 0; i < nresults; i++) {
+                const struct result *r = &results[i];
+                const char *sep = (i + 1 < nresults) ? "," : "";
+                if (r->skipped != NULL) {
+                        fprintf(fp,
+                                "    {\"name\": \"%s\", \"skipped\": "
+                                "\"%s\"}%s\n",
+                                r->kernel->name, r->skipped, sep);
+                        continue;
+                }
+                fprintf(fp,
+                        "    {\"name\": \"%s\", \"n\": %" PRIu32
+                        ", \"ns_per_op\": %.3f",
+                        r->kernel->name, r->n, (double)r->best_ns / r->n);
+                if (r->insns > 0) {
+                        fprintf(fp, ", \"insn_per_sec\": %.0f",
+                                (double)r->insns * 1e9 / r->best_ns);
+                } else {
+                        fprintf(fp, ", \"insn_per_sec\": null");
+                }
+#if defined(TOYWASM_ENABLE_HEAP_TRACKING_PEAK)
+                fprintf(fp, ", \"peak_heap\": %zu", r->peak_heap);
+#else
+                fprintf(fp, ", \"peak_heap\": null");
+#endif
+                fprintf(fp, ", \"checksum\": %" PRIu32 "}%s\n", r->checksum,
+                        sep);
+        }
+        fprintf(fp, "  ]\n");
+        fprintf(fp, "}\n");
+        if (fclose(fp) != 0) {
+                return errno;
+        }
+        return 0;
+}
+
+static void
+usage(void)
+{
+        fprintf(stderr, "usage: toywasm-bench [--repeat N] [--scale N] "
+                        "[--threads N] [--output JSON_PATH] KERNEL_DIR "
+                        "[KERNEL...]\n");
+        fprintf(stderr, "kernels:");
+        unsigned int i;
+        for (i = 0; i < ARRAYCOUNT(kernels); i++) {
+                fprintf(stderr, " %s", kernels[i].name);
+        }
+        fprintf(stderr, "\n");
+}
+
+enum longopt {
+        opt_output = 0x100,
+        opt_repeat,
+        opt_scale,
+        opt_threads,
+};
+
+static const struct option longopts[] = {
+        {"output", required_argument, NULL, opt_output},
+        {"repeat", required_argument, NULL, opt_repeat},
+        {"scale", required_argument, NULL, opt_scale},
+        {"threads", required_argument, NULL, opt_threads},
+        {NULL, 0, NULL, 0},
+};
+
+int
+main(int argc, char **argv)
+{
+        struct result results[ARRAYCOUNT(kernels)];
+        unsigned int nresults = 0;
+        const char *output = NULL;
+        unsigned int repeat = 5;
+        unsigned int scale = 1;
+        unsigned int nthreads = 4;
+        int ret;
+        int longidx;
+
+        while ((ret = getopt_long(argc, argv, "", longopts, &longidx)) !=
+               -1) {
+                switch (ret) {
+                case opt_output:
+                        output = optarg;
+                        break;
+                case opt_repeat:
+                        repeat = atoi(optarg);
+                        break;
+                case opt_scale:
+                        scale = atoi(optarg);
+                        break;
+                case opt_threads:
+                        nthreads = atoi(optarg);
+                        break;
+                default:
+                        usage();
+                        exit(2);
+                }
+        }
+        argc -= optind;
+        argv += optind;
+        if (argc < 1 || repeat < 1 || scale < 1 || nthreads < 1) {
+                usage();
+                exit(2);
+        }
+        const char *dir = argv[0];
+        unsigned int i;
+        for (i = 0; i < ARRAYCOUNT(kernels); i++) {
+                const struct kernel *k = &kernels[i];
+                if (argc > 1) {
+                        int j;
+                        for (j = 1; j < argc; j++) {
+                                if (!strcmp(argv[j], k->name)) {
+                                        break;
+                                }
+                        }
+                        if (j == argc) {
+                                continue;
+                        }
+                }
+                ret = bench_kernel(dir, k, repeat, scale, nthreads,
+                                   &results[nresults]);
+                if (ret != 0) {
+                        xlog_error("%s: failed with %d", k->name, ret);
+                        exit(1);
+                }
+                nresults++;
+        }
+        print_table(results, nresults);
+        if (output != NULL) {
+                ret = write_json(output, results, nresults, repeat);
+                if (ret != 0) {
+                        xlog_error("failed to write %s: %d", output, ret);
+                        exit(1);
+                }
+        }
+        exit(0);
+}
@@ -0,0 +1,54 @@
+;; branch-heavy: br_table and if/else per iteration.
+(module
+  (func (export "run") (param $n i32) (result i32)
+    (local $acc i32)
+    loop $loop
+      block $b3
+        block $b2
+          block $b1
+            block $b0
+              local.get $n
+              i32.const 3
+              i32.and
+              br_table $b0 $b1 $b2 $b3
+            end
+            local.get $acc
+            i32.const 1
+            i32.add
+            local.set $acc
+            br $b3
+          end
+          local.get $acc
+          i32.const 3
+          i32.xor
+          local.set $acc
+          br $b3
+        end
+        local.get $acc
+        i32.const 1
+        i32.shl
+        local.set $acc
+      end
+      local.get $n
+      i32.const 1
+      i32.and
+      if
+        local.get $acc
+        i32.const 7
+        i32.add
+        local.set $acc
+      else
+        local.get $acc
+        i32.const 1
+        i32.sub
+        local.set $acc
+      end
+      local.get $n
+      i32.const 1
+      i32.sub
+      local.tee $n
+      br_if $loop
+    end
+    local.get $acc
+  )
+)
@@ -0,0 +1,23 @@
+;; call-heavy: a direct call per iteration.
+(module
+  (func $add (param i32 i32) (result i32)
+    local.get 0
+    local.get 1
+    i32.add
+  )
+  (func (export "run") (param $n i32) (result i32)
+    (local $acc i32)
+    loop $loop
+      local.get $acc
+      local.get $n
+      call $add
+      local.set $acc
+      local.get $n
+      i32.const 1
+      i32.sub
+      local.tee $n
+      br_if $loop
+    end
+    local.get $acc
+  )
+)
@@ -0,0 +1,43 @@
+;; call_indirect: an indirect call via a table per iteration.
+(module
+  (type $t (func (param i32) (result i32)))
+  (table 4 funcref)
+  (elem (i32.const 0) $f0 $f1 $f2 $f3)
+  (func $f0 (type $t)
+    local.get 0
+    i32.const 1
+    i32.add
+  )
+  (func $f1 (type $t)
+    local.get 0
+    i32.const 1
+    i32.xor
+  )
+  (func $f2 (type $t)
+    local.get 0
+    i32.const 3
+    i32.mul
+  )
+  (func $f3 (type $t)
+    local.get 0
+    i32.const 1
+    i32.shr_u
+  )
+  (func (export "run") (param $n i32) (result i32)
+    (local $acc i32)
+    loop $loop
+      local.get $acc
+      local.get $n
+      i32.const 3
+      i32.and
+      call_indirect (type $t)
+      local.set $acc
+      local.get $n
+      i32.const 1
+      i32.sub
+      local.tee $n
+      br_if $loop
+    end
+    local.get $acc
+  )
+)
@@ -0,0 +1,54 @@
+#! /usr/bin/env python3
+
+# compare two results of toywasm-bench --output.
+# exit with 1 if any kernel got slower than the threshold.
+
+import argparse
+import json
+import os
+import sys
+
+parser = argparse.ArgumentParser()
+parser.add_argument("--threshold", type=float, default=10.0,
+                    help="regression threshold in percent (default: 10)")
+parser.add_argument("--allow-missing-baseline", action="store_true")
+parser.add_argument("baseline")
+parser.add_argument("current")
+args = parser.parse_args()
+
+if not os.path.exists(args.baseline) and args.allow_missing_baseline:
+    print(f"no baseline at {args.baseline}. nothing to compare.")
+    sys.exit(0)
+
+
+def load(path):
+    with open(path) as f:
+        d = json.load(f)
+    return {r["name"]: r for r in d["results"] if "skipped" not in r}
+
+
+base = load(args.baseline)
+cur = load(args.current)
+
+print(f"{'kernel':16} {'base ns/op':>12} {'ns/op':>12} {'change':>8}")
+regressions = []
+for name, r in cur.items():
+    b = base.get(name)
+    if b is None:
+        print(f"{name:16} {'-':>12} {r['ns_per_op']:12.2f}")
+        continue
+    change = (r["ns_per_op"] / b["ns_per_op"] - 1) * 100
+    mark = ""
+    if change > args.threshold:
+        mark = " REGRESSION"
+        regressions.append(name)
+    print(f"{name:16} {b['ns_per_op']:12.2f} {r['ns_per_op']:12.2f} "
+          f"{change:+7.1f}%{mark}")
+    for key in ("peak_heap",):
+        if b.get(key) is not None and r.get(key) is not None:
+            if r[key] > b[key]:
+                print(f"{'':16} {key} {b[key]} -> {r[key]}")
+
+if regressions:
+    print(f"regressions (>{args.threshold}%): {' '.join(regressions)}")
+    sys.exit(1)
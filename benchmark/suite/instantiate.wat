@@ -0,0 +1,79 @@
+;; instantiation-heavy: the harness measures instance_create and
+;; instance_destroy of this module.
+(module
+  (type $t (func (param i32) (result i32)))
+  (memory (export "memory") 1)
+  (table (export "table") 16 funcref)
+  (global $g0 (mut i32) (i32.const 0))
+  (global $g1 (mut i32) (i32.const 1))
+  (global $g2 (mut i32) (i32.const 2))
+  (global $g3 (mut i32) (i32.const 3))
+  (global $g4 (mut i32) (i32.const 4))
+  (global $g5 (mut i32) (i32.const 5))
+  (global $g6 (mut i32) (i32.const 6))
+  (global $g7 (mut i32) (i32.const 7))
+  (global $h0 (mut i64) (i64.const 0))
+  (global $h1 (mut i64) (i64.const 1))
+  (global $h2 (mut i64) (i64.const 2))
+  (global $h3 (mut i64) (i64.const 3))
+  (global $h4 (mut i64) (i64.const 4))
+  (global $h5 (mut i64) (i64.const 5))
+  (global $h6 (mut i64) (i64.const 6))
+  (global $h7 (mut i64) (i64.const 7))
+  (data (i32.const 0) "toywasm benchmark data segment 0")
+  (data (i32.const 1024) "toywasm benchmark data segment 1")
+  (data (i32.const 4096) "toywasm benchmark data segment 2")
+  (data (i32.const 32768) "toywasm benchmark data segment 3")
+  (elem (i32.const 0) $f0 $f1 $f2 $f3 $f4 $f5 $f6 $f7)
+  (elem (i32.const 8) $f0 $f1 $f2 $f3 $f4 $f5 $f6 $f7)
+  (func $f0 (export "f0") (type $t)
+    local.get 0
+    i32.const 0
+    i32.add
+  )
+  (func $f1 (export "f1") (type $t)
+    local.get 0
+    i32.const 1
+    i32.add
+  )
+  (func $f2 (export "f2") (type $t)
+    local.get 0
+    i32.const 2
+    i32.add
+  )
+  (func $f3 (export "f3") (type $t)
+    local.get 0
+    i32.const 3
+    i32.add
+  )
+  (func $f4 (export "f4") (type $t)
+    local.get 0
+    i32.const 4
+    i32.add
+  )
+  (func $f5 (export "f5") (type $t)
+    local.get 0
+    i32.const 5
+    i32.add
+  )
+  (func $f6 (export "f6") (type $t)
+    local.get 0
+    i32.const 6
+    i32.add
+  )
+  (func $f7 (export "f7") (type $t)
+    local.get 0
+    i32.const 7
+    i32.add
+  )
+  (func $init
+    global.get $g0
+    i32.const 1
+    i32.add
+    global.set $g0
+  )
+  (start $init)
+  (func (export "run") (param $n i32) (result i32)
+    local.get $n
+  )
+)
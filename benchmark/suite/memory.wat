@@ -0,0 +1,38 @@
+;; memory-heavy: loads and stores scattered over a 64KB page.
+(module
+  (memory 1)
+  (func (export "run") (param $n i32) (result i32)
+    (local $acc i32)
+    (local $addr i32)
+    loop $loop
+      ;; addr = (n << 2) & 0xfffc
+      local.get $n
+      i32.const 2
+      i32.shl
+      i32.const 0xfffc
+      i32.and
+      local.set $addr
+      ;; mem[addr] += n
+      local.get $addr
+      local.get $addr
+      i32.load
+      local.get $n
+      i32.add
+      i32.store
+      ;; acc += mem8[addr ^ 0x80]
+      local.get $acc
+      local.get $addr
+      i32.const 0x80
+      i32.xor
+      i32.load8_u
+      i32.add
+      local.set $acc
+      local.get $n
+      i32.const 1
+      i32.sub
+      local.tee $n
+      br_if $loop
+    end
+    local.get $acc
+  )
+)
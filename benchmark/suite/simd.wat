@@ -0,0 +1,41 @@
+;; simd: i32x4 loads, adds and stores.
+(module
+  (memory 1)
+  (func (export "run") (param $n i32) (result i32)
+    (local $acc v128)
+    (local $addr i32)
+    loop $loop
+      ;; addr = (n << 4) & 0xfff0
+      local.get $n
+      i32.const 4
+      i32.shl
+      i32.const 0xfff0
+      i32.and
+      local.set $addr
+      ;; mem[addr] += splat(n)
+      local.get $addr
+      local.get $addr
+      v128.load
+      local.get $n
+      i32x4.splat
+      i32x4.add
+      v128.store
+      ;; acc += mem[addr]
+      local.get $acc
+      local.get $addr
+      v128.load
+      i32x4.add
+      local.set $acc
+      local.get $n
+      i32.const 1
+      i32.sub
+      local.tee $n
+      br_if $loop
+    end
+    local.get $acc
+    i32x4.extract_lane 0
+    local.get $acc
+    i32x4.extract_lane 3
+    i32.add
+  )
+)
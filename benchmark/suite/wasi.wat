@@ -0,0 +1,28 @@
+;; wasi: a wasi host call per iteration.
+(module
+  (import "wasi_snapshot_preview1" "clock_time_get"
+    (func $clock_time_get (param i32 i64 i32) (result i32)))
+  (memory (export "memory") 1)
+  (func (export "run") (param $n i32) (result i32)
+    (local $acc i32)
+    loop $loop
+      ;; clock_time_get(CLOCK_MONOTONIC, 0, 0)
+      i32.const 1
+      i64.const 0
+      i32.const 0
+      call $clock_time_get
+      local.get $acc
+      i32.add
+      i32.const 0
+      i32.load
+      i32.xor
+      local.set $acc
+      local.get $n
+      i32.const 1
+      i32.sub
+      local.tee $n
+      br_if $loop
+    end
+    local.get $acc
+  )
+)
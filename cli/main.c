@@ -8,6 +8,9 @@
 #include <string.h>
 
 #include "mem.h"
+#if defined(TOYWASM_ENABLE_PROFILER)
+#include "profiler.h"
+#endif
 #include "repl.h"
 #include "str_to_uint.h"
 #include "toywasm_config.h"
@@ -41,11 +44,20 @@ enum longopt {
         opt_max_memory,
 #endif
         opt_max_stack_cells,
+        opt_module_arena,
         opt_register,
         opt_repl,
         opt_repl_prompt,
         opt_print_build_options,
         opt_print_stats,
+#if defined(TOYWASM_ENABLE_PROFILER)
+        opt_profile,
+        opt_profile_format,
+        opt_profile_interval,
+#endif
+#if defined(TOYWASM_ENABLE_WRITER)
+        opt_snapshot,
+#endif
         opt_timeout,
 #if defined(TOYWASM_ENABLE_TRACING)
         opt_trace,
@@ -154,6 +166,12 @@ static const struct option longopts[] = {
                 NULL,
                 opt_max_stack_cells,
         },
+        {
+                "module-arena",
+                no_argument,
+                NULL,
+                opt_module_arena,
+        },
         {
                 "repl",
                 no_argument,
@@ -178,6 +196,34 @@ static const struct option longopts[] = {
                 NULL,
                 opt_print_stats,
         },
+#if defined(TOYWASM_ENABLE_PROFILER)
+        {
+                "profile",
+                required_argument,
+                NULL,
+                opt_profile,
+        },
+        {
+                "profile-format",
+                required_argument,
+                NULL,
+                opt_profile_format,
+        },
+        {
+                "profile-interval",
+                required_argument,
+                NULL,
+                opt_profile_interval,
+        },
+#endif
+#if defined(TOYWASM_ENABLE_WRITER)
+        {
+                "snapshot",
+                required_argument,
+                NULL,
+                opt_snapshot,
+        },
+#endif
         {
                 "timeout",
                 required_argument,
@@ -261,6 +307,14 @@ static const char *opt_metavars[] = {
         [opt_wasi_littlefs_dir] = "LITTLEFS_IMAGE_PATH::LFS_DIR[::GUEST_DIR]",
         [opt_wasi_littlefs_block_size] = "BLOCK_SIZE",
         [opt_wasi_littlefs_disk_version] = "DISK_VERSION",
+#endif
+#if defined(TOYWASM_ENABLE_PROFILER)
+        [opt_profile] = "OUTPUT_PATH",
+        [opt_profile_format] = "pprof|folded",
+        [opt_profile_interval] = "INTERVAL_MS",
+#endif
+#if defined(TOYWASM_ENABLE_WRITER)
+        [opt_snapshot] = "OUTPUT_PATH",
 #endif
         [opt_timeout] = "TIMEOUT_MS",
 #if defined(TOYWASM_ENABLE_TRACING)
@@ -313,6 +367,12 @@ print_usage(void)
 #endif
         printf("\tLoad a module and invoke its function\n\t\ttoywasm --load "
                "module --invoke \"func arg1 arg2\"\n");
+        printf("\tRead a module from stdin\n\t\tgzip -dc module.gz | "
+               "toywasm -\n");
+#if defined(TOYWASM_ENABLE_WRITER)
+        printf("\tPre-initialize a module and write a snapshot\n\t\ttoywasm "
+               "--load module --invoke init --snapshot out.wasm\n");
+#endif
 }
 
 int
@@ -333,6 +393,12 @@ main(int argc, char *const *argv)
 #if defined(TOYWASM_ENABLE_DYLD)
         VEC(, const char *) dyld_paths;
         VEC_INIT(dyld_paths);
+        struct dyld_module_cache dyld_module_cache;
+#endif
+#if defined(TOYWASM_ENABLE_PROFILER)
+        const char *profile_path = NULL;
+        enum profiler_format profile_format = PROFILER_FORMAT_PPROF;
+        struct profiler *profiler = NULL;
 #endif
         int ret;
         int longidx;
@@ -369,6 +435,9 @@ main(int argc, char *const *argv)
         wasi_mctx->parent = mctx;
         dyld_mctx->parent = mctx;
         impobj_mctx->parent = mctx;
+#if defined(TOYWASM_ENABLE_DYLD)
+        dyld_module_cache_init(&dyld_module_cache, dyld_mctx);
+#endif
 
         state = malloc(sizeof(*state));
         if (state == NULL) {
@@ -382,6 +451,10 @@ main(int argc, char *const *argv)
         state->dyld_mctx = dyld_mctx;
         state->impobj_mctx = impobj_mctx;
         struct repl_options *opts = &state->opts;
+#if defined(TOYWASM_ENABLE_DYLD)
+        /* share modules among multiple --load */
+        opts->dyld_options.module_cache = &dyld_module_cache;
+#endif
         size_t limit;
         while ((ret = getopt_long(argc, argv, "", longopts, &longidx)) != -1) {
                 switch (ret) {
@@ -477,6 +550,9 @@ main(int argc, char *const *argv)
                                 goto fail;
                         }
                         break;
+                case opt_module_arena:
+                        opts->load_options.use_arena = true;
+                        break;
                 case opt_register:
                         ret = toywasm_repl_register(state, NULL, optarg);
                         if (ret != 0) {
@@ -496,6 +572,51 @@ main(int argc, char *const *argv)
                 case opt_print_stats:
                         opts->print_stats = true;
                         break;
+#if defined(TOYWASM_ENABLE_PROFILER)
+                case opt_profile:
+                        if (profiler == NULL) {
+                                ret = profiler_create(mctx, &profiler);
+                                if (ret != 0) {
+                                        goto fail;
+                                }
+                                opts->profiler = profiler;
+#if defined(TOYWASM_ENABLE_DYLD)
+                                opts->dyld_options.profiler = profiler;
+#endif
+                        }
+                        profile_path = optarg;
+                        break;
+                case opt_profile_format:
+                        if (!strcmp(optarg, "pprof")) {
+                                profile_format = PROFILER_FORMAT_PPROF;
+                        } else if (!strcmp(optarg, "folded")) {
+                                profile_format = PROFILER_FORMAT_FOLDED;
+                        } else {
+                                xlog_error("unknown profile format: %s",
+                                           optarg);
+                                goto fail;
+                        }
+                        break;
+                case opt_profile_interval:
+                        if (profiler == NULL) {
+                                xlog_error("--profile-interval requires "
+                                           "--profile");
+                                goto fail;
+                        }
+                        ret = str_to_u32(optarg, 0, &profiler->interval_ms);
+                        if (ret != 0 || profiler->interval_ms == 0) {
+                                goto fail;
+                        }
+                        break;
+#endif
+#if defined(TOYWASM_ENABLE_WRITER)
+                case opt_snapshot:
+                        ret = toywasm_repl_snapshot(state, NULL, optarg);
+                        if (ret != 0) {
+                                goto fail;
+                        }
+                        break;
+#endif
                 case opt_timeout:
                         toywasm_repl_set_timeout(state, atoi(optarg));
                         break;
@@ -659,12 +780,34 @@ main(int argc, char *const *argv)
         exit_status = 0;
 #endif
 fail:
+#if defined(TOYWASM_ENABLE_PROFILER)
+        /*
+         * note: write before toywasm_repl_reset destroys modules.
+         * (it's fine with profiler_forget_module, but less work.)
+         */
+        if (profiler != NULL) {
+                ret = profiler_write(profiler, profile_path, profile_format);
+                if (ret != 0) {
+                        xlog_error("failed to write profile to %s: %d",
+                                   profile_path, ret);
+                }
+                profiler_destroy(profiler);
+                opts->profiler = NULL;
+#if defined(TOYWASM_ENABLE_DYLD)
+                opts->dyld_options.profiler = NULL;
+#endif
+        }
+#endif
         toywasm_repl_reset(state);
 #if defined(TOYWASM_ENABLE_WASI)
         VEC_FREE(mctx, wasi_envs);
 #endif
 #if defined(TOYWASM_ENABLE_DYLD)
         VEC_FREE(mctx, dyld_paths);
+        if (opts->print_stats) {
+                dyld_module_cache_print_stats(&dyld_module_cache);
+        }
+        dyld_module_cache_clear(&dyld_module_cache);
 #endif
         free(state);
         mem_context_clear(dyld_mctx);
@@ -19,6 +19,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "cconv.h"
 #include "endian.h"
@@ -31,6 +32,7 @@
 #include "module.h"
 #include "module_writer.h"
 #include "nbio.h"
+#include "profiler.h"
 #include "repl.h"
 #include "report.h"
 #include "str_to_uint.h"
@@ -134,6 +136,13 @@ repl_unload(struct repl_state *state, struct repl_module_state *mod)
                 mod->inst = NULL;
         }
         if (mod->module != NULL) {
+#if defined(TOYWASM_ENABLE_PROFILER)
+                /* the profiler can have samples from the module */
+                if (state->opts.profiler != NULL) {
+                        profiler_forget_module(state->opts.profiler,
+                                               mod->module);
+                }
+#endif
                 module_destroy(mod->module_mctx, mod->module);
                 mod->module = NULL;
         }
@@ -177,7 +186,7 @@ repl_unload_u(struct repl_state *state, struct repl_module_state_u *mod_u)
 {
 #if defined(TOYWASM_ENABLE_DYLD)
         if (state->opts.enable_dyld) {
-                struct dyld *d = &mod_u->u.dyld;
+                struct dyld *d = mod_u->u.dyld;
 #if defined(TOYWASM_ENABLE_DYLD)
                 if (state->opts.print_stats) {
                         nbio_printf("=== dyld memory consumption immediately "
@@ -186,6 +195,7 @@ repl_unload_u(struct repl_state *state, struct repl_module_state_u *mod_u)
                 }
 #endif
                 dyld_clear(d);
+                mem_free(state->dyld_mctx, d, sizeof(*d));
                 return;
         }
 #endif
@@ -495,8 +505,33 @@ print_trap(const struct exec_context *ctx, const struct trap_info *trap)
         print_trace(ctx); /* XXX nbio_printf */
 }
 
+static int
+check_timeout(const struct timespec *abstimeout)
+{
+        struct timespec now;
+        int ret = timespec_now(CLOCK_MONOTONIC, &now);
+        if (ret != 0) {
+                goto fail;
+        }
+        if (timespec_cmp(&now, abstimeout) > 0) {
+                xlog_error("execution timed out");
+                ret = ETIMEDOUT;
+                goto fail;
+        }
+        ret = 0;
+fail:
+        return ret;
+}
+
+static int
+timeout_intr_handler(struct exec_context *ctx, void *arg)
+{
+        const struct timespec *abstimeout = arg;
+        return check_timeout(abstimeout);
+}
+
 static void
-setup_timeout(struct exec_context *ctx)
+setup_timeout(struct exec_context *ctx, const struct timespec *abstimeout)
 {
         /*
          * REVISIT: this timeout logic is a bit broken because it
@@ -533,24 +568,9 @@ setup_timeout(struct exec_context *ctx)
          * by ourselves. but i feel it's too much for now.
          */
         ctx->user_intr_delay = 1;
-}
-
-static int
-check_timeout(const struct timespec *abstimeout)
-{
-        struct timespec now;
-        int ret = timespec_now(CLOCK_MONOTONIC, &now);
-        if (ret != 0) {
-                goto fail;
-        }
-        if (timespec_cmp(&now, abstimeout) > 0) {
-                xlog_error("execution timed out");
-                ret = ETIMEDOUT;
-                goto fail;
-        }
-        ret = 0;
-fail:
-        return ret;
+        /* aot functions can't return the interrupt to us */
+        ctx->user_intr_handler = timeout_intr_handler;
+        ctx->user_intr_handler_arg = (void *)abstimeout;
 }
 
 static int
@@ -563,8 +583,11 @@ repl_exec_init(struct repl_state *state, struct repl_module_state *mod,
         int ret;
         exec_context_init(ctx, mod->inst, mod->instance_mctx);
         ctx->options = state->opts.exec_options;
+#if defined(TOYWASM_ENABLE_PROFILER)
+        ctx->profiler = state->opts.profiler;
+#endif
         if (has_timeout) {
-                setup_timeout(ctx);
+                setup_timeout(ctx, &state->abstimeout);
         }
         ret = instance_execute_init(ctx);
         do {
@@ -605,6 +628,23 @@ set_memory(struct repl_state *state, struct meminst *mem)
 #endif
 }
 
+static int
+repl_read_stdin(void *arg, void *buf, size_t bufsize, size_t *resultp)
+{
+        ssize_t ssz;
+        do {
+                ssz = read(STDIN_FILENO, buf, bufsize);
+        } while (ssz == -1 && errno == EINTR);
+        if (ssz == -1) {
+                return errno;
+        }
+        *resultp = ssz;
+        return 0;
+}
+
+/*
+ * Note: if mod->buf is NULL, read the module from stdin.
+ */
 static int
 repl_load_from_buf(struct repl_state *state, const char *modname,
                    struct repl_module_state *mod, bool trap_ok)
@@ -629,8 +669,19 @@ repl_load_from_buf(struct repl_state *state, const char *modname,
         struct load_context ctx;
         load_context_init(&ctx, mod->module_mctx);
         ctx.options = state->opts.load_options;
-        ret = module_create(&mod->module, mod->buf, mod->buf + mod->bufsize,
-                            &ctx);
+        if (mod->buf != NULL) {
+                ret = module_create(&mod->module, mod->buf,
+                                    mod->buf + mod->bufsize, &ctx);
+        } else {
+                bool orig;
+                ret = set_nonblocking(STDIN_FILENO, false, &orig);
+                if (ret == 0) {
+                        ret = module_create_from_reader(
+                                &mod->module, repl_read_stdin, NULL, &ctx);
+                        int ret2 = set_nonblocking(STDIN_FILENO, orig, NULL);
+                        assert(ret2 == 0); /* no good way to recover */
+                }
+        }
         if (ret != 0) {
                 const char *msg = report_getmessage(&ctx.report);
                 xlog_error("load/validation error: %s", msg);
@@ -647,6 +698,9 @@ repl_load_from_buf(struct repl_state *state, const char *modname,
                             mod->module_mctx->allocated);
         }
 #endif
+        if (state->opts.print_stats) {
+                module_print_stats(mod->module);
+        }
 
         struct import_object *imports = state->imports;
 #if defined(TOYWASM_ENABLE_WASI_THREADS)
@@ -734,35 +788,45 @@ toywasm_repl_load(struct repl_state *state, const char *modname,
         struct repl_module_state_u *mod_u = &VEC_NEXTELEM(state->modules);
 #if defined(TOYWASM_ENABLE_DYLD)
         if (state->opts.enable_dyld) {
-                if (trap_ok) {
-                        return ENOTSUP; /* not implemented */
+                /*
+                 * Note: trap_ok is not implemented for dyld.
+                 * a trap in the init functions fails the load.
+                 */
+                struct dyld *d = mem_alloc(state->dyld_mctx, sizeof(*d));
+                if (d == NULL) {
+                        return ENOMEM;
                 }
-                struct dyld *d = &mod_u->u.dyld;
                 dyld_init(d, state->dyld_mctx);
                 d->opts = state->opts.dyld_options;
                 d->opts.base_import_obj = state->imports;
                 ret = dyld_load(d, filename);
                 if (ret != 0) {
+                        mem_free(state->dyld_mctx, d, sizeof(*d));
                         return ret;
                 }
                 set_memory(state, dyld_memory(d));
                 ret = dyld_execute_init_funcs(d);
                 if (ret != 0) {
                         dyld_clear(d);
+                        mem_free(state->dyld_mctx, d, sizeof(*d));
                         return ret;
                 }
+                mod_u->u.dyld = d;
                 state->modules.lsize++;
                 return 0;
         }
 #endif
         struct repl_module_state *mod = &mod_u->u.repl;
         memset(mod, 0, sizeof(*mod));
-        ret = map_file(filename, (void **)&mod->buf, &mod->bufsize);
-        if (ret != 0) {
-                xlog_error("failed to map %s (error %d)", filename, ret);
-                goto fail;
+        if (strcmp(filename, "-") != 0) {
+                ret = map_file(filename, (void **)&mod->buf, &mod->bufsize);
+                if (ret != 0) {
+                        xlog_error("failed to map %s (error %d)", filename,
+                                   ret);
+                        goto fail;
+                }
+                mod->buf_mapped = true;
         }
-        mod->buf_mapped = true;
         ret = repl_load_from_buf(state, modname, mod, trap_ok);
         if (ret != 0) {
                 goto fail;
@@ -843,6 +907,34 @@ fail:
 #endif
 }
 
+int
+toywasm_repl_snapshot(struct repl_state *state, const char *modname,
+                      const char *filename)
+{
+#if defined(TOYWASM_ENABLE_WRITER)
+        if (state->modules.lsize == 0) {
+                return EPROTO;
+        }
+        struct repl_module_state *mod;
+        int ret;
+        ret = find_mod(state, modname, &mod);
+        if (ret != 0) {
+                goto fail;
+        }
+        ret = module_write_snapshot(filename, mod->inst);
+        if (ret != 0) {
+                xlog_error("failed to write snapshot %s (error %d)", filename,
+                           ret);
+                goto fail;
+        }
+        ret = 0;
+fail:
+        return ret;
+#else
+        return ENOTSUP;
+#endif
+}
+
 int
 toywasm_repl_register(struct repl_state *state, const char *modname,
                       const char *register_name)
@@ -1021,14 +1113,22 @@ repl_print_result(const struct resulttype *rt, const struct val *vals)
                         }
                         break;
 #if defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING)
-                case TYPE_exnref:
-                        if (val->u.exnref.tag == NULL) {
+                case TYPE_exnref: {
+#if defined(TOYWASM_USE_HEAP_EXNREF)
+                        const struct wasm_exception *exc = val->u.exnref;
+                        const struct taginst *tag =
+                                exc != NULL ? exc->tag : NULL;
+#else
+                        const struct taginst *tag = val->u.exnref.tag;
+#endif
+                        if (tag == NULL) {
                                 nbio_printf("%snull:exnref", sep);
                         } else {
                                 nbio_printf("%s%" PRIuPTR ":exnref", sep,
-                                            (uintptr_t)val->u.exnref.tag);
+                                            (uintptr_t)tag);
                         }
                         break;
+                }
 #endif
                 default:
                         xlog_printf("print_result: unimplementd type %02x\n",
@@ -1129,7 +1229,7 @@ exec_func(struct exec_context *ctx, uint32_t funcidx,
         int ret;
         *trapp = NULL;
         if (abstimeout != NULL) {
-                setup_timeout(ctx);
+                setup_timeout(ctx, abstimeout);
         }
         assert(ctx->stack.lsize == 0);
         ret = exec_push_vals(ctx, ptype, param);
@@ -1198,7 +1298,7 @@ toywasm_repl_invoke(struct repl_state *state, const char *modname,
         struct mem_context *mctx;
 #if defined(TOYWASM_ENABLE_DYLD)
         if (state->opts.enable_dyld) {
-                struct dyld *d = &mod_u->u.dyld;
+                struct dyld *d = mod_u->u.dyld;
                 inst = dyld_main_object_instance(d);
                 mctx = state->mctx;
         } else
@@ -1254,6 +1354,9 @@ toywasm_repl_invoke(struct repl_state *state, const char *modname,
         struct exec_context *ctx = &ctx0;
         exec_context_init(ctx, inst, mctx);
         ctx->options = state->opts.exec_options;
+#if defined(TOYWASM_ENABLE_PROFILER)
+        ctx->profiler = state->opts.profiler;
+#endif
         const struct trap_info *trap;
 #if defined(TOYWASM_ENABLE_WASI_THREADS)
         struct wasi_threads_instance *wasi_threads = state->wasi_threads;
@@ -1469,6 +1572,11 @@ repl_module_subcmd(struct repl_state *state, const char *cmd,
                 if (ret != 0) {
                         goto fail;
                 }
+        } else if (!strcmp(cmd, "snapshot") && opt != NULL) {
+                ret = toywasm_repl_snapshot(state, modname, opt);
+                if (ret != 0) {
+                        goto fail;
+                }
         } else if (!strcmp(cmd, "global-get") && opt != NULL) {
                 ret = repl_global_get(state, modname, opt);
                 if (ret != 0) {
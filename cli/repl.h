@@ -10,6 +10,8 @@
 #include "options.h"
 #include "type.h"
 
+struct profiler;
+
 struct repl_options {
         const char *prompt;
         struct repl_state *state;
@@ -21,6 +23,9 @@ struct repl_options {
 #endif
         struct load_options load_options;
         struct exec_options exec_options;
+#if defined(TOYWASM_ENABLE_PROFILER)
+        struct profiler *profiler; /* attached to exec_contexts if non-NULL */
+#endif
 #if defined(TOYWASM_ENABLE_WASI_LITTLEFS)
         struct wasi_littlefs_mount_cfg wasi_littlefs_mount_cfg;
 #endif
@@ -44,7 +49,11 @@ struct repl_module_state {
 struct repl_module_state_u {
         union {
 #if defined(TOYWASM_ENABLE_DYLD)
-                struct dyld dyld;
+                /*
+                 * Note: struct dyld is not relocatable.
+                 * (it's referenced by its objects)
+                 */
+                struct dyld *dyld;
 #endif
                 struct repl_module_state repl;
         } u;
@@ -88,6 +97,8 @@ int toywasm_repl_load(struct repl_state *state, const char *modname,
                       const char *filename, bool trap_ok);
 int toywasm_repl_register(struct repl_state *state, const char *modname,
                           const char *register_name);
+int toywasm_repl_snapshot(struct repl_state *state, const char *modname,
+                          const char *filename);
 int toywasm_repl_invoke(struct repl_state *state, const char *modname,
                         const char *cmd, uint32_t *exitcodep,
                         bool print_result);
@@ -55,6 +55,19 @@ cmake_dependent_option(TOYWASM_ENABLE_TRACING_INSN
     "TOYWASM_ENABLE_TRACING"
     OFF)
 
+# per-opcode execution counters in exec_stat. (for --print-stats)
+# much cheaper than TOYWASM_ENABLE_TRACING_INSN, but still not free.
+option(TOYWASM_ENABLE_INSN_STATS "Enable per-opcode execution counters" OFF)
+cmake_dependent_option(TOYWASM_ENABLE_INSN_STATS_CYCLES
+    "Enable per-opcode cycle counts"
+    OFF
+    "TOYWASM_ENABLE_INSN_STATS"
+    OFF)
+
+# call-path counters, timers and histograms in exec_stat.
+# (frame setup, stack growth, locals zeroing, host calls, restarts)
+option(TOYWASM_ENABLE_CALL_STATS "Enable call-path statistics" OFF)
+
 # Sort module exports to speed up the uniqueness check.
 # O(n^2) -> O(n*log(n))
 option(TOYWASM_SORT_EXPORTS "Sort module export" ON)
@@ -74,16 +87,49 @@ set(TOYWASM_JUMP_CACHE2_SIZE "4" CACHE STRING "The size of jump cache")
 # TOYWASM_USE_LOCALS_CACHE=OFF -> slightly smaller code and exec_context
 option(TOYWASM_USE_LOCALS_CACHE "Enable current_locals" ON)
 
+# TOYWASM_USE_GLOBALS_CACHE=ON -> global.get/global.set skip an indirection
+# TOYWASM_USE_GLOBALS_CACHE=OFF -> slightly smaller code and exec_context
+# Off by default because the difference was within the noise even for
+# a loop doing nothing but global.get/global.set. (< 1% on x86-64)
+option(TOYWASM_USE_GLOBALS_CACHE "Cache instance globals in exec_context" OFF)
+
+# TOYWASM_USE_MEMORY_CACHE=ON -> faster memory access (for memory 0)
+# TOYWASM_USE_MEMORY_CACHE=OFF -> slightly smaller code and exec_context
+option(TOYWASM_USE_MEMORY_CACHE "Cache memory 0 in exec_context" ON)
+
 # use separate stack for operand stack and function locals or not
 option(TOYWASM_USE_SEPARATE_LOCALS "Separate locals and stack" ON)
 
+# TOYWASM_USE_RESERVED_STACK=ON places the execution stacks (frames,
+# labels, locals and operands) in a single address range reserved for
+# each exec_context, instead of growing them with realloc.
+# it makes calls a bit cheaper. it requires mmap.
+# the number of frames, labels and cells are capped by
+# TOYWASM_RESERVED_STACK_FRAMES, TOYWASM_RESERVED_STACK_LABELS and
+# TOYWASM_RESERVED_STACK_CELLS respectively.
+# only the used part of the range is accounted to the exec_context's
+# mem_context.
+option(TOYWASM_USE_RESERVED_STACK "Reserve the execution stacks" OFF)
+set(TOYWASM_RESERVED_STACK_FRAMES "262144" CACHE STRING
+    "The max number of frames with TOYWASM_USE_RESERVED_STACK")
+set(TOYWASM_RESERVED_STACK_LABELS "1048576" CACHE STRING
+    "The max number of labels with TOYWASM_USE_RESERVED_STACK")
+set(TOYWASM_RESERVED_STACK_CELLS "4194304" CACHE STRING
+    "The max number of cells with TOYWASM_USE_RESERVED_STACK")
+
 # control how to store values for wasm operand stack, locals, and tables.
 #
 # TOYWASM_USE_SMALL_CELLS=ON
+# TOYWASM_USE_64BIT_CELLS=OFF
 #    i32,f32 -> occupies 32 bit memory
 #    i64,f64 -> occupies 64 bit memory
 #    v128    -> occupies 128 bit memory
 #
+# TOYWASM_USE_SMALL_CELLS=ON
+# TOYWASM_USE_64BIT_CELLS=ON
+#    i32,f32,i64,f64,refs -> occupies 64 bit memory
+#    v128                 -> occupies 128 bit memory
+#
 # TOYWASM_USE_SMALL_CELLS=OFF
 # TOYWASM_ENABLE_WASM_SIMD=OFF
 #    any value occupies 64 bit memory
@@ -94,6 +140,11 @@ option(TOYWASM_USE_SEPARATE_LOCALS "Separate locals and stack" ON)
 #
 # TOYWASM_USE_SMALL_CELLS=OFF produces simpler and in many cases faster code.
 option(TOYWASM_USE_SMALL_CELLS "Use smaller stack cells" ON)
+cmake_dependent_option(TOYWASM_USE_64BIT_CELLS
+    "Use 64-bit stack cells"
+    OFF
+    "TOYWASM_USE_SMALL_CELLS"
+    OFF)
 
 # enable indexes for faster lookup for resulttype and localtype respectively.
 cmake_dependent_option(TOYWASM_USE_RESULTTYPE_CELLIDX
@@ -138,6 +189,19 @@ option(TOYWASM_ENABLE_WASM_SIMD "Enable SIMD" ON)
 # enable each wasm proposals.
 option(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING "Enable exception-handling proposal" OFF)
 set(TOYWASM_EXCEPTION_MAX_CELLS "4" CACHE STRING "The max size of exception")
+# TOYWASM_USE_HEAP_EXNREF=ON
+#   exnref is a pointer to a reference-counted exception object owned
+#   by the instance which created it. struct val doesn't need to be
+#   large enough to hold an exception. TOYWASM_EXCEPTION_MAX_CELLS is
+#   not used. an exnref can't outlive the instance which created it.
+#   not available with TOYWASM_ENABLE_WASM_THREADS.
+# TOYWASM_USE_HEAP_EXNREF=OFF
+#   exnref is a copyable value containing the exception.
+cmake_dependent_option(TOYWASM_USE_HEAP_EXNREF
+    "Use heap-allocated exception objects for exnref"
+    OFF
+    "TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING;NOT TOYWASM_ENABLE_WASM_THREADS"
+    OFF)
 option(TOYWASM_ENABLE_WASM_EXTENDED_CONST "Enable extended-const proposal" OFF)
 option(TOYWASM_ENABLE_WASM_MULTI_MEMORY "Enable multi-memory proposal" OFF)
 option(TOYWASM_ENABLE_WASM_TAILCALL "Enable WASM tail-call proposal" OFF)
@@ -145,6 +209,41 @@ option(TOYWASM_ENABLE_WASM_THREADS "Enable WASM threads proposal" OFF)
 option(TOYWASM_ENABLE_WASM_CUSTOM_PAGE_SIZES "Enable WASM custom-page-sizes proposal" OFF)
 option(TOYWASM_ENABLE_WASM_NAME_SECTION "Enable name section" ON)
 
+# sampling profiler. (see lib/profiler.h)
+option(TOYWASM_ENABLE_PROFILER "Enable sampling profiler" ON)
+
+# functions translated to C ahead of time. (see lib/aot.h)
+option(TOYWASM_ENABLE_AOT "Enable ahead-of-time compiled functions" OFF)
+
+# a baseline jit for x86-64, built on the aot runtime. (see lib/jit.h)
+# a function is compiled after TOYWASM_JIT_THRESHOLD calls.
+cmake_dependent_option(TOYWASM_ENABLE_JIT
+    "Enable baseline jit"
+    OFF
+    "TOYWASM_ENABLE_AOT;NOT TOYWASM_ENABLE_WASM_THREADS"
+    OFF)
+set(TOYWASM_JIT_THRESHOLD "1000" CACHE STRING
+    "The number of calls before jit-compiling a function")
+if(TOYWASM_ENABLE_JIT)
+# the jit queries the stack of the thread. (pthread_getattr_np)
+set(CMAKE_C_FLAGS "${CMAKE_C_FLAGS} -pthread")
+set(CMAKE_EXE_LINKER_FLAGS "${CMAKE_EXE_LINKER_FLAGS} -pthread")
+# other backends, including arm64, are not implemented yet. (see lib/jit.h)
+# on such hosts, the jit builds but leaves every function to the
+# interpreter.
+if(TRIPLET)
+set(JIT_TARGET_ARCH "${TRIPLET}")
+else()
+set(JIT_TARGET_ARCH "${CMAKE_SYSTEM_PROCESSOR}")
+endif()
+if(NOT JIT_TARGET_ARCH MATCHES "^(x86_64|amd64|AMD64)" OR WIN32 OR
+   CMAKE_OSX_ARCHITECTURES MATCHES "arm64")
+message(WARNING "TOYWASM_ENABLE_JIT: the jit only supports x86-64 "
+    "(System V ABI). it's a no-op for ${JIT_TARGET_ARCH} "
+    "${CMAKE_OSX_ARCHITECTURES}")
+endif()
+endif()
+
 # enable WASI.
 option(TOYWASM_ENABLE_WASI "Enable WASI snapshow preview1" ON)
 
@@ -160,6 +259,17 @@ cmake_dependent_option(TOYWASM_ENABLE_LITTLEFS_STATS
     "TOYWASM_ENABLE_WASI"
     OFF)
 
+# use linux io_uring for WASI file i/o.
+# it allows other threads to run while a thread is waiting for
+# a file i/o. (mainly for TOYWASM_USE_USER_SCHED)
+# a read/write request is capped to 1MiB. larger requests end up with
+# short reads/writes.
+cmake_dependent_option(TOYWASM_ENABLE_WASI_IO_URING
+    "Use io_uring for WASI file i/o (linux only)"
+    OFF
+    "TOYWASM_ENABLE_WASI"
+    OFF)
+
 # enable wasi-threads.
 cmake_dependent_option(TOYWASM_ENABLE_WASI_THREADS
     "Enable wasi-threads proposal"
@@ -181,6 +291,12 @@ option(TOYWASM_ENABLE_COVERAGE "Enable coverage" OFF)
 
 option(TOYWASM_BUILD_UNITTEST "Build toywasm-test" ON)
 option(TOYWASM_BUILD_CLI "Build toywasm command" ON)
+# toywasm-bench and the "benchmark" target. see benchmark/suite.
+cmake_dependent_option(TOYWASM_BUILD_BENCHMARK
+    "Build toywasm-bench"
+    OFF
+    "CMAKE_SYSTEM_NAME STREQUAL Linux"
+    OFF)
 
 if(TOYWASM_ENABLE_FUZZER)
 add_compile_options(-fsanitize=fuzzer-no-link)
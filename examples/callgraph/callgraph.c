@@ -137,12 +137,14 @@ callgraph(const struct module *m)
                 if (e->mode != ELEM_MODE_ACTIVE) {
                         continue;
                 }
-                if (e->funcs == NULL) {
+                if (!element_has_funcidxes(e)) {
                         continue;
                 }
+                struct element_funcidx_iter it;
+                element_funcidx_iter_init(&it, e, 0);
                 uint32_t j;
                 for (j = 0; j < e->init_size; j++) {
-                        uint32_t funcidx = e->funcs[j];
+                        uint32_t funcidx = element_funcidx_iter_next(&it);
                         uint32_t tableidx = e->table;
                         jsonutil_pack_and_append(a, "{sisi}", "tableidx",
                                                  tableidx, "funcidx", funcidx);
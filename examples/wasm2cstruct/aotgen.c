@@ -0,0 +1,925 @@
+/*
+ * translate function bodies to C. (wasm2cstruct --aot)
+ * see lib/aot.h for the runtime side.
+ *
+ * each operand stack slot and local is a uint64_t variable. as the
+ * operand stack height is static in wasm, the slot for an instruction
+ * is known at the translation time. blocks are translated to labels and
+ * gotos. a branch copies the values it carries to the slots where
+ * the target expects them.
+ *
+ * a function is translated only when all of its instructions are
+ * supported. the rest are left to the interpreter. notably:
+ *
+ * - float and vector types
+ * - calls to imported or interpreted functions, call_indirect
+ * - memory.grow, bulk memory, atomics, memory64, multi-memory
+ * - reference types, exception handling, tail calls
+ * - "if" with parameters
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <toywasm/cell.h>
+#include <toywasm/leb128.h>
+#include <toywasm/type.h>
+
+#include "aotgen.h"
+
+enum aot_opkind {
+        AOT_UNOP,
+        AOT_BINOP,
+        AOT_DIVOP,
+        AOT_LOAD,
+        AOT_STORE,
+};
+
+/* instructions which map to a helper in lib/aot.h */
+static const struct aot_op {
+        uint8_t op;
+        uint8_t kind;
+        const char *name;
+} aot_ops[] = {
+        {0x28, AOT_LOAD, "i32_load"},
+        {0x29, AOT_LOAD, "i64_load"},
+        {0x2c, AOT_LOAD, "i32_load8_s"},
+        {0x2d, AOT_LOAD, "i32_load8_u"},
+        {0x2e, AOT_LOAD, "i32_load16_s"},
+        {0x2f, AOT_LOAD, "i32_load16_u"},
+        {0x30, AOT_LOAD, "i64_load8_s"},
+        {0x31, AOT_LOAD, "i64_load8_u"},
+        {0x32, AOT_LOAD, "i64_load16_s"},
+        {0x33, AOT_LOAD, "i64_load16_u"},
+        {0x34, AOT_LOAD, "i64_load32_s"},
+        {0x35, AOT_LOAD, "i64_load32_u"},
+        {0x36, AOT_STORE, "i32_store"},
+        {0x37, AOT_STORE, "i64_store"},
+        {0x3a, AOT_STORE, "i32_store8"},
+        {0x3b, AOT_STORE, "i32_store16"},
+        {0x3c, AOT_STORE, "i64_store8"},
+        {0x3d, AOT_STORE, "i64_store16"},
+        {0x3e, AOT_STORE, "i64_store32"},
+        {0x45, AOT_UNOP, "i32_eqz"},
+        {0x46, AOT_BINOP, "i32_eq"},
+        {0x47, AOT_BINOP, "i32_ne"},
+        {0x48, AOT_BINOP, "i32_lt_s"},
+        {0x49, AOT_BINOP, "i32_lt_u"},
+        {0x4a, AOT_BINOP, "i32_gt_s"},
+        {0x4b, AOT_BINOP, "i32_gt_u"},
+        {0x4c, AOT_BINOP, "i32_le_s"},
+        {0x4d, AOT_BINOP, "i32_le_u"},
+        {0x4e, AOT_BINOP, "i32_ge_s"},
+        {0x4f, AOT_BINOP, "i32_ge_u"},
+        {0x50, AOT_UNOP, "i64_eqz"},
+        {0x51, AOT_BINOP, "i64_eq"},
+        {0x52, AOT_BINOP, "i64_ne"},
+        {0x53, AOT_BINOP, "i64_lt_s"},
+        {0x54, AOT_BINOP, "i64_lt_u"},
+        {0x55, AOT_BINOP, "i64_gt_s"},
+        {0x56, AOT_BINOP, "i64_gt_u"},
+        {0x57, AOT_BINOP, "i64_le_s"},
+        {0x58, AOT_BINOP, "i64_le_u"},
+        {0x59, AOT_BINOP, "i64_ge_s"},
+        {0x5a, AOT_BINOP, "i64_ge_u"},
+        {0x67, AOT_UNOP, "i32_clz"},
+        {0x68, AOT_UNOP, "i32_ctz"},
+        {0x69, AOT_UNOP, "i32_popcnt"},
+        {0x6a, AOT_BINOP, "i32_add"},
+        {0x6b, AOT_BINOP, "i32_sub"},
+        {0x6c, AOT_BINOP, "i32_mul"},
+        {0x6d, AOT_DIVOP, "i32_div_s"},
+        {0x6e, AOT_DIVOP, "i32_div_u"},
+        {0x6f, AOT_DIVOP, "i32_rem_s"},
+        {0x70, AOT_DIVOP, "i32_rem_u"},
+        {0x71, AOT_BINOP, "i32_and"},
+        {0x72, AOT_BINOP, "i32_or"},
+        {0x73, AOT_BINOP, "i32_xor"},
+        {0x74, AOT_BINOP, "i32_shl"},
+        {0x75, AOT_BINOP, "i32_shr_s"},
+        {0x76, AOT_BINOP, "i32_shr_u"},
+        {0x77, AOT_BINOP, "i32_rotl"},
+        {0x78, AOT_BINOP, "i32_rotr"},
+        {0x79, AOT_UNOP, "i64_clz"},
+        {0x7a, AOT_UNOP, "i64_ctz"},
+        {0x7b, AOT_UNOP, "i64_popcnt"},
+        {0x7c, AOT_BINOP, "i64_add"},
+        {0x7d, AOT_BINOP, "i64_sub"},
+        {0x7e, AOT_BINOP, "i64_mul"},
+        {0x7f, AOT_DIVOP, "i64_div_s"},
+        {0x80, AOT_DIVOP, "i64_div_u"},
+        {0x81, AOT_DIVOP, "i64_rem_s"},
+        {0x82, AOT_DIVOP, "i64_rem_u"},
+        {0x83, AOT_BINOP, "i64_and"},
+        {0x84, AOT_BINOP, "i64_or"},
+        {0x85, AOT_BINOP, "i64_xor"},
+        {0x86, AOT_BINOP, "i64_shl"},
+        {0x87, AOT_BINOP, "i64_shr_s"},
+        {0x88, AOT_BINOP, "i64_shr_u"},
+        {0x89, AOT_BINOP, "i64_rotl"},
+        {0x8a, AOT_BINOP, "i64_rotr"},
+        {0xa7, AOT_UNOP, "i32_wrap_i64"},
+        {0xac, AOT_UNOP, "i64_extend_i32_s"},
+        {0xad, AOT_UNOP, "i64_extend_i32_u"},
+        {0xc0, AOT_UNOP, "i32_extend8_s"},
+        {0xc1, AOT_UNOP, "i32_extend16_s"},
+        {0xc2, AOT_UNOP, "i64_extend8_s"},
+        {0xc3, AOT_UNOP, "i64_extend16_s"},
+        {0xc4, AOT_UNOP, "i64_extend32_s"},
+};
+
+struct aot_label {
+        uint8_t op; /* block, loop, if. 0 for the function body. */
+        bool has_else;
+        uint32_t id;
+        uint32_t height; /* the operand stack height excluding params */
+        uint32_t nparams;
+        uint32_t nresults;
+};
+
+struct aot_ctx {
+        FILE *out; /* NULL when only checking if it's supported */
+        int error;
+        const struct module *m;
+        const bool *translated; /* indexed by funcidx - nimportedfuncs */
+
+        struct aot_label *labels;
+        uint32_t nlabels;
+        uint32_t maxlabels;
+        uint32_t nextid;
+
+        uint32_t sp;
+        uint32_t maxsp;
+        uint32_t maxcallresults;
+
+        /* skipping unreachable code until the end of the block */
+        bool dead;
+        uint32_t deadnest;
+};
+
+static void
+emit(struct aot_ctx *c, const char *fmt, ...)
+{
+        va_list ap;
+        if (c->out == NULL || c->error != 0) {
+                return;
+        }
+        va_start(ap, fmt);
+        if (vfprintf(c->out, fmt, ap) < 0) {
+                c->error = errno;
+                assert(c->error > 0);
+        }
+        va_end(ap);
+}
+
+static const struct aot_op *
+find_op(uint8_t op)
+{
+        uint32_t i;
+        for (i = 0; i < sizeof(aot_ops) / sizeof(aot_ops[0]); i++) {
+                if (aot_ops[i].op == op) {
+                        return &aot_ops[i];
+                }
+        }
+        return NULL;
+}
+
+static bool
+is_int_type(enum valtype t)
+{
+        return t == TYPE_i32 || t == TYPE_i64;
+}
+
+static bool
+is_int_resulttype(const struct resulttype *rt)
+{
+        uint32_t i;
+        for (i = 0; i < rt->ntypes; i++) {
+                if (!is_int_type(rt->types[i])) {
+                        return false;
+                }
+        }
+        return true;
+}
+
+static const char *
+val_field(enum valtype t)
+{
+        return t == TYPE_i32 ? "i32" : "i64";
+}
+
+static const struct functype *
+local_functype(const struct module *m, uint32_t localidx)
+{
+        return &m->types[m->functypeidxes[localidx]];
+}
+
+static bool
+is_supported_func(const struct module *m, uint32_t localidx)
+{
+        const struct functype *ft = local_functype(m, localidx);
+        const struct localtype *lt = &m->funcs[localidx].localtype;
+        uint32_t i;
+        if (!is_int_resulttype(&ft->parameter) ||
+            !is_int_resulttype(&ft->result)) {
+                return false;
+        }
+        for (i = 0; i < lt->nlocalchunks; i++) {
+                if (!is_int_type(lt->localchunks[i].type)) {
+                        return false;
+                }
+        }
+        return true;
+}
+
+static bool
+is_supported_memory(const struct module *m)
+{
+        if (m->nimportedmems + m->nmems == 0) {
+                return false;
+        }
+        const struct memtype *mt = module_memtype(m, 0);
+        return (mt->flags & MEMTYPE_FLAG_64) == 0;
+}
+
+static int
+push_label(struct aot_ctx *c, uint8_t op, uint32_t nparams, uint32_t nresults)
+{
+        if (c->nlabels == c->maxlabels) {
+                uint32_t n = c->maxlabels * 2 + 8;
+                void *np = realloc(c->labels, n * sizeof(*c->labels));
+                if (np == NULL) {
+                        return ENOMEM;
+                }
+                c->labels = np;
+                c->maxlabels = n;
+        }
+        assert(c->sp >= nparams);
+        struct aot_label *l = &c->labels[c->nlabels++];
+        l->op = op;
+        l->has_else = false;
+        l->id = c->nextid++;
+        l->height = c->sp - nparams;
+        l->nparams = nparams;
+        l->nresults = nresults;
+        return 0;
+}
+
+static int
+read_blocktype(struct aot_ctx *c, const uint8_t **pp, uint32_t *nparamsp,
+               uint32_t *nresultsp)
+{
+        int64_t bt = read_leb_s33_nocheck(pp);
+        if (bt >= 0) {
+                const struct functype *ft = &c->m->types[bt];
+                if (!is_int_resulttype(&ft->parameter) ||
+                    !is_int_resulttype(&ft->result)) {
+                        return ENOTSUP;
+                }
+                *nparamsp = ft->parameter.ntypes;
+                *nresultsp = ft->result.ntypes;
+                return 0;
+        }
+        uint8_t t = (uint8_t)(bt & 0x7f);
+        *nparamsp = 0;
+        if (t == 0x40) {
+                *nresultsp = 0;
+        } else if (is_int_type(t)) {
+                *nresultsp = 1;
+        } else {
+                return ENOTSUP;
+        }
+        return 0;
+}
+
+static uint32_t
+push(struct aot_ctx *c)
+{
+        uint32_t slot = c->sp++;
+        if (c->sp > c->maxsp) {
+                c->maxsp = c->sp;
+        }
+        return slot;
+}
+
+static uint32_t
+pop(struct aot_ctx *c)
+{
+        assert(c->sp > 0);
+        return --c->sp;
+}
+
+static void
+emit_check(struct aot_ctx *c)
+{
+        emit(c, "if (ret != 0) {\nreturn ret;\n}\n");
+}
+
+/* copy the values to the target and jump */
+static void
+emit_br(struct aot_ctx *c, uint32_t labelidx)
+{
+        assert(labelidx < c->nlabels);
+        const struct aot_label *l = &c->labels[c->nlabels - 1 - labelidx];
+        bool is_loop = l->op == 0x03;
+        uint32_t arity = is_loop ? l->nparams : l->nresults;
+        uint32_t i;
+        assert(c->sp >= arity);
+        for (i = 0; i < arity; i++) {
+                uint32_t src = c->sp - arity + i;
+                uint32_t dst = l->height + i;
+                assert(dst <= src);
+                if (dst != src) {
+                        emit(c, "s%" PRIu32 " = s%" PRIu32 ";\n", dst, src);
+                }
+        }
+        emit(c, "goto L%" PRIu32 "_%s;\n", l->id, is_loop ? "loop" : "end");
+}
+
+static int
+translate_memarg(struct aot_ctx *c, const uint8_t **pp, uint32_t *offsetp)
+{
+        uint32_t align = read_leb_u32_nocheck(pp);
+        if ((align & 0x40) != 0) {
+                /* multi-memory */
+                if (read_leb_u32_nocheck(pp) != 0) {
+                        return ENOTSUP;
+                }
+        }
+        if (!is_supported_memory(c->m)) {
+                return ENOTSUP;
+        }
+        *offsetp = read_leb_u32_nocheck(pp);
+        return 0;
+}
+
+static int
+translate_call(struct aot_ctx *c, uint32_t funcidx)
+{
+        const struct module *m = c->m;
+        if (funcidx < m->nimportedfuncs) {
+                return ENOTSUP;
+        }
+        uint32_t localidx = funcidx - m->nimportedfuncs;
+        if (!c->translated[localidx]) {
+                return ENOTSUP;
+        }
+        if (c->dead) {
+                return 0;
+        }
+        const struct functype *ft = local_functype(m, localidx);
+        uint32_t nparams = ft->parameter.ntypes;
+        uint32_t nresults = ft->result.ntypes;
+        uint32_t i;
+        assert(c->sp >= nparams);
+        uint32_t base = c->sp - nparams;
+        emit(c, "ret = aot_f%" PRIu32 "(ctx, inst, %s", funcidx,
+             nresults > 0 ? "cr" : "NULL");
+        for (i = 0; i < nparams; i++) {
+                emit(c, ", s%" PRIu32, base + i);
+        }
+        emit(c, ");\n");
+        emit_check(c);
+        c->sp = base;
+        for (i = 0; i < nresults; i++) {
+                emit(c, "s%" PRIu32 " = cr[%" PRIu32 "];\n", push(c), i);
+        }
+        if (nresults > c->maxcallresults) {
+                c->maxcallresults = nresults;
+        }
+        return 0;
+}
+
+static int
+translate_insn(struct aot_ctx *c, const uint8_t **pp)
+{
+        const struct module *m = c->m;
+        const uint8_t *p = *pp;
+        uint8_t op = *p++;
+        uint32_t nparams;
+        uint32_t nresults;
+        uint32_t idx;
+        uint32_t a = 0;
+        uint32_t b;
+        int ret = 0;
+
+        switch (op) {
+        case 0x02: /* block */
+        case 0x03: /* loop */
+        case 0x04: /* if */
+                ret = read_blocktype(c, &p, &nparams, &nresults);
+                if (ret != 0) {
+                        break;
+                }
+                if (c->dead) {
+                        c->deadnest++;
+                        break;
+                }
+                if (op == 0x04) {
+                        /*
+                         * the "then" block might overwrite the
+                         * slots of the params the "else" block needs.
+                         */
+                        if (nparams > 0) {
+                                ret = ENOTSUP;
+                                break;
+                        }
+                        a = pop(c);
+                }
+                ret = push_label(c, op, nparams, nresults);
+                if (ret != 0) {
+                        break;
+                }
+                idx = c->labels[c->nlabels - 1].id;
+                if (op == 0x03) {
+                        emit(c, "AOT_LABEL(L%" PRIu32 "_loop)\n", idx);
+                        emit(c, "ret = aot_safepoint(ctx);\n");
+                        emit_check(c);
+                } else if (op == 0x04) {
+                        emit(c,
+                             "if ((uint32_t)s%" PRIu32 " == 0) {\n"
+                             "goto L%" PRIu32 "_else;\n}\n",
+                             a, idx);
+                }
+                break;
+        case 0x05: { /* else */
+                if (c->dead && c->deadnest > 0) {
+                        break;
+                }
+                assert(c->nlabels > 0);
+                struct aot_label *l = &c->labels[c->nlabels - 1];
+                assert(l->op == 0x04);
+                if (!c->dead) {
+                        emit(c, "goto L%" PRIu32 "_end;\n", l->id);
+                }
+                emit(c, "AOT_LABEL(L%" PRIu32 "_else)\n", l->id);
+                l->has_else = true;
+                c->sp = l->height + l->nparams;
+                c->dead = false;
+                break;
+        }
+        case 0x0b: { /* end */
+                if (c->dead && c->deadnest > 0) {
+                        c->deadnest--;
+                        break;
+                }
+                assert(c->nlabels > 0);
+                const struct aot_label *e = &c->labels[c->nlabels - 1];
+                if (e->op == 0x04 && !e->has_else) {
+                        emit(c, "AOT_LABEL(L%" PRIu32 "_else)\n", e->id);
+                }
+                emit(c, "AOT_LABEL(L%" PRIu32 "_end)\n", e->id);
+                c->sp = e->height + e->nresults;
+                c->dead = false;
+                c->nlabels--;
+                break;
+        }
+        case 0x00: /* unreachable */
+                if (!c->dead) {
+                        emit(c, "return aot_trap(ctx, TRAP_UNREACHABLE);\n");
+                        c->dead = true;
+                }
+                break;
+        case 0x01: /* nop */
+                break;
+        case 0x0c: /* br */
+                idx = read_leb_u32_nocheck(&p);
+                if (!c->dead) {
+                        emit_br(c, idx);
+                        c->dead = true;
+                }
+                break;
+        case 0x0d: /* br_if */
+                idx = read_leb_u32_nocheck(&p);
+                if (!c->dead) {
+                        a = pop(c);
+                        emit(c, "if ((uint32_t)s%" PRIu32 " != 0) {\n", a);
+                        emit_br(c, idx);
+                        emit(c, "}\n");
+                }
+                break;
+        case 0x0e: { /* br_table */
+                uint32_t n = read_leb_u32_nocheck(&p);
+                uint32_t i;
+                if (!c->dead) {
+                        a = pop(c);
+                        emit(c, "switch ((uint32_t)s%" PRIu32 ") {\n", a);
+                }
+                for (i = 0; i < n; i++) {
+                        idx = read_leb_u32_nocheck(&p);
+                        if (!c->dead) {
+                                emit(c, "case %" PRIu32 ":\n", i);
+                                emit_br(c, idx);
+                        }
+                }
+                idx = read_leb_u32_nocheck(&p);
+                if (!c->dead) {
+                        emit(c, "default:\n");
+                        emit_br(c, idx);
+                        emit(c, "}\n");
+                        c->dead = true;
+                }
+                break;
+        }
+        case 0x0f: /* return */
+                if (!c->dead) {
+                        emit_br(c, c->nlabels - 1);
+                        c->dead = true;
+                }
+                break;
+        case 0x10: /* call */
+                ret = translate_call(c, read_leb_u32_nocheck(&p));
+                break;
+        case 0x1a: /* drop */
+                if (!c->dead) {
+                        pop(c);
+                }
+                break;
+        case 0x1c: /* select t */
+                if (read_leb_u32_nocheck(&p) != 1 || !is_int_type(*p++)) {
+                        ret = ENOTSUP;
+                        break;
+                }
+                /* fallthrough */
+        case 0x1b: /* select */
+                if (!c->dead) {
+                        idx = pop(c);
+                        b = pop(c);
+                        a = c->sp - 1;
+                        emit(c,
+                             "if ((uint32_t)s%" PRIu32 " == 0) {\n"
+                             "s%" PRIu32 " = s%" PRIu32 ";\n}\n",
+                             idx, a, b);
+                }
+                break;
+        case 0x20: /* local.get */
+                idx = read_leb_u32_nocheck(&p);
+                if (!c->dead) {
+                        emit(c, "s%" PRIu32 " = l%" PRIu32 ";\n", push(c),
+                             idx);
+                }
+                break;
+        case 0x21: /* local.set */
+        case 0x22: /* local.tee */
+                idx = read_leb_u32_nocheck(&p);
+                if (!c->dead) {
+                        a = (op == 0x21) ? pop(c) : c->sp - 1;
+                        emit(c, "l%" PRIu32 " = s%" PRIu32 ";\n", idx, a);
+                }
+                break;
+        case 0x23: /* global.get */
+        case 0x24: { /* global.set */
+                idx = read_leb_u32_nocheck(&p);
+                enum valtype t = module_globaltype(m, idx)->t;
+                if (!is_int_type(t)) {
+                        ret = ENOTSUP;
+                        break;
+                }
+                if (c->dead) {
+                        break;
+                }
+                if (op == 0x23) {
+                        emit(c,
+                             "s%" PRIu32 " = aot_global(inst, %" PRIu32
+                             ")->val.u.%s;\n",
+                             push(c), idx, val_field(t));
+                } else {
+                        emit(c,
+                             "aot_global(inst, %" PRIu32
+                             ")->val.u.%s = s%" PRIu32 ";\n",
+                             idx, val_field(t), pop(c));
+                }
+                break;
+        }
+        case 0x3f: /* memory.size */
+                if (read_leb_u32_nocheck(&p) != 0 ||
+                    !is_supported_memory(m)) {
+                        ret = ENOTSUP;
+                        break;
+                }
+                if (!c->dead) {
+                        emit(c, "s%" PRIu32 " = aot_memory_size(inst);\n",
+                             push(c));
+                }
+                break;
+        case 0x41: { /* i32.const */
+                uint32_t v = read_leb_i32_nocheck(&p);
+                if (!c->dead) {
+                        emit(c, "s%" PRIu32 " = UINT32_C(0x%" PRIx32 ");\n",
+                             push(c), v);
+                }
+                break;
+        }
+        case 0x42: { /* i64.const */
+                uint64_t v = read_leb_i64_nocheck(&p);
+                if (!c->dead) {
+                        emit(c, "s%" PRIu32 " = UINT64_C(0x%" PRIx64 ");\n",
+                             push(c), v);
+                }
+                break;
+        }
+        default: {
+                const struct aot_op *o = find_op(op);
+                uint32_t offset;
+                if (o == NULL) {
+                        ret = ENOTSUP;
+                        break;
+                }
+                if (o->kind == AOT_LOAD || o->kind == AOT_STORE) {
+                        ret = translate_memarg(c, &p, &offset);
+                        if (ret != 0) {
+                                break;
+                        }
+                }
+                if (c->dead) {
+                        break;
+                }
+                switch (o->kind) {
+                case AOT_UNOP:
+                        a = c->sp - 1;
+                        emit(c, "s%" PRIu32 " = aot_%s(s%" PRIu32 ");\n", a,
+                             o->name, a);
+                        break;
+                case AOT_BINOP:
+                        b = pop(c);
+                        a = c->sp - 1;
+                        emit(c,
+                             "s%" PRIu32 " = aot_%s(s%" PRIu32 ", s%" PRIu32
+                             ");\n",
+                             a, o->name, a, b);
+                        break;
+                case AOT_DIVOP:
+                        b = pop(c);
+                        a = c->sp - 1;
+                        emit(c,
+                             "ret = aot_%s(ctx, &s%" PRIu32 ", s%" PRIu32
+                             ");\n",
+                             o->name, a, b);
+                        emit_check(c);
+                        break;
+                case AOT_LOAD:
+                        a = c->sp - 1;
+                        emit(c,
+                             "ret = aot_%s(ctx, &s%" PRIu32 ", %" PRIu32
+                             ");\n",
+                             o->name, a, offset);
+                        emit_check(c);
+                        break;
+                case AOT_STORE:
+                        b = pop(c);
+                        a = pop(c);
+                        emit(c,
+                             "ret = aot_%s(ctx, s%" PRIu32 ", s%" PRIu32
+                             ", %" PRIu32 ");\n",
+                             o->name, a, b, offset);
+                        emit_check(c);
+                        break;
+                }
+                break;
+        }
+        }
+        *pp = p;
+        return ret;
+}
+
+/*
+ * translate the body of a function.
+ * with c->out == NULL, this only checks if the function is supported.
+ */
+static int
+translate_body(struct aot_ctx *c, uint32_t localidx)
+{
+        const struct module *m = c->m;
+        const struct functype *ft = local_functype(m, localidx);
+        const uint8_t *p = m->funcs[localidx].e.start;
+        int ret;
+
+        c->nlabels = 0;
+        c->nextid = 0;
+        c->sp = 0;
+        c->maxsp = 0;
+        c->maxcallresults = 0;
+        c->dead = false;
+        c->deadnest = 0;
+        ret = push_label(c, 0, 0, ft->result.ntypes);
+        if (ret != 0) {
+                return ret;
+        }
+        while (c->nlabels > 0) {
+                ret = translate_insn(c, &p);
+                if (ret != 0) {
+                        return ret;
+                }
+        }
+        return c->error;
+}
+
+static void
+emit_func_decl(struct aot_ctx *c, uint32_t funcidx)
+{
+        const struct module *m = c->m;
+        const struct functype *ft =
+                local_functype(m, funcidx - m->nimportedfuncs);
+        uint32_t i;
+        emit(c,
+             "static int\naot_f%" PRIu32 "(struct exec_context *ctx, "
+             "struct instance *inst, uint64_t *r",
+             funcidx);
+        for (i = 0; i < ft->parameter.ntypes; i++) {
+                emit(c, ", uint64_t l%" PRIu32, i);
+        }
+        emit(c, ")");
+}
+
+static int
+emit_func(struct aot_ctx *c, uint32_t localidx)
+{
+        const struct module *m = c->m;
+        const uint32_t funcidx = m->nimportedfuncs + localidx;
+        const struct functype *ft = local_functype(m, localidx);
+        const struct localtype *lt = &m->funcs[localidx].localtype;
+        FILE *out = c->out;
+        uint32_t nlocals = ft->parameter.ntypes + lt->nlocals;
+        uint32_t i;
+        int ret;
+
+        /* the first pass to get maxsp etc */
+        c->out = NULL;
+        ret = translate_body(c, localidx);
+        c->out = out;
+        if (ret != 0) {
+                return ret;
+        }
+
+        emit_func_decl(c, funcidx);
+        emit(c, "\n{\n");
+        for (i = ft->parameter.ntypes; i < nlocals; i++) {
+                emit(c, "uint64_t l%" PRIu32 " = 0;\n", i);
+        }
+        for (i = 0; i < c->maxsp; i++) {
+                emit(c, "uint64_t s%" PRIu32 " = 0;\n", i);
+        }
+        if (c->maxcallresults > 0) {
+                emit(c, "uint64_t cr[%" PRIu32 "];\n", c->maxcallresults);
+        }
+        emit(c, "int ret;\n");
+        for (i = 0; i < c->maxsp; i++) {
+                emit(c, "(void)s%" PRIu32 ";\n", i);
+        }
+        emit(c, "ret = aot_enter(ctx);\n");
+        emit_check(c);
+        ret = translate_body(c, localidx);
+        if (ret != 0) {
+                return ret;
+        }
+        /* the function body label */
+        for (i = 0; i < ft->result.ntypes; i++) {
+                emit(c, "r[%" PRIu32 "] = s%" PRIu32 ";\n", i, i);
+        }
+        emit(c, "aot_leave(ctx);\nreturn 0;\n}\n");
+        return c->error;
+}
+
+/*
+ * the entry point from the interpreter. see aot_func_t.
+ * the parameters and results are on the operand stack.
+ */
+static int
+emit_entry(struct aot_ctx *c, uint32_t localidx)
+{
+        const struct module *m = c->m;
+        const uint32_t funcidx = m->nimportedfuncs + localidx;
+        const struct functype *ft = local_functype(m, localidx);
+        const struct resulttype *pt = &ft->parameter;
+        const struct resulttype *rt = &ft->result;
+        uint32_t cellidx;
+        uint32_t csz;
+        uint32_t i;
+
+        emit(c,
+             "static int\naot_entry_f%" PRIu32
+             "(struct exec_context *ctx, struct instance *inst, "
+             "struct cell *cells)\n{\n",
+             funcidx);
+        emit(c, "uint64_t r[%" PRIu32 "];\n", rt->ntypes > 0 ? rt->ntypes : 1);
+        for (i = 0; i < pt->ntypes; i++) {
+                emit(c, "uint64_t p%" PRIu32 ";\n", i);
+        }
+        emit(c, "struct val v;\nint ret;\n(void)v;\n");
+        for (i = 0; i < pt->ntypes; i++) {
+                cellidx = resulttype_cellidx(pt, i, &csz);
+                emit(c,
+                     "val_from_cells(&v, &cells[%" PRIu32 "], %" PRIu32
+                     ");\n"
+                     "p%" PRIu32 " = v.u.%s;\n",
+                     cellidx, csz, i, val_field(pt->types[i]));
+        }
+        emit(c, "ret = aot_f%" PRIu32 "(ctx, inst, r", funcidx);
+        for (i = 0; i < pt->ntypes; i++) {
+                emit(c, ", p%" PRIu32, i);
+        }
+        emit(c, ");\n");
+        emit_check(c);
+        for (i = 0; i < rt->ntypes; i++) {
+                cellidx = resulttype_cellidx(rt, i, &csz);
+                emit(c,
+                     "v.u.%s = r[%" PRIu32 "];\n"
+                     "val_to_cells(&v, &cells[%" PRIu32 "], %" PRIu32
+                     ");\n",
+                     val_field(rt->types[i]), i, cellidx, csz);
+        }
+        emit(c, "return 0;\n}\n");
+        return c->error;
+}
+
+int
+dump_module_aot_funcs(FILE *out, const char *name, const struct module *m)
+{
+        struct aot_ctx c0;
+        struct aot_ctx *c = &c0;
+        bool *translated = NULL;
+        uint32_t ntranslated;
+        uint32_t i;
+        bool changed;
+        int ret = 0;
+
+        memset(c, 0, sizeof(*c));
+        c->m = m;
+        if (m->nfuncs > 0) {
+                translated = malloc(m->nfuncs * sizeof(*translated));
+                if (translated == NULL) {
+                        return ENOMEM;
+                }
+        }
+        c->translated = translated;
+        for (i = 0; i < m->nfuncs; i++) {
+                translated[i] = is_supported_func(m, i);
+        }
+
+        /*
+         * a function is translated only if all the functions it calls
+         * are translated. iterate until it converges.
+         */
+        do {
+                changed = false;
+                for (i = 0; i < m->nfuncs; i++) {
+                        if (!translated[i]) {
+                                continue;
+                        }
+                        ret = translate_body(c, i);
+                        if (ret == ENOTSUP) {
+                                translated[i] = false;
+                                changed = true;
+                        } else if (ret != 0) {
+                                goto fail;
+                        }
+                }
+        } while (changed);
+
+        c->out = out;
+        ntranslated = 0;
+        emit(c, "#include <toywasm/aot.h>\n");
+        for (i = 0; i < m->nfuncs; i++) {
+                if (translated[i]) {
+                        emit_func_decl(c, m->nimportedfuncs + i);
+                        emit(c, ";\n");
+                        ntranslated++;
+                }
+        }
+        for (i = 0; i < m->nfuncs; i++) {
+                if (!translated[i]) {
+                        continue;
+                }
+                ret = emit_func(c, i);
+                if (ret != 0) {
+                        goto fail;
+                }
+                ret = emit_entry(c, i);
+                if (ret != 0) {
+                        goto fail;
+                }
+        }
+        emit(c, "/* %" PRIu32 " of %" PRIu32 " functions translated */\n",
+             ntranslated, m->nfuncs);
+        emit(c, "static const aot_func_t %s[] = {\n", name);
+        for (i = 0; i < m->nfuncs; i++) {
+                if (translated[i]) {
+                        emit(c, "aot_entry_f%" PRIu32 ",\n",
+                             m->nimportedfuncs + i);
+                } else {
+                        emit(c, "NULL,\n");
+                }
+        }
+        emit(c, "};\n");
+        ret = c->error;
+fail:
+        free(c->labels);
+        free(translated);
+        return ret;
+}
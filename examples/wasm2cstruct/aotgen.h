@@ -0,0 +1,5 @@
+#include <stdio.h>
+
+struct module;
+
+int dump_module_aot_funcs(FILE *out, const char *name, const struct module *m);
@@ -1,6 +1,7 @@
 #include <assert.h>
 #include <errno.h>
 #include <inttypes.h>
+#include <stdbool.h>
 #include <stdio.h>
 
 #include <toywasm/context.h>
@@ -9,6 +10,9 @@
 #include <toywasm/dylink_type.h>
 #endif
 
+#if defined(TOYWASM_ENABLE_AOT)
+#include "aotgen.h"
+#endif
 #include "cstruct.h"
 
 #define ERRCHK(call)                                                          \
@@ -40,10 +44,8 @@
         ERRCHK(print_u8_array_init(out, __VA_ARGS__))
 #define PRINT_U8_ARRAY_LITERAL(out, ...)                                      \
         ERRCHK(print_u8_array_literal(out, __VA_ARGS__))
-#define PRINT_U32_ARRAY_INIT(out, ...)                                        \
-        ERRCHK(print_u32_array_init(out, __VA_ARGS__))
-#define PRINT_U32_ARRAY_LITERAL(out, ...)                                     \
-        ERRCHK(print_u32_array_literal(out, __VA_ARGS__))
+#define PRINT_ELEMENT_FUNCS(out, ...)                                         \
+        ERRCHK(print_element_funcs(out, __VA_ARGS__))
 #define PRINT_ENUM_FIELD(out, s, f)                                           \
         PRINT(out, "." #f " = %" PRIu32 ",\n", (uint32_t)(s)->f)
 #define PRINT_U8_FIELD(out, s, f) PRINT(out, "." #f " = %" PRIu8 ",\n", (s)->f)
@@ -176,12 +178,26 @@ print_exprs(FILE *out, const struct expr *expr, const struct ctx *ctx)
         const struct expr_exec_info *ei = &expr->ei;
         PRINT(out, ".ei = {\n");
         PRINT_U32_FIELD(out, ei, njumps);
+        PRINT(out, ".small = %s,\n", ei->small ? "true" : "false");
         if (ei->njumps == 0) {
-                PRINT(out, ".jumps = NULL,\n");
+                PRINT(out, ".jumps_u.jumps = NULL,\n");
+        } else if (ei->small) {
+                PRINT(out, ".jumps_u.jumps16 = (void *)(const struct "
+                           "jump16 []){\n");
+                for (i = 0; i < ei->njumps; i++) {
+                        const struct jump16 *j = &ei->jumps_u.jumps16[i];
+                        PRINT(out, "{\n");
+                        PRINT(out, ".pc = 0x%" PRIx32 ",\n", (uint32_t)j->pc);
+                        PRINT(out, ".targetpc = 0x%" PRIx32 ",\n",
+                              (uint32_t)j->targetpc);
+                        PRINT(out, "},\n");
+                }
+                PRINT(out, "},\n");
         } else {
-                PRINT(out, ".jumps = (void *)(const struct jump []){\n");
+                PRINT(out, ".jumps_u.jumps = (void *)(const struct "
+                           "jump []){\n");
                 for (i = 0; i < ei->njumps; i++) {
-                        const struct jump *j = &ei->jumps[i];
+                        const struct jump *j = &ei->jumps_u.jumps[i];
                         PRINT(out, "{\n");
                         PRINT(out, ".pc = 0x%" PRIx32 ",\n", j->pc);
                         PRINT(out, ".targetpc = 0x%" PRIx32 ",\n",
@@ -198,12 +214,26 @@ print_exprs(FILE *out, const struct expr *expr, const struct ctx *ctx)
         PRINT_U32_FIELD(out, an, default_size);
         PRINT_U32_FIELD(out, an, ntypes);
         if (an->ntypes == 0) {
-                PRINT(out, ".types = NULL,\n");
+                PRINT(out, ".types_u.types = NULL,\n");
+        } else if (ei->small) {
+                PRINT(out, ".types_u.types16 = (void *)(const struct "
+                           "type_annotation16[]){\n");
+                for (i = 0; i < an->ntypes; i++) {
+                        const struct type_annotation16 *a =
+                                &an->types_u.types16[i];
+                        PRINT(out, "{\n");
+                        PRINT(out, ".pc = %" PRIu32 ",\n", (uint32_t)a->pc);
+                        PRINT(out, ".size = %" PRIu32 ",\n",
+                              (uint32_t)a->size);
+                        PRINT(out, "},\n");
+                }
+                PRINT(out, "},\n");
         } else {
-                PRINT(out, ".types = (void *)(const struct "
+                PRINT(out, ".types_u.types = (void *)(const struct "
                            "type_annotation[]){\n");
                 for (i = 0; i < an->ntypes; i++) {
-                        const struct type_annotation *a = &an->types[i];
+                        const struct type_annotation *a =
+                                &an->types_u.types[i];
                         PRINT(out, "{\n");
                         PRINT_U32_FIELD(out, a, pc);
                         PRINT_U32_FIELD(out, a, size);
@@ -212,6 +242,24 @@ print_exprs(FILE *out, const struct expr *expr, const struct ctx *ctx)
                 PRINT(out, "},\n");
         }
         PRINT(out, "},\n");
+#endif
+#if defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING)
+        PRINT_U32_FIELD(out, ei, ncatches);
+        if (ei->ncatches == 0) {
+                PRINT(out, ".catches = NULL,\n");
+        } else {
+                PRINT(out, ".catches = (void *)(const struct "
+                           "catch_handler []){\n");
+                for (i = 0; i < ei->ncatches; i++) {
+                        const struct catch_handler *h = &ei->catches[i];
+                        PRINT(out, "{\n");
+                        PRINT(out, ".pc = 0x%" PRIx32 ",\n", h->pc);
+                        PRINT(out, ".tagidx = 0x%" PRIx32 ",\n", h->tagidx);
+                        PRINT_U32_FIELD(out, h, label);
+                        PRINT(out, "},\n");
+                }
+                PRINT(out, "},\n");
+        }
 #endif
         PRINT(out, "},\n");
 
@@ -325,26 +373,23 @@ fail:
         return ret;
 }
 
+/*
+ * Note: we always print funcidxes as a plain array (.funcs)
+ * regardless of the representation in the loaded module.
+ */
 static int
-print_u32_array_init(FILE *out, const uint32_t *p, uint32_t size)
+print_element_funcs(FILE *out, const struct element *e)
 {
         int ret = 0;
+        struct element_funcidx_iter it;
         uint32_t i;
+        element_funcidx_iter_init(&it, e, 0);
+        PRINT(out, "(const uint32_t [])\n");
         PRINT(out, "{\n");
-        for (i = 0; i < size; i++) {
-                PRINT(out, "0x%" PRIx32 ",\n", p[i]);
+        for (i = 0; i < e->init_size; i++) {
+                PRINT(out, "0x%" PRIx32 ",\n", element_funcidx_iter_next(&it));
         }
         PRINT(out, "}");
-fail:
-        return ret;
-}
-
-static int
-print_u32_array_literal(FILE *out, const uint32_t *p, uint32_t size)
-{
-        int ret = 0;
-        PRINT(out, "(const uint32_t [])\n");
-        PRINT_U32_ARRAY_INIT(out, p, size);
         PRINT(out, ",\n");
 fail:
         return ret;
@@ -427,7 +472,8 @@ fail:
 #endif
 
 int
-dump_module_as_cstruct(FILE *out, const char *name, const struct module *m)
+dump_module_as_cstruct(FILE *out, const char *name, const struct module *m,
+                       bool aot)
 {
         struct ctx ctx;
         uint32_t pc_offset = 0;
@@ -528,9 +574,9 @@ dump_module_as_cstruct(FILE *out, const char *name, const struct module *m)
         for (i = 0; i < m->nelems; i++) {
                 const struct element *e = &m->elems[i];
                 PRINT(out, "{\n");
-                if (e->funcs != NULL) {
+                if (element_has_funcidxes(e)) {
                         PRINT(out, ".funcs = (void *)");
-                        PRINT_U32_ARRAY_LITERAL(out, e->funcs, e->init_size);
+                        PRINT_ELEMENT_FUNCS(out, e);
                 } else {
                         PRINT(out, ".init_exprs = (void *)");
                         PRINT_EXPRS_LIST(out, e->init_exprs, e->init_size,
@@ -623,6 +669,20 @@ dump_module_as_cstruct(FILE *out, const char *name, const struct module *m)
         }
 #endif
 
+#if defined(TOYWASM_ENABLE_AOT)
+        if (aot) {
+                ret = dump_module_aot_funcs(out, "aot_funcs", m);
+                if (ret != 0) {
+                        goto fail;
+                }
+        }
+#else
+        if (aot) {
+                ret = ENOTSUP;
+                goto fail;
+        }
+#endif
+
         PRINT(out, "const struct module %s = {\n", name);
 
         PRINT(out, ".ntypes = ARRAYCOUNT(types),\n");
@@ -684,6 +744,11 @@ dump_module_as_cstruct(FILE *out, const char *name, const struct module *m)
                 PRINT_DYLINK(out, m->dylink);
         }
 #endif
+#if defined(TOYWASM_ENABLE_AOT)
+        if (aot) {
+                PRINT(out, ".aot_funcs = aot_funcs,\n");
+        }
+#endif
 
         PRINT(out, "};\n");
 fail:
@@ -1,4 +1,7 @@
+#include <stdbool.h>
+#include <stdio.h>
+
 struct module;
 
 int dump_module_as_cstruct(FILE *out, const char *name,
-                           const struct module *m);
+                           const struct module *m, bool aot);
@@ -1,6 +1,8 @@
 #include <inttypes.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <toywasm/fileio.h>
 #include <toywasm/load_context.h>
@@ -14,6 +16,12 @@
 int
 main(int argc, char **argv)
 {
+        bool aot = false;
+        if (argc > 1 && !strcmp(argv[1], "--aot")) {
+                aot = true;
+                argc--;
+                argv++;
+        }
         if (argc != 3) {
                 xlog_error("unexpected number of args");
                 exit(2);
@@ -40,7 +48,7 @@ main(int argc, char **argv)
                 exit(1);
         }
         load_context_clear(&ctx);
-        ret = dump_module_as_cstruct(stdout, name, m);
+        ret = dump_module_as_cstruct(stdout, name, m, aot);
         if (ret != 0) {
                 xlog_error("dump_module_as_cstruct failed with %d", ret);
                 exit(1);
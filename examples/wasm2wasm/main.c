@@ -1,17 +1,26 @@
 #include <inttypes.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <toywasm/fileio.h>
 #include <toywasm/load_context.h>
 #include <toywasm/mem.h>
 #include <toywasm/module.h>
+#include <toywasm/module_optimizer.h>
 #include <toywasm/module_writer.h>
 #include <toywasm/xlog.h>
 
 int
 main(int argc, char **argv)
 {
+        bool optimize = false;
+        if (argc == 4 && !strcmp(argv[1], "-O")) {
+                optimize = true;
+                argc--;
+                argv++;
+        }
         if (argc != 3) {
                 xlog_error("unexpected number of args");
                 exit(2);
@@ -38,12 +47,36 @@ main(int argc, char **argv)
                 exit(1);
         }
         load_context_clear(&ctx);
+        struct module_optimizer opt;
+        module_optimizer_init(&opt, &mctx);
+        if (optimize) {
+                ret = module_optimize(&opt, m);
+                if (ret != 0) {
+                        xlog_error("module_optimize failed with %d", ret);
+                        exit(1);
+                }
+                const struct module_optimizer_stats *st = &opt.stats;
+                fprintf(stderr,
+                        "code size %" PRIu64 " -> %" PRIu64 " bytes\n"
+                        "constants folded: %" PRIu32 "\n"
+                        "dead stores removed: %" PRIu32 "\n"
+                        "local.tee merged: %" PRIu32 "\n"
+                        "unused values dropped: %" PRIu32 "\n"
+                        "nops removed: %" PRIu32 "\n"
+                        "unreachable instructions removed: %" PRIu32 "\n"
+                        "branches simplified: %" PRIu32 "\n",
+                        st->orig_code_size, st->new_code_size,
+                        st->nconstfolded, st->ndeadstores, st->ntees,
+                        st->ndrops, st->nnops, st->nunreachable,
+                        st->nbranches);
+        }
         ret = module_write(outfilename, m);
         if (ret != 0) {
                 xlog_error("module_write to %s failed with %d", outfilename,
                            ret);
                 exit(1);
         }
+        module_optimizer_clear(&opt);
         module_destroy(&mctx, m);
         mem_context_clear(&mctx);
         exit(0);
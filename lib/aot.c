@@ -0,0 +1,198 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "aot.h"
+#include "exec.h"
+#if defined(TOYWASM_ENABLE_WASM_THREADS)
+#include "suspend.h"
+#endif
+#include "xlog.h"
+
+/*
+ * unlike the interpreter, we can't unwind the native frames to
+ * restart the execution later. handle the restart request here.
+ * a user interrupt is passed to the embedder's handler.
+ * (see exec_context::user_intr_handler)
+ */
+int
+aot_check_interrupt(struct exec_context *ctx)
+{
+        int ret;
+
+        ctx->aot_check_countdown = AOT_CHECK_INTERVAL;
+        ret = check_interrupt(ctx);
+        if (ret == ETOYWASMRESTART) {
+#if defined(TOYWASM_ENABLE_WASM_THREADS)
+                /* block while another thread is suspending us */
+                suspend_parked(ctx->cluster);
+#endif
+                /*
+                 * Note: with TOYWASM_USE_USER_SCHED, this would
+                 * block other threads until we return to the
+                 * interpreter. aot_usable() doesn't allow it.
+                 */
+                xlog_trace("%s: restart handled in place", __func__);
+                memory_cache_refresh(ctx);
+                ret = 0;
+        } else if (ret == ETOYWASMUSERINTERRUPT) {
+                if (ctx->user_intr_handler == NULL) {
+                        /*
+                         * intrp was set after we entered the native
+                         * code. we can neither return it nor ignore it.
+                         */
+                        return trap_with_id(ctx, TRAP_MISC,
+                                            "user interrupt in aot function");
+                }
+                ret = ctx->user_intr_handler(ctx, ctx->user_intr_handler_arg);
+                assert(!IS_RESTARTABLE(ret));
+                if (ret == 0) {
+                        memory_cache_refresh(ctx);
+                }
+        }
+        return ret;
+}
+
+bool
+aot_usable(const struct exec_context *ctx)
+{
+        if (ctx->intrp != NULL && ctx->user_intr_handler == NULL) {
+                return false;
+        }
+#if defined(TOYWASM_USE_USER_SCHED)
+        /*
+         * a reschedule request can't be handled in place without
+         * blocking other threads.
+         */
+        if (ctx->sched != NULL) {
+                return false;
+        }
+#endif
+        return true;
+}
+
+int
+aot_trap(struct exec_context *ctx, enum trapid id)
+{
+        const char *msg;
+
+        switch (id) {
+        case TRAP_DIV_BY_ZERO:
+                msg = "division by zero";
+                break;
+        case TRAP_INTEGER_OVERFLOW:
+                msg = "integer overflow";
+                break;
+        case TRAP_UNREACHABLE:
+                msg = "unreachable";
+                break;
+        case TRAP_TOO_MANY_FRAMES:
+                msg = "too many frames";
+                break;
+        default:
+                msg = "trap";
+                break;
+        }
+        return trap_with_id(ctx, id, "%s (aot)", msg);
+}
+
+int
+aot_memory_getptr(struct exec_context *ctx, uint32_t ptr, uint32_t offset,
+                  uint32_t size, void **pp)
+{
+        return memory_getptr(ctx, 0, ptr, offset, size, pp);
+}
+
+static uint32_t
+clz(uint32_t v)
+{
+#if __has_builtin(__builtin_clz)
+        return __builtin_clz(v);
+#else
+        uint32_t cnt = 0;
+        uint32_t u = v;
+        while ((u & 0x80000000) == 0) {
+                cnt++;
+                u <<= 1;
+        }
+        return cnt;
+#endif
+}
+
+static uint32_t
+ctz(uint32_t v)
+{
+#if __has_builtin(__builtin_ctz)
+        return __builtin_ctz(v);
+#else
+        uint32_t cnt = 0;
+        uint32_t u = v;
+        while ((u & 1) == 0) {
+                cnt++;
+                u >>= 1;
+        }
+        return cnt;
+#endif
+}
+
+static uint32_t
+popcount(uint32_t v)
+{
+#if __has_builtin(__builtin_popcount)
+        return __builtin_popcount(v);
+#else
+        uint32_t cnt = 0;
+        uint32_t u = v;
+        while (u != 0) {
+                cnt++;
+                u &= u - 1;
+        }
+        return cnt;
+#endif
+}
+
+uint64_t
+aot_i32_clz(uint64_t a)
+{
+        uint32_t v = (uint32_t)a;
+        return (v == 0) ? 32 : clz(v);
+}
+
+uint64_t
+aot_i32_ctz(uint64_t a)
+{
+        uint32_t v = (uint32_t)a;
+        return (v == 0) ? 32 : ctz(v);
+}
+
+uint64_t
+aot_i32_popcnt(uint64_t a)
+{
+        return popcount((uint32_t)a);
+}
+
+uint64_t
+aot_i64_clz(uint64_t a)
+{
+        uint32_t high = (uint32_t)(a >> 32);
+        if (high == 0) {
+                return 32 + aot_i32_clz(a);
+        }
+        return clz(high);
+}
+
+uint64_t
+aot_i64_ctz(uint64_t a)
+{
+        uint32_t low = (uint32_t)a;
+        if (low == 0) {
+                return 32 + aot_i32_ctz(a >> 32);
+        }
+        return ctz(low);
+}
+
+uint64_t
+aot_i64_popcnt(uint64_t a)
+{
+        return popcount((uint32_t)a) + popcount((uint32_t)(a >> 32));
+}
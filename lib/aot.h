@@ -0,0 +1,332 @@
+#if !defined(_TOYWASM_AOT_H)
+#define _TOYWASM_AOT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "toywasm_config.h"
+
+#include "cell.h"
+#include "endian.h"
+#include "exec_context.h"
+#include "platform.h"
+#include "type.h"
+#include "vec.h"
+
+/*
+ * runtime support for functions translated to C ahead of time.
+ * (see wasm2cstruct --aot)
+ *
+ * a translated function is a C function which keeps each local and
+ * operand stack slot in a uint64_t variable. i32 values are kept
+ * zero-extended. the generated code uses the helpers in this file for
+ * the most of the operations. functions which the translator doesn't
+ * support are left to the interpreter.
+ *
+ * the translated functions are registered as module::aot_funcs.
+ * when instantiating the module, they are used for funcinst::u.wasm.aot
+ * and the interpreter calls them in place of the bytecode.
+ *
+ * limitations:
+ *
+ * - an aot function can only call aot functions in the same module.
+ *   the interpreter is not re-entrant. a host function can return a
+ *   restartable error (ETOYWASMRESTART) expecting the interpreter to
+ *   execute the call instruction again later, which doesn't work with
+ *   native frames on the C stack.
+ *   for the same reason, call_indirect and memory.grow, which might
+ *   need to suspend other threads, are not supported.
+ *
+ * - restart requests from check_interrupt() are handled in place.
+ *   (see aot_check_interrupt) a user interrupt is passed to
+ *   exec_context::user_intr_handler as the execution can't be
+ *   resumed later. aot functions are not used when they can't
+ *   handle interrupts this way. (see aot_usable)
+ *
+ * - the native call depth is limited by AOT_MAX_DEPTH in addition to
+ *   exec_options::max_frames.
+ */
+
+/*
+ * the limit of the nested aot function calls.
+ * it's to protect the C stack.
+ */
+#define AOT_MAX_DEPTH 2048
+
+/*
+ * the number of loop iterations and function calls between
+ * check_interrupt() calls.
+ */
+#define AOT_CHECK_INTERVAL 65536
+
+#if defined(__GNUC__)
+#define AOT_LABEL(L)                                                          \
+        L:                                                                    \
+        __attribute__((unused));
+#else
+#define AOT_LABEL(L)                                                          \
+        L:;
+#endif
+
+__BEGIN_EXTERN_C
+
+int aot_check_interrupt(struct exec_context *ctx);
+bool aot_usable(const struct exec_context *ctx);
+int aot_trap(struct exec_context *ctx, enum trapid id);
+int aot_memory_getptr(struct exec_context *ctx, uint32_t ptr, uint32_t offset,
+                      uint32_t size, void **pp);
+
+uint64_t aot_i32_clz(uint64_t a);
+uint64_t aot_i32_ctz(uint64_t a);
+uint64_t aot_i32_popcnt(uint64_t a);
+uint64_t aot_i64_clz(uint64_t a);
+uint64_t aot_i64_ctz(uint64_t a);
+uint64_t aot_i64_popcnt(uint64_t a);
+
+__END_EXTERN_C
+
+static inline int
+aot_safepoint(struct exec_context *ctx)
+{
+        if (__predict_false(ctx->aot_check_countdown-- == 0)) {
+                return aot_check_interrupt(ctx);
+        }
+        return 0;
+}
+
+static inline int
+aot_enter(struct exec_context *ctx)
+{
+        if (__predict_false(ctx->aot_depth >= AOT_MAX_DEPTH ||
+                            ctx->frames.lsize + ctx->aot_depth >=
+                                    ctx->options.max_frames)) {
+                return aot_trap(ctx, TRAP_TOO_MANY_FRAMES);
+        }
+        ctx->aot_depth++;
+        return aot_safepoint(ctx);
+}
+
+static inline void
+aot_leave(struct exec_context *ctx)
+{
+        ctx->aot_depth--;
+}
+
+static inline struct globalinst *
+aot_global(struct instance *inst, uint32_t idx)
+{
+        return VEC_ELEM(inst->globals, idx);
+}
+
+static inline uint64_t
+aot_memory_size(struct instance *inst)
+{
+        return VEC_ELEM(inst->mems, 0)->size_in_pages;
+}
+
+/*
+ * memory 0 of ctx->instance, with the same fast path as the interpreter.
+ * (MEMORY_GETPTR)
+ */
+static inline int
+aot_getptr(struct exec_context *ctx, uint32_t ptr, uint32_t offset,
+           uint32_t size, void **pp)
+{
+#if defined(TOYWASM_USE_MEMORY_CACHE)
+        if (__predict_true((uint64_t)ptr + offset + size <=
+                           ctx->mem0_allocated)) {
+                *pp = ctx->mem0_data + (size_t)ptr + offset;
+                return 0;
+        }
+#endif
+        return aot_memory_getptr(ctx, ptr, offset, size, pp);
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define AOT_LE(BITS)                                                          \
+        static inline uint##BITS##_t aot_le##BITS##_decode(const void *p)     \
+        {                                                                     \
+                uint##BITS##_t v;                                             \
+                memcpy(&v, p, sizeof(v));                                     \
+                return v;                                                     \
+        }                                                                     \
+        static inline void aot_le##BITS##_encode(void *p, uint##BITS##_t v)   \
+        {                                                                     \
+                memcpy(p, &v, sizeof(v));                                     \
+        }
+AOT_LE(16)
+AOT_LE(32)
+AOT_LE(64)
+#undef AOT_LE
+#else
+#define aot_le16_decode le16_decode
+#define aot_le32_decode le32_decode
+#define aot_le64_decode le64_decode
+#define aot_le16_encode le16_encode
+#define aot_le32_encode le32_encode
+#define aot_le64_encode le64_encode
+#endif
+
+#define AOT_LOAD(NAME, SIZE, EXPR)                                            \
+        static inline int aot_##NAME(struct exec_context *ctx, uint64_t *vp,  \
+                                     uint32_t offset)                         \
+        {                                                                     \
+                void *p;                                                      \
+                int ret = aot_getptr(ctx, (uint32_t)*vp, offset, SIZE, &p);   \
+                if (__predict_false(ret != 0)) {                              \
+                        return ret;                                           \
+                }                                                             \
+                *vp = EXPR;                                                   \
+                return 0;                                                     \
+        }
+
+#define AOT_STORE(NAME, SIZE, STMT)                                           \
+        static inline int aot_##NAME(struct exec_context *ctx, uint64_t a,    \
+                                     uint64_t v, uint32_t offset)             \
+        {                                                                     \
+                void *p;                                                      \
+                int ret = aot_getptr(ctx, (uint32_t)a, offset, SIZE, &p);     \
+                if (__predict_false(ret != 0)) {                              \
+                        return ret;                                           \
+                }                                                             \
+                STMT;                                                         \
+                return 0;                                                     \
+        }
+
+AOT_LOAD(i32_load, 4, aot_le32_decode(p))
+AOT_LOAD(i64_load, 8, aot_le64_decode(p))
+AOT_LOAD(i32_load8_s, 1, (uint32_t)*(int8_t *)p)
+AOT_LOAD(i32_load8_u, 1, *(uint8_t *)p)
+AOT_LOAD(i32_load16_s, 2, (uint32_t)(int16_t)aot_le16_decode(p))
+AOT_LOAD(i32_load16_u, 2, aot_le16_decode(p))
+AOT_LOAD(i64_load8_s, 1, (uint64_t)*(int8_t *)p)
+AOT_LOAD(i64_load8_u, 1, *(uint8_t *)p)
+AOT_LOAD(i64_load16_s, 2, (uint64_t)(int16_t)aot_le16_decode(p))
+AOT_LOAD(i64_load16_u, 2, aot_le16_decode(p))
+AOT_LOAD(i64_load32_s, 4, (uint64_t)(int32_t)aot_le32_decode(p))
+AOT_LOAD(i64_load32_u, 4, aot_le32_decode(p))
+
+AOT_STORE(i32_store, 4, aot_le32_encode(p, (uint32_t)v))
+AOT_STORE(i64_store, 8, aot_le64_encode(p, v))
+AOT_STORE(i32_store8, 1, *(uint8_t *)p = (uint8_t)v)
+AOT_STORE(i32_store16, 2, aot_le16_encode(p, (uint16_t)v))
+AOT_STORE(i64_store8, 1, *(uint8_t *)p = (uint8_t)v)
+AOT_STORE(i64_store16, 2, aot_le16_encode(p, (uint16_t)v))
+AOT_STORE(i64_store32, 4, aot_le32_encode(p, (uint32_t)v))
+
+#undef AOT_LOAD
+#undef AOT_STORE
+
+#define AOT_UNOP(NAME, T, EXPR)                                               \
+        static inline uint64_t aot_##NAME(uint64_t a0)                        \
+        {                                                                     \
+                const T a = (T)a0;                                            \
+                return EXPR;                                                  \
+        }
+
+#define AOT_BINOP(NAME, T, EXPR)                                              \
+        static inline uint64_t aot_##NAME(uint64_t a0, uint64_t b0)           \
+        {                                                                     \
+                const T a = (T)a0;                                            \
+                const T b = (T)b0;                                            \
+                return EXPR;                                                  \
+        }
+
+AOT_UNOP(i32_eqz, uint32_t, a == 0)
+AOT_BINOP(i32_eq, uint32_t, a == b)
+AOT_BINOP(i32_ne, uint32_t, a != b)
+AOT_BINOP(i32_lt_s, uint32_t, (int32_t)a < (int32_t)b)
+AOT_BINOP(i32_lt_u, uint32_t, a < b)
+AOT_BINOP(i32_gt_s, uint32_t, (int32_t)a > (int32_t)b)
+AOT_BINOP(i32_gt_u, uint32_t, a > b)
+AOT_BINOP(i32_le_s, uint32_t, (int32_t)a <= (int32_t)b)
+AOT_BINOP(i32_le_u, uint32_t, a <= b)
+AOT_BINOP(i32_ge_s, uint32_t, (int32_t)a >= (int32_t)b)
+AOT_BINOP(i32_ge_u, uint32_t, a >= b)
+
+AOT_UNOP(i64_eqz, uint64_t, a == 0)
+AOT_BINOP(i64_eq, uint64_t, a == b)
+AOT_BINOP(i64_ne, uint64_t, a != b)
+AOT_BINOP(i64_lt_s, uint64_t, (int64_t)a < (int64_t)b)
+AOT_BINOP(i64_lt_u, uint64_t, a < b)
+AOT_BINOP(i64_gt_s, uint64_t, (int64_t)a > (int64_t)b)
+AOT_BINOP(i64_gt_u, uint64_t, a > b)
+AOT_BINOP(i64_le_s, uint64_t, (int64_t)a <= (int64_t)b)
+AOT_BINOP(i64_le_u, uint64_t, a <= b)
+AOT_BINOP(i64_ge_s, uint64_t, (int64_t)a >= (int64_t)b)
+AOT_BINOP(i64_ge_u, uint64_t, a >= b)
+
+AOT_BINOP(i32_add, uint32_t, (uint32_t)(a + b))
+AOT_BINOP(i32_sub, uint32_t, (uint32_t)(a - b))
+AOT_BINOP(i32_mul, uint32_t, (uint32_t)(a * b))
+AOT_BINOP(i32_and, uint32_t, a & b)
+AOT_BINOP(i32_or, uint32_t, a | b)
+AOT_BINOP(i32_xor, uint32_t, a ^ b)
+AOT_BINOP(i32_shl, uint32_t, (uint32_t)(a << (b & 31)))
+AOT_BINOP(i32_shr_s, uint32_t, (uint32_t)((int32_t)a >> (b & 31)))
+AOT_BINOP(i32_shr_u, uint32_t, a >> (b & 31))
+AOT_BINOP(i32_rotl, uint32_t,
+          (uint32_t)((a << (b & 31)) | (a >> ((32 - b) & 31))))
+AOT_BINOP(i32_rotr, uint32_t,
+          (uint32_t)((a >> (b & 31)) | (a << ((32 - b) & 31))))
+
+AOT_BINOP(i64_add, uint64_t, a + b)
+AOT_BINOP(i64_sub, uint64_t, a - b)
+AOT_BINOP(i64_mul, uint64_t, a * b)
+AOT_BINOP(i64_and, uint64_t, a & b)
+AOT_BINOP(i64_or, uint64_t, a | b)
+AOT_BINOP(i64_xor, uint64_t, a ^ b)
+AOT_BINOP(i64_shl, uint64_t, a << (b & 63))
+AOT_BINOP(i64_shr_s, uint64_t, (uint64_t)((int64_t)a >> (b & 63)))
+AOT_BINOP(i64_shr_u, uint64_t, a >> (b & 63))
+AOT_BINOP(i64_rotl, uint64_t, (a << (b & 63)) | (a >> ((64 - b) & 63)))
+AOT_BINOP(i64_rotr, uint64_t, (a >> (b & 63)) | (a << ((64 - b) & 63)))
+
+AOT_UNOP(i32_wrap_i64, uint32_t, a)
+AOT_UNOP(i64_extend_i32_s, uint32_t, (uint64_t)(int32_t)a)
+AOT_UNOP(i64_extend_i32_u, uint32_t, a)
+AOT_UNOP(i32_extend8_s, uint32_t, (uint32_t)(int8_t)a)
+AOT_UNOP(i32_extend16_s, uint32_t, (uint32_t)(int16_t)a)
+AOT_UNOP(i64_extend8_s, uint64_t, (uint64_t)(int8_t)a)
+AOT_UNOP(i64_extend16_s, uint64_t, (uint64_t)(int16_t)a)
+AOT_UNOP(i64_extend32_s, uint64_t, (uint64_t)(int32_t)a)
+
+#undef AOT_UNOP
+#undef AOT_BINOP
+
+/*
+ * division and remainder, which can trap.
+ * the result is stored to *ap.
+ */
+#define AOT_DIVOP(NAME, T, ST, SMIN, SIGNED, EXPR)                            \
+        static inline int aot_##NAME(struct exec_context *ctx, uint64_t *ap,  \
+                                     uint64_t b0)                             \
+        {                                                                     \
+                const T a = (T)*ap;                                           \
+                const T b = (T)b0;                                            \
+                if (__predict_false(b == 0)) {                                \
+                        return aot_trap(ctx, TRAP_DIV_BY_ZERO);               \
+                }                                                             \
+                if (SIGNED && __predict_false((ST)a == SMIN &&                \
+                                              (ST)b == -1)) {                 \
+                        return aot_trap(ctx, TRAP_INTEGER_OVERFLOW);          \
+                }                                                             \
+                *ap = (T)(EXPR);                                              \
+                return 0;                                                     \
+        }
+
+AOT_DIVOP(i32_div_s, uint32_t, int32_t, INT32_MIN, 1, (int32_t)a / (int32_t)b)
+AOT_DIVOP(i32_div_u, uint32_t, int32_t, INT32_MIN, 0, a / b)
+AOT_DIVOP(i32_rem_s, uint32_t, int32_t, INT32_MIN, 0,
+          (int32_t)b == -1 ? 0 : (int32_t)a % (int32_t)b)
+AOT_DIVOP(i32_rem_u, uint32_t, int32_t, INT32_MIN, 0, a % b)
+AOT_DIVOP(i64_div_s, uint64_t, int64_t, INT64_MIN, 1, (int64_t)a / (int64_t)b)
+AOT_DIVOP(i64_div_u, uint64_t, int64_t, INT64_MIN, 0, a / b)
+AOT_DIVOP(i64_rem_s, uint64_t, int64_t, INT64_MIN, 0,
+          (int64_t)b == -1 ? 0 : (int64_t)a % (int64_t)b)
+AOT_DIVOP(i64_rem_u, uint64_t, int64_t, INT64_MIN, 0, a % b)
+
+#undef AOT_DIVOP
+
+#endif /* !defined(_TOYWASM_AOT_H) */
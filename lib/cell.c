@@ -18,11 +18,11 @@ valtype_cellsize(enum valtype t)
                 break;
         case TYPE_i64:
         case TYPE_f64:
-                sz = 2;
+                sz = NUMTYPE_NCELLS;
                 break;
 #if defined(TOYWASM_ENABLE_WASM_SIMD)
         case TYPE_v128:
-                sz = 4;
+                sz = VECTYPE_NCELLS;
                 break;
 #endif
         case TYPE_funcref:
@@ -33,8 +33,12 @@ valtype_cellsize(enum valtype t)
 #if defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING)
         case TYPE_exnref:
                 sz = EXNREF_NCELLS;
+#if defined(TOYWASM_USE_HEAP_EXNREF)
+                assert(sizeof(void *) == sz * sizeof(struct cell));
+#else
                 assert(sizeof(struct wasm_exception) <=
                        sz * sizeof(struct cell));
+#endif
                 break;
 #endif
         default:
@@ -188,6 +192,17 @@ frame_locals_cellidx_fast(struct exec_context *ctx, uint32_t localidx,
         const struct local_info_fast *fast = &ctx->local_u.fast;
         xassert(fast->paramtype_cellidxes != NULL);
         xassert(fast->localtype_cellidxes != NULL);
+#if defined(TOYWASM_USE_64BIT_CELLS)
+        /*
+         * with 64-bit cells, only v128 (and exnref w/o
+         * TOYWASM_USE_HEAP_EXNREF) takes more than a cell.
+         * for the rest of functions, localidx is the cell index.
+         */
+        if (__predict_true(fast->unit)) {
+                *cszp = 1;
+                return localidx;
+        }
+#endif
         uint32_t cidx;
         uint32_t nparams = fast->nparams;
         if (localidx < nparams) {
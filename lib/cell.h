@@ -16,7 +16,11 @@ struct val;
 
 struct cell {
 #if defined(TOYWASM_USE_SMALL_CELLS)
+#if defined(TOYWASM_USE_64BIT_CELLS)
+        uint64_t x;
+#else
         uint32_t x;
+#endif
 #else
 #if defined(TOYWASM_ENABLE_WASM_SIMD)
         uint64_t x[2];
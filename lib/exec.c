@@ -9,9 +9,13 @@
 #include "context.h"
 #include "exec.h"
 #include "expr.h"
+#include "fileio.h"
 #include "insn.h"
+#include "jit.h"
 #include "leb128.h"
+#include "mem.h"
 #include "platform.h"
+#include "profiler.h"
 #include "restart.h"
 #include "suspend.h"
 #include "timeutil.h"
@@ -20,6 +24,10 @@
 #include "util.h"
 #include "xlog.h"
 
+#if defined(TOYWASM_ENABLE_AOT)
+#include "aot.h"
+#endif
+
 /*
  * Note: The C standard allows _Atomic types to have a different
  * size/alignment from their base types:
@@ -44,6 +52,268 @@ ctassert(alignof(_Atomic uint16_t) <= 2);
 ctassert(alignof(_Atomic uint32_t) <= 4);
 ctassert(alignof(_Atomic uint64_t) <= 8);
 
+#if defined(TOYWASM_ENABLE_INSN_STATS_CYCLES) ||                             \
+        defined(TOYWASM_ENABLE_CALL_STATS)
+static uint64_t
+read_cycle_counter(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+        return __builtin_ia32_rdtsc();
+#else
+        /* fall back to nanoseconds */
+        struct timespec now;
+        int ret = timespec_now(CLOCK_MONOTONIC, &now);
+        if (ret != 0) {
+                return 0;
+        }
+        return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+}
+#endif
+
+#if defined(TOYWASM_ENABLE_CALL_STATS)
+static uint32_t
+call_stat_bucket(uint32_t v)
+{
+        uint32_t b = 0;
+        while (v != 0 && b < CALL_STAT_HIST_NBUCKETS - 1) {
+                v >>= 1;
+                b++;
+        }
+        return b;
+}
+
+#if !defined(TOYWASM_USE_RESERVED_STACK)
+static int
+call_stat_vec_grow(struct exec_context *ctx, void *vec, size_t elem_size,
+                   uint32_t count, uint64_t *growp, uint64_t *cyclesp)
+{
+        uint64_t start = read_cycle_counter();
+        int ret = _vec_prealloc(exec_mctx(ctx), vec, elem_size, count);
+        *cyclesp += read_cycle_counter() - start;
+        (*growp)++;
+        return ret;
+}
+#endif
+#endif /* defined(TOYWASM_ENABLE_CALL_STATS) */
+
+#if defined(TOYWASM_USE_RESERVED_STACK)
+static size_t
+stack_region_part_size(uint32_t n, size_t elem_size, size_t pgsz)
+{
+        /* the part itself and a guard page */
+        return HOWMANY((size_t)n * elem_size, pgsz) * pgsz + pgsz;
+}
+
+/*
+ * reserve an address range for the execution stacks and carve it
+ * into the vectors:
+ *
+ *   frames | guard | labels | guard | locals | guard | stack | guard
+ *
+ * as the vectors are never reallocated after this, the per-call checks
+ * are mere comparisons with psize.
+ *
+ * Note: the overflow is detected by the explicit checks, not by
+ * the guard pages. the guard pages are only a safety net.
+ *
+ * the range is not accounted to exec_mctx as a whole. psize of
+ * the vectors starts with 0 and stack_region_grow charges the growth.
+ */
+static int
+stack_region_reserve(struct exec_context *ctx)
+{
+        const size_t pgsz = map_anon_pagesize();
+        uint32_t nframes = TOYWASM_RESERVED_STACK_FRAMES;
+        uint32_t nlabels = TOYWASM_RESERVED_STACK_LABELS;
+        uint32_t ncells = TOYWASM_RESERVED_STACK_CELLS;
+        if (nframes > ctx->options.max_frames) {
+                nframes = ctx->options.max_frames;
+        }
+        if (ncells > ctx->options.max_stackcells) {
+                ncells = ctx->options.max_stackcells;
+        }
+        const size_t frames_size = stack_region_part_size(
+                nframes, sizeof(*ctx->frames.p), pgsz);
+        const size_t labels_size = stack_region_part_size(
+                nlabels, sizeof(*ctx->labels.p), pgsz);
+#if defined(TOYWASM_USE_SEPARATE_LOCALS)
+        const size_t locals_size = stack_region_part_size(
+                ncells, sizeof(*ctx->locals.p), pgsz);
+#else
+        const size_t locals_size = 0;
+#endif
+        const size_t stack_size =
+                stack_region_part_size(ncells, sizeof(*ctx->stack.p), pgsz);
+        const size_t size = frames_size + labels_size + locals_size +
+                            stack_size;
+        uint8_t *p;
+        int ret;
+
+        assert(ctx->stack_region == NULL);
+        assert(ctx->frames.lsize == 0 && ctx->frames.psize == 0);
+        assert(ctx->labels.lsize == 0 && ctx->labels.psize == 0);
+        assert(ctx->stack.lsize == 0 && ctx->stack.psize == 0);
+        ret = map_anon_reserve(size, (void **)&p);
+        if (ret != 0) {
+                xlog_error("failed to reserve execution stacks (%zu bytes) "
+                           "with error %d",
+                           size, ret);
+                return ret;
+        }
+        uint8_t *q = p;
+        ctx->frames.p = (void *)q;
+        q += frames_size;
+        ret = map_anon_guard(q - pgsz, pgsz);
+        if (ret != 0) {
+                goto fail;
+        }
+        ctx->labels.p = (void *)q;
+        q += labels_size;
+        ret = map_anon_guard(q - pgsz, pgsz);
+        if (ret != 0) {
+                goto fail;
+        }
+#if defined(TOYWASM_USE_SEPARATE_LOCALS)
+        assert(ctx->locals.lsize == 0 && ctx->locals.psize == 0);
+        ctx->locals.p = (void *)q;
+        q += locals_size;
+        ret = map_anon_guard(q - pgsz, pgsz);
+        if (ret != 0) {
+                goto fail;
+        }
+#endif
+        ctx->stack.p = (void *)q;
+        q += stack_size;
+        ret = map_anon_guard(q - pgsz, pgsz);
+        if (ret != 0) {
+                goto fail;
+        }
+        assert(q == p + size);
+        ctx->stack_region = p;
+        ctx->stack_region_size = size;
+        ctx->stack_region_charged = 0;
+        ctx->frames_cap = nframes;
+        ctx->labels_cap = nlabels;
+        ctx->cells_cap = ncells;
+        return 0;
+fail:
+        unmap_anon(p, size);
+        VEC_INIT(ctx->frames);
+        VEC_INIT(ctx->labels);
+#if defined(TOYWASM_USE_SEPARATE_LOCALS)
+        VEC_INIT(ctx->locals);
+#endif
+        VEC_INIT(ctx->stack);
+        return ret;
+}
+
+static void
+stack_region_release(struct exec_context *ctx)
+{
+        if (ctx->stack_region != NULL) {
+                unmap_anon(ctx->stack_region, ctx->stack_region_size);
+                mem_unreserve(exec_mctx(ctx), ctx->stack_region_charged);
+                ctx->stack_region = NULL;
+        }
+        VEC_INIT(ctx->frames);
+        VEC_INIT(ctx->labels);
+#if defined(TOYWASM_USE_SEPARATE_LOCALS)
+        VEC_INIT(ctx->locals);
+#endif
+        VEC_INIT(ctx->stack);
+}
+
+/*
+ * extend psize of a vector in the region, charging the growth to
+ * exec_mctx. the memory is only committed by the kernel when it's
+ * touched. we charge a bit ahead, in the same way as VEC_PREALLOC.
+ */
+static int
+stack_region_grow(struct exec_context *ctx, uint32_t *psizep, uint32_t cap,
+                  size_t elem_size, uint64_t needed)
+{
+        assert(needed <= cap);
+        uint64_t newsize = (uint64_t)*psizep * 2;
+        const uint64_t min = map_anon_pagesize() / elem_size;
+        if (newsize < min) {
+                newsize = min;
+        }
+        if (newsize < needed) {
+                newsize = needed;
+        }
+        if (newsize > cap) {
+                newsize = cap;
+        }
+        const size_t diff = (size_t)(newsize - *psizep) * elem_size;
+        int ret = mem_reserve(exec_mctx(ctx), diff);
+        if (ret != 0) {
+                return ret;
+        }
+        ctx->stack_region_charged += diff;
+        *psizep = (uint32_t)newsize;
+        return 0;
+}
+
+/*
+ * the slow path of EXEC_VEC_PREALLOC: the first use of the stacks,
+ * a growth within the reserved range, or an overflow.
+ */
+static int
+stack_region_prealloc(struct exec_context *ctx, uint32_t *psizep,
+                      uint64_t needed)
+{
+        if (ctx->stack_region == NULL) {
+                int ret = stack_region_reserve(ctx);
+                if (ret != 0) {
+                        return ret;
+                }
+        }
+        if (psizep == &ctx->frames.psize) {
+                if (needed <= ctx->frames_cap) {
+                        return stack_region_grow(ctx, psizep, ctx->frames_cap,
+                                                 sizeof(*ctx->frames.p),
+                                                 needed);
+                }
+                return trap_with_id(ctx, TRAP_TOO_MANY_FRAMES,
+                                    "too many frames");
+        }
+        if (psizep == &ctx->labels.psize) {
+                if (needed <= ctx->labels_cap) {
+                        return stack_region_grow(ctx, psizep, ctx->labels_cap,
+                                                 sizeof(*ctx->labels.p),
+                                                 needed);
+                }
+                return trap_with_id(ctx, TRAP_TOO_MANY_STACKCELLS,
+                                    "too many labels");
+        }
+        if (needed <= ctx->cells_cap) {
+                return stack_region_grow(ctx, psizep, ctx->cells_cap,
+                                         sizeof(*ctx->stack.p), needed);
+        }
+        return trap_with_id(ctx, TRAP_TOO_MANY_STACKCELLS,
+                            "too many values on the stacks");
+}
+
+#define EXEC_VEC_PREALLOC(CTX, V, N, NAME)                                    \
+        (((uint64_t)(V).lsize + (N) > (V).psize)                              \
+                 ? stack_region_prealloc(CTX, &(V).psize,                     \
+                                         (uint64_t)(V).lsize + (N))           \
+                 : 0)
+#elif defined(TOYWASM_ENABLE_CALL_STATS)
+/*
+ * VEC_PREALLOC, counting and timing actual reallocations.
+ */
+#define EXEC_VEC_PREALLOC(CTX, V, N, NAME)                                    \
+        (((uint64_t)(V).lsize + (N) > (V).psize)                              \
+                 ? call_stat_vec_grow(CTX, &(V), sizeof(*(V).p), N,           \
+                                      &(CTX)->stats.calls.NAME,               \
+                                      &(CTX)->stats.calls.NAME##_cycles)      \
+                 : 0)
+#else
+#define EXEC_VEC_PREALLOC(CTX, V, N, NAME) VEC_PREALLOC(exec_mctx(CTX), V, N)
+#endif
+
 void
 frame_clear(struct funcframe *frame)
 {
@@ -62,12 +332,15 @@ frame_locals(const struct exec_context *ctx, const struct funcframe *frame)
 static int
 stack_prealloc(struct exec_context *ctx, uint32_t count)
 {
+#if !defined(TOYWASM_USE_RESERVED_STACK)
+        /* with TOYWASM_USE_RESERVED_STACK, psize is within the limit */
         uint32_t needed = ctx->stack.lsize + count;
         if (needed > ctx->options.max_stackcells) {
                 return trap_with_id(ctx, TRAP_TOO_MANY_STACKCELLS,
                                     "too many values on the operand stack");
         }
-        return VEC_PREALLOC(exec_mctx(ctx), ctx->stack, count);
+#endif
+        return EXEC_VEC_PREALLOC(ctx, ctx->stack, count, stack_grow);
 }
 
 static void
@@ -84,7 +357,7 @@ set_current_frame(struct exec_context *ctx, const struct funcframe *frame,
                  * keyed by PC, they are not safe to use among modules.
                  */
 #if defined(TOYWASM_USE_JUMP_CACHE)
-                ctx->jump_cache = NULL;
+                ctx->jump_cache.ei = NULL;
 #endif
 #if TOYWASM_JUMP_CACHE2_SIZE > 0
                 memset(&ctx->cache, 0, sizeof(ctx->cache));
@@ -126,6 +399,11 @@ set_current_frame(struct exec_context *ctx, const struct funcframe *frame,
                         fast->paramcsz = resulttype_cellsize(&ft->parameter);
                         fast->paramtype_cellidxes = paramtype_cellidxes;
                         fast->localtype_cellidxes = localtype_cellidxes;
+#if defined(TOYWASM_USE_64BIT_CELLS)
+                        const struct localtype *lt = &func->localtype;
+                        fast->unit = fast->paramcsz == fast->nparams &&
+                                     localtype_cellsize(lt) == lt->nlocals;
+#endif
                 } else {
 #endif
                         struct local_info_slow *slow = &ctx->local_u.slow;
@@ -139,7 +417,43 @@ set_current_frame(struct exec_context *ctx, const struct funcframe *frame,
 #if defined(TOYWASM_USE_LOCALS_CACHE)
         ctx->current_locals = frame_locals(ctx, frame);
 #endif
+#if defined(TOYWASM_USE_GLOBALS_CACHE)
+        ctx->own_globals = inst->own_globals;
+        ctx->nimportedglobals = inst->module->nimportedglobals;
+#endif
+        memory_cache_refresh(ctx);
+}
+
+#if defined(TOYWASM_USE_MEMORY_CACHE)
+/*
+ * refresh ctx->mem0_data and ctx->mem0_allocated.
+ *
+ * called when the current instance can have changed (set_current_frame)
+ * and when the memory can have been grown or moved:
+ *
+ * - memory.grow and the lazy extension in memory_getptr2
+ * - host functions, which can grow the memory with memory_grow()
+ * - the resumption of the execution in exec_expr_continue.
+ *   (eg. another thread might have grown a shared memory while we were
+ *   suspended.)
+ *
+ * a stale mem0_allocated smaller than the actual one is harmless
+ * because MEMORY_GETPTR falls back to memory_getptr.
+ */
+void
+memory_cache_refresh(struct exec_context *ctx)
+{
+        const struct instance *inst = ctx->instance;
+        if (inst->mems.lsize > 0) {
+                const struct meminst *mi = VEC_ELEM(inst->mems, 0);
+                ctx->mem0_data = mi->data;
+                ctx->mem0_allocated = mi->allocated;
+        } else {
+                ctx->mem0_data = NULL;
+                ctx->mem0_allocated = 0;
+        }
 }
+#endif
 
 static bool branch_to_label(struct exec_context *ctx, uint32_t labelidx,
                             bool goto_else, uint32_t *heightp,
@@ -177,7 +491,7 @@ frame_enter(struct exec_context *ctx, struct instance *inst, uint32_t funcidx,
                 return trap_with_id(ctx, TRAP_TOO_MANY_FRAMES,
                                     "too many frames");
         }
-        ret = VEC_PREALLOC(exec_mctx(ctx), ctx->frames, 1);
+        ret = EXEC_VEC_PREALLOC(ctx, ctx->frames, 1, frame_grow);
         if (ret != 0) {
                 return ret;
         }
@@ -191,15 +505,15 @@ frame_enter(struct exec_context *ctx, struct instance *inst, uint32_t funcidx,
         frame->labelidx = ctx->labels.lsize;
 #if defined(TOYWASM_USE_SEPARATE_LOCALS)
         frame->localidx = ctx->locals.lsize;
-        ret = VEC_PREALLOC(exec_mctx(ctx), ctx->locals, nlocals);
+        ret = EXEC_VEC_PREALLOC(ctx, ctx->locals, nlocals, frame_grow);
         if (ret != 0) {
                 return ret;
         }
 #endif
         if (ei->maxlabels > 1) {
                 frame->labelidx = ctx->labels.lsize;
-                ret = VEC_PREALLOC(exec_mctx(ctx), ctx->labels,
-                                   ei->maxlabels - 1);
+                ret = EXEC_VEC_PREALLOC(ctx, ctx->labels,
+                                        ei->maxlabels - 1, frame_grow);
                 if (ret != 0) {
                         return ret;
                 }
@@ -251,7 +565,32 @@ frame_enter(struct exec_context *ctx, struct instance *inst, uint32_t funcidx,
                 cells_copy(locals, params, nparams);
         }
 #endif
+#if defined(TOYWASM_ENABLE_CALL_STATS)
+        struct exec_call_stat *cst = &ctx->stats.calls;
+        uint64_t zero_start = read_cycle_counter();
+        cells_zero(locals + nparams, nlocals - nparams);
+        cst->locals_zero_cycles += read_cycle_counter() - zero_start;
+        cst->locals_zero_cells += func_nlocals;
+#if defined(TOYWASM_USE_SEPARATE_LOCALS)
+        const uint32_t reserved = ei->maxcells;
+        cst->locals_hist[call_stat_bucket(nlocals)]++;
+        if (cst->max_localcells < frame->localidx + nlocals) {
+                cst->max_localcells = frame->localidx + nlocals;
+        }
+#else
+        const uint32_t reserved = nlocals + ei->maxcells;
+#endif
+        cst->depth_hist[call_stat_bucket(ctx->frames.lsize)]++;
+        cst->stack_growth_hist[call_stat_bucket(reserved)]++;
+        if (cst->max_frames < ctx->frames.lsize + 1) {
+                cst->max_frames = ctx->frames.lsize + 1;
+        }
+        if (cst->max_stackcells < ctx->stack.lsize + reserved) {
+                cst->max_stackcells = ctx->stack.lsize + reserved;
+        }
+#else
         cells_zero(locals + nparams, nlocals - nparams);
+#endif
 
         xlog_trace_insn("frame enter: maxlabels %u maxcells %u", ei->maxlabels,
                         ei->maxcells);
@@ -260,18 +599,16 @@ frame_enter(struct exec_context *ctx, struct instance *inst, uint32_t funcidx,
                 if (i == nparams) {
                         xlog_trace_insn("-- ^-params v-locals");
                 }
-#if defined(TOYWASM_USE_SMALL_CELLS)
+#if defined(TOYWASM_USE_SMALL_CELLS) && !defined(TOYWASM_USE_64BIT_CELLS)
                 xlog_trace_insn("local [%" PRIu32 "] %08" PRIx32, i,
                                 frame_locals(ctx, frame)[i].x);
-#else
-#if defined(TOYWASM_ENABLE_WASM_SIMD)
+#elif defined(TOYWASM_ENABLE_WASM_SIMD) && !defined(TOYWASM_USE_SMALL_CELLS)
                 xlog_trace_insn("local [%" PRIu32 "] %08" PRIx64 "%08" PRIx64,
                                 i, frame_locals(ctx, frame)[i].x[1],
                                 frame_locals(ctx, frame)[i].x[0]);
 #else
                 xlog_trace_insn("local [%" PRIu32 "] %08" PRIx64, i,
                                 frame_locals(ctx, frame)[i].x);
-#endif
 #endif
         }
 
@@ -327,8 +664,44 @@ frame_exit(struct exec_context *ctx)
 #endif
 }
 
-static const struct jump *
-jump_table_lookup(const struct expr_exec_info *ei, uint32_t blockpc)
+/*
+ * the pc of the start of the expression.
+ * the compact forms of annotations (expr_exec_info::small) are
+ * relative to it.
+ */
+static uint32_t
+expr_basepc(const struct module *m, const struct expr_exec_info *ei)
+{
+        const struct expr *e =
+                (const void *)((uintptr_t)ei -
+                               toywasm_offsetof(struct expr, ei));
+        return ptr2pc(m, e->start);
+}
+
+static uint32_t
+jump_table_pc(const struct expr_exec_info *ei, uint32_t idx)
+{
+        if (ei->small) {
+                return ei->jumps_u.jumps16[idx].pc;
+        }
+        return ei->jumps_u.jumps[idx].pc;
+}
+
+static uint32_t
+jump_table_targetpc(const struct expr_exec_info *ei, uint32_t idx)
+{
+        if (ei->small) {
+                return ei->jumps_u.jumps16[idx].targetpc;
+        }
+        return ei->jumps_u.jumps[idx].targetpc;
+}
+
+/*
+ * returns the index of the jump table entry for the block at pc.
+ * for the compact form, pc is relative to the start of the expression.
+ */
+static uint32_t
+jump_table_lookup(const struct expr_exec_info *ei, uint32_t pc)
 {
         uint32_t left = 0;
         uint32_t right = ei->njumps;
@@ -340,11 +713,11 @@ jump_table_lookup(const struct expr_exec_info *ei, uint32_t blockpc)
         while (true) {
                 assert(left < right);
                 uint32_t mid = (left + right) / 2;
-                const struct jump *jump = &ei->jumps[mid];
-                if (jump->pc == blockpc) {
-                        return jump;
+                const uint32_t mid_pc = jump_table_pc(ei, mid);
+                if (mid_pc == pc) {
+                        return mid;
                 }
-                if (jump->pc < blockpc) {
+                if (mid_pc < pc) {
                         left = mid + 1;
                 } else {
                         right = mid;
@@ -353,33 +726,59 @@ jump_table_lookup(const struct expr_exec_info *ei, uint32_t blockpc)
 #else  /* defined(TOYWASM_USE_JUMP_BINARY_SEARCH) */
         uint32_t i;
         for (i = left; i < right; i++) {
-                const struct jump *jump = &ei->jumps[i];
-                if (jump->pc == blockpc) {
-                        return jump;
+                if (jump_table_pc(ei, i) == pc) {
+                        return i;
                 }
         }
 #endif /* defined(TOYWASM_USE_JUMP_BINARY_SEARCH) */
         assert(false);
 }
 
-static const struct jump *
+/*
+ * look up the jump table for the block at blockpc.
+ *
+ * returns the pc to jump to.
+ * if goto_else is true and the block ("if") has "else", the jump
+ * target is the "else" and *stay_in_blockp is set to true.
+ */
+static uint32_t
 jump_lookup(struct exec_context *ctx, const struct expr_exec_info *ei,
-            uint32_t blockpc)
+            uint32_t blockpc, bool goto_else, bool *stay_in_blockp)
 {
-        const struct jump *jump;
+        uint32_t basepc = 0;
+        uint32_t idx;
+        if (ei->small) {
+                basepc = expr_basepc(ctx->instance->module, ei);
+        }
 #if defined(TOYWASM_USE_JUMP_CACHE)
-        jump = ctx->jump_cache;
-        if (jump != NULL && jump->pc == blockpc) {
+        if (ctx->jump_cache.ei == ei && ctx->jump_cache.blockpc == blockpc) {
                 STAT_INC(ctx, jump_cache_hit);
-                return jump;
-        }
+                idx = ctx->jump_cache.idx;
+        } else
 #endif
-        STAT_INC(ctx, jump_table_search);
-        jump = jump_table_lookup(ei, blockpc);
+        {
+                STAT_INC(ctx, jump_table_search);
+                idx = jump_table_lookup(ei, blockpc - basepc);
 #if defined(TOYWASM_USE_JUMP_CACHE)
-        ctx->jump_cache = jump;
+                ctx->jump_cache.ei = ei;
+                ctx->jump_cache.blockpc = blockpc;
+                ctx->jump_cache.idx = idx;
 #endif
-        return jump;
+        }
+        *stay_in_blockp = false;
+        if (goto_else) {
+                /* the slot for "if -> else" */
+                assert(jump_table_pc(ei, idx + 1) + basepc == blockpc + 1);
+                const uint32_t else_targetpc =
+                        jump_table_targetpc(ei, idx + 1);
+                if (else_targetpc != 0) {
+                        *stay_in_blockp = true;
+                        return basepc + else_targetpc;
+                }
+        }
+        const uint32_t targetpc = jump_table_targetpc(ei, idx);
+        assert(targetpc != 0);
+        return basepc + targetpc;
 }
 
 const struct func *
@@ -436,7 +835,14 @@ do_host_call(struct exec_context *ctx, const struct funcinst *finst)
                 }
         }
         struct cell *p = &VEC_ELEM(ctx->stack, ctx->stack.lsize - nparams);
+#if defined(TOYWASM_ENABLE_CALL_STATS)
+        uint64_t start = read_cycle_counter();
         ret = finst->u.host.func(ctx, finst->u.host.instance, ft, p, p);
+        ctx->stats.calls.host_call_cycles += read_cycle_counter() - start;
+#else
+        ret = finst->u.host.func(ctx, finst->u.host.instance, ft, p, p);
+#endif
+        memory_cache_refresh(ctx);
         assert(IS_RESTARTABLE(ret) || restart_info_is_none(ctx));
         if (ret != 0) {
                 if (IS_RESTARTABLE(ret)) {
@@ -455,6 +861,55 @@ do_host_call(struct exec_context *ctx, const struct funcinst *finst)
         return 0;
 }
 
+#if defined(TOYWASM_ENABLE_AOT)
+static int
+do_aot_call(struct exec_context *ctx, const struct funcinst *finst)
+{
+        const struct functype *ft = funcinst_functype(finst);
+        uint32_t nparams = resulttype_cellsize(&ft->parameter);
+        uint32_t nresults = resulttype_cellsize(&ft->result);
+        int ret;
+        assert(ctx->stack.lsize >= nparams);
+        if (nresults > nparams) {
+                ret = stack_prealloc(ctx, nresults - nparams);
+                if (ret != 0) {
+                        return ret;
+                }
+        }
+        struct cell *p = &VEC_ELEM(ctx->stack, ctx->stack.lsize - nparams);
+        /*
+         * aot functions only call aot functions in the same instance.
+         * (see aot.h) switch the instance for the whole native call tree.
+         *
+         * Note: aot_depth is not maintained on errors. restore it here.
+         */
+        struct instance *saved_inst = ctx->instance;
+        uint32_t saved_depth = ctx->aot_depth;
+        ctx->instance = finst->u.wasm.instance;
+        memory_cache_refresh(ctx);
+#if defined(TOYWASM_ENABLE_JIT)
+        if (finst->u.wasm.aot == NULL) {
+                ret = jit_call(ctx, finst, p);
+        } else {
+                ret = finst->u.wasm.aot(ctx, ctx->instance, p);
+        }
+#else
+        ret = finst->u.wasm.aot(ctx, ctx->instance, p);
+#endif
+        ctx->instance = saved_inst;
+        ctx->aot_depth = saved_depth;
+        memory_cache_refresh(ctx);
+        assert(!IS_RESTARTABLE(ret));
+        if (ret != 0) {
+                return ret;
+        }
+        ctx->stack.lsize -= nparams;
+        ctx->stack.lsize += nresults;
+        assert(ctx->stack.lsize <= ctx->stack.psize);
+        return 0;
+}
+#endif
+
 static int
 do_call(struct exec_context *ctx, const struct funcinst *finst)
 {
@@ -462,9 +917,18 @@ do_call(struct exec_context *ctx, const struct funcinst *finst)
         if (finst->is_host) {
                 STAT_INC(ctx, host_call);
                 return do_host_call(ctx, finst);
-        } else {
-                return do_wasm_call(ctx, finst);
         }
+#if defined(TOYWASM_ENABLE_AOT)
+        if (finst->u.wasm.aot != NULL && aot_usable(ctx)) {
+                return do_aot_call(ctx, finst);
+        }
+#endif
+#if defined(TOYWASM_ENABLE_JIT)
+        if (aot_usable(ctx) && jit_ready(finst)) {
+                return do_aot_call(ctx, finst);
+        }
+#endif
+        return do_wasm_call(ctx, finst);
 }
 
 #if defined(TOYWASM_ENABLE_WASM_TAILCALL)
@@ -499,9 +963,37 @@ compare_taginst(const struct taginst *a, const struct taginst *b)
         return a != b;
 }
 
+/*
+ * returns the number of the exception handler table entries whose pc is
+ * less than or equal to the given pc.
+ */
+static uint32_t
+catch_handler_upper_bound(const struct expr_exec_info *ei, uint32_t pc)
+{
+        uint32_t left = 0;
+        uint32_t right = ei->ncatches;
+        while (left < right) {
+                uint32_t mid = (left + right) / 2;
+                if (ei->catches[mid].pc <= pc) {
+                        left = mid + 1;
+                } else {
+                        right = mid;
+                }
+        }
+        return left;
+}
+
 /*
  * find_catch: find the matching exception handler for the given taginst.
  *
+ * we don't decode the bytecode here. instead, we use the exception
+ * handler table built by the validation. (expr_exec_info::catches)
+ *
+ * frames without try_table are skipped as a whole.
+ * within a frame, the pcs of the labels are decreasing as we walk
+ * from the innermost label. thus we can walk the table backward in
+ * parallel with the labels.
+ *
  * At this point, we avoid modifying exec_context so that we can give
  * a better diagnostic on uncaught exception.
  */
@@ -512,96 +1004,418 @@ find_catch(const struct exec_context *ctx, const struct taginst *taginst,
         assert(ctx->frames.lsize > 0);
         uint32_t frameidx = ctx->frames.lsize - 1;
         uint32_t labelheight = ctx->labels.lsize;
-        uint32_t catch_labelidx;
-        bool all;
-        uint32_t i;
-        const struct funcframe *frame;
-        for (i = 0; i < ctx->labels.lsize; i++) {
-                uint32_t labelidx = ctx->labels.lsize - i - 1;
-                do {
-                        frame = &VEC_ELEM(ctx->frames, frameidx);
-                        if (frame->labelidx <= labelidx) {
-                                break;
-                        }
-                        if (frameidx == ctx->bottom) {
-                                /*
-                                 * we hit a host frame.
-                                 */
-                                return ENOENT;
-                        }
-                        labelheight = frame->labelidx;
-                        assert(frameidx > 0);
-                        frameidx--;
-                } while (true);
-                assert(labelidx >= frame->labelidx);
-                assert(labelidx < labelheight);
+        while (true) {
+                const struct funcframe *frame =
+                        &VEC_ELEM(ctx->frames, frameidx);
                 const struct instance *inst = frame->instance;
                 const struct module *m = inst->module;
-                const struct label *l = &VEC_ELEM(ctx->labels, labelidx);
-                uint32_t blockpc = l->pc;
-                xlog_trace_insn("%s: looking at frame %" PRIu32
-                                " label %" PRIu32 " pc %06" PRIx32,
-                                __func__, frameidx, labelidx, blockpc);
-                const uint8_t *const blockp = pc2ptr(m, blockpc);
-                const uint8_t *p = blockp;
-                const uint8_t op = *p++;
-                if (op != FRAME_OP_TRY_TABLE) {
-                        xlog_trace_insn("%s: not a try-table", __func__);
-                        continue;
+                const struct expr_exec_info *ei = NULL;
+                if (frame->funcidx != FUNCIDX_INVALID) {
+                        assert(frame->funcidx >= m->nimportedfuncs);
+                        const struct func *func =
+                                &m->funcs[frame->funcidx - m->nimportedfuncs];
+                        ei = &func->e.ei;
                 }
-                /* const int64_t blocktype = */ read_leb_s33_nocheck(&p);
-                const uint32_t vec_count = read_leb_u32_nocheck(&p);
-                xlog_trace_insn("%s: try-table with %" PRIu32
-                                " catch clause(s)",
-                                __func__, vec_count);
-                uint32_t j;
-                for (j = 0; j < vec_count; j++) {
-                        xlog_trace_insn(
-                                "%s: looking at catch at pc %06" PRIx32,
-                                __func__, ptr2pc(m, p));
-                        const uint8_t catch_op = *p++;
-                        uint32_t catch_tagidx;
-                        const struct taginst *catch_taginst = NULL;
-                        switch (catch_op) {
-                        case CATCH_REF:
-                        case CATCH:
-                                catch_tagidx = read_leb_u32_nocheck(&p);
-                                assert(catch_tagidx <
-                                       m->nimportedtags + m->ntags);
-                                catch_taginst =
-                                        VEC_ELEM(inst->tags, catch_tagidx);
-                                break;
-                        case CATCH_ALL_REF:
-                        case CATCH_ALL:
+                assert(frame->labelidx <= labelheight);
+                uint32_t labelidx = labelheight;
+                uint32_t hi = 0;
+                if (ei != NULL && ei->ncatches > 0 &&
+                    labelidx > frame->labelidx) {
+                        const struct label *l =
+                                &VEC_ELEM(ctx->labels, labelidx - 1);
+                        hi = catch_handler_upper_bound(ei, l->pc);
+                }
+                if (hi == 0) {
+                        xlog_trace_insn("%s: skipping frame %" PRIu32
+                                        " w/o catch clauses",
+                                        __func__, frameidx);
+                        labelidx = frame->labelidx;
+                }
+                while (labelidx > frame->labelidx) {
+                        labelidx--;
+                        const struct label *l =
+                                &VEC_ELEM(ctx->labels, labelidx);
+                        const uint32_t blockpc = l->pc;
+                        while (hi > 0 && ei->catches[hi - 1].pc > blockpc) {
+                                hi--;
+                        }
+                        if (hi == 0) {
+                                /* no try_table in the outer labels */
                                 break;
-                        default:
-                                assert(false);
                         }
-                        uint32_t catch_label = read_leb_u32_nocheck(&p);
-                        /* labelidx here is of try_table block. */
-                        assert(catch_label <= labelidx - frame->labelidx);
-                        catch_labelidx =
-                                catch_label + (labelheight - labelidx);
-                        if (catch_taginst == NULL) {
-                                all = true;
-                                goto found;
+                        if (ei->catches[hi - 1].pc != blockpc) {
+                                continue;
+                        }
+                        uint32_t lo = hi - 1;
+                        while (lo > 0 && ei->catches[lo - 1].pc == blockpc) {
+                                lo--;
+                        }
+                        xlog_trace_insn("%s: try-table at frame %" PRIu32
+                                        " label %" PRIu32 " pc %06" PRIx32
+                                        " with %" PRIu32 " catch clause(s)",
+                                        __func__, frameidx, labelidx,
+                                        blockpc, hi - lo);
+                        uint32_t i;
+                        for (i = lo; i < hi; i++) {
+                                const struct catch_handler *h =
+                                        &ei->catches[i];
+                                /* label here is of try_table block. */
+                                assert(h->label <=
+                                       labelidx - frame->labelidx);
+                                bool all = h->tagidx == CATCH_HANDLER_ALL;
+                                if (!all) {
+                                        assert(h->tagidx <
+                                               m->nimportedtags + m->ntags);
+                                        const struct taginst *catch_taginst =
+                                                VEC_ELEM(inst->tags,
+                                                         h->tagidx);
+                                        if (compare_taginst(catch_taginst,
+                                                            taginst)) {
+                                                continue;
+                                        }
+                                }
+                                *frameidxp = frameidx;
+                                *labelidxp =
+                                        h->label + (labelheight - labelidx);
+                                *allp = all;
+                                return 0;
+                        }
+                }
+                if (frameidx == ctx->bottom) {
+                        /*
+                         * we hit a host frame.
+                         */
+                        return ENOENT;
+                }
+                labelheight = frame->labelidx;
+                assert(frameidx > 0);
+                frameidx--;
+        }
+}
+
+#if defined(TOYWASM_USE_HEAP_EXNREF)
+/* the minimum number of exposed exceptions to trigger exception_gc */
+#define EXCEPTION_GC_MIN 64
+
+static size_t
+exception_size(uint32_t ncells)
+{
+        return sizeof(struct wasm_exception) + ncells * sizeof(struct cell);
+}
+
+struct wasm_exception *
+exnref_from_cells(const struct cell *cells)
+{
+        struct wasm_exception *exc;
+        /* Note: use memcpy as the cells might be misaligned */
+        memcpy(&exc, cells, sizeof(exc));
+        return exc;
+}
+
+/*
+ * an exception object (see push_exception) is owned by the instance
+ * which created it. it's kept alive by references from:
+ *
+ * - globals and table elements (global_set, table_set, etc)
+ * - the parameters of other exceptions
+ * - the embedder (exec_pop_vals)
+ * - exec_contexts which have exposed it to wasm (exception_expose)
+ *
+ * when the last reference is dropped, it's recycled via the free list
+ * of the instance. otherwise, it's freed by instance_destroy.
+ *
+ * globals, table elements and exception parameters can only refer to
+ * the exceptions owned by the instance which owns them. storing other
+ * exceptions traps. (exnref_store_check) this way, instance_destroy
+ * never leaves a dangling reference in another instance. the embedder
+ * should follow the same rule when using global_set and table_set
+ * directly. the exnref values returned by exec_pop_vals are only valid
+ * until the instance is destroyed.
+ *
+ * as operand stacks and locals are not typed, an exec_context can't
+ * track copies of exnref there. instead, it keeps a reference to each
+ * exception it has exposed and periodically drops the ones which are
+ * not found in its stack. (exception_gc) it's safe because the other
+ * places where a copy of exnref can be while the context is running
+ * are:
+ *
+ * - the parameters and results of host functions.
+ *   they are on the operand stack during the call, including when
+ *   the host function calls back wasm. (schedule_call_from_hostfunc)
+ *   a host function which keeps an exnref elsewhere across a restart
+ *   should take a reference with exception_ref.
+ *
+ * - restart_info. it doesn't have values. (RESTART_HOSTFUNC only
+ *   saves the stack height)
+ *
+ * - jit and aot code. they only deal with integer values.
+ */
+void
+exception_ref(struct wasm_exception *exc)
+{
+        if (exc != NULL) {
+                exc->refcount++;
+        }
+}
+
+/*
+ * put an unreferenced exception to the free list, dropping the
+ * references from its parameters.
+ */
+static void
+exception_release(struct wasm_exception *exc)
+{
+        /*
+         * exceptions can be chained via parameters.
+         * use next_free as a work list to avoid recursion.
+         */
+        struct wasm_exception *pending = exc;
+        assert(exc->refcount == 0);
+        assert(exc->next_free == NULL);
+        while ((exc = pending) != NULL) {
+                pending = exc->next_free;
+                const struct resulttype *rt =
+                        &taginst_functype(exc->tag)->parameter;
+                uint32_t i;
+                for (i = 0; i < rt->ntypes; i++) {
+                        if (rt->types[i] != TYPE_exnref) {
+                                continue;
                         }
-                        if (!compare_taginst(catch_taginst, taginst)) {
-                                all = false;
-                                goto found;
+                        uint32_t csz;
+                        uint32_t idx = resulttype_cellidx(rt, i, &csz);
+                        struct wasm_exception *e =
+                                exnref_from_cells(&exc->cells[idx]);
+                        if (e != NULL) {
+                                assert(e->refcount > 0);
+                                if (--e->refcount == 0) {
+                                        e->next_free = pending;
+                                        pending = e;
+                                }
                         }
                 }
+                struct instance *inst = exc->owner;
+                exc->tag = NULL;
+                exc->next_free = inst->free_exceptions;
+                inst->free_exceptions = exc;
         }
-        /* not found */
-        return ENOENT;
+}
 
-found:
-        *frameidxp = frameidx;
-        *labelidxp = catch_labelidx;
-        *allp = all;
+void
+exception_unref(struct wasm_exception *exc)
+{
+        if (exc == NULL) {
+                return;
+        }
+        assert(exc->refcount > 0);
+        if (--exc->refcount == 0) {
+                exception_release(exc);
+        }
+}
+
+/*
+ * make the exception reachable from the wasm code executed by
+ * the context. (eg. by catch_ref or global.get)
+ */
+int
+exception_expose(struct exec_context *ctx, struct wasm_exception *exc)
+{
+        if (exc == NULL || exc->exposed == ctx) {
+                return 0;
+        }
+        int ret = VEC_PREALLOC(exec_mctx(ctx), ctx->exnrefs, 1);
+        if (ret != 0) {
+                return ret;
+        }
+        exception_ref(exc);
+        exc->exposed = ctx;
+        *VEC_PUSH(ctx->exnrefs) = exc;
         return 0;
 }
 
+/*
+ * check if the exception can be stored in a global or a table element
+ * of the current instance, or in the parameters of a new exception.
+ * "imported" is true if the global or table is imported.
+ * see the comment on exception_ref.
+ */
+int
+exnref_store_check(struct exec_context *ctx, const struct wasm_exception *exc,
+                   bool imported)
+{
+        if (exc == NULL || (!imported && exc->owner == ctx->instance)) {
+                return 0;
+        }
+        return trap_with_id(ctx, TRAP_FOREIGN_EXNREF_STORE,
+                            "storing an exnref of another instance");
+}
+
+static int
+exnref_cmp(const void *a, const void *b)
+{
+        uintptr_t x = (uintptr_t)*(struct wasm_exception *const *)a;
+        uintptr_t y = (uintptr_t)*(struct wasm_exception *const *)b;
+        if (x < y) {
+                return -1;
+        }
+        return x > y;
+}
+
+static void
+exception_mark_cells(struct exec_context *ctx, const struct cell *cells,
+                     uint32_t ncells)
+{
+        struct wasm_exception *const *p = ctx->exnrefs.p;
+        uint32_t n = ctx->exnrefs.lsize;
+        uintptr_t lo = (uintptr_t)p[0];
+        uintptr_t hi = (uintptr_t)p[n - 1];
+        uint32_t csz = valtype_cellsize(TYPE_exnref);
+        uint32_t i;
+        /*
+         * an exnref can be at any cell. look at every position.
+         * false positives only keep garbage a bit longer.
+         */
+        for (i = 0; i + csz <= ncells; i++) {
+                struct wasm_exception *exc = exnref_from_cells(&cells[i]);
+                if ((uintptr_t)exc < lo || (uintptr_t)exc > hi) {
+                        continue;
+                }
+                struct wasm_exception *const *found =
+                        bsearch(&exc, p, n, sizeof(*p), exnref_cmp);
+                if (found != NULL) {
+                        (*found)->marked = true;
+                }
+        }
+}
+
+/*
+ * drop the references from the context to the exposed exceptions
+ * which are no longer on the operand stack or locals.
+ *
+ * Note: the caller should ensure ctx->stack.lsize covers all the live
+ * values. (SAVE_STACK_PTR)
+ */
+static void
+exception_gc(struct exec_context *ctx)
+{
+        struct wasm_exception **p = ctx->exnrefs.p;
+        uint32_t n = ctx->exnrefs.lsize;
+        uint32_t i;
+        uint32_t j = 0;
+        if (n > 0) {
+                qsort(p, n, sizeof(*p), exnref_cmp);
+                exception_mark_cells(ctx, ctx->stack.p, ctx->stack.lsize);
+#if defined(TOYWASM_USE_SEPARATE_LOCALS)
+                exception_mark_cells(ctx, ctx->locals.p, ctx->locals.lsize);
+#endif
+                for (i = 0; i < n; i++) {
+                        struct wasm_exception *exc = p[i];
+                        /* keep one reference for each live exception */
+                        if (exc->marked && (j == 0 || p[j - 1] != exc)) {
+                                p[j++] = exc;
+                                continue;
+                        }
+                        if (!exc->marked && exc->exposed == ctx) {
+                                exc->exposed = NULL;
+                        }
+                        exception_unref(exc);
+                }
+                for (i = 0; i < j; i++) {
+                        p[i]->marked = false;
+                }
+                xlog_trace("%s: %" PRIu32 " -> %" PRIu32 " exceptions",
+                           __func__, n, j);
+                ctx->exnrefs.lsize = j;
+        }
+        ctx->exnrefs_gc_threshold = j * 2;
+        if (ctx->exnrefs_gc_threshold < EXCEPTION_GC_MIN) {
+                ctx->exnrefs_gc_threshold = EXCEPTION_GC_MIN;
+        }
+}
+
+/*
+ * allocate an exception object with at least ncells cells for
+ * the current instance.
+ * see the comment on push_exception.
+ *
+ * Note: this might run exception_gc.
+ */
+struct wasm_exception *
+exception_alloc(struct exec_context *ctx, uint32_t ncells)
+{
+        struct instance *inst = ctx->instance;
+        if (ctx->exnrefs.lsize >= ctx->exnrefs_gc_threshold) {
+                exception_gc(ctx);
+        }
+        struct wasm_exception **excp = &inst->free_exceptions;
+        struct wasm_exception *exc;
+        while ((exc = *excp) != NULL) {
+                if (exc->ncells >= ncells) {
+                        *excp = exc->next_free;
+                        exc->next_free = NULL;
+                        goto found;
+                }
+                excp = &exc->next_free;
+        }
+        exc = mem_alloc(inst->mctx, exception_size(ncells));
+        if (exc == NULL) {
+                return NULL;
+        }
+        exc->owner = inst;
+        exc->ncells = ncells;
+        exc->next_free = NULL;
+        exc->next = inst->exceptions;
+        inst->exceptions = exc;
+found:
+        exc->exposed = NULL;
+        exc->refcount = 0;
+        exc->marked = false;
+        return exc;
+}
+
+/*
+ * drop the references from the own globals and tables of the instance,
+ * and free all the exception objects owned by the instance.
+ * for instance_destroy.
+ *
+ * Note: because of exnref_store_check, the references from the globals
+ * and tables are all to the exceptions being freed here. we drop them
+ * anyway to keep the reference counts consistent for the exceptions
+ * which are still referenced by the embedder.
+ */
+void
+instance_exceptions_destroy(struct instance *inst)
+{
+        const struct module *m = inst->module;
+        struct wasm_exception *exc;
+        uint32_t i;
+        for (i = 0; inst->own_globals != NULL && i < m->nglobals; i++) {
+                struct globalinst *ginst = &inst->own_globals[i];
+                if (ginst->type->t == TYPE_exnref) {
+                        exception_unref(ginst->val.u.exnref);
+                        ginst->val.u.exnref = NULL;
+                }
+        }
+        for (i = m->nimportedtables; i < inst->tables.lsize; i++) {
+                struct tableinst *t = VEC_ELEM(inst->tables, i);
+                if (t == NULL || t->type->et != TYPE_exnref) {
+                        continue;
+                }
+                uint32_t csz = valtype_cellsize(TYPE_exnref);
+                uint32_t j;
+                for (j = 0; j < t->size; j++) {
+                        struct cell *cells = &t->cells[j * csz];
+                        exception_unref(exnref_from_cells(cells));
+                        memset(cells, 0, csz * sizeof(*cells));
+                }
+        }
+        while ((exc = inst->exceptions) != NULL) {
+                inst->exceptions = exc->next;
+                mem_free(inst->mctx, exc, exception_size(exc->ncells));
+        }
+        inst->free_exceptions = NULL;
+}
+#endif /* defined(TOYWASM_USE_HEAP_EXNREF) */
+
 static int
 do_exception(struct exec_context *ctx)
 {
@@ -613,6 +1427,19 @@ do_exception(struct exec_context *ctx)
          */
         uint32_t exnref_csz = valtype_cellsize(TYPE_exnref);
         assert(ctx->stack.lsize >= exnref_csz);
+#if defined(TOYWASM_USE_HEAP_EXNREF)
+        struct wasm_exception *exc;
+        /* Note: use memcpy as the cells might be misaligned */
+        memcpy(&exc, &VEC_ELEM(ctx->stack, ctx->stack.lsize - exnref_csz),
+               sizeof(exc));
+        ctx->stack.lsize -= exnref_csz;
+
+        const struct taginst *taginst = NULL;
+        if (exc != NULL) {
+                taginst = exc->tag;
+                assert(taginst != NULL);
+        }
+#else
         const struct cell *exc_cells =
                 &VEC_ELEM(ctx->stack, ctx->stack.lsize - exnref_csz);
         const struct wasm_exception *exc = (const void *)exc_cells;
@@ -621,6 +1448,7 @@ do_exception(struct exec_context *ctx)
         const struct taginst *taginst;
         /* Note: use memcpy as exc might be misaligned */
         memcpy(&taginst, exception_tag_ptr(exc), sizeof(taginst));
+#endif
         xlog_trace_insn("%s: taginst %p", __func__, (const void *)taginst);
         if (taginst == NULL) {
                 /* an attempt to throw ref.null should trap. */
@@ -638,6 +1466,11 @@ do_exception(struct exec_context *ctx)
         if (ret != 0) {
                 assert(ret == ENOENT);
                 xlog_trace_insn("%s: no catch clause found for tag", __func__);
+#if defined(TOYWASM_USE_HEAP_EXNREF)
+                if (exc->refcount == 0) {
+                        exception_release(exc);
+                }
+#endif
                 return trap_with_id(ctx, TRAP_UNCAUGHT_EXCEPTION,
                                     "uncaught exception");
         }
@@ -694,6 +1527,39 @@ do_exception(struct exec_context *ctx)
                 assert(arity == csz + exnref_csz);
         }
 
+#if defined(TOYWASM_USE_HEAP_EXNREF)
+        assert(ctx->stack.psize >= height + arity);
+        struct cell *dst = &VEC_ELEM(ctx->stack, height);
+        cells_copy(dst, exc->cells, csz);
+        if (!all) {
+                const struct resulttype *rt =
+                        &taginst_functype(taginst)->parameter;
+                uint32_t i;
+                for (i = 0; i < rt->ntypes; i++) {
+                        if (rt->types[i] != TYPE_exnref) {
+                                continue;
+                        }
+                        uint32_t vcsz;
+                        uint32_t idx = resulttype_cellidx(rt, i, &vcsz);
+                        ret = exception_expose(ctx,
+                                               exnref_from_cells(&dst[idx]));
+                        if (ret != 0) {
+                                return ret;
+                        }
+                }
+        }
+        if (arity != csz) {
+                /* catch_ref/catch_all_ref exposes exnref to wasm. */
+                ret = exception_expose(ctx, exc);
+                if (ret != 0) {
+                        return ret;
+                }
+                memcpy(dst + csz, &exc, sizeof(exc));
+        } else if (exc->refcount == 0) {
+                /* nobody else can have a reference to the exception. */
+                exception_release(exc);
+        }
+#else
         /*
          * Note: we use cells_move here as src and dst can overlap.
          *
@@ -722,6 +1588,7 @@ do_exception(struct exec_context *ctx)
                 exc = (const void *)exc_cells;
         }
         cells_move(dst, exc_cells, csz);
+#endif
         ctx->stack.lsize = height + arity;
         xlog_trace_insn("%s: copied csz %" PRIu32, __func__, csz);
         return 0;
@@ -861,21 +1728,12 @@ block_exit(struct exec_context *ctx, uint32_t blockpc, bool goto_else,
                  * do a jump. (w/ jump table)
                  */
                 const struct expr_exec_info *const ei = ctx->ei;
-                if (ei->jumps != NULL) {
+                if (ei->jumps_u.jumps != NULL) {
                         xlog_trace_insn("jump w/ table");
-                        bool stay_in_block = false;
-                        const struct jump *jump;
-                        jump = jump_lookup(ctx, ei, blockpc);
-                        if (goto_else) {
-                                const struct jump *jump_to_else = jump + 1;
-                                assert(jump_to_else->pc == blockpc + 1);
-                                if (jump_to_else->targetpc != 0) {
-                                        stay_in_block = true;
-                                        jump = jump_to_else;
-                                }
-                        }
-                        assert(jump->targetpc != 0);
-                        ctx->p = pc2ptr(ctx->instance->module, jump->targetpc);
+                        bool stay_in_block;
+                        const uint32_t targetpc = jump_lookup(
+                                ctx, ei, blockpc, goto_else, &stay_in_block);
+                        ctx->p = pc2ptr(m, targetpc);
                         if (stay_in_block) {
                                 xlog_trace_insn("jump inside a block");
                                 return true;
@@ -887,7 +1745,7 @@ block_exit(struct exec_context *ctx, uint32_t blockpc, bool goto_else,
                 /*
                  * do a jump. (w/o jump table)
                  */
-                if (ei->jumps == NULL) {
+                if (ei->jumps_u.jumps == NULL) {
                         xlog_trace_insn("jump w/o table");
                         /*
                          * The only way to find out the jump target is
@@ -1030,6 +1888,39 @@ do_branch(struct exec_context *ctx, uint32_t labelidx, bool goto_else)
         rewind_stack(ctx, height, arity);
 }
 
+#if defined(TOYWASM_ENABLE_INSN_STATS_CYCLES)
+void
+insn_stat_record(struct exec_context *ctx, uint32_t slot)
+{
+        struct exec_stat *st = &ctx->stats;
+        uint64_t now = read_cycle_counter();
+        if (st->insn_last_cycles != 0) {
+                st->insn_cycles[st->insn_last_slot] +=
+                        now - st->insn_last_cycles;
+        }
+        st->insn_last_cycles = now;
+        st->insn_last_slot = slot;
+        st->insn[slot]++;
+}
+#endif /* defined(TOYWASM_ENABLE_INSN_STATS_CYCLES) */
+
+#if defined(TOYWASM_ENABLE_INSN_STATS) && !defined(TOYWASM_USE_SEPARATE_EXECUTE)
+static uint32_t
+insn_stat_slot(uint32_t prefix, uint32_t op)
+{
+        switch (prefix) {
+        case 0xfc:
+                return INSN_STAT_FC + op;
+        case 0xfd:
+                return INSN_STAT_FD + op;
+        case 0xfe:
+                return INSN_STAT_FE + op;
+        }
+        assert(false);
+        return 0;
+}
+#endif
+
 int
 fetch_exec_next_insn(const uint8_t *p, struct cell *stack,
                      struct exec_context *ctx)
@@ -1044,6 +1935,11 @@ fetch_exec_next_insn(const uint8_t *p, struct cell *stack,
 #endif
         uint32_t op = *p++;
 #if defined(TOYWASM_USE_SEPARATE_EXECUTE)
+        /*
+         * Note: for prefixed opcodes, this counts the prefix.
+         * fetch_multibyte_opcode counts the second opcode.
+         */
+        INSN_STAT_INC(ctx, op);
         xlog_trace_insn("exec %06" PRIx32 ": %s (%02" PRIx32 ")", pc,
                         instructions[op].name, op);
         const struct exec_instruction_desc *desc = &exec_instructions[op];
@@ -1054,8 +1950,14 @@ fetch_exec_next_insn(const uint8_t *p, struct cell *stack,
 #else
         const struct instruction_desc *desc = &instructions[op];
         if (__predict_false(desc->next_table != NULL)) {
+#if defined(TOYWASM_ENABLE_INSN_STATS)
+                const uint32_t prefix = op;
+#endif
                 op = read_leb_u32_nocheck(&p);
                 desc = &desc->next_table[op];
+                INSN_STAT_INC(ctx, insn_stat_slot(prefix, op));
+        } else {
+                INSN_STAT_INC(ctx, op);
         }
         xlog_trace_insn("exec %06" PRIx32 ": %s", pc, desc->name);
         assert(desc->process != NULL);
@@ -1088,6 +1990,11 @@ restart_insn(struct exec_context *ctx)
 int
 check_interrupt(struct exec_context *ctx)
 {
+#if defined(TOYWASM_ENABLE_PROFILER)
+        if (ctx->profiler != NULL) {
+                profiler_sample(ctx->profiler, ctx);
+        }
+#endif
         /*
          * theoretically we probably need a memory barrier.
          * practically it shouldn't be a problem though.
@@ -1175,6 +2082,12 @@ check_interrupt_interval_ms(struct exec_context *ctx)
                         }
                 }
         }
+#endif
+#if defined(TOYWASM_ENABLE_PROFILER)
+        const struct profiler *p = ctx->profiler;
+        if (p != NULL && (uint32_t)interval_ms > p->interval_ms) {
+                interval_ms = p->interval_ms;
+        }
 #endif
         return interval_ms;
 }
@@ -1207,16 +2120,22 @@ adjust_check_interval(struct exec_context *ctx, const struct timespec *now,
 {
         struct timespec diff;
         timespec_sub(now, last, &diff);
-        uint64_t diff_ms = timespec_to_ms(&diff);
+        /*
+         * use microseconds because the profiler can request
+         * intervals as short as 1ms.
+         */
+        uint64_t diff_us = (uint64_t)diff.tv_sec * 1000000 +
+                           (uint64_t)diff.tv_nsec / 1000;
         uint32_t check_interval = ctx->check_interval;
-        uint32_t interval_ms = check_interrupt_interval_ms(ctx);
-        if (diff_ms < interval_ms / 2) {
+        uint64_t interval_us =
+                (uint64_t)check_interrupt_interval_ms(ctx) * 1000;
+        if (diff_us < interval_us / 2) {
                 if (check_interval <= CHECK_INTERVAL_MAX / 2) {
                         check_interval *= 2;
                 } else {
                         check_interval = CHECK_INTERVAL_MAX;
                 }
-        } else if (diff_ms / 2 > interval_ms) {
+        } else if (diff_us / 2 > interval_us) {
                 check_interval /= 2;
                 if (check_interval < CHECK_INTERVAL_MIN) {
                         check_interval = CHECK_INTERVAL_MIN;
@@ -1265,8 +2184,13 @@ exec_expr(uint32_t funcidx, const struct expr *expr,
         return exec_expr_continue(ctx);
 }
 
+#if defined(TOYWASM_ENABLE_CALL_STATS)
+static int
+do_exec_expr_continue(struct exec_context *ctx)
+#else
 int
 exec_expr_continue(struct exec_context *ctx)
+#endif
 {
 #if defined(ADJUST_CHECK_INTERVAL)
         struct timespec last;
@@ -1274,12 +2198,31 @@ exec_expr_continue(struct exec_context *ctx)
 #endif
         uint32_t n = ctx->check_interval;
         assert(n > 0);
+#if defined(TOYWASM_ENABLE_INSN_STATS_CYCLES)
+        /* don't charge the time outside of the loop to an insn */
+        ctx->stats.insn_last_cycles = 0;
+#endif
+        memory_cache_refresh(ctx);
         while (true) {
+                /*
+                 * only calls and backward branches can make
+                 * the execution unbounded. we count only them. (safepoints)
+                 * straight-line code, including forward branches, doesn't
+                 * need the bookkeeping.
+                 *
+                 * in a function, the only backward branches are the ones
+                 * to loop labels. (a catch clause can target a loop label
+                 * as well. exceptions are always counted.)
+                 */
+                const uint8_t *pc = ctx->p;
+                const uint32_t nframes = ctx->frames.lsize;
+                bool safepoint = false;
                 int ret;
                 switch (ctx->event) {
 #if defined(TOYWASM_ENABLE_WASM_TAILCALL)
                 case EXEC_EVENT_RETURN_CALL:
                         assert(ctx->frames.lsize > 0);
+                        safepoint = true;
                         ret = do_return_call(ctx, ctx->event_u.call.func);
                         if (ret != 0) {
                                 if (IS_RESTARTABLE(ret)) {
@@ -1298,6 +2241,8 @@ exec_expr_continue(struct exec_context *ctx)
 #endif /* defined(TOYWASM_ENABLE_WASM_TAILCALL) */
 #if defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING)
                 case EXEC_EVENT_EXCEPTION:
+                        /* rare enough. just count it. */
+                        safepoint = true;
                         ret = do_exception(ctx);
                         if (ret != 0) {
                                 return ret;
@@ -1305,15 +2250,23 @@ exec_expr_continue(struct exec_context *ctx)
                         break;
 #endif /* defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING) */
                 case EXEC_EVENT_CALL:
+                        safepoint = true;
                         ret = do_call(ctx, ctx->event_u.call.func);
                         if (ret != 0) {
                                 return ret;
                         }
                         break;
                 case EXEC_EVENT_BRANCH:
-                        assert(ctx->frames.lsize > 0);
+                        assert(nframes > 0);
                         do_branch(ctx, ctx->event_u.branch.index,
                                   ctx->event_u.branch.goto_else);
+                        /*
+                         * a branch to the function label returns to
+                         * the caller. comparing pc with the caller's
+                         * code is meaningless. a return can't loop.
+                         */
+                        safepoint =
+                                ctx->frames.lsize == nframes && ctx->p <= pc;
                         break;
                 case EXEC_EVENT_RESTART_INSN:
                         /*
@@ -1349,8 +2302,7 @@ exec_expr_continue(struct exec_context *ctx)
                         return_to_hostfunc(ctx);
                         continue;
                 }
-                n--;
-                if (__predict_false(n == 0)) {
+                if (safepoint && __predict_false(--n == 0)) {
 #if defined(ADJUST_CHECK_INTERVAL)
                         struct timespec now;
                         ret = timespec_now(CLOCK_MONOTONIC, &now);
@@ -1388,6 +2340,38 @@ after_insn:
         return 0;
 }
 
+#if defined(TOYWASM_ENABLE_CALL_STATS)
+int
+exec_expr_continue(struct exec_context *ctx)
+{
+        struct exec_call_stat *cst = &ctx->stats.calls;
+        if (cst->restart_last_cycles != 0) {
+                cst->restart_cycles +=
+                        read_cycle_counter() - cst->restart_last_cycles;
+                cst->restart_last_cycles = 0;
+        }
+        int ret = do_exec_expr_continue(ctx);
+        if (IS_RESTARTABLE(ret)) {
+                cst->restart++;
+                cst->restart_last_cycles = read_cycle_counter();
+        }
+        return ret;
+}
+
+void
+exec_context_get_call_stats(const struct exec_context *ctx,
+                            struct exec_call_stat *st)
+{
+        *st = ctx->stats.calls;
+}
+
+void
+exec_context_reset_call_stats(struct exec_context *ctx)
+{
+        memset(&ctx->stats.calls, 0, sizeof(ctx->stats.calls));
+}
+#endif /* defined(TOYWASM_ENABLE_CALL_STATS) */
+
 int
 exec_push_vals(struct exec_context *ctx, const struct resulttype *rt,
                const struct val *vals)
@@ -1403,9 +2387,9 @@ exec_push_vals(struct exec_context *ctx, const struct resulttype *rt,
         return 0;
 }
 
-void
-exec_pop_vals(struct exec_context *ctx, const struct resulttype *rt,
-              struct val *vals)
+static void
+pop_vals(struct exec_context *ctx, const struct resulttype *rt,
+         struct val *vals)
 {
         uint32_t ncells = resulttype_cellsize(rt);
         assert(ctx->stack.lsize >= ncells);
@@ -1414,6 +2398,25 @@ exec_pop_vals(struct exec_context *ctx, const struct resulttype *rt,
         vals_from_cells(vals, cells, rt);
 }
 
+void
+exec_pop_vals(struct exec_context *ctx, const struct resulttype *rt,
+              struct val *vals)
+{
+        pop_vals(ctx, rt, vals);
+#if defined(TOYWASM_USE_HEAP_EXNREF)
+        /*
+         * the embedder can keep exnref after exec_context_clear.
+         * the exception is kept until the instance is destroyed.
+         */
+        uint32_t i;
+        for (i = 0; i < rt->ntypes; i++) {
+                if (rt->types[i] == TYPE_exnref) {
+                        exception_ref(vals[i].u.exnref);
+                }
+        }
+#endif
+}
+
 /*
  * skip the block starting at *p.
  *
@@ -1514,7 +2517,7 @@ exec_const_expr(const struct expr *expr, enum valtype type, struct val *result,
                 return ret;
         }
         DEFINE_RESULTTYPE(, rt, &type, 1);
-        exec_pop_vals(ctx, &rt, result);
+        pop_vals(ctx, &rt, result);
         assert(ctx->frames.lsize == saved_height);
         return 0;
 }
@@ -1540,13 +2543,29 @@ exec_context_clear(struct exec_context *ctx)
         VEC_FOREACH(frame, ctx->frames) {
                 frame_clear(frame);
         }
+#if defined(TOYWASM_USE_RESERVED_STACK)
+        stack_region_release(ctx);
+#else
         VEC_FREE(mctx, ctx->frames);
         VEC_FREE(mctx, ctx->stack);
         VEC_FREE(mctx, ctx->labels);
 #if defined(TOYWASM_USE_SEPARATE_LOCALS)
         VEC_FREE(mctx, ctx->locals);
 #endif
+#endif
+        restart_info_abandon(ctx);
         VEC_FREE(mctx, ctx->restarts);
+#if defined(TOYWASM_USE_HEAP_EXNREF)
+        struct wasm_exception **excp;
+        VEC_FOREACH(excp, ctx->exnrefs) {
+                struct wasm_exception *exc = *excp;
+                if (exc->exposed == ctx) {
+                        exc->exposed = NULL;
+                }
+                exception_unref(exc);
+        }
+        VEC_FREE(mctx, ctx->exnrefs);
+#endif
         report_clear(&ctx->report0);
         ctx->report = NULL;
 }
@@ -1562,20 +2581,39 @@ find_type_annotation(struct exec_context *ctx, const uint8_t *p)
                 STAT_INC(ctx, type_annotation_lookup1);
                 return an->default_size;
         }
-        const uint32_t pc = ptr2pc(ctx->instance->module, p);
+        const struct module *m = ctx->instance->module;
+        uint32_t pc = ptr2pc(m, p);
+        uint32_t size = 0;
         uint32_t i;
-        for (i = 0; i < an->ntypes; i++) {
-                if (pc < an->types[i].pc) {
-                        break;
+        if (ei->small) {
+                pc -= expr_basepc(m, ei);
+                const struct type_annotation16 *types = an->types_u.types16;
+                for (i = 0; i < an->ntypes; i++) {
+                        if (pc < types[i].pc) {
+                                break;
+                        }
+                }
+                if (i > 0) {
+                        size = types[i - 1].size;
+                }
+        } else {
+                const struct type_annotation *types = an->types_u.types;
+                for (i = 0; i < an->ntypes; i++) {
+                        if (pc < types[i].pc) {
+                                break;
+                        }
+                }
+                if (i > 0) {
+                        size = types[i - 1].size;
                 }
         }
         if (i == 0) {
                 STAT_INC(ctx, type_annotation_lookup2);
                 return an->default_size;
         }
-        assert(an->types[i - 1].size > 0);
+        assert(size > 0);
         STAT_INC(ctx, type_annotation_lookup3);
-        return an->types[i - 1].size;
+        return size;
 #else
         return 1;
 #endif
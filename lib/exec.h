@@ -56,6 +56,38 @@ int memory_getptr(struct exec_context *ctx, uint32_t memidx, uint32_t ptr,
                   uint32_t offset, uint32_t size, void **pp);
 int memory_getptr2(struct exec_context *ctx, uint32_t memidx, uint32_t ptr,
                    uint32_t offset, uint32_t size, void **pp, bool *movedp);
+
+/*
+ * EXEC_GLOBALINST: VEC_ELEM(ctx->instance->globals, idx) with a fast path
+ * for non-imported globals.
+ */
+#if defined(TOYWASM_USE_GLOBALS_CACHE)
+#define EXEC_GLOBALINST(CTX, IDX)                                             \
+        (((IDX) >= (CTX)->nimportedglobals)                                   \
+                 ? &(CTX)->own_globals[(IDX) - (CTX)->nimportedglobals]       \
+                 : VEC_ELEM((CTX)->instance->globals, IDX))
+#else
+#define EXEC_GLOBALINST(CTX, IDX) VEC_ELEM((CTX)->instance->globals, IDX)
+#endif
+
+/*
+ * MEMORY_GETPTR: memory_getptr with a fast path for memory 0.
+ *
+ * the fast path only covers the range already allocated. the rest,
+ * including the lazy extension of the memory, is left to memory_getptr.
+ */
+#if defined(TOYWASM_USE_MEMORY_CACHE)
+#define MEMORY_GETPTR(CTX, MEMIDX, PTR, OFFSET, SIZE, PP)                     \
+        (((MEMIDX) == 0 && (uint64_t)(PTR) + (OFFSET) + (SIZE) <=             \
+                                   (CTX)->mem0_allocated)                     \
+                 ? (*(PP) = (CTX)->mem0_data + (size_t)(PTR) + (OFFSET), 0)   \
+                 : memory_getptr(CTX, MEMIDX, PTR, OFFSET, SIZE, PP))
+void memory_cache_refresh(struct exec_context *ctx);
+#else
+#define MEMORY_GETPTR(CTX, MEMIDX, PTR, OFFSET, SIZE, PP)                     \
+        memory_getptr(CTX, MEMIDX, PTR, OFFSET, SIZE, PP)
+#define memory_cache_refresh(CTX)
+#endif
 struct toywasm_mutex;
 int memory_atomic_getptr(struct exec_context *ctx, uint32_t memidx,
                          uint32_t ptr, uint32_t offset, uint32_t size,
@@ -67,6 +99,20 @@ int frame_enter(struct exec_context *ctx, struct instance *inst,
                 const struct resulttype *paramtype, uint32_t nresults,
                 const struct cell *params);
 void frame_clear(struct funcframe *frame);
+#if defined(TOYWASM_USE_HEAP_EXNREF)
+struct wasm_exception *exception_alloc(struct exec_context *ctx,
+                                       uint32_t ncells);
+struct wasm_exception *exnref_from_cells(const struct cell *cells);
+void exception_ref(struct wasm_exception *exc);
+void exception_unref(struct wasm_exception *exc);
+int exception_expose(struct exec_context *ctx, struct wasm_exception *exc);
+int exnref_store_check(struct exec_context *ctx,
+                       const struct wasm_exception *exc, bool imported);
+void instance_exceptions_destroy(struct instance *inst);
+int table_copy_exnref(struct exec_context *ctx, const struct tableinst *dst,
+                      uint32_t d, bool dst_imported,
+                      const struct tableinst *src, uint32_t s, uint32_t n);
+#endif
 void frame_exit(struct exec_context *ctx);
 struct cell *frame_locals(const struct exec_context *ctx,
                           const struct funcframe *frame) __purefunc;
@@ -1,3 +1,6 @@
+#if !defined(_TOYWASM_EXEC_CONTEXT_H)
+#define _TOYWASM_EXEC_CONTEXT_H
+
 #if __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_ATOMICS__)
 #include <stdatomic.h>
 #endif
@@ -95,6 +98,7 @@ enum trapid {
         TRAP_THROW_REF_NULL,
         TRAP_UNRESOLVED_IMPORTED_FUNC,
         TRAP_MEMORY_NOT_FOUND,
+        TRAP_FOREIGN_EXNREF_STORE,
 };
 
 enum exec_event {
@@ -114,8 +118,76 @@ enum restart_type {
         RESTART_NONE,
         RESTART_TIMER,
         RESTART_HOSTFUNC,
+        RESTART_IO,
 };
 
+#if defined(TOYWASM_ENABLE_INSN_STATS)
+/*
+ * slots for exec_stat::insn.
+ * prefixed opcodes (0xfc, 0xfd, 0xfe) are counted in their own ranges,
+ * indexed by the second opcode.
+ */
+#define INSN_STAT_FC 256
+#define INSN_STAT_FD (INSN_STAT_FC + 32)
+#define INSN_STAT_FE (INSN_STAT_FD + 256)
+#define INSN_STAT_NSLOTS (INSN_STAT_FE + 128)
+#endif
+
+#if defined(TOYWASM_ENABLE_CALL_STATS)
+/*
+ * log2 histogram buckets.
+ * bucket 0 is for 0. bucket i (i > 0) is for [2^(i-1), 2^i).
+ * the last bucket also counts larger values.
+ */
+#define CALL_STAT_HIST_NBUCKETS 24
+
+/*
+ * where the call overhead goes.
+ *
+ * "cycles" are in the unit of the cycle counter used for
+ * TOYWASM_ENABLE_INSN_STATS_CYCLES. (rdtsc on x86, nanoseconds otherwise)
+ */
+struct exec_call_stat {
+        /* frame_enter grew ctx->frames, ctx->locals or ctx->labels */
+        uint64_t frame_grow;
+        uint64_t frame_grow_cycles;
+        /* stack_prealloc grew ctx->stack */
+        uint64_t stack_grow;
+        uint64_t stack_grow_cycles;
+        /* non-parameter locals zeroed by frame_enter */
+        uint64_t locals_zero_cells;
+        uint64_t locals_zero_cycles;
+        /* host function calls, including argument/result marshalling */
+        uint64_t host_call_cycles;
+        /*
+         * restartable errors returned from exec_expr_continue and
+         * the time until the execution is resumed.
+         */
+        uint64_t restart;
+        uint64_t restart_cycles;
+        uint64_t restart_last_cycles; /* 0 when not restarting */
+
+        /* high-water marks */
+        uint32_t max_frames;
+        uint32_t max_stackcells; /* including the reserved cells */
+#if defined(TOYWASM_USE_SEPARATE_LOCALS)
+        uint32_t max_localcells;
+#endif
+
+        /* the number of frames when entering a frame */
+        uint64_t depth_hist[CALL_STAT_HIST_NBUCKETS];
+        /*
+         * ctx->stack cells reserved by frame_enter.
+         * (max operand stack, plus locals w/o TOYWASM_USE_SEPARATE_LOCALS)
+         */
+        uint64_t stack_growth_hist[CALL_STAT_HIST_NBUCKETS];
+#if defined(TOYWASM_USE_SEPARATE_LOCALS)
+        /* ctx->locals cells used by a frame. (params + locals) */
+        uint64_t locals_hist[CALL_STAT_HIST_NBUCKETS];
+#endif
+};
+#endif
+
 struct exec_stat {
         uint64_t call;
         uint64_t host_call; /* included in call */
@@ -156,6 +228,23 @@ struct exec_stat {
 #if defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING)
         uint64_t exception;
 #endif
+#if defined(TOYWASM_ENABLE_INSN_STATS)
+        uint64_t insn[INSN_STAT_NSLOTS];
+#if defined(TOYWASM_ENABLE_INSN_STATS_CYCLES)
+        /*
+         * cycles spent from the dispatch of an instruction to
+         * the dispatch of the next one. it includes the dispatch
+         * overhead and whatever the instruction does. (eg. a call
+         * instruction includes the frame setup.)
+         */
+        uint64_t insn_cycles[INSN_STAT_NSLOTS];
+        uint64_t insn_last_cycles; /* 0 when not running an insn */
+        uint32_t insn_last_slot;
+#endif
+#endif
+#if defined(TOYWASM_ENABLE_CALL_STATS)
+        struct exec_call_stat calls;
+#endif
 };
 
 struct jump_cache {
@@ -172,6 +261,7 @@ struct trap_info {
 
 struct sched;
 struct context;
+struct profiler;
 
 struct restart_info {
         enum restart_type restart_type;
@@ -198,6 +288,23 @@ struct restart_info {
                         uint32_t user1;
                         uint32_t user2;
                 } hostfunc;
+
+                /*
+                 * RESTART_IO
+                 *
+                 * an asynchronous i/o request which a host function has
+                 * submitted and is waiting for.
+                 * (eg. WASI fd_read w/ TOYWASM_ENABLE_WASI_IO_URING)
+                 *
+                 * the request is managed by the host function
+                 * implementation. we only keep a reference here.
+                 * abandon is called with req if the execution is
+                 * never restarted. (exec_context_clear)
+                 */
+                struct {
+                        void *req;
+                        void (*abandon)(void *req);
+                } io;
         } restart_u;
 };
 
@@ -215,6 +322,10 @@ struct exec_context {
                         const uint16_t *localtype_cellidxes;
                         uint32_t nparams;
                         uint32_t paramcsz;
+#if defined(TOYWASM_USE_64BIT_CELLS)
+                        /* every param and local is a single cell */
+                        bool unit;
+#endif
                 } fast;
 #endif
                 struct local_info_slow {
@@ -230,8 +341,25 @@ struct exec_context {
 #if defined(TOYWASM_USE_LOCALS_CACHE)
         struct cell *current_locals;
 #endif
+#if defined(TOYWASM_USE_GLOBALS_CACHE)
+        /* instance::own_globals of the current instance */
+        struct globalinst *own_globals;
+        uint32_t nimportedglobals;
+#endif
+#if defined(TOYWASM_USE_MEMORY_CACHE)
+        /*
+         * a copy of data/allocated of memory 0 of the current instance.
+         * see memory_cache_refresh().
+         */
+        uint8_t *mem0_data;
+        size_t mem0_allocated;
+#endif
 #if defined(TOYWASM_USE_JUMP_CACHE)
-        const struct jump *jump_cache;
+        struct {
+                const struct expr_exec_info *ei;
+                uint32_t blockpc;
+                uint32_t idx; /* index in ei's jump table */
+        } jump_cache;
 #endif
 #if TOYWASM_JUMP_CACHE2_SIZE > 0
         struct jump_cache cache[TOYWASM_JUMP_CACHE2_SIZE];
@@ -244,6 +372,21 @@ struct exec_context {
 #if defined(TOYWASM_USE_SEPARATE_LOCALS)
         VEC(, struct cell) locals;
 #endif
+#if defined(TOYWASM_USE_RESERVED_STACK)
+        /*
+         * the address range backing the above vectors.
+         * reserved on the first use. see stack_region_reserve().
+         *
+         * psize of the vectors is the part charged to exec_mctx.
+         * it grows up to the *_cap below. (stack_region_grow)
+         */
+        void *stack_region;
+        size_t stack_region_size;
+        size_t stack_region_charged;
+        uint32_t frames_cap;
+        uint32_t labels_cap;
+        uint32_t cells_cap; /* for locals and stack */
+#endif
 
         /* check_interrupt() */
         /*
@@ -271,10 +414,44 @@ struct exec_context {
          * raise_user_interrupt(ectx).
          */
         const atomic_uint *intrp;
+        /*
+         * native frames of aot functions can't be unwound to return
+         * ETOYWASMUSERINTERRUPT to the embedder. instead, an aot
+         * function calls this in place on a user interrupt.
+         * it should return 0 to continue the execution, or a
+         * non-restartable error (eg. ETIMEDOUT) to abort it.
+         *
+         * when `intrp` is set without a handler, aot functions are
+         * not used and the interpreter executes the bytecode instead.
+         */
+        int (*user_intr_handler)(struct exec_context *ctx, void *arg);
+        void *user_intr_handler_arg;
         struct cluster *cluster;
         unsigned int user_intr_delay_count;
         unsigned int user_intr_delay;
         uint32_t check_interval;
+#if defined(TOYWASM_ENABLE_PROFILER)
+        /*
+         * when non-NULL, check_interrupt() takes a sample of the call
+         * stack. see profiler.h.
+         */
+        struct profiler *profiler;
+#endif
+#if defined(TOYWASM_ENABLE_AOT)
+        /*
+         * native call depth and the countdown to the next
+         * check_interrupt() in aot functions. see aot.h.
+         */
+        uint32_t aot_depth;
+        uint32_t aot_check_countdown;
+#endif
+#if defined(TOYWASM_ENABLE_JIT)
+        /*
+         * the lowest address of the C stack jit code can use.
+         * computed on the first jit call. (see jit_call)
+         */
+        uintptr_t jit_stack_limit;
+#endif
 
 #if defined(TOYWASM_USE_USER_SCHED)
         /* scheduler */
@@ -321,6 +498,15 @@ struct exec_context {
 
         struct mem_context *mctx;
 
+#if defined(TOYWASM_USE_HEAP_EXNREF)
+        /*
+         * the exception objects exposed to this context, each with
+         * a reference. see exception_expose.
+         */
+        VEC(, struct wasm_exception *) exnrefs;
+        uint32_t exnrefs_gc_threshold;
+#endif
+
         /* Options */
         struct exec_options options;
 
@@ -335,6 +521,13 @@ struct exec_context {
 
 /* for exec_stats */
 #define STAT_INC(CTX, NAME) (CTX)->stats.NAME++
+#if defined(TOYWASM_ENABLE_INSN_STATS_CYCLES)
+#define INSN_STAT_INC(CTX, SLOT) insn_stat_record(CTX, SLOT)
+#elif defined(TOYWASM_ENABLE_INSN_STATS)
+#define INSN_STAT_INC(CTX, SLOT) (CTX)->stats.insn[SLOT]++
+#else
+#define INSN_STAT_INC(CTX, SLOT)
+#endif
 
 __BEGIN_EXTERN_C
 
@@ -342,6 +535,14 @@ void exec_context_init(struct exec_context *ctx, struct instance *inst,
                        struct mem_context *mctx);
 void exec_context_clear(struct exec_context *ctx);
 void exec_context_print_stats(struct exec_context *ctx);
+#if defined(TOYWASM_ENABLE_INSN_STATS_CYCLES)
+void insn_stat_record(struct exec_context *ctx, uint32_t slot);
+#endif
+#if defined(TOYWASM_ENABLE_CALL_STATS)
+void exec_context_get_call_stats(const struct exec_context *ctx,
+                                 struct exec_call_stat *st);
+void exec_context_reset_call_stats(struct exec_context *ctx);
+#endif
 
 int exec_push_vals(struct exec_context *ctx, const struct resulttype *rt,
                    const struct val *params);
@@ -357,3 +558,5 @@ int trap_with_id(struct exec_context *ctx, enum trapid id, const char *fmt,
                  ...) __printflike(3, 4);
 
 __END_EXTERN_C
+
+#endif /* !defined(_TOYWASM_EXEC_CONTEXT_H) */
@@ -1,9 +1,13 @@
 #include <assert.h>
 #include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
 
 #include "context.h"
 #include "exec.h"
 #include "exec_debug.h"
+#include "insn.h"
+#include "mem.h"
 #include "name.h"
 #include "nbio.h"
 #include "type.h"
@@ -16,6 +20,194 @@
 #define STAT_PRINT(name)                                                      \
         nbio_printf("%23s %12" PRIu64 "\n", #name, ctx->stats.name);
 
+#if defined(TOYWASM_ENABLE_INSN_STATS)
+struct insn_stat_entry {
+        uint64_t count;
+        uint32_t slot;
+};
+
+static int
+insn_stat_cmp(const void *a, const void *b)
+{
+        const struct insn_stat_entry *ea = a;
+        const struct insn_stat_entry *eb = b;
+        if (ea->count != eb->count) {
+                return (ea->count > eb->count) ? -1 : 1;
+        }
+        return (ea->slot > eb->slot) - (ea->slot < eb->slot);
+}
+
+static const char *
+insn_stat_name(uint32_t slot, uint32_t *prefixp, uint32_t *opp)
+{
+        const struct instruction_desc *desc;
+        uint32_t prefix;
+        uint32_t op;
+        if (slot >= INSN_STAT_FE) {
+                prefix = 0xfe;
+                op = slot - INSN_STAT_FE;
+        } else if (slot >= INSN_STAT_FD) {
+                prefix = 0xfd;
+                op = slot - INSN_STAT_FD;
+        } else if (slot >= INSN_STAT_FC) {
+                prefix = 0xfc;
+                op = slot - INSN_STAT_FC;
+        } else {
+                *prefixp = 0;
+                *opp = slot;
+                return instructions[slot].name;
+        }
+        *prefixp = prefix;
+        *opp = op;
+        desc = &instructions[prefix];
+        if (desc->next_table == NULL || op >= desc->next_table_size) {
+                return NULL;
+        }
+        return desc->next_table[op].name;
+}
+
+/*
+ * print non-zero per-opcode counters, sorted by the count.
+ * prefixes (0xfc etc) themselves are not shown.
+ */
+static void
+print_insn_stats(const struct exec_context *ctx)
+{
+        const struct exec_stat *st = &ctx->stats;
+        struct insn_stat_entry *entries;
+        uint64_t total = 0;
+#if defined(TOYWASM_ENABLE_INSN_STATS_CYCLES)
+        uint64_t total_cycles = 0;
+#endif
+        uint32_t n = 0;
+        uint32_t i;
+
+        entries = mem_alloc(ctx->mctx, INSN_STAT_NSLOTS * sizeof(*entries));
+        if (entries == NULL) {
+                return;
+        }
+        for (i = 0; i < INSN_STAT_NSLOTS; i++) {
+                if (st->insn[i] == 0) {
+                        continue;
+                }
+                if (i < INSN_STAT_FC && instructions[i].next_table != NULL) {
+                        continue;
+                }
+                entries[n].count = st->insn[i];
+                entries[n].slot = i;
+                n++;
+                total += st->insn[i];
+#if defined(TOYWASM_ENABLE_INSN_STATS_CYCLES)
+                total_cycles += st->insn_cycles[i];
+#endif
+        }
+        qsort(entries, n, sizeof(*entries), insn_stat_cmp);
+        nbio_printf("=== per-opcode statistics ===\n");
+#if defined(TOYWASM_ENABLE_INSN_STATS_CYCLES)
+        nbio_printf("%9s %-24s %14s %7s %16s %7s %9s\n", "opcode", "name",
+                    "count", "%", "cycles", "%", "cyc/insn");
+#else
+        nbio_printf("%9s %-24s %14s %7s\n", "opcode", "name", "count", "%");
+#endif
+        for (i = 0; i < n; i++) {
+                const struct insn_stat_entry *e = &entries[i];
+                uint32_t prefix;
+                uint32_t op;
+                const char *name = insn_stat_name(e->slot, &prefix, &op);
+                char opbuf[sizeof("0xfe 0xffffffff")];
+                if (prefix != 0) {
+                        snprintf(opbuf, sizeof(opbuf),
+                                 "0x%02" PRIx32 " 0x%02" PRIx32, prefix, op);
+                } else {
+                        snprintf(opbuf, sizeof(opbuf), "0x%02" PRIx32, op);
+                }
+                nbio_printf("%9s %-24s %14" PRIu64 " %6.2f%%", opbuf,
+                            (name != NULL) ? name : "?", e->count,
+                            (double)e->count * 100 / total);
+#if defined(TOYWASM_ENABLE_INSN_STATS_CYCLES)
+                const uint64_t cycles = st->insn_cycles[e->slot];
+                nbio_printf(" %16" PRIu64 " %6.2f%% %9.1f", cycles,
+                            (total_cycles > 0)
+                                    ? (double)cycles * 100 / total_cycles
+                                    : 0.0,
+                            (double)cycles / e->count);
+#endif
+                nbio_printf("\n");
+        }
+        nbio_printf("%9s %-24s %14" PRIu64, "", "total", total);
+#if defined(TOYWASM_ENABLE_INSN_STATS_CYCLES)
+        nbio_printf(" %7s %16" PRIu64, "", total_cycles);
+#endif
+        nbio_printf("\n");
+        mem_free(ctx->mctx, entries, INSN_STAT_NSLOTS * sizeof(*entries));
+}
+#endif /* defined(TOYWASM_ENABLE_INSN_STATS) */
+
+#if defined(TOYWASM_ENABLE_CALL_STATS)
+#define CALL_STAT_PRINT(name)                                                 \
+        nbio_printf("%23s %12" PRIu64 "\n", #name, st->name);
+
+static void
+print_call_stat_hist(const char *title, const uint64_t *hist)
+{
+        uint64_t total = 0;
+        uint32_t i;
+        for (i = 0; i < CALL_STAT_HIST_NBUCKETS; i++) {
+                total += hist[i];
+        }
+        if (total == 0) {
+                return;
+        }
+        nbio_printf("%s:\n", title);
+        for (i = 0; i < CALL_STAT_HIST_NBUCKETS; i++) {
+                if (hist[i] == 0) {
+                        continue;
+                }
+                char buf[sizeof("[4294967295, 4294967295)")];
+                if (i == 0) {
+                        snprintf(buf, sizeof(buf), "0");
+                } else if (i == CALL_STAT_HIST_NBUCKETS - 1) {
+                        snprintf(buf, sizeof(buf), ">= %" PRIu32,
+                                 (uint32_t)1 << (i - 1));
+                } else {
+                        snprintf(buf, sizeof(buf), "[%" PRIu32 ", %" PRIu32 ")",
+                                 (uint32_t)1 << (i - 1), (uint32_t)1 << i);
+                }
+                nbio_printf("%23s %12" PRIu64 " %6.2f%%\n", buf, hist[i],
+                            (double)hist[i] * 100 / total);
+        }
+}
+
+static void
+print_call_stats(const struct exec_context *ctx)
+{
+        const struct exec_call_stat *st = &ctx->stats.calls;
+        nbio_printf("=== call statistics ===\n");
+        CALL_STAT_PRINT(frame_grow);
+        CALL_STAT_PRINT(frame_grow_cycles);
+        CALL_STAT_PRINT(stack_grow);
+        CALL_STAT_PRINT(stack_grow_cycles);
+        CALL_STAT_PRINT(locals_zero_cells);
+        CALL_STAT_PRINT(locals_zero_cycles);
+        CALL_STAT_PRINT(host_call_cycles);
+        CALL_STAT_PRINT(restart);
+        CALL_STAT_PRINT(restart_cycles);
+        nbio_printf("%23s %12" PRIu32 "\n", "max_frames", st->max_frames);
+        nbio_printf("%23s %12" PRIu32 "\n", "max_stackcells",
+                    st->max_stackcells);
+#if defined(TOYWASM_USE_SEPARATE_LOCALS)
+        nbio_printf("%23s %12" PRIu32 "\n", "max_localcells",
+                    st->max_localcells);
+#endif
+        print_call_stat_hist("frame depth", st->depth_hist);
+        print_call_stat_hist("stack cells reserved per call",
+                             st->stack_growth_hist);
+#if defined(TOYWASM_USE_SEPARATE_LOCALS)
+        print_call_stat_hist("locals cells per call", st->locals_hist);
+#endif
+}
+#endif /* defined(TOYWASM_ENABLE_CALL_STATS) */
+
 void
 exec_context_print_stats(struct exec_context *ctx)
 {
@@ -67,6 +259,12 @@ exec_context_print_stats(struct exec_context *ctx)
 #if defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING)
         STAT_PRINT(exception);
 #endif
+#if defined(TOYWASM_ENABLE_CALL_STATS)
+        print_call_stats(ctx);
+#endif
+#if defined(TOYWASM_ENABLE_INSN_STATS)
+        print_insn_stats(ctx);
+#endif
 }
 
 static void
@@ -7,6 +7,7 @@
 
 #include "bitmap.h"
 #include "exec.h"
+#include "instance.h"
 #include "leb128.h"
 #include "mem.h"
 #include "platform.h"
@@ -134,6 +135,10 @@ memory_getptr2(struct exec_context *ctx, uint32_t memidx, uint32_t ptr,
                         1 << memtype_page_shift(meminst->type));
                 assert(ret != 0);
         }
+        if (memidx == 0 && ret == 0) {
+                /* we might have extended the memory */
+                memory_cache_refresh(ctx);
+        }
         return ret;
 }
 
@@ -266,13 +271,17 @@ table_init(struct exec_context *ectx, uint32_t tableidx, uint32_t elemidx,
         }
         struct tableinst *t = VEC_ELEM(inst->tables, tableidx);
         assert(t->type->et == elem->type);
-        uint32_t csz = valtype_cellsize(t->type->et);
+        const bool has_funcidxes = element_has_funcidxes(elem);
+        struct element_funcidx_iter it;
+        if (has_funcidxes) {
+                element_funcidx_iter_init(&it, elem, s);
+        }
         uint32_t i;
         for (i = 0; i < n; i++) {
                 struct val val;
-                if (elem->funcs != NULL) {
-                        val.u.funcref.func =
-                                VEC_ELEM(inst->funcs, elem->funcs[s + i]);
+                if (has_funcidxes) {
+                        val.u.funcref.func = VEC_ELEM(
+                                inst->funcs, element_funcidx_iter_next(&it));
                 } else {
                         ret = exec_const_expr(&elem->init_exprs[s + i],
                                               elem->type, &val, ectx);
@@ -280,7 +289,7 @@ table_init(struct exec_context *ectx, uint32_t tableidx, uint32_t elemidx,
                                 goto fail;
                         }
                 }
-                val_to_cells(&val, &t->cells[(d + i) * csz], csz);
+                table_set(t, d + i, &val);
                 xlog_trace("table %" PRIu32 " offset %" PRIu32
                            " initialized to %016" PRIx64,
                            tableidx, d + i, val.u.i64);
@@ -294,9 +303,51 @@ void
 table_set(struct tableinst *tinst, uint32_t elemidx, const struct val *val)
 {
         uint32_t csz = valtype_cellsize(tinst->type->et);
-        val_to_cells(val, &tinst->cells[elemidx * csz], csz);
+        struct cell *cells = &tinst->cells[elemidx * csz];
+#if defined(TOYWASM_USE_HEAP_EXNREF)
+        /* an element holds a reference. see exception_ref. */
+        if (tinst->type->et == TYPE_exnref) {
+                exception_ref(val->u.exnref);
+                exception_unref(exnref_from_cells(cells));
+        }
+#endif
+        val_to_cells(val, cells, csz);
 }
 
+#if defined(TOYWASM_USE_HEAP_EXNREF)
+/*
+ * check and adjust the references for table.copy before copying
+ * the cells.
+ */
+int
+table_copy_exnref(struct exec_context *ctx, const struct tableinst *dst,
+                  uint32_t d, bool dst_imported, const struct tableinst *src,
+                  uint32_t s, uint32_t n)
+{
+        uint32_t csz = valtype_cellsize(TYPE_exnref);
+        uint32_t i;
+        if (src != dst) {
+                for (i = 0; i < n; i++) {
+                        int ret = exnref_store_check(
+                                ctx,
+                                exnref_from_cells(&src->cells[(s + i) * csz]),
+                                dst_imported);
+                        if (ret != 0) {
+                                return ret;
+                        }
+                }
+        }
+        for (i = 0; i < n; i++) {
+                exception_ref(exnref_from_cells(&src->cells[(s + i) * csz]));
+        }
+        for (i = 0; i < n; i++) {
+                exception_unref(
+                        exnref_from_cells(&dst->cells[(d + i) * csz]));
+        }
+        return 0;
+}
+#endif
+
 void
 table_get(struct tableinst *tinst, uint32_t elemidx, struct val *val)
 {
@@ -378,6 +429,11 @@ table_grow(struct tableinst *t, const struct val *val, uint32_t n)
 
         uint32_t i;
         for (i = t->size; i < newsize; i++) {
+#if defined(TOYWASM_USE_HEAP_EXNREF)
+                if (t->type->et == TYPE_exnref) {
+                        exception_ref(val->u.exnref);
+                }
+#endif
                 val_to_cells(val, &t->cells[i * csz], csz);
         }
         uint32_t oldsize = t->size;
@@ -388,6 +444,13 @@ table_grow(struct tableinst *t, const struct val *val, uint32_t n)
 void
 global_set(struct globalinst *ginst, const struct val *val)
 {
+#if defined(TOYWASM_USE_HEAP_EXNREF)
+        /* a global holds a reference. see exception_ref. */
+        if (ginst->type->t == TYPE_exnref) {
+                exception_ref(val->u.exnref);
+                exception_unref(ginst->val.u.exnref);
+        }
+#endif
         ginst->val = *val;
 }
 
@@ -535,7 +598,9 @@ memory_grow2(struct exec_context *ctx, uint32_t memidx, uint32_t sz)
         const struct module *m = inst->module;
         assert(memidx < m->nimportedmems + m->nmems);
         struct meminst *mi = VEC_ELEM(inst->mems, memidx);
-        return memory_grow_impl(ctx, mi, sz);
+        uint32_t ret = memory_grow_impl(ctx, mi, sz);
+        memory_cache_refresh(ctx);
+        return ret;
 }
 
 uint32_t
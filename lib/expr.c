@@ -138,6 +138,163 @@ fail:
 }
 #endif /* defined(TOYWASM_USE_SEPARATE_VALIDATE) */
 
+size_t
+expr_exec_info_jumps_size(const struct expr_exec_info *ei)
+{
+        if (ei->small) {
+                return ei->njumps * sizeof(*ei->jumps_u.jumps16);
+        }
+        return ei->njumps * sizeof(*ei->jumps_u.jumps);
+}
+
+size_t
+expr_exec_info_types_size(const struct expr_exec_info *ei)
+{
+#if defined(TOYWASM_USE_SMALL_CELLS)
+        const struct type_annotations *an = &ei->type_annotations;
+        if (ei->small) {
+                return an->ntypes * sizeof(*an->types_u.types16);
+        }
+        return an->ntypes * sizeof(*an->types_u.types);
+#else
+        return 0;
+#endif
+}
+
+/*
+ * the jump table, the type annotations and the exception handler table
+ * are built incrementally using the allocator of the validation context.
+ * (load_tmp_mctx)
+ * after the validation of the expression, we finish them:
+ *
+ * - convert them to the compact forms if the expression is small.
+ *   (struct jump16 and struct type_annotation16)
+ *
+ * - move them to the module's allocator if it's different.
+ *   when the module uses an arena (load_options::use_arena), it isn't
+ *   suitable for such growing arrays.
+ *
+ * on a failure, ei is left intact.
+ */
+static int
+expr_exec_info_finish(struct mem_context *dst, struct mem_context *src,
+                      struct expr_exec_info *ei, uint32_t basepc,
+                      uint32_t size)
+{
+        assert(!ei->small);
+        const bool small = size <= EXPR_SMALL_MAX;
+        if (!small && dst == src) {
+                return 0;
+        }
+        struct expr_exec_info nei = *ei;
+        nei.small = small;
+        const size_t jumps_size = expr_exec_info_jumps_size(ei);
+        const size_t njumps_size = expr_exec_info_jumps_size(&nei);
+        void *jumps = NULL;
+        if (ei->jumps_u.jumps != NULL) {
+                jumps = mem_alloc(dst, njumps_size);
+                if (jumps == NULL) {
+                        return ENOMEM;
+                }
+        }
+#if defined(TOYWASM_USE_SMALL_CELLS)
+        struct type_annotations *an = &ei->type_annotations;
+        const size_t types_size = expr_exec_info_types_size(ei);
+        const size_t ntypes_size = expr_exec_info_types_size(&nei);
+        void *types = NULL;
+        if (an->types_u.types != NULL) {
+                types = mem_alloc(dst, ntypes_size);
+                if (types == NULL) {
+                        mem_free(dst, jumps, njumps_size);
+                        return ENOMEM;
+                }
+        }
+#endif
+#if defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING)
+        /* the handler table doesn't have a compact form */
+        const size_t catches_size = ei->ncatches * sizeof(*ei->catches);
+        struct catch_handler *catches = NULL;
+        if (ei->catches != NULL && dst != src) {
+                catches = mem_alloc(dst, catches_size);
+                if (catches == NULL) {
+#if defined(TOYWASM_USE_SMALL_CELLS)
+                        mem_free(dst, types, ntypes_size);
+#endif
+                        mem_free(dst, jumps, njumps_size);
+                        return ENOMEM;
+                }
+        }
+#endif
+        uint32_t i;
+        if (jumps != NULL) {
+                if (small) {
+                        struct jump16 *j16 = jumps;
+                        for (i = 0; i < ei->njumps; i++) {
+                                const struct jump *j = &ei->jumps_u.jumps[i];
+                                assert(j->pc >= basepc);
+                                j16[i].pc = j->pc - basepc;
+                                /* keep 0, which means "no else" */
+                                if (j->targetpc == 0) {
+                                        j16[i].targetpc = 0;
+                                } else {
+                                        assert(j->targetpc > basepc);
+                                        j16[i].targetpc = j->targetpc - basepc;
+                                }
+                        }
+                } else {
+                        memcpy(jumps, ei->jumps_u.jumps, jumps_size);
+                }
+                mem_free(src, ei->jumps_u.jumps, jumps_size);
+                nei.jumps_u.jumps = jumps;
+        }
+#if defined(TOYWASM_USE_SMALL_CELLS)
+        if (types != NULL) {
+                if (small) {
+                        struct type_annotation16 *t16 = types;
+                        for (i = 0; i < an->ntypes; i++) {
+                                const struct type_annotation *t =
+                                        &an->types_u.types[i];
+                                assert(t->pc >= basepc);
+                                t16[i].pc = t->pc - basepc;
+                                t16[i].size = t->size;
+                        }
+                } else {
+                        memcpy(types, an->types_u.types, types_size);
+                }
+                mem_free(src, an->types_u.types, types_size);
+                nei.type_annotations.types_u.types = types;
+        }
+#endif
+#if defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING)
+        if (catches != NULL) {
+                memcpy(catches, ei->catches, catches_size);
+                mem_free(src, ei->catches, catches_size);
+                nei.catches = catches;
+        }
+#endif
+        *ei = nei;
+        return 0;
+}
+
+static void
+expr_exec_info_free(struct mem_context *mctx, struct expr_exec_info *ei)
+{
+        mem_free(mctx, ei->jumps_u.jumps, expr_exec_info_jumps_size(ei));
+        ei->jumps_u.jumps = NULL;
+        ei->njumps = 0;
+#if defined(TOYWASM_USE_SMALL_CELLS)
+        struct type_annotations *an = &ei->type_annotations;
+        mem_free(mctx, an->types_u.types, expr_exec_info_types_size(ei));
+        an->types_u.types = NULL;
+        an->ntypes = 0;
+#endif
+#if defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING)
+        mem_free(mctx, ei->catches, ei->ncatches * sizeof(*ei->catches));
+        ei->catches = NULL;
+        ei->ncatches = 0;
+#endif
+}
+
 static int
 read_expr_common(const uint8_t **pp, const uint8_t *ep, struct expr *expr,
                  uint32_t nlocals, const struct localchunk *locals,
@@ -150,7 +307,7 @@ read_expr_common(const uint8_t **pp, const uint8_t *ep, struct expr *expr,
         int ret;
 
         assert(lctx->module != NULL);
-        struct mem_context *mctx = load_mctx(lctx);
+        struct mem_context *mctx = load_tmp_mctx(lctx);
         struct validation_context *vctx = lctx->vctx;
         if (vctx == NULL) {
                 vctx = mem_alloc(mctx, sizeof(*vctx));
@@ -233,7 +390,7 @@ read_expr_common(const uint8_t **pp, const uint8_t *ep, struct expr *expr,
         }
 #if defined(TOYWASM_ENABLE_TRACING_INSN)
         for (i = 0; i < ei->njumps; i++) {
-                const struct jump *j = &ei->jumps[i];
+                const struct jump *j = &ei->jumps_u.jumps[i];
                 xlog_trace_insn("jump table [%" PRIu32 "] %06" PRIx32
                                 " -> %06" PRIx32,
                                 i, j->pc, j->targetpc);
@@ -245,11 +402,21 @@ read_expr_common(const uint8_t **pp, const uint8_t *ep, struct expr *expr,
 #endif
         xlog_trace("code size %zu, jump table size %zu, max labels %" PRIu32
                    ", cells %" PRIu32,
-                   p - expr->start, ei->njumps * sizeof(*ei->jumps),
+                   p - expr->start, ei->njumps * sizeof(*ei->jumps_u.jumps),
                    ei->maxlabels, ei->maxcells);
+        const uint32_t basepc = ptr2pc(lctx->module, expr->start);
+        ret = expr_exec_info_finish(load_mctx(lctx), vctx->mctx, ei, basepc,
+                                    p - expr->start);
+        if (ret != 0) {
+                goto fail;
+        }
         validation_context_reuse(vctx);
         return 0;
 fail:
+        if (load_mctx(lctx) != vctx->mctx) {
+                /* the module doesn't know how to free these. */
+                expr_exec_info_free(vctx->mctx, ei);
+        }
         validation_context_reuse(vctx);
         return ret;
 }
@@ -275,9 +442,12 @@ read_const_expr(const uint8_t **pp, const uint8_t *ep, struct expr *expr,
         int ret = read_expr_common(pp, ep, expr, 0, NULL, empty_rt,
                                    &resulttype, true, lctx);
         /* a const expr does never require these annotations */
-        assert(expr->ei.jumps == NULL);
+        assert(expr->ei.jumps_u.jumps == NULL);
 #if defined(TOYWASM_USE_SMALL_CELLS)
-        assert(expr->ei.type_annotations.types == NULL);
+        assert(expr->ei.type_annotations.types_u.types == NULL);
+#endif
+#if defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING)
+        assert(expr->ei.catches == NULL);
 #endif
         return ret;
 }
@@ -1,8 +1,10 @@
+#include <stddef.h>
 #include <stdint.h>
 
 #include "valtype.h"
 
 struct expr;
+struct expr_exec_info;
 struct resulttype;
 struct localchunk;
 struct load_context;
@@ -20,3 +22,6 @@ int read_expr(const uint8_t **pp, const uint8_t *ep, struct expr *expr,
               struct load_context *lctx);
 int read_const_expr(const uint8_t **pp, const uint8_t *ep, struct expr *expr,
                     enum valtype type, struct load_context *lctx);
+
+size_t expr_exec_info_jumps_size(const struct expr_exec_info *ei);
+size_t expr_exec_info_types_size(const struct expr_exec_info *ei);
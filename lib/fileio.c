@@ -1,7 +1,12 @@
+#define _DARWIN_C_SOURCE
+#define _GNU_SOURCE
+#define _NETBSD_SOURCE
+
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <sys/stat.h>
 #if defined(_WIN32)
 #include <io.h>
@@ -109,6 +114,58 @@ unmap_file(void *p, size_t sz)
         free(p);
 }
 
+/*
+ * Note: as map_anon_reserve and map_anon_reserve_noaccess always fail,
+ * the callers are expected to fall back to something else. the other
+ * functions are never called with a valid range.
+ */
+int
+map_anon_reserve(size_t size, void **pp)
+{
+        return ENOTSUP;
+}
+
+int
+map_anon_reserve_noaccess(size_t size, void **pp)
+{
+        return ENOTSUP;
+}
+
+int
+map_anon_commit(void *p, size_t sz)
+{
+        return ENOTSUP;
+}
+
+size_t
+map_anon_shrink(void *p, size_t size, size_t newsize)
+{
+        return size;
+}
+
+int
+map_anon_guard(void *p, size_t sz)
+{
+        return ENOTSUP;
+}
+
+int
+map_anon_exec(void *p, size_t sz)
+{
+        return ENOTSUP;
+}
+
+size_t
+map_anon_pagesize(void)
+{
+        return 4096;
+}
+
+void
+unmap_anon(void *p, size_t sz)
+{
+}
+
 #else
 
 #include <sys/mman.h>
@@ -152,4 +209,116 @@ unmap_file(void *p, size_t sz)
         munmap(p, sz);
 }
 
+/*
+ * map_anon_reserve: reserve an address range for anonymous memory.
+ *
+ * the pages are populated on demand. ie. only the pages actually
+ * touched consume physical memory.
+ */
+int
+map_anon_reserve(size_t size, void **pp)
+{
+        int flags = MAP_PRIVATE | MAP_ANON;
+#if defined(MAP_NORESERVE)
+        flags |= MAP_NORESERVE;
+#endif
+        void *vp = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (vp == (void *)MAP_FAILED) {
+                return errno;
+        }
+        *pp = vp;
+        return 0;
+}
+
+/*
+ * map_anon_reserve_noaccess: reserve an inaccessible address range.
+ *
+ * unlike map_anon_reserve, the range doesn't count as memory usage
+ * until the pages are made accessible by map_anon_commit.
+ */
+int
+map_anon_reserve_noaccess(size_t size, void **pp)
+{
+        int flags = MAP_PRIVATE | MAP_ANON;
+#if defined(MAP_NORESERVE)
+        flags |= MAP_NORESERVE;
+#endif
+        void *vp = mmap(NULL, size, PROT_NONE, flags, -1, 0);
+        if (vp == (void *)MAP_FAILED) {
+                return errno;
+        }
+        *pp = vp;
+        return 0;
+}
+
+/*
+ * map_anon_commit: make a page-aligned part of a range mapped by
+ * map_anon_reserve_noaccess readable and writable.
+ */
+int
+map_anon_commit(void *p, size_t sz)
+{
+        if (mprotect(p, sz, PROT_READ | PROT_WRITE) == -1) {
+                return errno;
+        }
+        return 0;
+}
+
+/*
+ * map_anon_shrink: release the tail of a range mapped by map_anon_reserve
+ * or map_anon_reserve_noaccess.
+ *
+ * returns the new size of the range, which is newsize rounded up to
+ * the page size.
+ */
+size_t
+map_anon_shrink(void *p, size_t size, size_t newsize)
+{
+        size_t pgsz = map_anon_pagesize();
+        newsize = (newsize + pgsz - 1) / pgsz * pgsz;
+        if (newsize < size) {
+                munmap((uint8_t *)p + newsize, size - newsize);
+                return newsize;
+        }
+        return size;
+}
+
+/*
+ * map_anon_guard: make a page-aligned part of a range mapped by
+ * map_anon_reserve inaccessible.
+ */
+int
+map_anon_guard(void *p, size_t sz)
+{
+        if (mprotect(p, sz, PROT_NONE) == -1) {
+                return errno;
+        }
+        return 0;
+}
+
+/*
+ * map_anon_exec: make a page-aligned part of a range mapped by
+ * map_anon_reserve read-only and executable. (for jit)
+ */
+int
+map_anon_exec(void *p, size_t sz)
+{
+        if (mprotect(p, sz, PROT_READ | PROT_EXEC) == -1) {
+                return errno;
+        }
+        return 0;
+}
+
+size_t
+map_anon_pagesize(void)
+{
+        return sysconf(_SC_PAGESIZE);
+}
+
+void
+unmap_anon(void *p, size_t sz)
+{
+        munmap(p, sz);
+}
+
 #endif
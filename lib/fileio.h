@@ -5,4 +5,13 @@ __BEGIN_EXTERN_C
 int map_file(const char *filename, void **pp, size_t *szp);
 void unmap_file(void *p, size_t sz);
 
+int map_anon_reserve(size_t size, void **pp);
+int map_anon_reserve_noaccess(size_t size, void **pp);
+int map_anon_commit(void *p, size_t sz);
+size_t map_anon_shrink(void *p, size_t size, size_t newsize);
+int map_anon_guard(void *p, size_t sz);
+int map_anon_exec(void *p, size_t sz);
+size_t map_anon_pagesize(void);
+void unmap_anon(void *p, size_t sz);
+
 __END_EXTERN_C
@@ -0,0 +1,87 @@
+#include <assert.h>
+#include <errno.h>
+
+#include "hash_index.h"
+#include "mem.h"
+
+#define HASH_INDEX_MIN_SIZE 16
+
+void
+hash_index_init(struct hash_index *hi)
+{
+        hi->size = 0;
+        hi->slots = NULL;
+}
+
+void
+hash_index_clear(struct mem_context *mctx, struct hash_index *hi)
+{
+        mem_free(mctx, hi->slots, hi->size * sizeof(*hi->slots));
+        hash_index_init(hi);
+}
+
+/*
+ * keep the load factor <= 1/2.
+ */
+int
+hash_index_reserve(struct mem_context *mctx, struct hash_index *hi,
+                   uint32_t nentries, uint32_t n,
+                   hash_index_hash_func_t hash_func, const void *arg)
+{
+        const uint64_t need = (uint64_t)nentries + n;
+        if (need * 2 <= hi->size) {
+                return 0;
+        }
+        uint64_t size = (hi->size > 0) ? hi->size : HASH_INDEX_MIN_SIZE;
+        while (need * 2 > size) {
+                size *= 2;
+        }
+        if (size > UINT32_MAX / sizeof(*hi->slots)) {
+                return EOVERFLOW;
+        }
+        uint32_t *slots = mem_calloc(mctx, size, sizeof(*slots));
+        if (slots == NULL) {
+                return ENOMEM;
+        }
+        struct hash_index nhi = {
+                .size = (uint32_t)size,
+                .slots = slots,
+        };
+        /* reinsert in the index order to keep the insertion order */
+        uint32_t i;
+        for (i = 0; i < nentries; i++) {
+                hash_index_insert(&nhi, hash_func(arg, i), i);
+        }
+        hash_index_clear(mctx, hi);
+        *hi = nhi;
+        return 0;
+}
+
+void
+hash_index_insert(struct hash_index *hi, uint32_t hash, uint32_t idx)
+{
+        assert(hi->size > 0);
+        assert(idx < UINT32_MAX);
+        const uint32_t mask = hi->size - 1;
+        uint32_t h = hash & mask;
+        while (hi->slots[h] != 0) {
+                h = (h + 1) & mask;
+        }
+        hi->slots[h] = idx + 1;
+}
+
+bool
+hash_index_next(const struct hash_index *hi, uint32_t *posp, uint32_t *idxp)
+{
+        if (hi->size == 0) {
+                return false;
+        }
+        const uint32_t h = *posp & (hi->size - 1);
+        const uint32_t slot = hi->slots[h];
+        if (slot == 0) {
+                return false;
+        }
+        *idxp = slot - 1;
+        *posp = h + 1;
+        return true;
+}
@@ -0,0 +1,60 @@
+#if !defined(_TOYWASM_HASH_INDEX_H)
+#define _TOYWASM_HASH_INDEX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "platform.h"
+
+/*
+ * an open addressing (linear probing) hash index of entries in
+ * an external array. the owner of the array keeps the entries and
+ * provides their hashes. entries can't be removed.
+ *
+ * entries with the same hash are visited in the insertion order.
+ * it's used to implement "the first one wins" rules.
+ */
+struct hash_index {
+        uint32_t size;   /* 0 or a power of 2 */
+        uint32_t *slots; /* entry index + 1. 0 for an empty slot */
+};
+
+typedef uint32_t (*hash_index_hash_func_t)(const void *arg, uint32_t idx);
+
+__BEGIN_EXTERN_C
+
+struct mem_context;
+void hash_index_init(struct hash_index *hi);
+void hash_index_clear(struct mem_context *mctx, struct hash_index *hi);
+
+/*
+ * hash_index_reserve: make room for n more entries.
+ *
+ * nentries is the number of the entries already in the index.
+ * on a resize, hash_func is called to rehash them.
+ */
+int hash_index_reserve(struct mem_context *mctx, struct hash_index *hi,
+                       uint32_t nentries, uint32_t n,
+                       hash_index_hash_func_t hash_func, const void *arg);
+
+/*
+ * hash_index_insert: add an entry.
+ * the caller should have reserved the room with hash_index_reserve.
+ */
+void hash_index_insert(struct hash_index *hi, uint32_t hash, uint32_t idx);
+
+/*
+ * hash_index_next: iterate over the candidates for the hash.
+ *
+ *      uint32_t pos = hash;
+ *      uint32_t idx;
+ *      while (hash_index_next(hi, &pos, &idx)) {
+ *              compare the key of the entry idx
+ *      }
+ */
+bool hash_index_next(const struct hash_index *hi, uint32_t *posp,
+                     uint32_t *idxp);
+
+__END_EXTERN_C
+
+#endif /* !defined(_TOYWASM_HASH_INDEX_H) */
@@ -88,6 +88,10 @@ import_object_create_for_host_funcs(struct mem_context *mctx,
                 }
         }
         assert(idx == nfuncs);
+        ret = import_object_build_index(mctx, im);
+        if (ret != 0) {
+                goto fail;
+        }
         *impp = im;
         return 0;
 fail:
@@ -112,7 +116,7 @@ host_func_dump_params(const struct functype *ft, const struct cell *params)
                 uint32_t sz = valtype_cellsize(type);
                 struct val val;
                 val_from_cells(&val, &params[cidx], sz);
-#if defined(TOYWASM_USE_SMALL_CELLS)
+#if defined(TOYWASM_USE_SMALL_CELLS) && !defined(TOYWASM_USE_64BIT_CELLS)
                 switch (sz) {
                 case 1:
                         xlog_trace("param[%" PRIu32 "] = %08" PRIx32, i,
@@ -3,6 +3,7 @@
 #include <stdlib.h>
 
 #include "escape.h"
+#include "hash_index.h"
 #include "instance.h"
 #include "mem.h"
 #include "report.h"
@@ -87,21 +88,105 @@ import_object_create_for_exports(struct mem_context *mctx,
 #if defined(TOYWASM_SORT_EXPORTS)
         im->use_binary_search = true;
 #endif
+        ret = import_object_build_index(mctx, im);
+        if (ret != 0) {
+                import_object_destroy(mctx, im);
+                return ret;
+        }
         im->next = NULL;
         *resultp = im;
         return 0;
 }
 
+static uint32_t
+import_hash(const struct name *module_name, const struct name *name)
+{
+        return name_hash(name, name_hash(module_name, 0));
+}
+
+static uint32_t
+import_entry_hash(const void *arg, uint32_t idx)
+{
+        const struct import_object *im = arg;
+        const struct import_object_entry *e = &im->entries[idx];
+        return import_hash(e->module_name, e->name);
+}
+
+int
+import_object_build_index(struct mem_context *mctx, struct import_object *im)
+{
+        assert(im->hash_index.size == 0);
+        if (im->nentries == 0) {
+                return 0;
+        }
+        if (im->nentries > UINT32_MAX / 4) {
+                return EOVERFLOW;
+        }
+        int ret = hash_index_reserve(mctx, &im->hash_index, 0,
+                                     (uint32_t)im->nentries, NULL, NULL);
+        if (ret != 0) {
+                return ret;
+        }
+        uint32_t i;
+        for (i = 0; i < im->nentries; i++) {
+                /*
+                 * Note: the index visits entries with the same key in
+                 * the insertion order. it's important to preserve
+                 * the "first one wins" rule.
+                 */
+                hash_index_insert(&im->hash_index, import_entry_hash(im, i),
+                                  i);
+        }
+        return 0;
+}
+
 void
 import_object_destroy(struct mem_context *mctx, struct import_object *im)
 {
         if (im->dtor != NULL) {
                 im->dtor(mctx, im);
         }
+        hash_index_clear(mctx, &im->hash_index);
         mem_free(mctx, im->entries, im->nentries * sizeof(*im->entries));
         mem_free(mctx, im, sizeof(*im));
 }
 
+/*
+ * check an entry which has the matching names.
+ *
+ * returns 0 if found.
+ * returns EINVAL on a type mismatch.
+ * returns ENOENT if check() failed. the caller should continue
+ * the search.
+ */
+static int
+import_object_check_entry(
+        const struct import_object_entry *e, const struct import *im,
+        int (*check)(const struct import_object_entry *e, const void *arg),
+        const void *checkarg, struct report *report)
+{
+        if (e->type != im->desc.type) {
+                struct escaped_string module_name;
+                struct escaped_string name;
+                escape_name(&module_name, &im->module_name);
+                escape_name(&name, &im->name);
+                report_error(report,
+                             "Type mismatch for import %.*s:%.*s (%u != %u)",
+                             ECSTR(&module_name), ECSTR(&name),
+                             (unsigned int)e->type,
+                             (unsigned int)im->desc.type);
+                escaped_string_clear(&module_name);
+                escaped_string_clear(&name);
+                return EINVAL;
+        }
+        if (check(e, checkarg) != 0) {
+                return ENOENT;
+        }
+        xlog_trace("Found an entry for import %.*s:%.*s",
+                   CSTR(&im->module_name), CSTR(&im->name));
+        return 0;
+}
+
 int
 import_object_find_entry(
         const struct import_object *impobj, const struct import *im,
@@ -110,6 +195,29 @@ import_object_find_entry(
         struct report *report)
 {
         const struct import_object_entry *e;
+        int result = ENOENT;
+        int ret;
+        if (impobj->hash_index.size > 0) {
+                uint32_t pos = import_hash(&im->module_name, &im->name);
+                uint32_t i;
+                while (hash_index_next(&impobj->hash_index, &pos, &i)) {
+                        e = &impobj->entries[i];
+                        if (!compare_name(e->name, &im->name) &&
+                            !compare_name(e->module_name, &im->module_name)) {
+                                ret = import_object_check_entry(
+                                        e, im, check, checkarg, report);
+                                if (ret == 0) {
+                                        *resultp = e;
+                                        return 0;
+                                }
+                                if (ret == EINVAL) {
+                                        return EINVAL;
+                                }
+                                result = EINVAL;
+                        }
+                }
+                return result;
+        }
 #if defined(TOYWASM_SORT_EXPORTS)
         if (impobj->use_binary_search) {
                 /*
@@ -122,8 +230,8 @@ import_object_find_entry(
                  *
                  * Note: while this is O(log(n)), this would have
                  * rather large constant factor because of string
-                 * comparisons. if we really care the performance here,
-                 * it's better to use a hash or something instead.
+                 * comparisons. import_object_build_index is usually
+                 * a better choice if the performance matters.
                  */
                 if (impobj->nentries == 0) {
                         return ENOENT;
@@ -144,12 +252,11 @@ import_object_find_entry(
                         xlog_trace("comparing with [%zu] %.*s -> %d", mid,
                                    CSTR(e->name), cmp);
                         if (cmp == 0) {
-                                if (e->type != im->desc.type) {
-                                        goto type_mismatch;
-                                }
-                                int ret = check(e, checkarg);
+                                ret = import_object_check_entry(
+                                        e, im, check, checkarg, report);
                                 if (ret == 0) {
-                                        goto found;
+                                        *resultp = e;
+                                        return 0;
                                 }
                                 return EINVAL;
                         } else if (cmp < 0) {
@@ -161,42 +268,20 @@ import_object_find_entry(
                 return ENOENT;
         }
 #endif
-        int result = ENOENT;
         size_t i;
         for (i = 0; i < impobj->nentries; i++) {
                 e = &impobj->entries[i];
                 if (!compare_name(e->module_name, &im->module_name) &&
                     !compare_name(e->name, &im->name)) {
-                        if (e->type != im->desc.type) {
-#if defined(TOYWASM_SORT_EXPORTS)
-type_mismatch:;
-#endif
-                                struct escaped_string module_name;
-                                struct escaped_string name;
-                                escape_name(&module_name, &im->module_name);
-                                escape_name(&name, &im->name);
-                                report_error(report,
-                                             "Type mismatch for import "
-                                             "%.*s:%.*s (%u != %u)",
-                                             ECSTR(&module_name), ECSTR(&name),
-                                             (unsigned int)e->type,
-                                             (unsigned int)im->desc.type);
-                                escaped_string_clear(&module_name);
-                                escaped_string_clear(&name);
-                                return EINVAL;
-                        }
-                        int ret = check(e, checkarg);
+                        ret = import_object_check_entry(e, im, check,
+                                                        checkarg, report);
                         if (ret == 0) {
-#if defined(TOYWASM_SORT_EXPORTS)
-found:
-#endif
-                                xlog_trace("Found an entry for import "
-                                           "%.*s:%.*s",
-                                           CSTR(&im->module_name),
-                                           CSTR(&im->name));
                                 *resultp = e;
                                 return 0;
                         }
+                        if (ret == EINVAL) {
+                                return EINVAL;
+                        }
                         result = EINVAL;
                 }
         }
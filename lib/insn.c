@@ -40,14 +40,14 @@ stack_push_val(const struct exec_context *ctx, const struct val *val,
 {
         assert(ctx->stack.p <= *stackp);
         assert(*stackp + csz <= ctx->stack.p + ctx->stack.psize);
-        switch (csz) {
-        case 1:
+        switch (csz * sizeof(struct cell)) {
+        case 4:
                 xlog_trace_insn("stack push %08" PRIx32, val->u.i32);
                 break;
-        case 2:
+        case 8:
                 xlog_trace_insn("stack push %016" PRIx64, val->u.i64);
                 break;
-        case 4:
+        case 16:
                 /* Note: val->u.v128 is in little-endian */
                 xlog_trace_insn("stack push %016" PRIx64 " %016" PRIx64,
                                 le64_to_host(val->u.v128.i64[1]),
@@ -69,14 +69,14 @@ stack_pop_val(const struct exec_context *ctx, struct val *val,
         assert(*stackp <= ctx->stack.p + ctx->stack.psize);
         *stackp -= csz;
         val_from_cells(val, *stackp, csz);
-        switch (csz) {
-        case 1:
+        switch (csz * sizeof(struct cell)) {
+        case 4:
                 xlog_trace_insn("stack pop  %08" PRIx32, val->u.i32);
                 break;
-        case 2:
+        case 8:
                 xlog_trace_insn("stack pop  %016" PRIx64, val->u.i64);
                 break;
-        case 4:
+        case 16:
                 /* Note: val->u.v128 is in little-endian */
                 xlog_trace_insn("stack pop  %016" PRIx64 " %016" PRIx64,
                                 le64_to_host(val->u.v128.i64[1]),
@@ -492,6 +492,80 @@ schedule_return_call(struct exec_context *ectx, const struct funcinst *fi)
 #endif
 
 #if defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING)
+#if defined(TOYWASM_USE_HEAP_EXNREF)
+/*
+ * push_exception: create and push an exception onto the operand stack
+ *
+ * logically, this is an equivalent of the following operations:
+ *
+ * - pop exception args
+ * - create an exception with the parameters
+ * - push exnref of the exception
+ *
+ * with TOYWASM_USE_HEAP_EXNREF, the exception is an object allocated
+ * by exception_alloc and exnref is a pointer to it:
+ *
+ * | ... | arg cell 0 | arg cell 1 |
+ *                                  ^
+ *                                  |
+ *                                  +--- stack top
+ * to:
+ *
+ * | ... | exnref |      +--> struct wasm_exception
+ *         |             |    | tag | ... | arg cell 0 | arg cell 1 |
+ *         +-------------+
+ *
+ * the exception object is owned by the current instance and
+ * reference-counted. see the comment on exception_ref.
+ * exnref parameters owned by other instances are rejected.
+ * (exnref_store_check)
+ * it's recycled right away when it's caught by catch/catch_all without
+ * being exposed to wasm.
+ */
+static int
+push_exception(struct exec_context *ectx, uint32_t tagidx,
+               const struct resulttype *rt)
+{
+        uint32_t exnref_csz = valtype_cellsize(TYPE_exnref);
+        uint32_t csz = resulttype_cellsize(rt);
+        assert(ectx->stack.lsize >= csz);
+        const struct cell *args =
+                &VEC_ELEM(ectx->stack, ectx->stack.lsize - csz);
+        uint32_t i;
+        int ret;
+        for (i = 0; i < rt->ntypes; i++) {
+                if (rt->types[i] == TYPE_exnref) {
+                        uint32_t vcsz;
+                        uint32_t idx = resulttype_cellidx(rt, i, &vcsz);
+                        ret = exnref_store_check(
+                                ectx, exnref_from_cells(&args[idx]), false);
+                        if (ret != 0) {
+                                return ret;
+                        }
+                }
+        }
+        struct wasm_exception *exc = exception_alloc(ectx, csz);
+        if (exc == NULL) {
+                return ENOMEM;
+        }
+        exc->tag = VEC_ELEM(ectx->instance->tags, tagidx);
+        ectx->stack.lsize -= csz;
+        cells_copy(exc->cells, &VEC_NEXTELEM(ectx->stack), csz);
+        for (i = 0; i < rt->ntypes; i++) {
+                if (rt->types[i] == TYPE_exnref) {
+                        uint32_t vcsz;
+                        uint32_t idx = resulttype_cellidx(rt, i, &vcsz);
+                        exception_ref(exnref_from_cells(&exc->cells[idx]));
+                }
+        }
+        assert(ectx->stack.psize - ectx->stack.lsize >= exnref_csz);
+        struct cell *cells = &VEC_NEXTELEM(ectx->stack);
+        /* Note: use memcpy as cells might be misaligned */
+        memcpy(cells, &exc, sizeof(exc));
+        ectx->stack.lsize += exnref_csz;
+        return 0;
+}
+#else /* defined(TOYWASM_USE_HEAP_EXNREF) */
 /*
  * push_exception: create and push an exception onto the operand stack
  *
@@ -526,7 +600,7 @@ schedule_return_call(struct exec_context *ectx, const struct funcinst *fi)
  *
  * where N = TOYWASM_EXCEPTION_MAX_CELLS - 1.
  */
-static void
+static int
 push_exception(struct exec_context *ectx, uint32_t tagidx,
                const struct resulttype *rt)
 {
@@ -545,7 +619,9 @@ push_exception(struct exec_context *ectx, uint32_t tagidx,
         const struct taginst *taginst = VEC_ELEM(ectx->instance->tags, tagidx);
         /* Note: use memcpy as exc might be misaligned */
         memcpy(exception_tag_ptr(exc), &taginst, sizeof(taginst));
+        return 0;
 }
+#endif /* defined(TOYWASM_USE_HEAP_EXNREF) */
 
 static void
 schedule_exception(struct exec_context *ectx)
@@ -834,6 +910,16 @@ const static struct exec_instruction_desc
 };
 #endif
 
+#if defined(TOYWASM_ENABLE_INSN_STATS)
+ctassert(ARRAYCOUNT(exec_instructions_fc) <= INSN_STAT_FD - INSN_STAT_FC);
+#if defined(TOYWASM_ENABLE_WASM_SIMD)
+ctassert(ARRAYCOUNT(exec_instructions_fd) <= INSN_STAT_FE - INSN_STAT_FD);
+#endif
+#if defined(TOYWASM_ENABLE_WASM_THREADS)
+ctassert(ARRAYCOUNT(exec_instructions_fe) <= INSN_STAT_NSLOTS - INSN_STAT_FE);
+#endif
+#endif
+
 const struct exec_instruction_desc exec_instructions[] __exec_table_align = {
 #include "insn_list_base.h"
 #if defined(TOYWASM_ENABLE_WASM_TAILCALL)
@@ -861,6 +947,22 @@ fetch_multibyte_opcode(const uint8_t **pp, struct exec_context *ctx,
 #endif
         uint32_t op = read_leb_u32_nocheck(pp);
         const struct exec_instruction_desc *desc = &table[op];
+#if defined(TOYWASM_ENABLE_INSN_STATS)
+        uint32_t slot;
+        if (table == exec_instructions_fc) {
+                slot = INSN_STAT_FC + op;
+#if defined(TOYWASM_ENABLE_WASM_SIMD)
+        } else if (table == exec_instructions_fd) {
+                slot = INSN_STAT_FD + op;
+#endif
+        } else {
+#if defined(TOYWASM_ENABLE_WASM_THREADS)
+                assert(table == exec_instructions_fe);
+#endif
+                slot = INSN_STAT_FE + op;
+        }
+        INSN_STAT_INC(ctx, slot);
+#endif
         xlog_trace_insn("exec %06" PRIx32 ": %s (2nd byte %02" PRIx32 ")", pc,
                         instruction_name(table, op), op);
         return desc->fetch_exec;
@@ -154,11 +154,26 @@ INSN_IMPL(global_get)
         READ_LEB_U32(globalidx);
         CHECK(globalidx < m->nimportedglobals + m->nglobals);
         struct val val_c;
+        enum valtype t;
+#if defined(__GNUC__) && !defined(__clang__)
+        /* suppress warnings */
+        t = 0;
+#endif
         if (EXECUTING) {
-                struct globalinst *ginst =
-                        VEC_ELEM(ECTX->instance->globals, globalidx);
+                struct globalinst *ginst = EXEC_GLOBALINST(ECTX, globalidx);
                 global_get(ginst, &val_c);
+                /* cheaper than module_globaltype */
+                t = ginst->type->t;
+#if defined(TOYWASM_USE_HEAP_EXNREF)
+                if (t == TYPE_exnref) {
+                        ret = exception_expose(ECTX, val_c.u.exnref);
+                        if (ret != 0) {
+                                goto fail;
+                        }
+                }
+#endif
         } else if (VALIDATING) {
+                t = module_globaltype(m, globalidx)->t;
                 struct validation_context *vctx = VCTX;
                 if (vctx->const_expr) {
                         /*
@@ -174,15 +189,15 @@ INSN_IMPL(global_get)
                                 ret = EINVAL;
                                 goto fail;
                         }
-                        const struct globaltype *t =
+                        const struct globaltype *gt =
                                 module_globaltype(m, globalidx);
-                        if (t->mut != GLOBAL_CONST) {
+                        if (gt->mut != GLOBAL_CONST) {
                                 ret = EINVAL;
                                 goto fail;
                         }
                 }
         }
-        PUSH_VAL(module_globaltype(m, globalidx)->t, c);
+        PUSH_VAL(t, c);
         SAVE_PC;
         INSN_SUCCESS;
 fail:
@@ -198,18 +213,34 @@ INSN_IMPL(global_set)
         READ_LEB_U32(globalidx);
         CHECK(globalidx < m->nimportedglobals + m->nglobals);
         const struct globaltype *gt;
+        struct globalinst *ginst;
 #if defined(__GNUC__) && !defined(__clang__)
         /* suppress warnings */
         gt = NULL;
+        ginst = NULL;
 #endif
-        if (EXECUTING || VALIDATING) {
+        if (EXECUTING) {
+                ginst = EXEC_GLOBALINST(ECTX, globalidx);
+                /* cheaper than module_globaltype */
+                gt = ginst->type;
+        } else if (VALIDATING) {
                 gt = module_globaltype(m, globalidx);
+        }
+        if (EXECUTING || VALIDATING) {
                 CHECK(gt->mut != GLOBAL_CONST);
         }
         POP_VAL(gt->t, a);
         if (EXECUTING) {
-                struct globalinst *ginst =
-                        VEC_ELEM(ECTX->instance->globals, globalidx);
+#if defined(TOYWASM_USE_HEAP_EXNREF)
+                if (gt->t == TYPE_exnref) {
+                        ret = exnref_store_check(
+                                ECTX, val_a.u.exnref,
+                                globalidx < m->nimportedglobals);
+                        if (ret != 0) {
+                                goto fail;
+                        }
+                }
+#endif
                 global_set(ginst, &val_a);
         }
         SAVE_PC;
@@ -238,6 +269,14 @@ INSN_IMPL(table_get)
                 const struct instance *inst = ectx->instance;
                 struct tableinst *t = VEC_ELEM(inst->tables, tableidx);
                 table_get(t, offset, &val_c);
+#if defined(TOYWASM_USE_HEAP_EXNREF)
+                if (t->type->et == TYPE_exnref) {
+                        ret = exception_expose(ectx, val_c.u.exnref);
+                        if (ret != 0) {
+                                goto fail;
+                        }
+                }
+#endif
         }
         PUSH_VAL(module_tabletype(m, tableidx)->et, c);
         SAVE_PC;
@@ -265,6 +304,16 @@ INSN_IMPL(table_set)
                 }
                 const struct instance *inst = ectx->instance;
                 struct tableinst *t = VEC_ELEM(inst->tables, tableidx);
+#if defined(TOYWASM_USE_HEAP_EXNREF)
+                if (t->type->et == TYPE_exnref) {
+                        ret = exnref_store_check(
+                                ectx, val_a.u.exnref,
+                                tableidx < m->nimportedtables);
+                        if (ret != 0) {
+                                goto fail;
+                        }
+                }
+#endif
                 table_set(t, offset, &val_a);
         }
         SAVE_PC;
@@ -542,11 +591,13 @@ INSN_IMPL(ref_is_null)
                 case EXTERNREF_NCELLS:
                         /*
                          * externref or funcref.
+                         * (or exnref w/ TOYWASM_USE_HEAP_EXNREF)
                          * Note: their bit-patterns are compatible.
                          */
                         val_result.u.i32 = (int)(val_n.u.funcref.func == NULL);
                         break;
-#if defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING)
+#if defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING) &&                        \
+        !defined(TOYWASM_USE_HEAP_EXNREF)
                 case EXNREF_NCELLS:
                         val_result.u.i32 = (int)(val_n.u.exnref.tag == NULL);
                         break;
@@ -555,7 +606,8 @@ INSN_IMPL(ref_is_null)
                         assert(false);
                 }
 #else /* defined(TOYWASM_USE_SMALL_CELLS) */
-#if defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING)
+#if defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING) &&                        \
+        !defined(TOYWASM_USE_HEAP_EXNREF)
                 /*
                  * TODO: exnref
                  *
@@ -15,6 +15,12 @@
  *   fixed-sized values because one value (exnref) needs to contain
  *   another. (eg. i32)  For now, we just require TOYWASM_USE_SMALL_CELLS.
  *
+ *   Alternatively, with TOYWASM_USE_HEAP_EXNREF, exnref is a pointer to
+ *   a reference-counted exception object owned by the instance which
+ *   created it. (see push_exception) It doesn't have the above mentioned
+ *   limitations. Like funcref, it's the user's responsibility not to
+ *   use the exnref after the instance is destroyed.
+ *
  * - We don't have embedder APIs to deal with exceptions.
  *   cf.
  * https://github.com/WebAssembly/exception-handling/blob/main/proposals/exception-handling/Exceptions.md#js-api
@@ -46,9 +52,10 @@ INSN_IMPL(try_table)
                 if (ret != 0) {
                         goto fail;
                 }
+                const uint32_t pc = ptr2pc(m, ORIG_PC - 1);
                 uint32_t i;
                 for (i = 0; i < vec_count; i++) {
-                        uint32_t tagidx;
+                        uint32_t tagidx = CATCH_HANDLER_ALL;
                         const struct tagtype *tt;
                         const struct functype *ft;
                         const struct resulttype *tag_rt = NULL;
@@ -103,6 +110,12 @@ INSN_IMPL(try_table)
                                 goto fail;
                         }
                         assert(vctx->valtypes.lsize == saved_height);
+                        /* for find_catch */
+                        ret = record_catch_handler(vctx, pc, tagidx,
+                                                   labelidx);
+                        if (ret != 0) {
+                                goto fail;
+                        }
                 }
                 /*
                  * Note: we should push our control frame _after_
@@ -112,7 +125,6 @@ INSN_IMPL(try_table)
                  * cf.
                  * https://github.com/WebAssembly/exception-handling/issues/286
                  */
-                uint32_t pc = ptr2pc(m, ORIG_PC - 1);
                 ret = push_ctrlframe(pc, FRAME_OP_TRY_TABLE, 0, rt_parameter,
                                      rt_result, vctx);
                 if (ret != 0) {
@@ -123,8 +135,9 @@ INSN_IMPL(try_table)
         } else {
                 /*
                  * skip and ignore catch clauses.
-                 * we will process them when an exception is
-                 * actually thrown. (find_catch)
+                 * when an exception is actually thrown, find_catch
+                 * uses the exception handler table built by
+                 * the validation instead. (expr_exec_info::catches)
                  */
                 uint32_t i;
                 for (i = 0; i < vec_count; i++) {
@@ -179,7 +192,10 @@ INSN_IMPL(throw)
                          * and push exnref.
                          */
                         SAVE_STACK_PTR;
-                        push_exception(ectx, tagidx, rt);
+                        ret = push_exception(ectx, tagidx, rt);
+                        if (ret != 0) {
+                                goto fail;
+                        }
                         LOAD_STACK_PTR;
                         /*
                          * now it's same as throw_ref.
@@ -205,6 +205,17 @@ INSN_IMPL(table_copy)
                         VEC_ELEM(inst->tables, tableidx_src);
                 assert(t_src->type->et == t_dst->type->et);
                 uint32_t csz = valtype_cellsize(t_src->type->et);
+#if defined(TOYWASM_USE_HEAP_EXNREF)
+                if (t_src->type->et == TYPE_exnref) {
+                        ret = table_copy_exnref(
+                                ectx, t_dst, d,
+                                tableidx_dst < m->nimportedtables, t_src, s,
+                                n);
+                        if (ret != 0) {
+                                goto fail;
+                        }
+                }
+#endif
                 cells_move(&t_dst->cells[d * csz], &t_src->cells[s * csz],
                            n * csz);
         }
@@ -229,6 +240,16 @@ INSN_IMPL(table_grow)
                 const struct instance *inst = ectx->instance;
                 struct tableinst *t = VEC_ELEM(inst->tables, tableidx);
                 uint32_t n = val_n.u.i32;
+#if defined(TOYWASM_USE_HEAP_EXNREF)
+                if (t->type->et == TYPE_exnref) {
+                        ret = exnref_store_check(
+                                ectx, val_val.u.exnref,
+                                tableidx < m->nimportedtables);
+                        if (ret != 0) {
+                                goto fail;
+                        }
+                }
+#endif
                 val_result.u.i32 = table_grow(t, &val_val, n);
         }
         PUSH_VAL(TYPE_i32, result);
@@ -279,11 +300,20 @@ INSN_IMPL(table_fill)
                 }
                 const struct instance *inst = ectx->instance;
                 struct tableinst *t = VEC_ELEM(inst->tables, tableidx);
+#if defined(TOYWASM_USE_HEAP_EXNREF)
+                if (t->type->et == TYPE_exnref) {
+                        ret = exnref_store_check(
+                                ectx, val_val.u.exnref,
+                                tableidx < m->nimportedtables);
+                        if (ret != 0) {
+                                goto fail;
+                        }
+                }
+#endif
                 uint32_t end = start + n;
                 uint32_t i;
-                uint32_t csz = valtype_cellsize(t->type->et);
                 for (i = start; i < end; i++) {
-                        val_to_cells(&val_val, &t->cells[i * csz], csz);
+                        table_set(t, i, &val_val);
                 }
         }
         SAVE_PC;
@@ -138,6 +138,65 @@ fail:                                                                         \
                 INSN_FAIL;                                                    \
         }
 
+/*
+ * ATOMIC_RMW_NATIVE: a single C11 fetch-op instead of a CAS loop.
+ *
+ * the operand and the returned old value are in little endian.
+ * it's fine for bitwise ops and xchg regardless of the host byte order.
+ * for add and sub, it's correct only on little endian hosts.
+ * (ATOMIC_RMW_ARITH below)
+ *
+ * Note: sub-word (8/16 bit) fetch-ops are fine too. if the target
+ * doesn't have native instructions for them, the compiler (or libatomic)
+ * implements them with a CAS loop on the containing word by itself.
+ */
+#define FETCH_ADD(p, v) atomic_fetch_add(p, v)
+#define FETCH_SUB(p, v) atomic_fetch_sub(p, v)
+#define FETCH_AND(p, v) atomic_fetch_and(p, v)
+#define FETCH_OR(p, v) atomic_fetch_or(p, v)
+#define FETCH_XOR(p, v) atomic_fetch_xor(p, v)
+#define FETCH_XCHG(p, v) atomic_exchange(p, v)
+
+#define ATOMIC_RMW_NATIVE(NAME, MEM, STACK, OP)                               \
+        INSN_IMPL(NAME)                                                       \
+        {                                                                     \
+                const struct module *m = MODULE;                              \
+                struct memarg memarg;                                         \
+                int ret;                                                      \
+                LOAD_PC;                                                      \
+                READ_MEMARG##MEM(&memarg);                                    \
+                CHECK(memarg.memidx < m->nimportedmems + m->nmems);           \
+                POP_VAL(TYPE_i##STACK, v);                                    \
+                POP_VAL(TYPE_i32, i);                                         \
+                struct val val_readv;                                         \
+                if (EXECUTING) {                                              \
+                        void *vp;                                             \
+                        ret = memory_atomic_getptr(                           \
+                                ECTX, memarg.memidx, val_i.u.i32,             \
+                                memarg.offset, MEM / 8, &vp, NULL);           \
+                        if (ret != 0) {                                       \
+                                goto fail;                                    \
+                        }                                                     \
+                        _Atomic uint##MEM##_t *ap = vp;                       \
+                        uint##MEM##_t v_le = host_to_le##MEM(                 \
+                                (uint##MEM##_t)val_v.u.i##STACK);             \
+                        uint##MEM##_t old_le = FETCH_##OP(ap, v_le);          \
+                        val_readv.u.i##STACK = le##MEM##_to_host(old_le);     \
+                }                                                             \
+                PUSH_VAL(TYPE_i##STACK, readv);                               \
+                SAVE_PC;                                                      \
+                INSN_SUCCESS;                                                 \
+fail:                                                                         \
+                INSN_FAIL;                                                    \
+        }
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define ATOMIC_RMW_ARITH(NAME, MEM, STACK, OP)                                \
+        ATOMIC_RMW_NATIVE(NAME, MEM, STACK, OP)
+#else
+#define ATOMIC_RMW_ARITH(NAME, MEM, STACK, OP) ATOMIC_RMW(NAME, MEM, STACK, OP)
+#endif
+
 /*
  * Consider a mutex implementation which uses an atomic opcode
  * (eg. x86 `cmpxchg`) to acquire a mutex and release it with a non-atomic
@@ -267,53 +326,53 @@ ATOMIC_STOREOP2(i64_atomic_store8_u, 8, 64, , i)
 ATOMIC_STOREOP2(i64_atomic_store16_u, 16, 64, , i)
 ATOMIC_STOREOP2(i64_atomic_store32_u, 32, 64, , i)
 
-ATOMIC_RMW(i32_atomic_rmw8_add_u, 8, 32, ADD)
-ATOMIC_RMW(i32_atomic_rmw16_add_u, 16, 32, ADD)
-ATOMIC_RMW(i32_atomic_rmw_add, 32, 32, ADD)
-ATOMIC_RMW(i64_atomic_rmw8_add_u, 8, 64, ADD)
-ATOMIC_RMW(i64_atomic_rmw16_add_u, 16, 64, ADD)
-ATOMIC_RMW(i64_atomic_rmw32_add_u, 32, 64, ADD)
-ATOMIC_RMW(i64_atomic_rmw_add, 64, 64, ADD)
+ATOMIC_RMW_ARITH(i32_atomic_rmw8_add_u, 8, 32, ADD)
+ATOMIC_RMW_ARITH(i32_atomic_rmw16_add_u, 16, 32, ADD)
+ATOMIC_RMW_ARITH(i32_atomic_rmw_add, 32, 32, ADD)
+ATOMIC_RMW_ARITH(i64_atomic_rmw8_add_u, 8, 64, ADD)
+ATOMIC_RMW_ARITH(i64_atomic_rmw16_add_u, 16, 64, ADD)
+ATOMIC_RMW_ARITH(i64_atomic_rmw32_add_u, 32, 64, ADD)
+ATOMIC_RMW_ARITH(i64_atomic_rmw_add, 64, 64, ADD)
 
-ATOMIC_RMW(i32_atomic_rmw8_sub_u, 8, 32, SUB)
-ATOMIC_RMW(i32_atomic_rmw16_sub_u, 16, 32, SUB)
-ATOMIC_RMW(i32_atomic_rmw_sub, 32, 32, SUB)
-ATOMIC_RMW(i64_atomic_rmw8_sub_u, 8, 64, SUB)
-ATOMIC_RMW(i64_atomic_rmw16_sub_u, 16, 64, SUB)
-ATOMIC_RMW(i64_atomic_rmw32_sub_u, 32, 64, SUB)
-ATOMIC_RMW(i64_atomic_rmw_sub, 64, 64, SUB)
+ATOMIC_RMW_ARITH(i32_atomic_rmw8_sub_u, 8, 32, SUB)
+ATOMIC_RMW_ARITH(i32_atomic_rmw16_sub_u, 16, 32, SUB)
+ATOMIC_RMW_ARITH(i32_atomic_rmw_sub, 32, 32, SUB)
+ATOMIC_RMW_ARITH(i64_atomic_rmw8_sub_u, 8, 64, SUB)
+ATOMIC_RMW_ARITH(i64_atomic_rmw16_sub_u, 16, 64, SUB)
+ATOMIC_RMW_ARITH(i64_atomic_rmw32_sub_u, 32, 64, SUB)
+ATOMIC_RMW_ARITH(i64_atomic_rmw_sub, 64, 64, SUB)
 
-ATOMIC_RMW(i32_atomic_rmw8_and_u, 8, 32, AND)
-ATOMIC_RMW(i32_atomic_rmw16_and_u, 16, 32, AND)
-ATOMIC_RMW(i32_atomic_rmw_and, 32, 32, AND)
-ATOMIC_RMW(i64_atomic_rmw8_and_u, 8, 64, AND)
-ATOMIC_RMW(i64_atomic_rmw16_and_u, 16, 64, AND)
-ATOMIC_RMW(i64_atomic_rmw32_and_u, 32, 64, AND)
-ATOMIC_RMW(i64_atomic_rmw_and, 64, 64, AND)
+ATOMIC_RMW_NATIVE(i32_atomic_rmw8_and_u, 8, 32, AND)
+ATOMIC_RMW_NATIVE(i32_atomic_rmw16_and_u, 16, 32, AND)
+ATOMIC_RMW_NATIVE(i32_atomic_rmw_and, 32, 32, AND)
+ATOMIC_RMW_NATIVE(i64_atomic_rmw8_and_u, 8, 64, AND)
+ATOMIC_RMW_NATIVE(i64_atomic_rmw16_and_u, 16, 64, AND)
+ATOMIC_RMW_NATIVE(i64_atomic_rmw32_and_u, 32, 64, AND)
+ATOMIC_RMW_NATIVE(i64_atomic_rmw_and, 64, 64, AND)
 
-ATOMIC_RMW(i32_atomic_rmw8_or_u, 8, 32, OR)
-ATOMIC_RMW(i32_atomic_rmw16_or_u, 16, 32, OR)
-ATOMIC_RMW(i32_atomic_rmw_or, 32, 32, OR)
-ATOMIC_RMW(i64_atomic_rmw8_or_u, 8, 64, OR)
-ATOMIC_RMW(i64_atomic_rmw16_or_u, 16, 64, OR)
-ATOMIC_RMW(i64_atomic_rmw32_or_u, 32, 64, OR)
-ATOMIC_RMW(i64_atomic_rmw_or, 64, 64, OR)
+ATOMIC_RMW_NATIVE(i32_atomic_rmw8_or_u, 8, 32, OR)
+ATOMIC_RMW_NATIVE(i32_atomic_rmw16_or_u, 16, 32, OR)
+ATOMIC_RMW_NATIVE(i32_atomic_rmw_or, 32, 32, OR)
+ATOMIC_RMW_NATIVE(i64_atomic_rmw8_or_u, 8, 64, OR)
+ATOMIC_RMW_NATIVE(i64_atomic_rmw16_or_u, 16, 64, OR)
+ATOMIC_RMW_NATIVE(i64_atomic_rmw32_or_u, 32, 64, OR)
+ATOMIC_RMW_NATIVE(i64_atomic_rmw_or, 64, 64, OR)
 
-ATOMIC_RMW(i32_atomic_rmw8_xor_u, 8, 32, XOR)
-ATOMIC_RMW(i32_atomic_rmw16_xor_u, 16, 32, XOR)
-ATOMIC_RMW(i32_atomic_rmw_xor, 32, 32, XOR)
-ATOMIC_RMW(i64_atomic_rmw8_xor_u, 8, 64, XOR)
-ATOMIC_RMW(i64_atomic_rmw16_xor_u, 16, 64, XOR)
-ATOMIC_RMW(i64_atomic_rmw32_xor_u, 32, 64, XOR)
-ATOMIC_RMW(i64_atomic_rmw_xor, 64, 64, XOR)
+ATOMIC_RMW_NATIVE(i32_atomic_rmw8_xor_u, 8, 32, XOR)
+ATOMIC_RMW_NATIVE(i32_atomic_rmw16_xor_u, 16, 32, XOR)
+ATOMIC_RMW_NATIVE(i32_atomic_rmw_xor, 32, 32, XOR)
+ATOMIC_RMW_NATIVE(i64_atomic_rmw8_xor_u, 8, 64, XOR)
+ATOMIC_RMW_NATIVE(i64_atomic_rmw16_xor_u, 16, 64, XOR)
+ATOMIC_RMW_NATIVE(i64_atomic_rmw32_xor_u, 32, 64, XOR)
+ATOMIC_RMW_NATIVE(i64_atomic_rmw_xor, 64, 64, XOR)
 
-ATOMIC_RMW(i32_atomic_rmw8_xchg_u, 8, 32, XCHG)
-ATOMIC_RMW(i32_atomic_rmw16_xchg_u, 16, 32, XCHG)
-ATOMIC_RMW(i32_atomic_rmw_xchg, 32, 32, XCHG)
-ATOMIC_RMW(i64_atomic_rmw8_xchg_u, 8, 64, XCHG)
-ATOMIC_RMW(i64_atomic_rmw16_xchg_u, 16, 64, XCHG)
-ATOMIC_RMW(i64_atomic_rmw32_xchg_u, 32, 64, XCHG)
-ATOMIC_RMW(i64_atomic_rmw_xchg, 64, 64, XCHG)
+ATOMIC_RMW_NATIVE(i32_atomic_rmw8_xchg_u, 8, 32, XCHG)
+ATOMIC_RMW_NATIVE(i32_atomic_rmw16_xchg_u, 16, 32, XCHG)
+ATOMIC_RMW_NATIVE(i32_atomic_rmw_xchg, 32, 32, XCHG)
+ATOMIC_RMW_NATIVE(i64_atomic_rmw8_xchg_u, 8, 64, XCHG)
+ATOMIC_RMW_NATIVE(i64_atomic_rmw16_xchg_u, 16, 64, XCHG)
+ATOMIC_RMW_NATIVE(i64_atomic_rmw32_xchg_u, 32, 64, XCHG)
+ATOMIC_RMW_NATIVE(i64_atomic_rmw_xchg, 64, 64, XCHG)
 
 ATOMIC_RMW_CMPXCHG(i32_atomic_rmw8_cmpxchg_u, 8, 32)
 ATOMIC_RMW_CMPXCHG(i32_atomic_rmw16_cmpxchg_u, 16, 32)
@@ -126,7 +126,7 @@ fail:                                                                         \
                 struct val val_c;                                             \
                 if (EXECUTING) {                                              \
                         void *datap;                                          \
-                        ret = memory_getptr(ECTX, memarg.memidx, val_i.u.i32, \
+                        ret = MEMORY_GETPTR(ECTX, memarg.memidx, val_i.u.i32, \
                                             memarg.offset, MEM / 8, &datap);  \
                         if (ret != 0) {                                       \
                                 goto fail;                                    \
@@ -157,7 +157,7 @@ fail:                                                                         \
                 POP_VAL(TYPE_i32, i);                                         \
                 if (EXECUTING) {                                              \
                         void *datap;                                          \
-                        ret = memory_getptr(ECTX, memarg.memidx, val_i.u.i32, \
+                        ret = MEMORY_GETPTR(ECTX, memarg.memidx, val_i.u.i32, \
                                             memarg.offset, MEM / 8, &datap);  \
                         if (ret != 0) {                                       \
                                 goto fail;                                    \
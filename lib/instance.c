@@ -8,6 +8,7 @@
 #include "escape.h"
 #include "exec.h"
 #include "instance.h"
+#include "jit.h"
 #include "mem.h"
 #include "module.h"
 #include "nbio.h"
@@ -525,6 +526,11 @@ instance_create_no_init(struct mem_context *mctx, const struct module *m,
                 fp->is_host = false;
                 fp->u.wasm.instance = inst;
                 fp->u.wasm.funcidx = i;
+#if defined(TOYWASM_ENABLE_AOT)
+                if (m->aot_funcs != NULL) {
+                        fp->u.wasm.aot = m->aot_funcs[i - m->nimportedfuncs];
+                }
+#endif
                 VEC_ELEM(inst->funcs, i) = fp;
         }
 
@@ -538,13 +544,18 @@ instance_create_no_init(struct mem_context *mctx, const struct module *m,
                 VEC_ELEM(inst->mems, i) = mp;
         }
 
-        for (i = m->nimportedglobals; i < nglobals; i++) {
-                struct globalinst *ginst;
-                const struct globaltype *gt = module_globaltype(m, i);
-                ret = global_instance_create(mctx, &ginst, gt);
-                if (ret != 0) {
+        if (m->nglobals > 0) {
+                inst->own_globals = mem_calloc(mctx, sizeof(*inst->own_globals),
+                                               m->nglobals);
+                if (inst->own_globals == NULL) {
+                        ret = ENOMEM;
                         goto fail;
                 }
+        }
+        for (i = m->nimportedglobals; i < nglobals; i++) {
+                struct globalinst *ginst =
+                        &inst->own_globals[i - m->nimportedglobals];
+                ginst->type = module_globaltype(m, i);
                 VEC_ELEM(inst->globals, i) = ginst;
         }
 
@@ -604,6 +615,12 @@ instance_execute_init(struct exec_context *ctx)
                 if (ret != 0) {
                         goto fail;
                 }
+#if defined(TOYWASM_USE_HEAP_EXNREF)
+                /* see global_set */
+                if (ginst->type->t == TYPE_exnref) {
+                        exception_ref(ginst->val.u.exnref);
+                }
+#endif
                 xlog_trace("global [%" PRIu32 "] initialized to %016" PRIx64,
                            m->nimportedglobals + i, ginst->val.u.i64);
         }
@@ -679,12 +696,13 @@ instance_destroy(struct instance *inst)
                 memory_instance_destroy(mctx, *mp);
         }
         VEC_FREE(mctx, inst->mems);
-        struct globalinst **gp;
-        VEC_FOREACH_IDX(i, gp, inst->globals) {
-                if (i < m->nimportedglobals) {
-                        continue;
-                }
-                global_instance_destroy(mctx, *gp);
+#if defined(TOYWASM_USE_HEAP_EXNREF)
+        /* before freeing the globals and tables which refer to them */
+        instance_exceptions_destroy(inst);
+#endif
+        if (inst->own_globals != NULL) {
+                mem_free(mctx, inst->own_globals,
+                         m->nglobals * sizeof(*inst->own_globals));
         }
         VEC_FREE(mctx, inst->globals);
         struct tableinst **tp;
@@ -707,6 +725,9 @@ instance_destroy(struct instance *inst)
 #endif
         bitmap_free(mctx, &inst->data_dropped, m->ndatas);
         bitmap_free(mctx, &inst->elem_dropped, m->nelems);
+#if defined(TOYWASM_ENABLE_JIT)
+        jit_instance_destroy(inst);
+#endif
         mem_free(mctx, inst, sizeof(*inst));
 }
 
@@ -123,6 +123,19 @@ int import_object_create_for_exports(struct mem_context *mctx,
 void import_object_destroy(struct mem_context *mctx, struct import_object *im);
 int import_object_alloc(struct mem_context *mctx, uint32_t nentries,
                         struct import_object **resultp);
+
+/*
+ * import_object_build_index: build a hash index of the entries.
+ *
+ * after this, import_object_find_entry can find an entry in O(1).
+ * it's worth to build an index for an import_object with many entries,
+ * especially when it's used for many instantiations.
+ *
+ * the index should be built after all entries are filled.
+ * entries should not be modified after that.
+ */
+int import_object_build_index(struct mem_context *mctx,
+                              struct import_object *im);
 int import_object_find_entry(
         const struct import_object *impobj, const struct import *im,
         int (*check)(const struct import_object_entry *e, const void *arg),
@@ -0,0 +1,1657 @@
+/*
+ * a baseline template jit. see jit.h.
+ *
+ * the native frame of a compiled function:
+ *
+ *   rsp + 0                            locals (params first)
+ *   rsp + 8 * nlocals                  operand stack slots
+ *   rsp + 8 * (nlocals + maxsp)        scratch for aot_memory_getptr
+ *
+ * each local and slot is 64-bit. the upper half of an i32 value is
+ * ignored by the instructions which consume it.
+ *
+ * registers:
+ *
+ *   rbx  the parameters/results (uint64_t [])
+ *   r12  exec_context
+ *   r13  instance
+ *   rax, rcx, rdx, rsi, rdi, r8  scratch
+ *
+ * the native code is "int f(ctx, inst, uint64_t *vals)", which reads
+ * the parameters from vals and writes the results to vals.
+ */
+
+#define _GNU_SOURCE /* pthread_getattr_np */
+
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "aot.h"
+#include "cell.h"
+#include "endian.h"
+#include "exec.h"
+#include "fileio.h"
+#include "jit.h"
+#include "leb128.h"
+#include "mem.h"
+#include "type.h"
+#include "util.h"
+#include "xlog.h"
+
+typedef int (*jit_code_t)(struct exec_context *ctx, struct instance *inst,
+                          uint64_t *vals);
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(_WIN32)
+#define JIT_X86_64
+#endif
+
+static struct jit_funcstate *
+jit_funcstate(const struct jit_instance *ji, const struct module *m,
+              uint32_t funcidx)
+{
+        assert(funcidx >= m->nimportedfuncs);
+        return &ji->funcs[funcidx - m->nimportedfuncs];
+}
+
+#if defined(JIT_X86_64)
+
+static const struct functype *
+local_functype(const struct module *m, uint32_t localidx)
+{
+        return &m->types[m->functypeidxes[localidx]];
+}
+
+enum jit_reg {
+        RAX = 0,
+        RCX = 1,
+        RDX = 2,
+        RBX = 3,
+        RSP = 4,
+        RBP = 5,
+        RSI = 6,
+        RDI = 7,
+        R8 = 8,
+        R12 = 12,
+        R13 = 13,
+        R14 = 14,
+};
+
+/* condition codes. (the lowest bit inverts the condition) */
+enum jit_cc {
+        CC_B = 0x2,
+        CC_AE = 0x3,
+        CC_E = 0x4,
+        CC_NE = 0x5,
+        CC_BE = 0x6,
+        CC_A = 0x7,
+        CC_L = 0xc,
+        CC_GE = 0xd,
+        CC_LE = 0xe,
+        CC_G = 0xf,
+        CC_ALWAYS = -1,
+};
+
+enum jit_opkind {
+        JIT_ALU,   /* op eax, [b] */
+        JIT_SHIFT, /* op eax, cl */
+        JIT_CMP,   /* cmp eax, [b]; setcc */
+        JIT_EQZ,
+        JIT_MOVX,  /* mov/movzx/movsx eax, [a] */
+        JIT_UNOP,  /* a = unop(a) */
+        JIT_DIVOP, /* divop(ctx, &a, b) */
+        JIT_LOAD,
+        JIT_STORE,
+};
+
+struct jit_op {
+        uint8_t op;
+        uint8_t kind;
+        bool w;      /* 64-bit operation */
+        uint8_t arg; /* condition code, /digit or access size */
+        uint8_t opc[2];
+        uint8_t oplen;
+        uint64_t (*unop)(uint64_t);
+        int (*divop)(struct exec_context *, uint64_t *, uint64_t);
+};
+
+#define OPC1(A) .opc = {A}, .oplen = 1
+#define OPC2(A, B) .opc = {A, B}, .oplen = 2
+
+#define ALU(OP, W, O) {.op = OP, .kind = JIT_ALU, .w = W, OPC1(O)}
+#define MUL(OP, W) {.op = OP, .kind = JIT_ALU, .w = W, OPC2(0x0f, 0xaf)}
+#define SHIFT(OP, W, N) {.op = OP, .kind = JIT_SHIFT, .w = W, .arg = N}
+#define CMP(OP, W, CC) {.op = OP, .kind = JIT_CMP, .w = W, .arg = CC}
+#define EQZ(OP, W) {.op = OP, .kind = JIT_EQZ, .w = W, .arg = CC_E}
+#define MOVX(OP, W, ...) {.op = OP, .kind = JIT_MOVX, .w = W, __VA_ARGS__}
+#define UNOP(OP, F) {.op = OP, .kind = JIT_UNOP, .unop = F}
+#define DIVOP(OP, F) {.op = OP, .kind = JIT_DIVOP, .divop = F}
+#define LOAD(OP, W, SZ, ...)                                                  \
+        {.op = OP, .kind = JIT_LOAD, .w = W, .arg = SZ, __VA_ARGS__}
+#define STORE(OP, SZ) {.op = OP, .kind = JIT_STORE, .arg = SZ}
+
+static const struct jit_op jit_ops[] = {
+        LOAD(0x28, false, 4, OPC1(0x8b)),       /* i32.load */
+        LOAD(0x29, true, 8, OPC1(0x8b)),        /* i64.load */
+        LOAD(0x2c, false, 1, OPC2(0x0f, 0xbe)), /* i32.load8_s */
+        LOAD(0x2d, false, 1, OPC2(0x0f, 0xb6)), /* i32.load8_u */
+        LOAD(0x2e, false, 2, OPC2(0x0f, 0xbf)), /* i32.load16_s */
+        LOAD(0x2f, false, 2, OPC2(0x0f, 0xb7)), /* i32.load16_u */
+        LOAD(0x30, true, 1, OPC2(0x0f, 0xbe)),  /* i64.load8_s */
+        LOAD(0x31, false, 1, OPC2(0x0f, 0xb6)), /* i64.load8_u */
+        LOAD(0x32, true, 2, OPC2(0x0f, 0xbf)),  /* i64.load16_s */
+        LOAD(0x33, false, 2, OPC2(0x0f, 0xb7)), /* i64.load16_u */
+        LOAD(0x34, true, 4, OPC1(0x63)),        /* i64.load32_s */
+        LOAD(0x35, false, 4, OPC1(0x8b)),       /* i64.load32_u */
+        STORE(0x36, 4),                         /* i32.store */
+        STORE(0x37, 8),                         /* i64.store */
+        STORE(0x3a, 1),                         /* i32.store8 */
+        STORE(0x3b, 2),                         /* i32.store16 */
+        STORE(0x3c, 1),                         /* i64.store8 */
+        STORE(0x3d, 2),                         /* i64.store16 */
+        STORE(0x3e, 4),                         /* i64.store32 */
+        EQZ(0x45, false),                       /* i32.eqz */
+        CMP(0x46, false, CC_E),                 /* i32.eq */
+        CMP(0x47, false, CC_NE),                /* i32.ne */
+        CMP(0x48, false, CC_L),                 /* i32.lt_s */
+        CMP(0x49, false, CC_B),                 /* i32.lt_u */
+        CMP(0x4a, false, CC_G),                 /* i32.gt_s */
+        CMP(0x4b, false, CC_A),                 /* i32.gt_u */
+        CMP(0x4c, false, CC_LE),                /* i32.le_s */
+        CMP(0x4d, false, CC_BE),                /* i32.le_u */
+        CMP(0x4e, false, CC_GE),                /* i32.ge_s */
+        CMP(0x4f, false, CC_AE),                /* i32.ge_u */
+        EQZ(0x50, true),                        /* i64.eqz */
+        CMP(0x51, true, CC_E),                  /* i64.eq */
+        CMP(0x52, true, CC_NE),                 /* i64.ne */
+        CMP(0x53, true, CC_L),                  /* i64.lt_s */
+        CMP(0x54, true, CC_B),                  /* i64.lt_u */
+        CMP(0x55, true, CC_G),                  /* i64.gt_s */
+        CMP(0x56, true, CC_A),                  /* i64.gt_u */
+        CMP(0x57, true, CC_LE),                 /* i64.le_s */
+        CMP(0x58, true, CC_BE),                 /* i64.le_u */
+        CMP(0x59, true, CC_GE),                 /* i64.ge_s */
+        CMP(0x5a, true, CC_AE),                 /* i64.ge_u */
+        UNOP(0x67, aot_i32_clz),                /* i32.clz */
+        UNOP(0x68, aot_i32_ctz),                /* i32.ctz */
+        UNOP(0x69, aot_i32_popcnt),             /* i32.popcnt */
+        ALU(0x6a, false, 0x03),                 /* i32.add */
+        ALU(0x6b, false, 0x2b),                 /* i32.sub */
+        MUL(0x6c, false),                       /* i32.mul */
+        DIVOP(0x6d, aot_i32_div_s),             /* i32.div_s */
+        DIVOP(0x6e, aot_i32_div_u),             /* i32.div_u */
+        DIVOP(0x6f, aot_i32_rem_s),             /* i32.rem_s */
+        DIVOP(0x70, aot_i32_rem_u),             /* i32.rem_u */
+        ALU(0x71, false, 0x23),                 /* i32.and */
+        ALU(0x72, false, 0x0b),                 /* i32.or */
+        ALU(0x73, false, 0x33),                 /* i32.xor */
+        SHIFT(0x74, false, 4),                  /* i32.shl */
+        SHIFT(0x75, false, 7),                  /* i32.shr_s */
+        SHIFT(0x76, false, 5),                  /* i32.shr_u */
+        SHIFT(0x77, false, 0),                  /* i32.rotl */
+        SHIFT(0x78, false, 1),                  /* i32.rotr */
+        UNOP(0x79, aot_i64_clz),                /* i64.clz */
+        UNOP(0x7a, aot_i64_ctz),                /* i64.ctz */
+        UNOP(0x7b, aot_i64_popcnt),             /* i64.popcnt */
+        ALU(0x7c, true, 0x03),                  /* i64.add */
+        ALU(0x7d, true, 0x2b),                  /* i64.sub */
+        MUL(0x7e, true),                        /* i64.mul */
+        DIVOP(0x7f, aot_i64_div_s),             /* i64.div_s */
+        DIVOP(0x80, aot_i64_div_u),             /* i64.div_u */
+        DIVOP(0x81, aot_i64_rem_s),             /* i64.rem_s */
+        DIVOP(0x82, aot_i64_rem_u),             /* i64.rem_u */
+        ALU(0x83, true, 0x23),                  /* i64.and */
+        ALU(0x84, true, 0x0b),                  /* i64.or */
+        ALU(0x85, true, 0x33),                  /* i64.xor */
+        SHIFT(0x86, true, 4),                   /* i64.shl */
+        SHIFT(0x87, true, 7),                   /* i64.shr_s */
+        SHIFT(0x88, true, 5),                   /* i64.shr_u */
+        SHIFT(0x89, true, 0),                   /* i64.rotl */
+        SHIFT(0x8a, true, 1),                   /* i64.rotr */
+        MOVX(0xa7, false, OPC1(0x8b)),          /* i32.wrap_i64 */
+        MOVX(0xac, true, OPC1(0x63)),           /* i64.extend_i32_s */
+        MOVX(0xad, false, OPC1(0x8b)),          /* i64.extend_i32_u */
+        MOVX(0xc0, false, OPC2(0x0f, 0xbe)),    /* i32.extend8_s */
+        MOVX(0xc1, false, OPC2(0x0f, 0xbf)),    /* i32.extend16_s */
+        MOVX(0xc2, true, OPC2(0x0f, 0xbe)),     /* i64.extend8_s */
+        MOVX(0xc3, true, OPC2(0x0f, 0xbf)),     /* i64.extend16_s */
+        MOVX(0xc4, true, OPC1(0x63)),           /* i64.extend32_s */
+};
+
+#undef OPC1
+#undef OPC2
+#undef ALU
+#undef MUL
+#undef SHIFT
+#undef CMP
+#undef EQZ
+#undef MOVX
+#undef UNOP
+#undef DIVOP
+#undef LOAD
+#undef STORE
+
+struct jit_label {
+        uint8_t op; /* block, loop, if. 0 for the function body. */
+        bool has_else;
+        uint32_t id;      /* the branch target */
+        uint32_t else_id; /* if */
+        uint32_t height;  /* the operand stack height excluding params */
+        uint32_t nparams;
+        uint32_t nresults;
+};
+
+/* a rel32 to patch. id is a label id or a localidx for calls */
+struct jit_fixup {
+        uint32_t pos;
+        uint32_t id;
+};
+
+struct jit_ctx {
+        struct mem_context *mctx;
+        struct instance *inst;
+        const struct module *m;
+        const struct jit_instance *ji;
+        int error;
+
+        /*
+         * when scanning, the code is thrown away and calls to
+         * the functions not compiled yet are recorded in callees.
+         */
+        bool scanning;
+        VEC(, uint32_t) callees;
+        const uint8_t *unit; /* JIT_UNIT_xxx, indexed by localidx */
+
+        VEC(, uint8_t) code;
+        VEC(, struct jit_fixup) calls;
+
+        /* per function */
+        VEC(, struct jit_label) labels;
+        VEC(, uint32_t) targets; /* label id -> code offset */
+        VEC(, struct jit_fixup) fixups;
+        uint32_t err_id;
+        uint32_t nlocals;
+        uint32_t sp;
+        uint32_t maxsp;
+
+        /* skipping unreachable code until the end of the block */
+        bool dead;
+        uint32_t deadnest;
+};
+
+enum jit_unit_state {
+        JIT_UNIT_NONE = 0,
+        JIT_UNIT_CANDIDATE,
+        JIT_UNIT_REJECTED,
+};
+
+static void
+emit_bytes(struct jit_ctx *c, const void *p, size_t n)
+{
+        int ret;
+        if (c->error != 0) {
+                return;
+        }
+        ret = VEC_PREALLOC(c->mctx, c->code, n);
+        if (ret != 0) {
+                c->error = ret;
+                return;
+        }
+        memcpy(&VEC_NEXTELEM(c->code), p, n);
+        c->code.lsize += n;
+}
+
+static void
+emit8(struct jit_ctx *c, uint8_t v)
+{
+        emit_bytes(c, &v, 1);
+}
+
+static void
+emit32(struct jit_ctx *c, uint32_t v)
+{
+        uint8_t b[4];
+        le32_encode(b, v);
+        emit_bytes(c, b, sizeof(b));
+}
+
+static void
+emit64(struct jit_ctx *c, uint64_t v)
+{
+        uint8_t b[8];
+        le64_encode(b, v);
+        emit_bytes(c, b, sizeof(b));
+}
+
+static void
+emit_rex(struct jit_ctx *c, bool w, unsigned int reg, unsigned int rm)
+{
+        uint8_t rex = 0x40 | (w << 3) | ((reg >> 3) << 2) | (rm >> 3);
+        if (rex != 0x40) {
+                emit8(c, rex);
+        }
+}
+
+/* op reg, [base + disp32] */
+static void
+emit_mem(struct jit_ctx *c, bool w, const uint8_t *opc, uint8_t oplen,
+         unsigned int reg, unsigned int base, int32_t disp)
+{
+        emit_rex(c, w, reg, base);
+        emit_bytes(c, opc, oplen);
+        emit8(c, 0x80 | ((reg & 7) << 3) | (base & 7));
+        if ((base & 7) == RSP) {
+                emit8(c, 0x24); /* sib */
+        }
+        emit32(c, (uint32_t)disp);
+}
+
+/* op reg, rm */
+static void
+emit_rr(struct jit_ctx *c, bool w, const uint8_t *opc, uint8_t oplen,
+        unsigned int reg, unsigned int rm)
+{
+        emit_rex(c, w, reg, rm);
+        emit_bytes(c, opc, oplen);
+        emit8(c, 0xc0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+#define EMIT_MEM(c, w, reg, base, disp, ...)                                  \
+        emit_mem(c, w, (const uint8_t[]){__VA_ARGS__},                        \
+                 sizeof((const uint8_t[]){__VA_ARGS__}), reg, base, disp)
+#define EMIT_RR(c, w, reg, rm, ...)                                           \
+        emit_rr(c, w, (const uint8_t[]){__VA_ARGS__},                         \
+                sizeof((const uint8_t[]){__VA_ARGS__}), reg, rm)
+
+/* mov reg, [base + disp] */
+static void
+emit_load(struct jit_ctx *c, bool w, unsigned int reg, unsigned int base,
+          int32_t disp)
+{
+        EMIT_MEM(c, w, reg, base, disp, 0x8b);
+}
+
+/* mov [base + disp], reg */
+static void
+emit_store(struct jit_ctx *c, bool w, unsigned int reg, unsigned int base,
+           int32_t disp)
+{
+        EMIT_MEM(c, w, reg, base, disp, 0x89);
+}
+
+static void
+emit_lea(struct jit_ctx *c, unsigned int reg, unsigned int base, int32_t disp)
+{
+        EMIT_MEM(c, true, reg, base, disp, 0x8d);
+}
+
+/* mov dst, src */
+static void
+emit_mov_rr(struct jit_ctx *c, bool w, unsigned int dst, unsigned int src)
+{
+        EMIT_RR(c, w, src, dst, 0x89);
+}
+
+/* mov reg32, imm32 (zero-extended) */
+static void
+emit_mov_imm32(struct jit_ctx *c, unsigned int reg, uint32_t v)
+{
+        emit_rex(c, false, 0, reg);
+        emit8(c, 0xb8 + (reg & 7));
+        emit32(c, v);
+}
+
+static void
+emit_mov_imm64(struct jit_ctx *c, unsigned int reg, uint64_t v)
+{
+        emit_rex(c, true, 0, reg);
+        emit8(c, 0xb8 + (reg & 7));
+        emit64(c, v);
+}
+
+static void
+emit_push(struct jit_ctx *c, unsigned int reg)
+{
+        emit_rex(c, false, 0, reg);
+        emit8(c, 0x50 + (reg & 7));
+}
+
+static void
+emit_pop(struct jit_ctx *c, unsigned int reg)
+{
+        emit_rex(c, false, 0, reg);
+        emit8(c, 0x58 + (reg & 7));
+}
+
+static void
+emit_test_eax(struct jit_ctx *c)
+{
+        EMIT_RR(c, false, RAX, RAX, 0x85);
+}
+
+static void
+emit_call_abs(struct jit_ctx *c, const void *fn)
+{
+        emit_mov_imm64(c, RAX, (uint64_t)(uintptr_t)fn);
+        EMIT_RR(c, false, 2, RAX, 0xff); /* call rax */
+}
+
+static uint32_t
+new_id(struct jit_ctx *c)
+{
+        int ret = VEC_PREALLOC(c->mctx, c->targets, 1);
+        if (ret != 0) {
+                if (c->error == 0) {
+                        c->error = ret;
+                }
+                return 0;
+        }
+        *VEC_PUSH(c->targets) = UINT32_MAX;
+        return c->targets.lsize - 1;
+}
+
+static void
+bind(struct jit_ctx *c, uint32_t id)
+{
+        if (c->error != 0) {
+                return;
+        }
+        assert(VEC_ELEM(c->targets, id) == UINT32_MAX);
+        VEC_ELEM(c->targets, id) = c->code.lsize;
+}
+
+static void
+add_fixup(struct jit_ctx *c, uint32_t id)
+{
+        int ret;
+        if (c->error != 0) {
+                return;
+        }
+        ret = VEC_PREALLOC(c->mctx, c->fixups, 1);
+        if (ret != 0) {
+                c->error = ret;
+                return;
+        }
+        struct jit_fixup *f = VEC_PUSH(c->fixups);
+        f->pos = c->code.lsize;
+        f->id = id;
+        emit32(c, 0);
+}
+
+/* jmp/jcc to a label */
+static void
+emit_jcc(struct jit_ctx *c, int cc, uint32_t id)
+{
+        if (cc == CC_ALWAYS) {
+                emit8(c, 0xe9);
+        } else {
+                emit8(c, 0x0f);
+                emit8(c, 0x80 + cc);
+        }
+        add_fixup(c, id);
+}
+
+/* a forward jmp/jcc within an instruction. see patch_here */
+static uint32_t
+emit_jcc_fwd(struct jit_ctx *c, int cc)
+{
+        if (cc == CC_ALWAYS) {
+                emit8(c, 0xe9);
+        } else {
+                emit8(c, 0x0f);
+                emit8(c, 0x80 + cc);
+        }
+        uint32_t pos = c->code.lsize;
+        emit32(c, 0);
+        return pos;
+}
+
+static void
+patch_rel32(struct jit_ctx *c, uint32_t pos, uint32_t target)
+{
+        le32_encode(&VEC_ELEM(c->code, pos), target - (pos + 4));
+}
+
+static void
+patch_here(struct jit_ctx *c, uint32_t pos)
+{
+        if (c->error != 0) {
+                return;
+        }
+        patch_rel32(c, pos, c->code.lsize);
+}
+
+static int32_t
+local_disp(uint32_t idx)
+{
+        return (int32_t)(8 * idx);
+}
+
+static int32_t
+slot_disp(const struct jit_ctx *c, uint32_t slot)
+{
+        return local_disp(c->nlocals + slot);
+}
+
+static uint32_t
+push(struct jit_ctx *c)
+{
+        uint32_t slot = c->sp++;
+        if (c->sp > c->maxsp) {
+                c->maxsp = c->sp;
+        }
+        return slot;
+}
+
+static uint32_t
+pop(struct jit_ctx *c)
+{
+        assert(c->sp > 0);
+        return --c->sp;
+}
+
+/* check the return value of a helper in eax */
+static void
+emit_check(struct jit_ctx *c)
+{
+        emit_test_eax(c);
+        emit_jcc(c, CC_NE, c->err_id);
+}
+
+static void
+emit_trap(struct jit_ctx *c, enum trapid id)
+{
+        emit_mov_rr(c, true, RDI, R12);
+        emit_mov_imm32(c, RSI, id);
+        emit_call_abs(c, (const void *)aot_trap);
+        emit_jcc(c, CC_ALWAYS, c->err_id);
+}
+
+/* see aot_safepoint */
+static void
+emit_safepoint(struct jit_ctx *c)
+{
+        /* sub dword [r12 + countdown], 1 */
+        EMIT_MEM(c, false, 5, R12,
+                 offsetof(struct exec_context, aot_check_countdown), 0x83);
+        emit8(c, 1);
+        uint32_t skip = emit_jcc_fwd(c, CC_AE);
+        emit_mov_rr(c, true, RDI, R12);
+        emit_call_abs(c, (const void *)aot_check_interrupt);
+        emit_check(c);
+        patch_here(c, skip);
+}
+
+/* copy the values to the target and jump if the condition is met */
+static void
+emit_br(struct jit_ctx *c, uint32_t labelidx, int cc)
+{
+        assert(labelidx < c->labels.lsize);
+        const struct jit_label *l =
+                &VEC_ELEM(c->labels, c->labels.lsize - 1 - labelidx);
+        bool is_loop = l->op == 0x03;
+        uint32_t arity = is_loop ? l->nparams : l->nresults;
+        uint32_t skip = 0;
+        uint32_t i;
+        assert(c->sp >= arity);
+        if (arity == 0 || l->height == c->sp - arity) {
+                emit_jcc(c, cc, l->id);
+                return;
+        }
+        if (cc != CC_ALWAYS) {
+                skip = emit_jcc_fwd(c, cc ^ 1);
+        }
+        for (i = 0; i < arity; i++) {
+                uint32_t src = c->sp - arity + i;
+                uint32_t dst = l->height + i;
+                assert(dst < src);
+                emit_load(c, true, RAX, RSP, slot_disp(c, src));
+                emit_store(c, true, RAX, RSP, slot_disp(c, dst));
+        }
+        emit_jcc(c, CC_ALWAYS, l->id);
+        if (cc != CC_ALWAYS) {
+                patch_here(c, skip);
+        }
+}
+
+/* test the i32 in the slot. */
+static void
+emit_test_slot(struct jit_ctx *c, uint32_t slot)
+{
+        emit_load(c, false, RAX, RSP, slot_disp(c, slot));
+        emit_test_eax(c);
+}
+
+/*
+ * leave the host address for the memory access in rax.
+ * see aot_getptr.
+ */
+static void
+emit_getptr(struct jit_ctx *c, uint32_t slot, uint32_t offset, uint32_t size)
+{
+        /* above the current operand stack. it's within the frame. */
+        const int32_t scratch = slot_disp(c, c->maxsp);
+#if defined(TOYWASM_USE_MEMORY_CACHE)
+        emit_load(c, false, RAX, RSP, slot_disp(c, slot));
+        emit_mov_imm32(c, RCX, offset);
+        EMIT_RR(c, true, RCX, RAX, 0x01); /* add rax, rcx */
+        emit_lea(c, RDX, RAX, size);
+        /* cmp rdx, [r12 + mem0_allocated] */
+        EMIT_MEM(c, true, RDX, R12,
+                 offsetof(struct exec_context, mem0_allocated), 0x3b);
+        uint32_t slow = emit_jcc_fwd(c, CC_A);
+        /* add rax, [r12 + mem0_data] */
+        EMIT_MEM(c, true, RAX, R12, offsetof(struct exec_context, mem0_data),
+                 0x03);
+        uint32_t done = emit_jcc_fwd(c, CC_ALWAYS);
+        patch_here(c, slow);
+#endif
+        emit_mov_rr(c, true, RDI, R12);
+        emit_load(c, false, RSI, RSP, slot_disp(c, slot));
+        emit_mov_imm32(c, RDX, offset);
+        emit_mov_imm32(c, RCX, size);
+        emit_lea(c, R8, RSP, scratch);
+        emit_call_abs(c, (const void *)aot_memory_getptr);
+        emit_check(c);
+        emit_load(c, true, RAX, RSP, scratch);
+#if defined(TOYWASM_USE_MEMORY_CACHE)
+        patch_here(c, done);
+#endif
+}
+
+static const struct jit_op *
+find_op(uint8_t op)
+{
+        uint32_t i;
+        for (i = 0; i < ARRAYCOUNT(jit_ops); i++) {
+                if (jit_ops[i].op == op) {
+                        return &jit_ops[i];
+                }
+        }
+        return NULL;
+}
+
+static bool
+is_int_type(enum valtype t)
+{
+        return t == TYPE_i32 || t == TYPE_i64;
+}
+
+static bool
+is_int_resulttype(const struct resulttype *rt)
+{
+        uint32_t i;
+        for (i = 0; i < rt->ntypes; i++) {
+                if (!is_int_type(rt->types[i])) {
+                        return false;
+                }
+        }
+        return true;
+}
+
+static bool
+is_supported_func(const struct module *m, uint32_t localidx)
+{
+        const struct functype *ft = local_functype(m, localidx);
+        const struct localtype *lt = &m->funcs[localidx].localtype;
+        uint32_t i;
+        if (!is_int_resulttype(&ft->parameter) ||
+            !is_int_resulttype(&ft->result) ||
+            ft->parameter.ntypes > JIT_MAX_VALS ||
+            ft->result.ntypes > JIT_MAX_VALS) {
+                return false;
+        }
+        for (i = 0; i < lt->nlocalchunks; i++) {
+                if (!is_int_type(lt->localchunks[i].type)) {
+                        return false;
+                }
+        }
+        return true;
+}
+
+static bool
+is_supported_memory(const struct module *m)
+{
+        if (m->nimportedmems + m->nmems == 0) {
+                return false;
+        }
+        const struct memtype *mt = module_memtype(m, 0);
+        return (mt->flags & MEMTYPE_FLAG_64) == 0;
+}
+
+static int
+push_label(struct jit_ctx *c, uint8_t op, uint32_t nparams, uint32_t nresults)
+{
+        int ret = VEC_PREALLOC(c->mctx, c->labels, 1);
+        if (ret != 0) {
+                return ret;
+        }
+        assert(c->sp >= nparams);
+        struct jit_label *l = VEC_PUSH(c->labels);
+        l->op = op;
+        l->has_else = false;
+        l->id = new_id(c);
+        l->else_id = (op == 0x04) ? new_id(c) : 0;
+        l->height = c->sp - nparams;
+        l->nparams = nparams;
+        l->nresults = nresults;
+        return 0;
+}
+
+static int
+read_blocktype(struct jit_ctx *c, const uint8_t **pp, uint32_t *nparamsp,
+               uint32_t *nresultsp)
+{
+        int64_t bt = read_leb_s33_nocheck(pp);
+        if (bt >= 0) {
+                const struct functype *ft = &c->m->types[bt];
+                if (!is_int_resulttype(&ft->parameter) ||
+                    !is_int_resulttype(&ft->result)) {
+                        return ENOTSUP;
+                }
+                *nparamsp = ft->parameter.ntypes;
+                *nresultsp = ft->result.ntypes;
+                return 0;
+        }
+        uint8_t t = (uint8_t)(bt & 0x7f);
+        *nparamsp = 0;
+        if (t == 0x40) {
+                *nresultsp = 0;
+        } else if (is_int_type(t)) {
+                *nresultsp = 1;
+        } else {
+                return ENOTSUP;
+        }
+        return 0;
+}
+
+static int
+read_memarg(struct jit_ctx *c, const uint8_t **pp, uint32_t *offsetp)
+{
+        uint32_t align = read_leb_u32_nocheck(pp);
+        if ((align & 0x40) != 0) {
+                /* multi-memory */
+                if (read_leb_u32_nocheck(pp) != 0) {
+                        return ENOTSUP;
+                }
+        }
+        if (!is_supported_memory(c->m)) {
+                return ENOTSUP;
+        }
+        *offsetp = read_leb_u32_nocheck(pp);
+        return 0;
+}
+
+static int
+compile_call(struct jit_ctx *c, uint32_t funcidx)
+{
+        const struct module *m = c->m;
+        int ret;
+        if (funcidx < m->nimportedfuncs) {
+                return ENOTSUP;
+        }
+        uint32_t localidx = funcidx - m->nimportedfuncs;
+        const struct jit_funcstate *st = jit_funcstate(c->ji, m, funcidx);
+        if (st->unsupported ||
+            c->unit[localidx] == JIT_UNIT_REJECTED) {
+                return ENOTSUP;
+        }
+        if (st->code == NULL && c->scanning) {
+                ret = VEC_PREALLOC(c->mctx, c->callees, 1);
+                if (ret != 0) {
+                        return ret;
+                }
+                *VEC_PUSH(c->callees) = localidx;
+        }
+        if (c->dead) {
+                return 0;
+        }
+        const struct functype *ft = local_functype(m, localidx);
+        uint32_t nparams = ft->parameter.ntypes;
+        uint32_t nresults = ft->result.ntypes;
+        assert(c->sp >= nparams);
+        uint32_t base = c->sp - nparams;
+        /* the callee reads the params and writes the results in place */
+        uint32_t n = (nparams > nresults) ? nparams : nresults;
+        if (base + n > c->maxsp) {
+                c->maxsp = base + n;
+        }
+        emit_mov_rr(c, true, RDI, R12);
+        emit_mov_rr(c, true, RSI, R13);
+        emit_lea(c, RDX, RSP, slot_disp(c, base));
+        if (st->code != NULL) {
+                emit_call_abs(c, st->code);
+        } else {
+                assert(c->scanning ||
+                       c->unit[localidx] == JIT_UNIT_CANDIDATE);
+                emit8(c, 0xe8); /* call rel32 */
+                if (c->error == 0) {
+                        ret = VEC_PREALLOC(c->mctx, c->calls, 1);
+                        if (ret != 0) {
+                                return ret;
+                        }
+                        struct jit_fixup *f = VEC_PUSH(c->calls);
+                        f->pos = c->code.lsize;
+                        f->id = localidx;
+                }
+                emit32(c, 0);
+        }
+        emit_check(c);
+        c->sp = base + nresults;
+        return 0;
+}
+
+static int
+compile_insn(struct jit_ctx *c, const uint8_t **pp)
+{
+        const struct module *m = c->m;
+        const uint8_t *p = *pp;
+        uint8_t op = *p++;
+        uint32_t nparams;
+        uint32_t nresults;
+        uint32_t idx;
+        uint32_t a = 0;
+        uint32_t b;
+        int ret = 0;
+
+        switch (op) {
+        case 0x02: /* block */
+        case 0x03: /* loop */
+        case 0x04: /* if */
+                ret = read_blocktype(c, &p, &nparams, &nresults);
+                if (ret != 0) {
+                        break;
+                }
+                if (c->dead) {
+                        c->deadnest++;
+                        break;
+                }
+                if (op == 0x04) {
+                        /*
+                         * the "then" block might overwrite the
+                         * slots of the params the "else" block needs.
+                         */
+                        if (nparams > 0) {
+                                ret = ENOTSUP;
+                                break;
+                        }
+                        a = pop(c);
+                }
+                ret = push_label(c, op, nparams, nresults);
+                if (ret != 0) {
+                        break;
+                }
+                const struct jit_label *l = &VEC_LASTELEM(c->labels);
+                if (op == 0x03) {
+                        bind(c, l->id);
+                        emit_safepoint(c);
+                } else if (op == 0x04) {
+                        emit_test_slot(c, a);
+                        emit_jcc(c, CC_E, l->else_id);
+                }
+                break;
+        case 0x05: { /* else */
+                if (c->dead && c->deadnest > 0) {
+                        break;
+                }
+                struct jit_label *l = &VEC_LASTELEM(c->labels);
+                assert(l->op == 0x04);
+                if (!c->dead) {
+                        emit_jcc(c, CC_ALWAYS, l->id);
+                }
+                bind(c, l->else_id);
+                l->has_else = true;
+                c->sp = l->height + l->nparams;
+                c->dead = false;
+                break;
+        }
+        case 0x0b: { /* end */
+                if (c->dead && c->deadnest > 0) {
+                        c->deadnest--;
+                        break;
+                }
+                assert(c->labels.lsize > 0);
+                const struct jit_label *l = &VEC_LASTELEM(c->labels);
+                if (l->op == 0x04 && !l->has_else) {
+                        bind(c, l->else_id);
+                }
+                if (l->op != 0x03) {
+                        bind(c, l->id);
+                }
+                c->sp = l->height + l->nresults;
+                c->dead = false;
+                c->labels.lsize--;
+                break;
+        }
+        case 0x00: /* unreachable */
+                if (!c->dead) {
+                        emit_trap(c, TRAP_UNREACHABLE);
+                        c->dead = true;
+                }
+                break;
+        case 0x01: /* nop */
+                break;
+        case 0x0c: /* br */
+                idx = read_leb_u32_nocheck(&p);
+                if (!c->dead) {
+                        emit_br(c, idx, CC_ALWAYS);
+                        c->dead = true;
+                }
+                break;
+        case 0x0d: /* br_if */
+                idx = read_leb_u32_nocheck(&p);
+                if (!c->dead) {
+                        emit_test_slot(c, pop(c));
+                        emit_br(c, idx, CC_NE);
+                }
+                break;
+        case 0x0e: { /* br_table */
+                uint32_t n = read_leb_u32_nocheck(&p);
+                uint32_t i;
+                if (!c->dead) {
+                        a = pop(c);
+                        emit_load(c, false, RDX, RSP, slot_disp(c, a));
+                }
+                for (i = 0; i < n; i++) {
+                        idx = read_leb_u32_nocheck(&p);
+                        if (!c->dead) {
+                                /* cmp edx, i */
+                                EMIT_RR(c, false, 7, RDX, 0x81);
+                                emit32(c, i);
+                                emit_br(c, idx, CC_E);
+                        }
+                }
+                idx = read_leb_u32_nocheck(&p);
+                if (!c->dead) {
+                        emit_br(c, idx, CC_ALWAYS);
+                        c->dead = true;
+                }
+                break;
+        }
+        case 0x0f: /* return */
+                if (!c->dead) {
+                        emit_br(c, c->labels.lsize - 1, CC_ALWAYS);
+                        c->dead = true;
+                }
+                break;
+        case 0x10: /* call */
+                ret = compile_call(c, read_leb_u32_nocheck(&p));
+                break;
+        case 0x1a: /* drop */
+                if (!c->dead) {
+                        pop(c);
+                }
+                break;
+        case 0x1c: /* select t */
+                if (read_leb_u32_nocheck(&p) != 1 || !is_int_type(*p++)) {
+                        ret = ENOTSUP;
+                        break;
+                }
+                /* fallthrough */
+        case 0x1b: { /* select */
+                if (c->dead) {
+                        break;
+                }
+                idx = pop(c);
+                b = pop(c);
+                a = c->sp - 1;
+                emit_test_slot(c, idx);
+                uint32_t skip = emit_jcc_fwd(c, CC_NE);
+                emit_load(c, true, RAX, RSP, slot_disp(c, b));
+                emit_store(c, true, RAX, RSP, slot_disp(c, a));
+                patch_here(c, skip);
+                break;
+        }
+        case 0x20: /* local.get */
+                idx = read_leb_u32_nocheck(&p);
+                if (!c->dead) {
+                        emit_load(c, true, RAX, RSP, local_disp(idx));
+                        emit_store(c, true, RAX, RSP, slot_disp(c, push(c)));
+                }
+                break;
+        case 0x21: /* local.set */
+        case 0x22: /* local.tee */
+                idx = read_leb_u32_nocheck(&p);
+                if (!c->dead) {
+                        a = (op == 0x21) ? pop(c) : c->sp - 1;
+                        emit_load(c, true, RAX, RSP, slot_disp(c, a));
+                        emit_store(c, true, RAX, RSP, local_disp(idx));
+                }
+                break;
+        case 0x23: /* global.get */
+        case 0x24: { /* global.set */
+                idx = read_leb_u32_nocheck(&p);
+                enum valtype t = module_globaltype(m, idx)->t;
+                if (!is_int_type(t)) {
+                        ret = ENOTSUP;
+                        break;
+                }
+                if (c->dead) {
+                        break;
+                }
+                /* the globalinst is known at this point */
+                bool w = t == TYPE_i64;
+                struct globalinst *g = VEC_ELEM(c->inst->globals, idx);
+                emit_mov_imm64(c, RCX, (uint64_t)(uintptr_t)&g->val);
+                if (op == 0x23) {
+                        emit_load(c, w, RAX, RCX, 0);
+                        emit_store(c, true, RAX, RSP, slot_disp(c, push(c)));
+                } else {
+                        emit_load(c, true, RAX, RSP, slot_disp(c, pop(c)));
+                        emit_store(c, w, RAX, RCX, 0);
+                }
+                break;
+        }
+        case 0x3f: { /* memory.size */
+                if (read_leb_u32_nocheck(&p) != 0 ||
+                    !is_supported_memory(m)) {
+                        ret = ENOTSUP;
+                        break;
+                }
+                if (c->dead) {
+                        break;
+                }
+                struct meminst *mi = VEC_ELEM(c->inst->mems, 0);
+                emit_mov_imm64(c, RCX,
+                               (uint64_t)(uintptr_t)&mi->size_in_pages);
+                emit_load(c, false, RAX, RCX, 0);
+                emit_store(c, true, RAX, RSP, slot_disp(c, push(c)));
+                break;
+        }
+        case 0x41: { /* i32.const */
+                uint32_t v = read_leb_i32_nocheck(&p);
+                if (!c->dead) {
+                        emit_mov_imm32(c, RAX, v);
+                        emit_store(c, true, RAX, RSP, slot_disp(c, push(c)));
+                }
+                break;
+        }
+        case 0x42: { /* i64.const */
+                uint64_t v = read_leb_i64_nocheck(&p);
+                if (!c->dead) {
+                        emit_mov_imm64(c, RAX, v);
+                        emit_store(c, true, RAX, RSP, slot_disp(c, push(c)));
+                }
+                break;
+        }
+        default: {
+                const struct jit_op *o = find_op(op);
+                uint32_t offset = 0;
+                if (o == NULL) {
+                        ret = ENOTSUP;
+                        break;
+                }
+                if (o->kind == JIT_LOAD || o->kind == JIT_STORE) {
+                        ret = read_memarg(c, &p, &offset);
+                        if (ret != 0) {
+                                break;
+                        }
+                }
+                if (c->dead) {
+                        break;
+                }
+                switch (o->kind) {
+                case JIT_ALU:
+                        b = pop(c);
+                        a = c->sp - 1;
+                        emit_load(c, o->w, RAX, RSP, slot_disp(c, a));
+                        emit_mem(c, o->w, o->opc, o->oplen, RAX, RSP,
+                                 slot_disp(c, b));
+                        emit_store(c, true, RAX, RSP, slot_disp(c, a));
+                        break;
+                case JIT_SHIFT:
+                        b = pop(c);
+                        a = c->sp - 1;
+                        emit_load(c, false, RCX, RSP, slot_disp(c, b));
+                        emit_load(c, o->w, RAX, RSP, slot_disp(c, a));
+                        EMIT_RR(c, o->w, o->arg, RAX, 0xd3);
+                        emit_store(c, true, RAX, RSP, slot_disp(c, a));
+                        break;
+                case JIT_CMP:
+                case JIT_EQZ:
+                        if (o->kind == JIT_CMP) {
+                                b = pop(c);
+                                a = c->sp - 1;
+                                emit_load(c, o->w, RAX, RSP, slot_disp(c, a));
+                                EMIT_MEM(c, o->w, RAX, RSP, slot_disp(c, b),
+                                         0x3b);
+                        } else {
+                                a = c->sp - 1;
+                                emit_load(c, o->w, RAX, RSP, slot_disp(c, a));
+                                EMIT_RR(c, o->w, RAX, RAX, 0x85);
+                        }
+                        /* setcc al; movzx eax, al */
+                        EMIT_RR(c, false, 0, RAX, 0x0f, 0x90 + (o->arg));
+                        EMIT_RR(c, false, RAX, RAX, 0x0f, 0xb6);
+                        emit_store(c, true, RAX, RSP, slot_disp(c, a));
+                        break;
+                case JIT_MOVX:
+                        a = c->sp - 1;
+                        emit_mem(c, o->w, o->opc, o->oplen, RAX, RSP,
+                                 slot_disp(c, a));
+                        emit_store(c, true, RAX, RSP, slot_disp(c, a));
+                        break;
+                case JIT_UNOP:
+                        a = c->sp - 1;
+                        emit_load(c, true, RDI, RSP, slot_disp(c, a));
+                        emit_call_abs(c, (const void *)o->unop);
+                        emit_store(c, true, RAX, RSP, slot_disp(c, a));
+                        break;
+                case JIT_DIVOP:
+                        b = pop(c);
+                        a = c->sp - 1;
+                        emit_mov_rr(c, true, RDI, R12);
+                        emit_lea(c, RSI, RSP, slot_disp(c, a));
+                        emit_load(c, true, RDX, RSP, slot_disp(c, b));
+                        emit_call_abs(c, (const void *)o->divop);
+                        emit_check(c);
+                        break;
+                case JIT_LOAD:
+                        a = c->sp - 1;
+                        emit_getptr(c, a, offset, o->arg);
+                        emit_mem(c, o->w, o->opc, o->oplen, RAX, RAX, 0);
+                        emit_store(c, true, RAX, RSP, slot_disp(c, a));
+                        break;
+                case JIT_STORE:
+                        b = pop(c);
+                        a = pop(c);
+                        emit_getptr(c, a, offset, o->arg);
+                        emit_load(c, true, RCX, RSP, slot_disp(c, b));
+                        if (o->arg == 1) {
+                                EMIT_MEM(c, false, RCX, RAX, 0, 0x88);
+                        } else {
+                                if (o->arg == 2) {
+                                        emit8(c, 0x66);
+                                }
+                                emit_store(c, o->arg == 8, RCX, RAX, 0);
+                        }
+                        break;
+                }
+                break;
+        }
+        }
+        *pp = p;
+        return ret;
+}
+
+/*
+ * compile a function at the end of c->code.
+ */
+static int
+compile_func(struct jit_ctx *c, uint32_t localidx)
+{
+        const struct module *m = c->m;
+        const struct functype *ft = local_functype(m, localidx);
+        const struct func *func = &m->funcs[localidx];
+        const uint8_t *p = func->e.start;
+        const uint32_t nparams = ft->parameter.ntypes;
+        const uint32_t nresults = ft->result.ntypes;
+        uint32_t i;
+        int ret;
+
+        c->labels.lsize = 0;
+        c->targets.lsize = 0;
+        c->fixups.lsize = 0;
+        c->nlocals = nparams + func->localtype.nlocals;
+        c->sp = 0;
+        c->maxsp = 0;
+        c->dead = false;
+        c->deadnest = 0;
+        c->err_id = new_id(c);
+        const uint32_t too_many_id = new_id(c);
+
+        /* prologue */
+        emit_push(c, RBP);
+        emit_mov_rr(c, true, RBP, RSP);
+        emit_push(c, RBX);
+        emit_push(c, R12);
+        emit_push(c, R13);
+        emit_push(c, R14); /* for the alignment */
+        emit_mov_rr(c, true, R12, RDI);
+        emit_mov_rr(c, true, R13, RSI);
+        emit_mov_rr(c, true, RBX, RDX);
+        /* sub rsp, framesize */
+        EMIT_RR(c, true, 5, RSP, 0x81);
+        const uint32_t framesize_pos = c->code.lsize;
+        emit32(c, 0);
+        /* cmp rsp, [r12 + jit_stack_limit] */
+        EMIT_MEM(c, true, RSP, R12,
+                 offsetof(struct exec_context, jit_stack_limit), 0x3b);
+        emit_jcc(c, CC_B, too_many_id);
+        /* the same checks as aot_enter */
+        emit_load(c, false, RAX, R12,
+                  offsetof(struct exec_context, aot_depth));
+        EMIT_RR(c, false, 7, RAX, 0x81);
+        emit32(c, AOT_MAX_DEPTH);
+        emit_jcc(c, CC_AE, too_many_id);
+        emit_load(c, false, RCX, R12,
+                  offsetof(struct exec_context, frames.lsize));
+        EMIT_RR(c, true, RCX, RAX, 0x01); /* add rax, rcx */
+        emit_load(c, false, RCX, R12,
+                  offsetof(struct exec_context, options.max_frames));
+        EMIT_RR(c, true, RCX, RAX, 0x39); /* cmp rax, rcx */
+        emit_jcc(c, CC_AE, too_many_id);
+        /* inc dword [r12 + aot_depth] */
+        EMIT_MEM(c, false, 0, R12, offsetof(struct exec_context, aot_depth),
+                 0xff);
+        emit_safepoint(c);
+        for (i = 0; i < nparams; i++) {
+                emit_load(c, true, RAX, RBX, 8 * i);
+                emit_store(c, true, RAX, RSP, local_disp(i));
+        }
+        if (c->nlocals > nparams) {
+                /* rep stosq */
+                emit_lea(c, RDI, RSP, local_disp(nparams));
+                emit_mov_imm32(c, RCX, c->nlocals - nparams);
+                EMIT_RR(c, false, RAX, RAX, 0x31); /* xor eax, eax */
+                emit8(c, 0xf3);
+                emit8(c, 0x48);
+                emit8(c, 0xab);
+        }
+
+        ret = push_label(c, 0, 0, nresults);
+        if (ret != 0) {
+                return ret;
+        }
+        while (c->labels.lsize > 0) {
+                ret = compile_insn(c, &p);
+                if (ret != 0) {
+                        return ret;
+                }
+        }
+        if (c->error != 0) {
+                return c->error;
+        }
+
+        /* epilogue */
+        for (i = 0; i < nresults; i++) {
+                emit_load(c, true, RAX, RSP, slot_disp(c, i));
+                emit_store(c, true, RAX, RBX, 8 * i);
+        }
+        /* dec dword [r12 + aot_depth] */
+        EMIT_MEM(c, false, 1, R12, offsetof(struct exec_context, aot_depth),
+                 0xff);
+        EMIT_RR(c, false, RAX, RAX, 0x31); /* xor eax, eax */
+        bind(c, c->err_id);
+        emit_lea(c, RSP, RBP, -32);
+        emit_pop(c, R14);
+        emit_pop(c, R13);
+        emit_pop(c, R12);
+        emit_pop(c, RBX);
+        emit_pop(c, RBP);
+        emit8(c, 0xc3); /* ret */
+        bind(c, too_many_id);
+        emit_trap(c, TRAP_TOO_MANY_FRAMES);
+        if (c->error != 0) {
+                return c->error;
+        }
+
+        /* locals, slots and the scratch. keep rsp 16-byte aligned. */
+        uint64_t framesize = ((uint64_t)c->nlocals + c->maxsp + 1) * 8;
+        framesize = (framesize + 15) & ~(uint64_t)15;
+        if (framesize > JIT_STACK_SIZE / 4) {
+                return ENOTSUP;
+        }
+        le32_encode(&VEC_ELEM(c->code, framesize_pos), (uint32_t)framesize);
+        const struct jit_fixup *f;
+        VEC_FOREACH(f, c->fixups) {
+                uint32_t target = VEC_ELEM(c->targets, f->id);
+                assert(target != UINT32_MAX);
+                patch_rel32(c, f->pos, target);
+        }
+        return 0;
+}
+
+/*
+ * compile the function and the functions it calls, which are not
+ * compiled yet, into a new code region.
+ */
+static int
+jit_compile(struct instance *inst, uint32_t localidx)
+{
+        const struct module *m = inst->module;
+        struct jit_instance *ji = inst->jit;
+        struct mem_context *mctx = inst->mctx;
+        struct jit_ctx c0;
+        struct jit_ctx *c = &c0;
+        VEC(, uint32_t) worklist;
+        VEC(, struct jit_fixup) edges; /* caller -> callee */
+        uint8_t *unit = NULL;
+        uint32_t *offsets = NULL;
+        void *region = NULL;
+        size_t regionsize = 0;
+        uint32_t ncompiled = 0;
+        uint32_t i;
+        bool changed;
+        int ret;
+
+        memset(c, 0, sizeof(*c));
+        VEC_INIT(worklist);
+        VEC_INIT(edges);
+        c->mctx = mctx;
+        c->inst = inst;
+        c->m = m;
+        c->ji = ji;
+        unit = mem_zalloc(mctx, m->nfuncs * sizeof(*unit));
+        offsets = mem_zalloc(mctx, m->nfuncs * sizeof(*offsets));
+        if (unit == NULL || offsets == NULL) {
+                ret = ENOMEM;
+                goto fail;
+        }
+        c->unit = unit;
+
+        /*
+         * collect the candidates, the function and its callees.
+         * a function is rejected if any of its callees is rejected.
+         */
+        ret = VEC_PREALLOC(mctx, worklist, 1);
+        if (ret != 0) {
+                goto fail;
+        }
+        *VEC_PUSH(worklist) = localidx;
+        unit[localidx] = JIT_UNIT_CANDIDATE;
+        c->scanning = true;
+        while (worklist.lsize > 0) {
+                uint32_t caller = *VEC_POP(worklist);
+                c->code.lsize = 0;
+                c->calls.lsize = 0;
+                c->callees.lsize = 0;
+                c->error = 0;
+                if (is_supported_func(m, caller)) {
+                        ret = compile_func(c, caller);
+                } else {
+                        ret = ENOTSUP;
+                }
+                if (ret == ENOTSUP) {
+                        unit[caller] = JIT_UNIT_REJECTED;
+                        continue;
+                }
+                if (ret != 0) {
+                        goto fail;
+                }
+                ret = VEC_PREALLOC(mctx, edges, c->callees.lsize);
+                if (ret != 0) {
+                        goto fail;
+                }
+                ret = VEC_PREALLOC(mctx, worklist, c->callees.lsize);
+                if (ret != 0) {
+                        goto fail;
+                }
+                const uint32_t *callee;
+                VEC_FOREACH(callee, c->callees) {
+                        struct jit_fixup *e = VEC_PUSH(edges);
+                        e->pos = caller;
+                        e->id = *callee;
+                        if (unit[*callee] == JIT_UNIT_NONE) {
+                                unit[*callee] = JIT_UNIT_CANDIDATE;
+                                *VEC_PUSH(worklist) = *callee;
+                        }
+                }
+        }
+        do {
+                changed = false;
+                const struct jit_fixup *e;
+                VEC_FOREACH(e, edges) {
+                        if (unit[e->pos] == JIT_UNIT_CANDIDATE &&
+                            unit[e->id] == JIT_UNIT_REJECTED) {
+                                unit[e->pos] = JIT_UNIT_REJECTED;
+                                changed = true;
+                        }
+                }
+        } while (changed);
+        for (i = 0; i < m->nfuncs; i++) {
+                if (unit[i] == JIT_UNIT_REJECTED) {
+                        ji->funcs[i].unsupported = true;
+                }
+        }
+        if (unit[localidx] != JIT_UNIT_CANDIDATE) {
+                ret = ENOTSUP;
+                goto fail;
+        }
+
+        /* compile the candidates into a buffer */
+        c->scanning = false;
+        c->code.lsize = 0;
+        c->calls.lsize = 0;
+        c->error = 0;
+        for (i = 0; i < m->nfuncs; i++) {
+                if (unit[i] != JIT_UNIT_CANDIDATE) {
+                        continue;
+                }
+                while ((c->code.lsize % 16) != 0) {
+                        emit8(c, 0xcc); /* int3 */
+                }
+                offsets[i] = c->code.lsize;
+                ret = compile_func(c, i);
+                if (ret != 0) {
+                        goto fail;
+                }
+                ncompiled++;
+        }
+        const struct jit_fixup *f;
+        VEC_FOREACH(f, c->calls) {
+                assert(unit[f->id] == JIT_UNIT_CANDIDATE);
+                patch_rel32(c, f->pos, offsets[f->id]);
+        }
+
+        /* copy it to an executable region */
+        const size_t pgsz = map_anon_pagesize();
+        regionsize = HOWMANY(c->code.lsize, pgsz) * pgsz;
+        ret = VEC_PREALLOC(mctx, ji->regions, 1);
+        if (ret != 0) {
+                goto fail;
+        }
+        ret = map_anon_reserve(regionsize, &region);
+        if (ret != 0) {
+                region = NULL;
+                goto fail;
+        }
+        memcpy(region, c->code.p, c->code.lsize);
+        ret = map_anon_exec(region, regionsize);
+        if (ret != 0) {
+                goto fail;
+        }
+        struct jit_region *r = VEC_PUSH(ji->regions);
+        r->p = region;
+        r->size = regionsize;
+        region = NULL;
+        for (i = 0; i < m->nfuncs; i++) {
+                if (unit[i] == JIT_UNIT_CANDIDATE) {
+                        ji->funcs[i].code = (uint8_t *)r->p + offsets[i];
+                }
+        }
+        xlog_trace("jit: compiled %" PRIu32 " functions (%" PRIu32
+                   " bytes) for func %" PRIu32,
+                   ncompiled, c->code.lsize, m->nimportedfuncs + localidx);
+        ret = 0;
+fail:
+        if (region != NULL) {
+                unmap_anon(region, regionsize);
+        }
+        VEC_FREE(mctx, c->code);
+        VEC_FREE(mctx, c->calls);
+        VEC_FREE(mctx, c->callees);
+        VEC_FREE(mctx, c->labels);
+        VEC_FREE(mctx, c->targets);
+        VEC_FREE(mctx, c->fixups);
+        VEC_FREE(mctx, worklist);
+        VEC_FREE(mctx, edges);
+        if (unit != NULL) {
+                mem_free(mctx, unit, m->nfuncs * sizeof(*unit));
+        }
+        if (offsets != NULL) {
+                mem_free(mctx, offsets, m->nfuncs * sizeof(*offsets));
+        }
+        return ret;
+}
+
+#else /* defined(JIT_X86_64) */
+
+static int
+jit_compile(struct instance *inst, uint32_t localidx)
+{
+        return ENOTSUP;
+}
+
+#endif /* defined(JIT_X86_64) */
+
+static int
+jit_instance_create(struct instance *inst)
+{
+        const struct module *m = inst->module;
+        struct mem_context *mctx = inst->mctx;
+        struct jit_instance *ji;
+
+        assert(inst->jit == NULL);
+        ji = mem_zalloc(mctx, sizeof(*ji));
+        if (ji == NULL) {
+                return ENOMEM;
+        }
+        ji->funcs = mem_zalloc(mctx, m->nfuncs * sizeof(*ji->funcs));
+        if (ji->funcs == NULL) {
+                mem_free(mctx, ji, sizeof(*ji));
+                return ENOMEM;
+        }
+        VEC_INIT(ji->regions);
+        inst->jit = ji;
+        return 0;
+}
+
+void
+jit_instance_destroy(struct instance *inst)
+{
+        struct jit_instance *ji = inst->jit;
+        struct mem_context *mctx = inst->mctx;
+        if (ji == NULL) {
+                return;
+        }
+        struct jit_region *r;
+        VEC_FOREACH(r, ji->regions) {
+                unmap_anon(r->p, r->size);
+        }
+        VEC_FREE(mctx, ji->regions);
+        mem_free(mctx, ji->funcs, inst->module->nfuncs * sizeof(*ji->funcs));
+        mem_free(mctx, ji, sizeof(*ji));
+        inst->jit = NULL;
+}
+
+/*
+ * the slow path of jit_ready.
+ */
+bool
+jit_tier_up(const struct funcinst *fi)
+{
+        struct instance *inst = fi->u.wasm.instance;
+        const struct module *m = inst->module;
+        struct jit_funcstate *st;
+        int ret;
+
+        if (inst->jit == NULL) {
+                ret = jit_instance_create(inst);
+                if (ret != 0) {
+                        return false;
+                }
+                st = jit_funcstate(inst->jit, m, fi->u.wasm.funcidx);
+                if (++st->ncalls < TOYWASM_JIT_THRESHOLD) {
+                        return false;
+                }
+        }
+        st = jit_funcstate(inst->jit, m, fi->u.wasm.funcidx);
+        ret = jit_compile(inst, fi->u.wasm.funcidx - m->nimportedfuncs);
+        if (ret != 0) {
+                xlog_trace("jit: failed to compile func %" PRIu32
+                           " with %d",
+                           fi->u.wasm.funcidx, ret);
+                st->unsupported = true;
+                return false;
+        }
+        assert(st->code != NULL);
+        return true;
+}
+
+/*
+ * the lowest address of the C stack of the calling thread the compiled
+ * code can use. JIT_STACK_RESERVE is left for the C functions it calls.
+ * (the aot runtime helpers)
+ * when the stack is not known, assume JIT_STACK_SIZE from here.
+ */
+static uintptr_t
+jit_stack_limit(void)
+{
+        uintptr_t limit =
+                (uintptr_t)__builtin_frame_address(0) - JIT_STACK_SIZE;
+#if defined(__linux__)
+        pthread_attr_t attr;
+        void *addr;
+        size_t size;
+        if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+                if (pthread_attr_getstack(&attr, &addr, &size) == 0) {
+                        limit = (uintptr_t)addr + JIT_STACK_RESERVE;
+                }
+                pthread_attr_destroy(&attr);
+        }
+#elif defined(__APPLE__)
+        pthread_t self = pthread_self();
+        limit = (uintptr_t)pthread_get_stackaddr_np(self) -
+                pthread_get_stacksize_np(self) + JIT_STACK_RESERVE;
+#endif
+        return limit;
+}
+
+/*
+ * call the compiled code with the parameters/results on the operand
+ * stack. (see aot_func_t)
+ */
+int
+jit_call(struct exec_context *ctx, const struct funcinst *fi,
+         struct cell *cells)
+{
+        struct instance *inst = fi->u.wasm.instance;
+        const struct functype *ft = funcinst_functype(fi);
+        const struct resulttype *pt = &ft->parameter;
+        const struct resulttype *rt = &ft->result;
+        const struct jit_funcstate *st =
+                jit_funcstate(inst->jit, inst->module, fi->u.wasm.funcidx);
+        jit_code_t code = (jit_code_t)st->code;
+        uint64_t vals[JIT_MAX_VALS];
+        struct val v;
+        uint32_t cellidx;
+        uint32_t csz;
+        uint32_t i;
+        int ret;
+
+        assert(code != NULL);
+        assert(pt->ntypes <= JIT_MAX_VALS && rt->ntypes <= JIT_MAX_VALS);
+        for (i = 0; i < pt->ntypes; i++) {
+                cellidx = resulttype_cellidx(pt, i, &csz);
+                val_from_cells(&v, &cells[cellidx], csz);
+                vals[i] = (pt->types[i] == TYPE_i32) ? v.u.i32 : v.u.i64;
+        }
+        /*
+         * querying the stack can be slow. (eg. glibc reads
+         * /proc/self/maps for the main thread) do it only once
+         * for a context.
+         */
+        if (ctx->jit_stack_limit == 0) {
+                ctx->jit_stack_limit = jit_stack_limit();
+        }
+        ret = code(ctx, inst, vals);
+        if (ret != 0) {
+                return ret;
+        }
+        for (i = 0; i < rt->ntypes; i++) {
+                cellidx = resulttype_cellidx(rt, i, &csz);
+                if (rt->types[i] == TYPE_i32) {
+                        v.u.i32 = (uint32_t)vals[i];
+                } else {
+                        v.u.i64 = vals[i];
+                }
+                val_to_cells(&v, &cells[cellidx], csz);
+        }
+        return 0;
+}
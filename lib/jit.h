@@ -0,0 +1,122 @@
+#if !defined(_TOYWASM_JIT_H)
+#define _TOYWASM_JIT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "toywasm_config.h"
+
+#include "platform.h"
+#include "type.h"
+#include "vec.h"
+
+/*
+ * a baseline template jit. (TOYWASM_ENABLE_JIT)
+ *
+ * a function is compiled to machine code when it has been called
+ * TOYWASM_JIT_THRESHOLD times. each instruction is translated to
+ * a fixed sequence of machine instructions. there is no register
+ * allocation; locals and operand stack slots live in the native frame,
+ * at the offsets statically known from the operand stack height.
+ *
+ * the compiled code follows the same rules as the aot functions.
+ * (see aot.h) it uses the aot runtime helpers for traps, safepoints
+ * (check_interrupt) and the slow path of memory accesses.
+ * do_aot_call is used to call it from the interpreter.
+ *
+ * a function is compiled together with the functions it calls
+ * directly, as a compiled function can only call compiled functions
+ * in the same instance. if any of them is not supported, the function
+ * is left to the interpreter.
+ *
+ * supported:
+ *
+ * - x86-64 (System V ABI)
+ * - the same subset of instructions as wasm2cstruct --aot.
+ *   (integer types, a single 32-bit memory)
+ *
+ * as the state is per instance and not protected by locks, this is
+ * not available with TOYWASM_ENABLE_WASM_THREADS.
+ *
+ * on other hosts, jit_compile fails with ENOTSUP and every function
+ * is left to the interpreter. cmake warns about it.
+ *
+ * TODO:
+ *
+ * - arm64 (AAPCS64) backend. the ci has arm64 jobs on qemu, and
+ *   the macOS release binary is universal. the template approach
+ *   should map well. (x0 for ctx, a callee-saved register for the
+ *   frame pointer of the native frame)
+ * - float types
+ */
+
+/*
+ * the native stack jit code can use for a call from the interpreter
+ * when the stack of the thread is not known. (see jit_stack_limit)
+ */
+#define JIT_STACK_SIZE (512 * 1024)
+
+/* the native stack left for the C functions called by jit code */
+#define JIT_STACK_RESERVE (64 * 1024)
+
+/* the max number of parameters and results of a compiled function */
+#define JIT_MAX_VALS 16
+
+struct exec_context;
+struct funcinst;
+struct instance;
+struct cell;
+
+struct jit_funcstate {
+        void *code; /* NULL until compiled */
+        uint32_t ncalls;
+        bool unsupported;
+};
+
+struct jit_region {
+        void *p;
+        size_t size;
+};
+
+struct jit_instance {
+        struct jit_funcstate *funcs; /* module::nfuncs entries */
+        VEC(, struct jit_region) regions;
+};
+
+__BEGIN_EXTERN_C
+
+bool jit_tier_up(const struct funcinst *fi);
+int jit_call(struct exec_context *ctx, const struct funcinst *fi,
+             struct cell *cells);
+void jit_instance_destroy(struct instance *inst);
+
+__END_EXTERN_C
+
+#if defined(TOYWASM_ENABLE_JIT)
+/*
+ * returns true if the function has been compiled.
+ * otherwise, count the call and maybe compile it.
+ */
+static inline bool
+jit_ready(const struct funcinst *fi)
+{
+        const struct instance *inst = fi->u.wasm.instance;
+        const struct jit_instance *ji = inst->jit;
+        if (__predict_true(ji != NULL)) {
+                struct jit_funcstate *st =
+                        &ji->funcs[fi->u.wasm.funcidx -
+                                   inst->module->nimportedfuncs];
+                if (st->code != NULL) {
+                        return true;
+                }
+                if (st->unsupported ||
+                    __predict_true(++st->ncalls < TOYWASM_JIT_THRESHOLD)) {
+                        return false;
+                }
+        }
+        return jit_tier_up(fi);
+}
+#endif
+
+#endif /* !defined(_TOYWASM_JIT_H) */
@@ -11,6 +11,7 @@ load_context_init(struct load_context *ctx, struct mem_context *mctx)
 {
         memset(ctx, 0, sizeof(*ctx));
         ctx->mctx = mctx;
+        ctx->module_mctx = mctx;
         report_init(&ctx->report);
         load_options_set_defaults(&ctx->options);
 }
@@ -18,7 +19,7 @@ load_context_init(struct load_context *ctx, struct mem_context *mctx)
 void
 load_context_clear(struct load_context *ctx)
 {
-        struct mem_context *mctx = load_mctx(ctx);
+        struct mem_context *mctx = load_tmp_mctx(ctx);
         report_clear(&ctx->report);
         bitmap_free(mctx, &ctx->refs, ctx->refs_size);
         if (ctx->vctx != NULL) {
@@ -15,10 +15,18 @@ struct load_context {
         uint32_t ndatas_in_datacount;
         struct load_options options;
         struct mem_context *mctx;
+        /*
+         * module_mctx is used for the allocations which live as long as
+         * the module. usually it's same as mctx. when
+         * load_options::use_arena is set, it's the module's arena.
+         */
+        struct mem_context *module_mctx;
         struct validation_context *vctx;
 };
 
-#define load_mctx(l) (l)->mctx
+#define load_mctx(l) (l)->module_mctx
+/* for temporary allocations, which are freed before the load completes */
+#define load_tmp_mctx(l) (l)->mctx
 
 __BEGIN_EXTERN_C
 
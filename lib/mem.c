@@ -70,7 +70,7 @@ mem_reserve_one(struct mem_context *ctx, size_t diff)
 }
 #endif
 
-static void
+void
 mem_unreserve(struct mem_context *ctx, size_t diff)
 {
 #if defined(TOYWASM_ENABLE_HEAP_TRACKING)
@@ -81,7 +81,7 @@ mem_unreserve(struct mem_context *ctx, size_t diff)
 #endif
 }
 
-static int
+int
 mem_reserve(struct mem_context *ctx, size_t diff)
 {
 #if defined(TOYWASM_ENABLE_HEAP_TRACKING)
@@ -101,6 +101,169 @@ mem_reserve(struct mem_context *ctx, size_t diff)
         return 0;
 }
 
+/*
+ * arena
+ */
+
+#define MEM_ARENA_ALIGN _Alignof(max_align_t)
+#define MEM_ARENA_ROUNDUP(sz)                                                 \
+        (((sz) + MEM_ARENA_ALIGN - 1) & ~(size_t)(MEM_ARENA_ALIGN - 1))
+
+struct mem_arena_chunk {
+        struct mem_arena_chunk *next;
+        size_t size; /* including this header */
+};
+
+#define MEM_ARENA_CHUNK_HDR_SIZE                                              \
+        MEM_ARENA_ROUNDUP(sizeof(struct mem_arena_chunk))
+
+static uint8_t *
+mem_arena_new_chunk(struct mem_context *ctx, size_t sz)
+{
+        struct mem_arena *a = ctx->arena;
+        if (sz > SIZE_MAX - MEM_ARENA_CHUNK_HDR_SIZE) {
+                return NULL;
+        }
+        size_t csz = MEM_ARENA_CHUNK_HDR_SIZE + sz;
+        if (mem_reserve(ctx, csz)) {
+                return NULL;
+        }
+        struct mem_arena_chunk *c = malloc(csz);
+        if (c == NULL) {
+                mem_unreserve(ctx, csz);
+                return NULL;
+        }
+        c->next = a->chunks;
+        c->size = csz;
+        a->chunks = c;
+        a->total += csz;
+        a->nchunks++;
+        return (uint8_t *)c + MEM_ARENA_CHUNK_HDR_SIZE;
+}
+
+static bool
+mem_arena_is_last(const struct mem_arena *a, const void *p, size_t sz)
+{
+        return p == a->last && (const uint8_t *)p + MEM_ARENA_ROUNDUP(sz) ==
+                                       a->cur;
+}
+
+static void *
+mem_arena_alloc(struct mem_context *ctx, size_t sz)
+{
+        struct mem_arena *a = ctx->arena;
+        if (sz > SIZE_MAX - MEM_ARENA_ALIGN) {
+                return NULL;
+        }
+        size_t asz = MEM_ARENA_ROUNDUP(sz);
+        uint8_t *p;
+        if ((size_t)(a->end - a->cur) >= asz) {
+                p = a->cur;
+                a->cur += asz;
+        } else if (asz > a->chunk_size / 4) {
+                /*
+                 * give a large allocation a dedicated chunk.
+                 * keep using the current chunk for the following
+                 * small allocations.
+                 */
+                p = mem_arena_new_chunk(ctx, asz);
+                if (p == NULL) {
+                        return NULL;
+                }
+                a->used += sz;
+                return p;
+        } else {
+                p = mem_arena_new_chunk(ctx, a->chunk_size);
+                if (p == NULL) {
+                        return NULL;
+                }
+                a->cur = p + asz;
+                a->end = p + a->chunk_size;
+        }
+        a->last = p;
+        a->used += sz;
+        return p;
+}
+
+static void
+mem_arena_free(struct mem_context *ctx, void *p, size_t sz)
+{
+        struct mem_arena *a = ctx->arena;
+        /*
+         * we can only reclaim the most recent allocation.
+         * others are released by mem_arena_clear.
+         */
+        if (mem_arena_is_last(a, p, sz)) {
+                a->cur = p;
+                a->last = NULL;
+                a->used -= sz;
+        }
+}
+
+static void *
+mem_arena_extend(struct mem_context *ctx, void *p, size_t oldsz, size_t newsz)
+{
+        struct mem_arena *a = ctx->arena;
+        if (p != NULL && mem_arena_is_last(a, p, oldsz) &&
+            newsz <= SIZE_MAX - MEM_ARENA_ALIGN &&
+            (size_t)(a->end - (uint8_t *)p) >= MEM_ARENA_ROUNDUP(newsz)) {
+                /* extend in-place */
+                a->cur = (uint8_t *)p + MEM_ARENA_ROUNDUP(newsz);
+                a->used += newsz - oldsz;
+                return p;
+        }
+        void *np = mem_arena_alloc(ctx, newsz);
+        if (np == NULL) {
+                return NULL;
+        }
+        if (p != NULL) {
+                memcpy(np, p, oldsz);
+        }
+        return np;
+}
+
+static void *
+mem_arena_shrink(struct mem_context *ctx, void *p, size_t oldsz, size_t newsz)
+{
+        struct mem_arena *a = ctx->arena;
+        if (mem_arena_is_last(a, p, oldsz)) {
+                a->cur = (uint8_t *)p + MEM_ARENA_ROUNDUP(newsz);
+                a->used -= oldsz - newsz;
+        }
+        return p;
+}
+
+void
+mem_arena_attach(struct mem_context *ctx, struct mem_arena *arena,
+                 size_t chunk_size)
+{
+        assert(ctx->arena == NULL);
+        assert(chunk_size > 0);
+        memset(arena, 0, sizeof(*arena));
+        arena->chunk_size = MEM_ARENA_ROUNDUP(chunk_size);
+        ctx->arena = arena;
+}
+
+/*
+ * release all the chunks and detach the arena from the mem_context.
+ */
+void
+mem_arena_clear(struct mem_context *ctx)
+{
+        struct mem_arena *a = ctx->arena;
+        assert(a != NULL);
+        struct mem_arena_chunk *c = a->chunks;
+        while (c != NULL) {
+                struct mem_arena_chunk *next = c->next;
+                size_t csz = c->size;
+                free(c);
+                mem_unreserve(ctx, csz);
+                c = next;
+        }
+        memset(a, 0, sizeof(*a));
+        ctx->arena = NULL;
+}
+
 static void
 assert_malloc_size(void *p, size_t sz)
 {
@@ -121,11 +284,13 @@ mem_context_init(struct mem_context *ctx)
 #endif
 #endif
         ctx->parent = NULL;
+        ctx->arena = NULL;
 }
 
 void
 mem_context_clear(struct mem_context *ctx)
 {
+        assert(ctx->arena == NULL);
         assert(ctx->allocated == 0);
 }
 
@@ -145,6 +310,9 @@ void *
 mem_alloc(struct mem_context *ctx, size_t sz)
 {
         assert(sz > 0);
+        if (ctx->arena != NULL) {
+                return mem_arena_alloc(ctx, sz);
+        }
         if (mem_reserve(ctx, sz)) {
                 return NULL;
         }
@@ -185,6 +353,10 @@ mem_free(struct mem_context *ctx, void *p, size_t sz)
                 return;
         }
         assert(sz > 0);
+        if (ctx->arena != NULL) {
+                mem_arena_free(ctx, p, sz);
+                return;
+        }
         assert_malloc_size(p, sz);
         free(p);
         mem_unreserve(ctx, sz);
@@ -195,11 +367,16 @@ mem_extend(struct mem_context *ctx, void *p, size_t oldsz, size_t newsz)
 {
         if (p != NULL) {
                 assert(oldsz > 0);
-                assert_malloc_size(p, oldsz);
         } else {
                 assert(oldsz == 0);
         }
         assert(oldsz < newsz);
+        if (ctx->arena != NULL) {
+                return mem_arena_extend(ctx, p, oldsz, newsz);
+        }
+        if (p != NULL) {
+                assert_malloc_size(p, oldsz);
+        }
         size_t diff = newsz - oldsz;
         if (mem_reserve(ctx, diff)) {
                 return NULL;
@@ -227,6 +404,9 @@ mem_shrink(struct mem_context *ctx, void *p, size_t oldsz, size_t newsz)
 {
         assert(p != NULL);
         assert(oldsz > newsz);
+        if (ctx->arena != NULL) {
+                return mem_arena_shrink(ctx, p, oldsz, newsz);
+        }
         assert_malloc_size(p, oldsz);
         void *np = realloc(p, newsz);
         if (np == NULL) {
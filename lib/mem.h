@@ -2,6 +2,7 @@
 #define _TOYWASM_MEM_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 #include "platform.h"
 #include "toywasm_config.h"
@@ -15,8 +16,39 @@ struct mem_context {
         size_t limit;
 #endif
         struct mem_context *parent;
+        struct mem_arena *arena; /* see mem_arena_attach */
 };
 
+/*
+ * an arena allocator.
+ *
+ * when an arena is attached to a mem_context, allocations on the
+ * mem_context are served from large chunks with a simple bump pointer.
+ * mem_free is a no-op except for the most recent allocation.
+ * all the chunks are released at once by mem_arena_clear.
+ *
+ * it's intended for a set of objects with the same lifetime.
+ * (eg. module metadata. see load_options::use_arena)
+ *
+ * only the chunks are accounted to the mem_context. it means that
+ * mem_context_setlimit works with the chunk granularity.
+ */
+struct mem_arena_chunk;
+struct mem_arena {
+        struct mem_arena_chunk *chunks;
+        uint8_t *cur;
+        uint8_t *end;
+        void *last; /* the most recent allocation */
+        size_t chunk_size;
+
+        /* statistics */
+        size_t total; /* sum of chunk sizes */
+        size_t used;  /* sum of allocation sizes */
+        uint32_t nchunks;
+};
+
+#define MEM_ARENA_DEFAULT_CHUNK_SIZE (64 * 1024)
+
 __BEGIN_EXTERN_C
 
 void mem_context_init(struct mem_context *ctx);
@@ -36,6 +68,17 @@ void *__must_check mem_extend_zero(struct mem_context *ctx, void *p,
 void *__must_check mem_shrink(struct mem_context *ctx, void *p, size_t oldsz,
                               size_t newsz) __malloc_like __alloc_size(4);
 
+/*
+ * account memory which is not allocated with mem_alloc.
+ * (eg. an mmap'ed region)
+ */
+int __must_check mem_reserve(struct mem_context *ctx, size_t sz);
+void mem_unreserve(struct mem_context *ctx, size_t sz);
+
+void mem_arena_attach(struct mem_context *ctx, struct mem_arena *arena,
+                      size_t chunk_size);
+void mem_arena_clear(struct mem_context *ctx);
+
 __END_EXTERN_C
 
 #endif /* !defined(_TOYWASM_MEM_H) */
@@ -17,6 +17,7 @@
 #include "decode.h"
 #include "dylink_type.h"
 #include "expr.h"
+#include "fileio.h"
 #include "leb128.h"
 #include "load_context.h"
 #include "mem.h"
@@ -626,6 +627,7 @@ read_tagtype(const uint8_t **pp, const uint8_t *ep, uint32_t idx,
                 ret = EINVAL;
                 goto fail;
         }
+#if !defined(TOYWASM_USE_HEAP_EXNREF)
         uint32_t csz = resulttype_cellsize(&ft->parameter);
         if (csz > TOYWASM_EXCEPTION_MAX_CELLS) {
                 report_error(&ctx->report,
@@ -634,6 +636,7 @@ read_tagtype(const uint8_t **pp, const uint8_t *ep, uint32_t idx,
                 ret = ENOTSUP;
                 goto fail;
         }
+#endif
         tag->typeidx = typeidx;
         ret = 0;
         *pp = p;
@@ -907,7 +910,8 @@ read_import_section(const uint8_t **pp, const uint8_t *ep,
         }
         if (m->nimportedfuncs > 0) {
                 ctx->refs_size = m->nimportedfuncs;
-                ret = bitmap_alloc(mctx, &ctx->refs, ctx->refs_size);
+                ret = bitmap_alloc(load_tmp_mctx(ctx), &ctx->refs,
+                                   ctx->refs_size);
                 if (ret != 0) {
                         goto fail;
                 }
@@ -926,19 +930,25 @@ fail:
 static void
 init_expr_exec_info(struct expr_exec_info *ei)
 {
-        ei->jumps = NULL;
+        ei->jumps_u.jumps = NULL;
 #if defined(TOYWASM_USE_SMALL_CELLS)
-        ei->type_annotations.types = NULL;
+        ei->type_annotations.types_u.types = NULL;
+#endif
+#if defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING)
+        ei->catches = NULL;
 #endif
 }
 
 static void
 clear_expr_exec_info(struct mem_context *mctx, struct expr_exec_info *ei)
 {
-        mem_free(mctx, ei->jumps, ei->njumps * sizeof(*ei->jumps));
+        mem_free(mctx, ei->jumps_u.jumps, expr_exec_info_jumps_size(ei));
 #if defined(TOYWASM_USE_SMALL_CELLS)
         struct type_annotations *an = &ei->type_annotations;
-        mem_free(mctx, an->types, an->ntypes * sizeof(*an->types));
+        mem_free(mctx, an->types_u.types, expr_exec_info_types_size(ei));
+#endif
+#if defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING)
+        mem_free(mctx, ei->catches, ei->ncatches * sizeof(*ei->catches));
 #endif
 }
 
@@ -1171,10 +1181,12 @@ read_function_section(const uint8_t **pp, const uint8_t *ep,
         assert(m->nimportedfuncs == ctx->refs_size);
         if (m->nfuncs > 0) {
                 if (ctx->refs_size > 0) {
-                        bitmap_free(mctx, &ctx->refs, ctx->refs_size);
+                        bitmap_free(load_tmp_mctx(ctx), &ctx->refs,
+                                    ctx->refs_size);
                 }
                 ctx->refs_size = m->nimportedfuncs + m->nfuncs;
-                ret = bitmap_alloc(mctx, &ctx->refs, ctx->refs_size);
+                ret = bitmap_alloc(load_tmp_mctx(ctx), &ctx->refs,
+                                   ctx->refs_size);
                 if (ret != 0) {
                         goto fail;
                 }
@@ -1389,6 +1401,11 @@ clear_element(struct mem_context *mctx, struct element *elem)
                 mem_free(mctx, elem->funcs,
                          elem->init_size * sizeof(*elem->funcs));
         }
+        if (elem->funcs_bin_index != NULL) {
+                mem_free(mctx, elem->funcs_bin_index,
+                         elem->init_size / ELEMENT_FUNCIDX_INDEX_INTERVAL *
+                                 sizeof(uint32_t));
+        }
         clear_expr(mctx, &elem->offset);
 }
 
@@ -1510,18 +1527,49 @@ read_element(const uint8_t **pp, const uint8_t *ep, uint32_t idx,
                  * vec(funcidx)
                  */
                 assert(elem->type == TYPE_funcref);
-                ret = read_vec_u32(load_mctx(ctx), &p, ep, &elem->init_size,
-                                   &elem->funcs);
+                ret = read_vec_count(&p, ep, &elem->init_size);
                 if (ret != 0) {
                         goto fail;
                 }
+                /*
+                 * validate the funcidxes here, but leave them encoded
+                 * in the module binary. see the comment on
+                 * struct element.
+                 */
+                elem->funcs_bin = p;
+                const uint32_t nindex =
+                        elem->init_size / ELEMENT_FUNCIDX_INDEX_INTERVAL;
+                if (nindex > 0) {
+                        elem->funcs_bin_index =
+                                mem_alloc(load_mctx(ctx),
+                                          nindex * sizeof(uint32_t));
+                        if (elem->funcs_bin_index == NULL) {
+                                ret = ENOMEM;
+                                goto fail;
+                        }
+                }
                 for (i = 0; i < elem->init_size; i++) {
-                        if (elem->funcs[i] >= ctx->module->nimportedfuncs +
-                                                      ctx->module->nfuncs) {
+                        uint32_t funcidx;
+                        if (i > 0 && i % ELEMENT_FUNCIDX_INDEX_INTERVAL == 0) {
+                                elem->funcs_bin_index
+                                        [i / ELEMENT_FUNCIDX_INDEX_INTERVAL -
+                                         1] = p - elem->funcs_bin;
+                        }
+                        ret = read_leb_u32(&p, ep, &funcidx);
+                        if (ret != 0) {
+                                goto fail;
+                        }
+                        if (funcidx >= ctx->module->nimportedfuncs +
+                                               ctx->module->nfuncs) {
                                 ret = EINVAL;
                                 goto fail;
                         }
-                        bitmap_set(&ctx->refs, elem->funcs[i]);
+                        bitmap_set(&ctx->refs, funcidx);
+                }
+                if (nindex > 0 &&
+                    elem->init_size % ELEMENT_FUNCIDX_INDEX_INTERVAL == 0) {
+                        elem->funcs_bin_index[nindex - 1] =
+                                p - elem->funcs_bin;
                 }
                 break;
         case 4:
@@ -2091,6 +2139,24 @@ static const struct known_custom_section {
         },
 #endif /* defined(TOYWASM_ENABLE_DYLD) */
 };
+
+static const struct known_custom_section *
+find_known_custom_section(const struct name *name)
+{
+        unsigned int i;
+        for (i = 0; i < ARRAYCOUNT(known_custom_sections); i++) {
+                const struct known_custom_section *k =
+                        &known_custom_sections[i];
+                struct name kname = NAME_FROM_CSTR(k->name);
+                if (compare_name(name, &kname)) {
+                        continue;
+                }
+                xlog_trace("known custom section %s found", k->name);
+                return k;
+        }
+        xlog_trace("skipping unknown custom section \"%.*s\"", CSTR(name));
+        return NULL;
+}
 #endif /* defined(TOYWASM_ENABLE_WASM_NAME_SECTION) ||                        \
           defined(TOYWASM_ENABLE_DYLD) */
 
@@ -2109,23 +2175,12 @@ read_custom_section(const uint8_t **pp, const uint8_t *ep,
                 goto fail;
         }
 #if defined(TOYWASM_ENABLE_WASM_NAME_SECTION) || defined(TOYWASM_ENABLE_DYLD)
-        const struct known_custom_section *k;
-        unsigned int i;
-        for (i = 0; i < ARRAYCOUNT(known_custom_sections); i++) {
-                k = &known_custom_sections[i];
-                struct name kname = NAME_FROM_CSTR(k->name);
-                if (compare_name(&name, &kname)) {
-                        xlog_trace("skipping unknown custom section \"%.*s\"",
-                                   CSTR(&name));
-                        continue;
-                }
-                xlog_trace("known custom section %s found", k->name);
-                break;
-        }
+        const struct known_custom_section *k =
+                find_known_custom_section(&name);
 #endif
         clear_name(&name);
 #if defined(TOYWASM_ENABLE_WASM_NAME_SECTION) || defined(TOYWASM_ENABLE_DYLD)
-        if (i < ARRAYCOUNT(known_custom_sections)) {
+        if (k != NULL) {
                 ret = read_section(&p, ep, k->name, k->read, ctx);
                 if (ret != 0) {
                         goto fail;
@@ -2189,16 +2244,13 @@ cmp_export(const void *vp_a, const void *vp_b)
 #endif
 
 static int
-module_load_into(struct module *m, const uint8_t *p, const uint8_t *ep,
-                 struct load_context *ctx)
+read_module_header(const uint8_t **pp, const uint8_t *ep,
+                   struct load_context *ctx)
 {
+        const uint8_t *p = *pp;
         uint32_t v;
         int ret;
 
-        memset(m, 0, sizeof(*m));
-        ctx->module = m;
-        m->bin = p;
-
         ret = read_u32(&p, ep, &v);
         if (ret != 0) {
                 goto fail;
@@ -2218,50 +2270,45 @@ module_load_into(struct module *m, const uint8_t *p, const uint8_t *ep,
                 ret = EINVAL;
                 goto fail;
         }
+        *pp = p;
+fail:
+        return ret;
+}
 
-        uint8_t max_seen_section_id = 0;
-        while (p < ep) {
-                struct section s;
-                ret = section_load(&s, &p, ep);
-                if (ret != 0) {
-                        report_error(&ctx->report,
-                                     "section_load failed with %d", ret);
-                        goto fail;
-                }
-                const struct section_type *t = get_section_type(s.id);
-
-                if (t == NULL) {
-                        report_error(&ctx->report, "unknown section %u", s.id);
-                        ret = EINVAL;
-                        goto fail;
-                }
-                const char *name = t->name;
-                /*
-                 * sections except the custom section (id=0) should be
-                 * seen in order, at most once.
-                 */
-                if (s.id > 0) {
-                        if (max_seen_section_id >= t->order) {
-                                report_error(&ctx->report,
-                                             "unexpected section %u (%s)",
-                                             s.id, name);
-                                ret = EINVAL;
-                                goto fail;
-                        }
-                        max_seen_section_id = t->order;
-                }
-                xlog_trace("section %u (%s), size %" PRIu32, s.id, name,
-                           s.size);
-                if (t != NULL && t->read != NULL) {
-                        const uint8_t *sp = s.data;
-                        const uint8_t *sep = sp + s.size;
+static int
+check_section_order(uint8_t id, uint8_t *max_seen_section_id,
+                    const struct section_type **tp, struct load_context *ctx)
+{
+        const struct section_type *t = get_section_type(id);
 
-                        ret = read_section(&sp, sep, name, t->read, ctx);
-                        if (ret != 0) {
-                                goto fail;
-                        }
+        if (t == NULL) {
+                report_error(&ctx->report, "unknown section %u", id);
+                return EINVAL;
+        }
+        /*
+         * sections except the custom section (id=0) should be
+         * seen in order, at most once.
+         */
+        if (id > 0) {
+                if (*max_seen_section_id >= t->order) {
+                        report_error(&ctx->report,
+                                     "unexpected section %u (%s)", id,
+                                     t->name);
+                        return EINVAL;
                 }
+                *max_seen_section_id = t->order;
         }
+        *tp = t;
+        return 0;
+}
+
+/*
+ * checks which can only be done after reading all sections.
+ */
+static int
+module_load_finish(struct module *m, struct load_context *ctx)
+{
+        int ret;
 
         /*
          * TODO some of module validations probably need to be done here
@@ -2340,6 +2387,83 @@ fail:
         return ret;
 }
 
+struct module_mem_arena {
+        struct mem_context mctx;
+        struct mem_arena arena;
+};
+
+static int
+module_load_begin(struct module *m, struct load_context *ctx)
+{
+        memset(m, 0, sizeof(*m));
+        ctx->module = m;
+        ctx->module_mctx = ctx->mctx;
+        if (ctx->options.use_arena) {
+                struct module_mem_arena *ma =
+                        mem_alloc(ctx->mctx, sizeof(*ma));
+                if (ma == NULL) {
+                        return ENOMEM;
+                }
+                mem_context_init(&ma->mctx);
+                ma->mctx.parent = ctx->mctx;
+                mem_arena_attach(&ma->mctx, &ma->arena,
+                                 MEM_ARENA_DEFAULT_CHUNK_SIZE);
+                m->mem_arena = ma;
+                ctx->module_mctx = &ma->mctx;
+        }
+        return 0;
+}
+
+static int
+module_load_into(struct module *m, const uint8_t *p, const uint8_t *ep,
+                 struct load_context *ctx)
+{
+        int ret;
+
+        ret = module_load_begin(m, ctx);
+        if (ret != 0) {
+                goto fail;
+        }
+        m->bin = p;
+
+        ret = read_module_header(&p, ep, ctx);
+        if (ret != 0) {
+                goto fail;
+        }
+
+        uint8_t max_seen_section_id = 0;
+        while (p < ep) {
+                struct section s;
+                ret = section_load(&s, &p, ep);
+                if (ret != 0) {
+                        report_error(&ctx->report,
+                                     "section_load failed with %d", ret);
+                        goto fail;
+                }
+                const struct section_type *t;
+                ret = check_section_order(s.id, &max_seen_section_id, &t,
+                                          ctx);
+                if (ret != 0) {
+                        goto fail;
+                }
+                const char *name = t->name;
+                xlog_trace("section %u (%s), size %" PRIu32, s.id, name,
+                           s.size);
+                if (t->read != NULL) {
+                        const uint8_t *sp = s.data;
+                        const uint8_t *sep = sp + s.size;
+
+                        ret = read_section(&sp, sep, name, t->read, ctx);
+                        if (ret != 0) {
+                                goto fail;
+                        }
+                }
+        }
+        ret = module_load_finish(m, ctx);
+fail:
+        return ret;
+}
+
 static int
 module_create0(struct mem_context *mctx, struct module **mp)
 {
@@ -2370,8 +2494,617 @@ module_create(struct module **mp, const uint8_t *p, const uint8_t *ep,
         return 0;
 }
 
+/*
+ * module_create_from_reader
+ *
+ * the sections are read one by one from the stream and parsed
+ * immediately. the code section is parsed function by function.
+ *
+ * the parsed module keeps references to the bytecode. (see the comment
+ * on struct module) the parts of the bytecode which can be referenced
+ * are copied to an arena owned by the module. (module->owned_bin)
+ * other sections are read into a temporary buffer and discarded after
+ * parsing. unknown custom sections (eg. debug info) are skipped without
+ * buffering at all.
+ *
+ * because an instruction is identified with its offset from
+ * module->bin ("pc"), the arena needs to be a contiguous region,
+ * which never moves. we reserve a large inaccessible address range for
+ * it, make pages accessible as the bytes arrive, and release the unused
+ * tail after loading. only the accessible pages are accounted to the
+ * module's mem_context.
+ * the bytes are placed at the same offsets as in the stream so that
+ * "pc" is same as module_create. the holes for the sections we don't
+ * retain are never made accessible except partial pages.
+ *
+ * where an address range can't be reserved, (eg. no mmap) we read
+ * the whole stream into a growing buffer and load it with
+ * module_load_into instead.
+ */
+
+#if SIZE_MAX > UINT32_MAX
+/* "pc" is 32-bit */
+#define MODULE_ARENA_RESERVE ((size_t)UINT32_MAX + 1)
+#else
+#define MODULE_ARENA_RESERVE ((size_t)512 * 1024 * 1024)
+#endif
+
+#define MODULE_STREAM_BUFSIZE 65536
+
+struct module_stream {
+        module_read_func_t read_func;
+        void *read_arg;
+
+        /* input buffer */
+        uint8_t *buf;
+        size_t buf_start;
+        size_t buf_end;
+        bool eof;
+        size_t offset; /* the number of bytes consumed */
+
+        uint8_t *arena;
+        size_t arena_size; /* reserved */
+        size_t arena_used;
+        size_t arena_committed; /* page-aligned high-water mark */
+
+        uint8_t *tmp;
+        size_t tmp_size;
+
+        struct load_context *ctx;
+};
+
+static int
+stream_fill(struct module_stream *s)
+{
+        assert(s->buf_start == s->buf_end);
+        size_t n;
+        int ret = s->read_func(s->read_arg, s->buf, MODULE_STREAM_BUFSIZE,
+                               &n);
+        if (ret != 0) {
+                report_error(&s->ctx->report, "read failed with %d", ret);
+                return ret;
+        }
+        assert(n <= MODULE_STREAM_BUFSIZE);
+        s->buf_start = 0;
+        s->buf_end = n;
+        if (n == 0) {
+                s->eof = true;
+        }
+        return 0;
+}
+
+/*
+ * returns true at the clean end of the stream.
+ */
+static int
+stream_at_eof(struct module_stream *s, bool *eofp)
+{
+        if (s->buf_start == s->buf_end && !s->eof) {
+                int ret = stream_fill(s);
+                if (ret != 0) {
+                        return ret;
+                }
+        }
+        *eofp = s->buf_start == s->buf_end;
+        return 0;
+}
+
+/*
+ * read exactly sz bytes. if dst is NULL, just skip them.
+ */
+static int
+stream_read(struct module_stream *s, uint8_t *dst, size_t sz)
+{
+        while (sz > 0) {
+                if (s->buf_start == s->buf_end) {
+                        if (s->eof) {
+                                report_error(&s->ctx->report,
+                                             "unexpected end of stream");
+                                return EINVAL;
+                        }
+                        int ret = stream_fill(s);
+                        if (ret != 0) {
+                                return ret;
+                        }
+                        continue;
+                }
+                size_t n = s->buf_end - s->buf_start;
+                if (n > sz) {
+                        n = sz;
+                }
+                if (dst != NULL) {
+                        memcpy(dst, &s->buf[s->buf_start], n);
+                        dst += n;
+                }
+                s->buf_start += n;
+                s->offset += n;
+                sz -= n;
+        }
+        return 0;
+}
+
+/*
+ * read a LEB128-encoded u32.
+ * the raw bytes are stored to dst (up to 5 bytes) and *nbytesp.
+ */
+static int
+stream_read_leb_u32(struct module_stream *s, uint8_t dst[5], size_t *nbytesp,
+                    uint32_t *resultp)
+{
+        size_t n = 0;
+        int ret;
+        do {
+                if (n == 5) {
+                        return EOVERFLOW;
+                }
+                ret = stream_read(s, &dst[n], 1);
+                if (ret != 0) {
+                        return ret;
+                }
+        } while ((dst[n++] & 0x80) != 0);
+        const uint8_t *p = dst;
+        ret = read_leb_u32(&p, dst + n, resultp);
+        if (ret != 0) {
+                return ret;
+        }
+        *nbytesp = n;
+        return 0;
+}
+
+/*
+ * make the pages covering [offset, end) of the arena accessible.
+ * as the arena is filled in the stream order, the pages below
+ * arena_committed are never revisited except the last one.
+ */
+static int
+stream_arena_commit(struct module_stream *s, size_t offset, size_t end)
+{
+        struct module *m = s->ctx->module;
+        const size_t pgsz = map_anon_pagesize();
+        int ret;
+
+        if (end <= s->arena_committed) {
+                return 0;
+        }
+        size_t start = offset / pgsz * pgsz;
+        if (start < s->arena_committed) {
+                start = s->arena_committed;
+        }
+        end = HOWMANY(end, pgsz) * pgsz;
+        assert(end <= s->arena_size);
+        const size_t sz = end - start;
+        ret = mem_reserve(load_mctx(s->ctx), sz);
+        if (ret != 0) {
+                return ret;
+        }
+        ret = map_anon_commit(s->arena + start, sz);
+        if (ret != 0) {
+                mem_unreserve(load_mctx(s->ctx), sz);
+                report_error(&s->ctx->report,
+                             "failed to commit memory for the module "
+                             "(error %d)",
+                             ret);
+                return ret;
+        }
+        m->owned_bin_committed += sz;
+        s->arena_committed = end;
+        return 0;
+}
+
+/*
+ * returns the location in the arena for the bytes at the given
+ * offset in the stream.
+ */
+static int
+stream_arena_alloc(struct module_stream *s, size_t offset, size_t sz,
+                   uint8_t **pp)
+{
+        int ret;
+
+        if (offset > s->arena_size || sz > s->arena_size - offset) {
+                report_error(&s->ctx->report, "module too large");
+                return E2BIG;
+        }
+        ret = stream_arena_commit(s, offset, offset + sz);
+        if (ret != 0) {
+                return ret;
+        }
+        *pp = s->arena + offset;
+        if (s->arena_used < offset + sz) {
+                s->arena_used = offset + sz;
+        }
+        return 0;
+}
+
+static int
+stream_tmp_alloc(struct module_stream *s, size_t sz, uint8_t **pp)
+{
+        struct mem_context *mctx = load_tmp_mctx(s->ctx);
+        if (s->tmp_size < sz) {
+                mem_free(mctx, s->tmp, s->tmp_size);
+                s->tmp_size = 0;
+                s->tmp = mem_alloc(mctx, sz);
+                if (s->tmp == NULL) {
+                        return ENOMEM;
+                }
+                s->tmp_size = sz;
+        }
+        *pp = s->tmp;
+        return 0;
+}
+
+/*
+ * sections which the module never references after parsing.
+ */
+static bool
+section_is_transient(uint8_t id)
+{
+        switch (id) {
+        case SECTION_ID_type:
+        case SECTION_ID_function:
+        case SECTION_ID_table:
+        case SECTION_ID_memory:
+        case SECTION_ID_start:
+        case SECTION_ID_datacount:
+#if defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING)
+        case SECTION_ID_tag:
+#endif
+                return true;
+        default:
+                return false;
+        }
+}
+
+/*
+ * the streaming version of read_code_section.
+ */
+static int
+stream_code_section(struct module_stream *s, uint32_t size)
+{
+        struct load_context *ctx = s->ctx;
+        struct mem_context *mctx = load_mctx(ctx);
+        struct module *m = ctx->module;
+        uint8_t leb[5];
+        size_t lebsz;
+        uint32_t count;
+        uint32_t i = 0;
+        int ret;
+
+        assert(m->funcs == NULL);
+        ret = stream_read_leb_u32(s, leb, &lebsz, &count);
+        if (ret != 0) {
+                goto fail;
+        }
+        if (count != m->nfuncs) {
+                xlog_trace("nfunc mismatch %" PRIu32 " != %" PRIu32, count,
+                           m->nfuncs);
+                ret = EINVAL;
+                goto fail;
+        }
+        size_t consumed = lebsz;
+        if (count > 0) {
+                m->funcs = mem_calloc(mctx, count, sizeof(*m->funcs));
+                if (m->funcs == NULL) {
+                        ret = ENOMEM;
+                        goto fail;
+                }
+        }
+        for (i = 0; i < count; i++) {
+                uint32_t fsize;
+                ret = stream_read_leb_u32(s, leb, &lebsz, &fsize);
+                if (ret != 0) {
+                        goto fail;
+                }
+                if (consumed + lebsz + fsize > size) {
+                        ret = EINVAL;
+                        goto fail;
+                }
+                consumed += lebsz + fsize;
+                /*
+                 * copy the size and the body to the arena and parse it.
+                 */
+                uint8_t *p;
+                ret = stream_arena_alloc(s, s->offset - lebsz, lebsz + fsize,
+                                         &p);
+                if (ret != 0) {
+                        goto fail;
+                }
+                memcpy(p, leb, lebsz);
+                ret = stream_read(s, p + lebsz, fsize);
+                if (ret != 0) {
+                        goto fail;
+                }
+                const uint8_t *fp = p;
+                const uint8_t *fep = p + lebsz + fsize;
+                ret = read_func(&fp, fep, i, &m->funcs[i], ctx);
+                if (ret != 0) {
+                        goto fail;
+                }
+                assert(fp == fep);
+        }
+        if (consumed != size) {
+                report_error(&ctx->report,
+                             "section (code) has %zu bytes extra data",
+                             size - consumed);
+                ret = EINVAL;
+                goto fail;
+        }
+        return 0;
+fail:
+        if (m->funcs != NULL) {
+                /* Note: read_func has cleared the failed one */
+                uint32_t j;
+                for (j = 0; j < i; j++) {
+                        clear_func(mctx, &m->funcs[j]);
+                }
+                mem_free(mctx, m->funcs, count * sizeof(*m->funcs));
+                m->funcs = NULL;
+        }
+        if (ret != 0) {
+                report_error(&ctx->report,
+                             "error (%d) while decoding section (code)", ret);
+        }
+        return ret;
+}
+
+static int
+stream_section(struct module_stream *s, uint8_t *max_seen_section_id)
+{
+        struct load_context *ctx = s->ctx;
+        uint8_t leb[5];
+        size_t lebsz;
+        uint8_t id;
+        uint32_t size;
+        int ret;
+
+        ret = stream_read(s, &id, 1);
+        if (ret != 0) {
+                return ret;
+        }
+        ret = stream_read_leb_u32(s, leb, &lebsz, &size);
+        if (ret != 0) {
+                report_error(&ctx->report, "section_load failed with %d",
+                             ret);
+                return ret;
+        }
+        const struct section_type *t;
+        ret = check_section_order(id, max_seen_section_id, &t, ctx);
+        if (ret != 0) {
+                return ret;
+        }
+        xlog_trace("section %u (%s), size %" PRIu32, id, t->name, size);
+        if (id == SECTION_ID_code) {
+                return stream_code_section(s, size);
+        }
+        const size_t offset = s->offset;
+        uint8_t *p;
+        size_t hdrsz = 0;
+        if (id == SECTION_ID_custom) {
+                /*
+                 * peek the name to see if it's a section we are
+                 * interested in.
+                 */
+                uint32_t namesz;
+                ret = stream_read_leb_u32(s, leb, &lebsz, &namesz);
+                if (ret != 0) {
+                        return ret;
+                }
+                if (lebsz + namesz > size) {
+                        return EINVAL;
+                }
+                hdrsz = lebsz + namesz;
+                ret = stream_tmp_alloc(s, hdrsz, &p);
+                if (ret != 0) {
+                        return ret;
+                }
+                memcpy(p, leb, lebsz);
+                ret = stream_read(s, p + lebsz, namesz);
+                if (ret != 0) {
+                        return ret;
+                }
+                const uint8_t *np = p;
+                struct name name;
+                ret = read_name(&np, p + hdrsz, &name);
+                if (ret != 0) {
+                        return ret;
+                }
+#if defined(TOYWASM_ENABLE_WASM_NAME_SECTION) || defined(TOYWASM_ENABLE_DYLD)
+                bool known = find_known_custom_section(&name) != NULL;
+#else
+                bool known = false;
+#endif
+                if (!known) {
+                        return stream_read(s, NULL, size - hdrsz);
+                }
+        }
+        if (section_is_transient(id)) {
+                ret = stream_tmp_alloc(s, size, &p);
+        } else {
+                const uint8_t *hdr = p;
+                ret = stream_arena_alloc(s, offset, size, &p);
+                if (ret == 0 && hdrsz > 0) {
+                        memcpy(p, hdr, hdrsz);
+                }
+        }
+        if (ret != 0) {
+                return ret;
+        }
+        ret = stream_read(s, p + hdrsz, size - hdrsz);
+        if (ret != 0) {
+                return ret;
+        }
+        const uint8_t *sp = p;
+        return read_section(&sp, p + size, t->name, t->read, ctx);
+}
+
+/*
+ * the fallback of module_load_from_reader for the platforms without
+ * map_anon_reserve_noaccess.
+ */
+static int
+module_load_from_reader_buffered(struct module *m, struct module_stream *s)
+{
+        struct load_context *ctx = s->ctx;
+        struct mem_context *mctx = ctx->mctx;
+        uint8_t *buf = NULL;
+        size_t size = 0;
+        size_t used = 0;
+        int ret;
+
+        while (true) {
+                bool eof;
+                ret = stream_at_eof(s, &eof);
+                if (ret != 0) {
+                        goto fail;
+                }
+                if (eof) {
+                        break;
+                }
+                const size_t n = s->buf_end - s->buf_start;
+                if (size - used < n) {
+                        size_t newsize = size * 2;
+                        if (newsize < used + n) {
+                                newsize = used + n;
+                        }
+                        if (newsize > MODULE_ARENA_RESERVE) {
+                                report_error(&ctx->report,
+                                             "module too large");
+                                ret = E2BIG;
+                                goto fail;
+                        }
+                        uint8_t *np = mem_extend(mctx, buf, size, newsize);
+                        if (np == NULL) {
+                                ret = ENOMEM;
+                                goto fail;
+                        }
+                        buf = np;
+                        size = newsize;
+                }
+                ret = stream_read(s, buf + used, n);
+                if (ret != 0) {
+                        goto fail;
+                }
+                used += n;
+        }
+        if (used == 0) {
+                report_error(&ctx->report, "unexpected end of stream");
+                ret = EINVAL;
+                goto fail;
+        }
+        if (used < size) {
+                uint8_t *np = mem_shrink(mctx, buf, size, used);
+                if (np != NULL) {
+                        buf = np;
+                        size = used;
+                }
+        }
+        ret = module_load_into(m, buf, buf + used, ctx);
+        m->owned_bin = buf;
+        m->owned_bin_size = size;
+        m->owned_bin_heap = true;
+        return ret;
+fail:
+        mem_free(mctx, buf, size);
+        return ret;
+}
+
+static int
+module_load_from_reader(struct module *m, struct module_stream *s)
+{
+        struct load_context *ctx = s->ctx;
+        uint8_t hdr[8];
+        int ret;
+
+        ret = map_anon_reserve_noaccess(MODULE_ARENA_RESERVE,
+                                        (void **)&s->arena);
+        if (ret != 0) {
+                /*
+                 * not only ENOTSUP. eg. ENOMEM with a small RLIMIT_AS.
+                 * the buffered loader doesn't need the address space.
+                 */
+                return module_load_from_reader_buffered(m, s);
+        }
+        s->arena_size = MODULE_ARENA_RESERVE;
+        ret = module_load_begin(m, ctx);
+        m->owned_bin = s->arena;
+        m->owned_bin_size = MODULE_ARENA_RESERVE;
+        if (ret != 0) {
+                goto fail;
+        }
+        ret = stream_read(s, hdr, sizeof(hdr));
+        if (ret != 0) {
+                goto fail;
+        }
+        const uint8_t *p = hdr;
+        ret = read_module_header(&p, hdr + sizeof(hdr), ctx);
+        if (ret != 0) {
+                goto fail;
+        }
+
+        m->bin = s->arena;
+
+        uint8_t max_seen_section_id = 0;
+        while (true) {
+                bool eof;
+                ret = stream_at_eof(s, &eof);
+                if (ret != 0) {
+                        goto fail;
+                }
+                if (eof) {
+                        break;
+                }
+                ret = stream_section(s, &max_seen_section_id);
+                if (ret != 0) {
+                        goto fail;
+                }
+        }
+        ret = module_load_finish(m, ctx);
+        if (ret != 0) {
+                goto fail;
+        }
+        m->owned_bin_size = map_anon_shrink(m->owned_bin, m->owned_bin_size,
+                                            s->arena_used);
+        xlog_trace("module arena: %zu bytes used, %zu bytes mapped",
+                   s->arena_used, m->owned_bin_size);
+fail:
+        return ret;
+}
+
+int
+module_create_from_reader(struct module **mp, module_read_func_t read_func,
+                          void *read_arg, struct load_context *ctx)
+{
+        struct mem_context *mctx = ctx->mctx;
+        struct module_stream s;
+        struct module *m;
+        int ret;
+
+        memset(&s, 0, sizeof(s));
+        s.read_func = read_func;
+        s.read_arg = read_arg;
+        s.ctx = ctx;
+        s.buf = mem_alloc(mctx, MODULE_STREAM_BUFSIZE);
+        if (s.buf == NULL) {
+                return ENOMEM;
+        }
+        ret = module_create0(mctx, &m);
+        if (ret != 0) {
+                goto fail;
+        }
+        ret = module_load_from_reader(m, &s);
+        if (ret != 0) {
+                module_destroy(mctx, m);
+                goto fail;
+        }
+        *mp = m;
+fail:
+        mem_free(mctx, s.tmp, s.tmp_size);
+        mem_free(mctx, s.buf, MODULE_STREAM_BUFSIZE);
+        return ret;
+}
+
 static void
-module_unload(struct mem_context *mctx, struct module *m)
+module_free_metadata(struct mem_context *mctx, struct module *m)
 {
         uint32_t i;
 
@@ -2425,6 +3158,36 @@ module_unload(struct mem_context *mctx, struct module *m)
                 mem_free(mctx, m->dylink, sizeof(*m->dylink));
         }
 #endif
+}
+
+static void
+module_unload(struct mem_context *mctx, struct module *m)
+{
+        struct module_mem_arena *ma = m->mem_arena;
+
+        /*
+         * Note: the committed part of owned_bin is accounted to the
+         * arena's mem_context, if any. release it first.
+         */
+        if (m->owned_bin_heap) {
+                mem_free(mctx, m->owned_bin, m->owned_bin_size);
+        } else if (m->owned_bin != NULL) {
+                unmap_anon(m->owned_bin, m->owned_bin_size);
+                mem_unreserve(ma != NULL ? &ma->mctx : mctx,
+                              m->owned_bin_committed);
+        }
+
+        if (ma != NULL) {
+                xlog_trace("module arena: %" PRIu32 " chunks, %zu bytes, "
+                           "%zu bytes used",
+                           ma->arena.nchunks, ma->arena.total,
+                           ma->arena.used);
+                mem_arena_clear(&ma->mctx);
+                mem_context_clear(&ma->mctx);
+                mem_free(mctx, ma, sizeof(*ma));
+        } else {
+                module_free_metadata(mctx, m);
+        }
 
         memset(m, 0, sizeof(*m));
 }
@@ -2456,26 +3219,43 @@ module_print_stats(const struct module *m)
         nbio_printf("=== module memory usage statistics ===\n");
         uint32_t i;
         size_t jump_table_size = 0;
+        size_t jump_table_size_wide = 0;
 #if defined(TOYWASM_ENABLE_WRITER)
         size_t code_size = 0;
 #endif
         size_t type_annotation_size = 0;
+        size_t type_annotation_size_wide = 0;
         size_t localtype_cellidx_size = 0;
         size_t resulttype_cellidx_size = 0;
+#if defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING)
+        size_t catch_handler_size = 0;
+#endif
         for (i = 0; i < m->nfuncs; i++) {
                 const struct func *func = &m->funcs[i];
                 const struct expr *e = &func->e;
                 const struct expr_exec_info *ei = &e->ei;
-                jump_table_size += sizeof(ei->jumps);
+                jump_table_size += sizeof(ei->jumps_u);
                 jump_table_size += sizeof(ei->njumps);
-                if (ei->jumps != NULL) {
-                        jump_table_size += ei->njumps * sizeof(*ei->jumps);
+                jump_table_size_wide += sizeof(ei->jumps_u);
+                jump_table_size_wide += sizeof(ei->njumps);
+                if (ei->jumps_u.jumps != NULL) {
+                        jump_table_size += expr_exec_info_jumps_size(ei);
+                        jump_table_size_wide +=
+                                ei->njumps * sizeof(*ei->jumps_u.jumps);
                 }
                 code_size += expr_end(e) - e->start;
 #if defined(TOYWASM_USE_SMALL_CELLS)
                 const struct type_annotations *a = &ei->type_annotations;
                 type_annotation_size += sizeof(*a);
-                type_annotation_size += a->ntypes * sizeof(*a->types);
+                type_annotation_size += expr_exec_info_types_size(ei);
+                type_annotation_size_wide += sizeof(*a);
+                type_annotation_size_wide +=
+                        a->ntypes * sizeof(*a->types_u.types);
+#endif
+#if defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING)
+                catch_handler_size += sizeof(ei->catches);
+                catch_handler_size += sizeof(ei->ncatches);
+                catch_handler_size += ei->ncatches * sizeof(*ei->catches);
 #endif
 #if defined(TOYWASM_USE_LOCALTYPE_CELLIDX)
                 const struct localtype *lt = &func->localtype;
@@ -2497,10 +3277,25 @@ module_print_stats(const struct module *m)
                     code_size);
         nbio_printf("%30s %12zu bytes\n", "jump table overhead",
                     jump_table_size);
+        nbio_printf("%30s %12zu bytes\n", "(w/o compact forms)",
+                    jump_table_size_wide);
         nbio_printf("%30s %12zu bytes\n", "type annotation overhead",
                     type_annotation_size);
+        nbio_printf("%30s %12zu bytes\n", "(w/o compact forms)",
+                    type_annotation_size_wide);
         nbio_printf("%30s %12zu bytes\n", "local type cell idx overhead",
                     localtype_cellidx_size);
         nbio_printf("%30s %12zu bytes\n", "result type cell idx overhead",
                     resulttype_cellidx_size);
+#if defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING)
+        nbio_printf("%30s %12zu bytes\n", "exception handler overhead",
+                    catch_handler_size);
+#endif
+        const struct module_mem_arena *ma = m->mem_arena;
+        if (ma != NULL) {
+                nbio_printf("%30s %12zu bytes (%" PRIu32 " chunks)\n",
+                            "arena", ma->arena.total, ma->arena.nchunks);
+                nbio_printf("%30s %12zu bytes\n", "arena used",
+                            ma->arena.used);
+        }
 }
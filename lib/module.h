@@ -1,3 +1,4 @@
+#include <stddef.h>
 #include <stdint.h>
 
 #include "platform.h"
@@ -11,6 +12,27 @@ __BEGIN_EXTERN_C
 
 int module_create(struct module **mp, const uint8_t *p, const uint8_t *ep,
                   struct load_context *ctx);
+
+/*
+ * module_create_from_reader: load a module from a stream.
+ *
+ * read_func is called to read the next chunk of the module bytecode.
+ * it should store the number of bytes read to *resultp and return 0.
+ * *resultp == 0 means the end of the stream.
+ * on an error, it should return an errno value.
+ *
+ * unlike module_create, the caller doesn't need to keep the bytecode
+ * after the call.
+ *
+ * it reads the module into a lazily committed address space reservation.
+ * when the reservation fails, (eg. platforms without mmap) it falls back
+ * to buffering the whole module on the heap.
+ */
+typedef int (*module_read_func_t)(void *arg, void *buf, size_t bufsize,
+                                  size_t *resultp);
+int module_create_from_reader(struct module **mp,
+                              module_read_func_t read_func, void *read_arg,
+                              struct load_context *ctx);
 void module_destroy(struct mem_context *mctx, struct module *m);
 int module_find_export(const struct module *m, const struct name *name,
                        uint32_t type, uint32_t *idxp);
@@ -0,0 +1,1057 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "bitmap.h"
+#include "expr_parser.h"
+#include "insn_op_helpers.h"
+#include "leb128.h"
+#include "mem.h"
+#include "module_optimizer.h"
+#include "type.h"
+#include "util.h"
+
+/*
+ * see module_optimizer.h for what this does.
+ */
+
+#define OP_UNREACHABLE 0x00
+#define OP_NOP 0x01
+#define OP_BLOCK 0x02
+#define OP_LOOP 0x03
+#define OP_IF 0x04
+#define OP_ELSE 0x05
+#define OP_THROW 0x08
+#define OP_THROW_REF 0x0a
+#define OP_END 0x0b
+#define OP_BR 0x0c
+#define OP_BR_IF 0x0d
+#define OP_BR_TABLE 0x0e
+#define OP_RETURN 0x0f
+#define OP_RETURN_CALL 0x12
+#define OP_RETURN_CALL_INDIRECT 0x13
+#define OP_DROP 0x1a
+#define OP_TRY_TABLE 0x1f
+#define OP_LOCAL_GET 0x20
+#define OP_LOCAL_SET 0x21
+#define OP_LOCAL_TEE 0x22
+#define OP_GLOBAL_GET 0x23
+#define OP_I32_CONST 0x41
+#define OP_I64_CONST 0x42
+#define OP_F32_CONST 0x43
+#define OP_F64_CONST 0x44
+#define OP_REF_NULL 0xd0
+#define OP_REF_FUNC 0xd2
+
+/* give up after this number of passes */
+#define MAX_PASSES 8
+
+struct opt_insn {
+        /*
+         * the original encoding of the instruction.
+         * NULL for instructions synthesized by the optimizer.
+         */
+        const uint8_t *p;
+        uint32_t len;
+        uint8_t op;
+        union {
+                uint32_t idx; /* local.get/set/tee, br, br_if */
+                uint64_t c;   /* i32.const, i64.const */
+        } u;
+        /* br_table */
+        const uint8_t *targets;
+        uint32_t ntargets;
+        uint32_t deflabel;
+};
+
+VEC(opt_insns, struct opt_insn);
+VEC(opt_bytes, uint8_t);
+
+struct opt_func {
+        struct mem_context *mctx;
+        struct module_optimizer_stats *stats;
+        uint32_t nlocals;
+        struct bitmap live; /* locals which are read by local.get */
+        struct opt_insns in;
+        struct opt_insns out;
+        bool dead; /* skipping unreachable code */
+        uint32_t deadlevel;
+        bool changed;
+};
+
+static void
+decode_insn(struct opt_insn *insn, const uint8_t *p, uint32_t len)
+{
+        const uint8_t *q = p + 1;
+        uint32_t i;
+
+        memset(insn, 0, sizeof(*insn));
+        insn->p = p;
+        insn->len = len;
+        insn->op = *p;
+        switch (insn->op) {
+        case OP_BR:
+        case OP_BR_IF:
+        case OP_LOCAL_GET:
+        case OP_LOCAL_SET:
+        case OP_LOCAL_TEE:
+                insn->u.idx = read_leb_u32_nocheck(&q);
+                break;
+        case OP_I32_CONST:
+                insn->u.c = read_leb_i32_nocheck(&q);
+                break;
+        case OP_I64_CONST:
+                insn->u.c = read_leb_i64_nocheck(&q);
+                break;
+        case OP_BR_TABLE:
+                insn->ntargets = read_leb_u32_nocheck(&q);
+                insn->targets = q;
+                for (i = 0; i < insn->ntargets; i++) {
+                        read_leb_u32_nocheck(&q);
+                }
+                insn->deflabel = read_leb_u32_nocheck(&q);
+                break;
+        default:
+                break;
+        }
+}
+
+static void
+synth(struct opt_insn *insn, uint8_t op, uint64_t imm)
+{
+        memset(insn, 0, sizeof(*insn));
+        insn->op = op;
+        if (op == OP_I32_CONST || op == OP_I64_CONST) {
+                insn->u.c = imm;
+        } else {
+                insn->u.idx = (uint32_t)imm;
+        }
+}
+
+static uint32_t
+count_insns(const uint8_t *p)
+{
+        struct parse_expr_context pctx;
+        uint32_t n = 0;
+
+        parse_expr_context_init(&pctx);
+        while (p != NULL) {
+                parse_expr(&p, &pctx);
+                n++;
+        }
+        parse_expr_context_clear(&pctx);
+        return n;
+}
+
+static int
+decode_expr(struct opt_func *f, const uint8_t *p)
+{
+        struct parse_expr_context pctx;
+        int ret;
+
+        /*
+         * size the vectors beforehand as growing them one by one
+         * is quadratic for large functions.
+         */
+        const uint32_t n = count_insns(p);
+        f->in.lsize = 0;
+        f->out.lsize = 0;
+        ret = VEC_PREALLOC(f->mctx, f->in, n);
+        if (ret != 0) {
+                return ret;
+        }
+        ret = VEC_PREALLOC(f->mctx, f->out, n);
+        if (ret != 0) {
+                return ret;
+        }
+        parse_expr_context_init(&pctx);
+        while (p != NULL) {
+                const uint8_t *start = p;
+                parse_expr(&p, &pctx);
+                /* the last "end" makes parse_expr return NULL */
+                uint32_t len = (p != NULL) ? p - start : 1;
+                decode_insn(VEC_PUSH(f->in), start, len);
+        }
+        parse_expr_context_clear(&pctx);
+        assert(f->in.lsize == n);
+        return 0;
+}
+
+static void
+compute_live(struct opt_func *f)
+{
+        const struct opt_insn *insn;
+
+        if (f->nlocals == 0) {
+                return;
+        }
+        memset(f->live.data, 0,
+               HOWMANY(f->nlocals, 32) * sizeof(*f->live.data));
+        VEC_FOREACH(insn, f->in) {
+                if (insn->op == OP_LOCAL_GET) {
+                        bitmap_set(&f->live, insn->u.idx);
+                }
+        }
+}
+
+static bool
+is_live(const struct opt_func *f, uint32_t idx)
+{
+        assert(idx < f->nlocals);
+        return bitmap_test(&f->live, idx);
+}
+
+/* n-th instruction from the last one emitted so far */
+static struct opt_insn *
+last(struct opt_func *f, uint32_t n)
+{
+        if (f->out.lsize <= n) {
+                return NULL;
+        }
+        return &VEC_ELEM(f->out, f->out.lsize - 1 - n);
+}
+
+static bool
+is_const(const struct opt_insn *insn, uint8_t op)
+{
+        return insn != NULL && insn->op == op;
+}
+
+/* instructions which only push a value without side effects */
+static bool
+is_pure(const struct opt_insn *insn)
+{
+        switch (insn->op) {
+        case OP_LOCAL_GET:
+        case OP_GLOBAL_GET:
+        case OP_I32_CONST:
+        case OP_I64_CONST:
+        case OP_F32_CONST:
+        case OP_F64_CONST:
+        case OP_REF_NULL:
+        case OP_REF_FUNC:
+                return true;
+        default:
+                return false;
+        }
+}
+
+/* instructions after which the rest of the block is unreachable */
+static bool
+is_terminal(uint8_t op)
+{
+        switch (op) {
+        case OP_UNREACHABLE:
+        case OP_THROW:
+        case OP_THROW_REF:
+        case OP_BR:
+        case OP_BR_TABLE:
+        case OP_RETURN:
+        case OP_RETURN_CALL:
+        case OP_RETURN_CALL_INDIRECT:
+                return true;
+        default:
+                return false;
+        }
+}
+
+/*
+ * the operand type of binary operators we can fold.
+ * returns 0 for others.
+ */
+static uint8_t
+binop_type(uint8_t op)
+{
+        if ((op >= 0x46 && op <= 0x4f) || (op >= 0x6a && op <= 0x78)) {
+                return OP_I32_CONST;
+        }
+        if ((op >= 0x51 && op <= 0x5a) || (op >= 0x7c && op <= 0x8a)) {
+                return OP_I64_CONST;
+        }
+        return 0;
+}
+
+static bool
+fold_i32_binop(uint8_t op, uint32_t a, uint32_t b, uint64_t *rp)
+{
+        uint32_t r;
+        switch (op) {
+        case 0x46: /* i32.eq */
+                r = a == b;
+                break;
+        case 0x47: /* i32.ne */
+                r = a != b;
+                break;
+        case 0x48: /* i32.lt_s */
+                r = (int32_t)a < (int32_t)b;
+                break;
+        case 0x49: /* i32.lt_u */
+                r = a < b;
+                break;
+        case 0x4a: /* i32.gt_s */
+                r = (int32_t)a > (int32_t)b;
+                break;
+        case 0x4b: /* i32.gt_u */
+                r = a > b;
+                break;
+        case 0x4c: /* i32.le_s */
+                r = (int32_t)a <= (int32_t)b;
+                break;
+        case 0x4d: /* i32.le_u */
+                r = a <= b;
+                break;
+        case 0x4e: /* i32.ge_s */
+                r = (int32_t)a >= (int32_t)b;
+                break;
+        case 0x4f: /* i32.ge_u */
+                r = a >= b;
+                break;
+        case 0x6a: /* i32.add */
+                r = ADD(32, a, b);
+                break;
+        case 0x6b: /* i32.sub */
+                r = SUB(32, a, b);
+                break;
+        case 0x6c: /* i32.mul */
+                r = MUL(32, a, b);
+                break;
+        case 0x6d: /* i32.div_s */
+                if (b == 0 || (a == (uint32_t)INT32_MIN && b == UINT32_MAX)) {
+                        return false; /* leave the trap to the runtime */
+                }
+                r = (uint32_t)DIV_S(32, a, b);
+                break;
+        case 0x6e: /* i32.div_u */
+                if (b == 0) {
+                        return false;
+                }
+                r = DIV_U(32, a, b);
+                break;
+        case 0x6f: /* i32.rem_s */
+                if (b == 0) {
+                        return false;
+                }
+                r = (b == UINT32_MAX) ? 0 : (uint32_t)REM_S(32, a, b);
+                break;
+        case 0x70: /* i32.rem_u */
+                if (b == 0) {
+                        return false;
+                }
+                r = REM_U(32, a, b);
+                break;
+        case 0x71: /* i32.and */
+                r = AND(32, a, b);
+                break;
+        case 0x72: /* i32.or */
+                r = OR(32, a, b);
+                break;
+        case 0x73: /* i32.xor */
+                r = XOR(32, a, b);
+                break;
+        case 0x74: /* i32.shl */
+                r = SHL(32, a, b);
+                break;
+        case 0x75: /* i32.shr_s */
+                r = (uint32_t)SHR_S(32, a, b);
+                break;
+        case 0x76: /* i32.shr_u */
+                r = SHR_U(32, a, b);
+                break;
+        case 0x77: /* i32.rotl */
+                r = ROTL(32, a, b);
+                break;
+        case 0x78: /* i32.rotr */
+                r = ROTR(32, a, b);
+                break;
+        default:
+                return false;
+        }
+        *rp = r;
+        return true;
+}
+
+static bool
+fold_i64_binop(uint8_t op, uint64_t a, uint64_t b, uint64_t *rp)
+{
+        uint64_t r;
+        switch (op) {
+        case 0x51: /* i64.eq */
+                r = a == b;
+                break;
+        case 0x52: /* i64.ne */
+                r = a != b;
+                break;
+        case 0x53: /* i64.lt_s */
+                r = (int64_t)a < (int64_t)b;
+                break;
+        case 0x54: /* i64.lt_u */
+                r = a < b;
+                break;
+        case 0x55: /* i64.gt_s */
+                r = (int64_t)a > (int64_t)b;
+                break;
+        case 0x56: /* i64.gt_u */
+                r = a > b;
+                break;
+        case 0x57: /* i64.le_s */
+                r = (int64_t)a <= (int64_t)b;
+                break;
+        case 0x58: /* i64.le_u */
+                r = a <= b;
+                break;
+        case 0x59: /* i64.ge_s */
+                r = (int64_t)a >= (int64_t)b;
+                break;
+        case 0x5a: /* i64.ge_u */
+                r = a >= b;
+                break;
+        case 0x7c: /* i64.add */
+                r = ADD(64, a, b);
+                break;
+        case 0x7d: /* i64.sub */
+                r = SUB(64, a, b);
+                break;
+        case 0x7e: /* i64.mul */
+                r = MUL(64, a, b);
+                break;
+        case 0x7f: /* i64.div_s */
+                if (b == 0 || (a == (uint64_t)INT64_MIN && b == UINT64_MAX)) {
+                        return false; /* leave the trap to the runtime */
+                }
+                r = (uint64_t)DIV_S(64, a, b);
+                break;
+        case 0x80: /* i64.div_u */
+                if (b == 0) {
+                        return false;
+                }
+                r = DIV_U(64, a, b);
+                break;
+        case 0x81: /* i64.rem_s */
+                if (b == 0) {
+                        return false;
+                }
+                r = (b == UINT64_MAX) ? 0 : (uint64_t)REM_S(64, a, b);
+                break;
+        case 0x82: /* i64.rem_u */
+                if (b == 0) {
+                        return false;
+                }
+                r = REM_U(64, a, b);
+                break;
+        case 0x83: /* i64.and */
+                r = AND(64, a, b);
+                break;
+        case 0x84: /* i64.or */
+                r = OR(64, a, b);
+                break;
+        case 0x85: /* i64.xor */
+                r = XOR(64, a, b);
+                break;
+        case 0x86: /* i64.shl */
+                r = SHL(64, a, b);
+                break;
+        case 0x87: /* i64.shr_s */
+                r = (uint64_t)SHR_S(64, a, b);
+                break;
+        case 0x88: /* i64.shr_u */
+                r = SHR_U(64, a, b);
+                break;
+        case 0x89: /* i64.rotl */
+                r = ROTL(64, a, b);
+                break;
+        case 0x8a: /* i64.rotr */
+                r = ROTR(64, a, b);
+                break;
+        default:
+                return false;
+        }
+        *rp = r;
+        return true;
+}
+
+/*
+ * "X; CONST; OP" -> "X" where CONST is the right identity of OP.
+ */
+static bool
+is_right_identity(uint8_t op, uint64_t b)
+{
+        switch (op) {
+        case 0x6a: /* i32.add */
+        case 0x6b: /* i32.sub */
+        case 0x72: /* i32.or */
+        case 0x73: /* i32.xor */
+        case 0x74: /* i32.shl */
+        case 0x75: /* i32.shr_s */
+        case 0x76: /* i32.shr_u */
+        case 0x77: /* i32.rotl */
+        case 0x78: /* i32.rotr */
+        case 0x7c: /* i64.add */
+        case 0x7d: /* i64.sub */
+        case 0x84: /* i64.or */
+        case 0x85: /* i64.xor */
+        case 0x86: /* i64.shl */
+        case 0x87: /* i64.shr_s */
+        case 0x88: /* i64.shr_u */
+        case 0x89: /* i64.rotl */
+        case 0x8a: /* i64.rotr */
+                return b == 0;
+        case 0x6c: /* i32.mul */
+        case 0x6d: /* i32.div_s */
+        case 0x6e: /* i32.div_u */
+        case 0x7e: /* i64.mul */
+        case 0x7f: /* i64.div_s */
+        case 0x80: /* i64.div_u */
+                return b == 1;
+        case 0x71: /* i32.and */
+                return (uint32_t)b == UINT32_MAX;
+        case 0x83: /* i64.and */
+                return b == UINT64_MAX;
+        default:
+                return false;
+        }
+}
+
+static bool
+fold_unop(uint8_t op, const struct opt_insn *a, uint8_t *ropp, uint64_t *rp)
+{
+        uint8_t aop;
+        uint8_t rop;
+        uint64_t r;
+        switch (op) {
+        case 0x45: /* i32.eqz */
+                aop = OP_I32_CONST;
+                rop = OP_I32_CONST;
+                r = (uint32_t)a->u.c == 0;
+                break;
+        case 0x50: /* i64.eqz */
+                aop = OP_I64_CONST;
+                rop = OP_I32_CONST;
+                r = a->u.c == 0;
+                break;
+        case 0xa7: /* i32.wrap_i64 */
+                aop = OP_I64_CONST;
+                rop = OP_I32_CONST;
+                r = (uint32_t)a->u.c;
+                break;
+        case 0xac: /* i64.extend_i32_s */
+                aop = OP_I32_CONST;
+                rop = OP_I64_CONST;
+                r = (uint64_t)(int64_t)(int32_t)a->u.c;
+                break;
+        case 0xad: /* i64.extend_i32_u */
+                aop = OP_I32_CONST;
+                rop = OP_I64_CONST;
+                r = (uint32_t)a->u.c;
+                break;
+        case 0xc0: /* i32.extend8_s */
+                aop = OP_I32_CONST;
+                rop = OP_I32_CONST;
+                r = (uint32_t)(int32_t)(int8_t)a->u.c;
+                break;
+        case 0xc1: /* i32.extend16_s */
+                aop = OP_I32_CONST;
+                rop = OP_I32_CONST;
+                r = (uint32_t)(int32_t)(int16_t)a->u.c;
+                break;
+        case 0xc2: /* i64.extend8_s */
+                aop = OP_I64_CONST;
+                rop = OP_I64_CONST;
+                r = (uint64_t)(int64_t)(int8_t)a->u.c;
+                break;
+        case 0xc3: /* i64.extend16_s */
+                aop = OP_I64_CONST;
+                rop = OP_I64_CONST;
+                r = (uint64_t)(int64_t)(int16_t)a->u.c;
+                break;
+        case 0xc4: /* i64.extend32_s */
+                aop = OP_I64_CONST;
+                rop = OP_I64_CONST;
+                r = (uint64_t)(int64_t)(int32_t)a->u.c;
+                break;
+        default:
+                return false;
+        }
+        if (a->op != aop) {
+                return false;
+        }
+        *ropp = rop;
+        *rp = r;
+        return true;
+}
+
+/*
+ * try to fold the instruction with the constants emitted just before it.
+ */
+static bool
+fold(struct opt_func *f, const struct opt_insn *insn)
+{
+        struct opt_insn *l0 = last(f, 0);
+        struct opt_insn *l1 = last(f, 1);
+        const uint8_t op = insn->op;
+        const uint8_t t = binop_type(op);
+        uint64_t r;
+        uint8_t rop;
+
+        if (t != 0) {
+                if (!is_const(l0, t)) {
+                        return false;
+                }
+                if (is_const(l1, t)) {
+                        bool ok;
+                        if (t == OP_I32_CONST) {
+                                ok = fold_i32_binop(op, (uint32_t)l1->u.c,
+                                                    (uint32_t)l0->u.c, &r);
+                        } else {
+                                ok = fold_i64_binop(op, l1->u.c, l0->u.c, &r);
+                        }
+                        if (ok) {
+                                /* comparisons produce i32 */
+                                rop = (op <= 0x5a) ? OP_I32_CONST : t;
+                                VEC_POP_DROP(f->out);
+                                synth(l1, rop, r);
+                                return true;
+                        }
+                }
+                if (is_right_identity(op, l0->u.c)) {
+                        VEC_POP_DROP(f->out);
+                        return true;
+                }
+                return false;
+        }
+        if (l0 != NULL && fold_unop(op, l0, &rop, &r)) {
+                synth(l0, rop, r);
+                return true;
+        }
+        return false;
+}
+
+static uint32_t
+br_table_target(const struct opt_insn *insn, uint32_t idx)
+{
+        const uint8_t *p = insn->targets;
+        uint32_t label = insn->deflabel;
+        uint32_t i;
+        for (i = 0; i < insn->ntargets; i++) {
+                uint32_t l = read_leb_u32_nocheck(&p);
+                if (i == idx) {
+                        label = l;
+                        break;
+                }
+        }
+        return label;
+}
+
+/*
+ * the number of targets after removing trailing ones which are
+ * same as the default.
+ */
+static uint32_t
+br_table_trim(const struct opt_insn *insn)
+{
+        const uint8_t *p = insn->targets;
+        uint32_t n = 0;
+        uint32_t i;
+        for (i = 0; i < insn->ntargets; i++) {
+                uint32_t l = read_leb_u32_nocheck(&p);
+                if (l != insn->deflabel) {
+                        n = i + 1;
+                }
+        }
+        return n;
+}
+
+static int
+push(struct opt_func *f, const struct opt_insn *insn)
+{
+        int ret;
+        ret = VEC_PREALLOC(f->mctx, f->out, 1);
+        if (ret != 0) {
+                return ret;
+        }
+        *VEC_PUSH(f->out) = *insn;
+        if (is_terminal(insn->op)) {
+                f->dead = true;
+                f->deadlevel = 0;
+        }
+        return 0;
+}
+
+static int
+optimize_insn(struct opt_func *f, const struct opt_insn *insn)
+{
+        struct module_optimizer_stats *stats = f->stats;
+        struct opt_insn *l0 = last(f, 0);
+        struct opt_insn new;
+        uint32_t n;
+        int ret;
+
+        if (f->dead) {
+                switch (insn->op) {
+                case OP_BLOCK:
+                case OP_LOOP:
+                case OP_IF:
+                case OP_TRY_TABLE:
+                        f->deadlevel++;
+                        break;
+                case OP_ELSE:
+                        if (f->deadlevel == 0) {
+                                f->dead = false;
+                                return push(f, insn);
+                        }
+                        break;
+                case OP_END:
+                        if (f->deadlevel == 0) {
+                                f->dead = false;
+                                return push(f, insn);
+                        }
+                        f->deadlevel--;
+                        break;
+                default:
+                        break;
+                }
+                stats->nunreachable++;
+                f->changed = true;
+                return 0;
+        }
+        switch (insn->op) {
+        case OP_NOP:
+                stats->nnops++;
+                f->changed = true;
+                return 0;
+        case OP_LOCAL_GET:
+                if (l0 != NULL && l0->op == OP_LOCAL_SET &&
+                    l0->u.idx == insn->u.idx) {
+                        synth(l0, OP_LOCAL_TEE, insn->u.idx);
+                        stats->ntees++;
+                        f->changed = true;
+                        return 0;
+                }
+                break;
+        case OP_LOCAL_SET:
+                if (!is_live(f, insn->u.idx)) {
+                        synth(&new, OP_DROP, 0);
+                        stats->ndeadstores++;
+                        f->changed = true;
+                        return optimize_insn(f, &new);
+                }
+                if (l0 != NULL && l0->op == OP_LOCAL_GET &&
+                    l0->u.idx == insn->u.idx) {
+                        VEC_POP_DROP(f->out);
+                        stats->ndeadstores++;
+                        f->changed = true;
+                        return 0;
+                }
+                break;
+        case OP_LOCAL_TEE:
+                if (!is_live(f, insn->u.idx)) {
+                        stats->ndeadstores++;
+                        f->changed = true;
+                        return 0;
+                }
+                break;
+        case OP_DROP:
+                if (l0 != NULL && is_pure(l0)) {
+                        VEC_POP_DROP(f->out);
+                        stats->ndrops++;
+                        f->changed = true;
+                        return 0;
+                }
+                if (l0 != NULL && l0->op == OP_LOCAL_TEE) {
+                        synth(l0, OP_LOCAL_SET, l0->u.idx);
+                        f->changed = true;
+                        return 0;
+                }
+                break;
+        case OP_BR_IF:
+                if (is_const(l0, OP_I32_CONST)) {
+                        bool taken = (uint32_t)l0->u.c != 0;
+                        VEC_POP_DROP(f->out);
+                        stats->nbranches++;
+                        f->changed = true;
+                        if (!taken) {
+                                return 0;
+                        }
+                        synth(&new, OP_BR, insn->u.idx);
+                        return optimize_insn(f, &new);
+                }
+                break;
+        case OP_BR_TABLE:
+                if (is_const(l0, OP_I32_CONST)) {
+                        n = br_table_target(insn, (uint32_t)l0->u.c);
+                        VEC_POP_DROP(f->out);
+                        stats->nbranches++;
+                        f->changed = true;
+                        synth(&new, OP_BR, n);
+                        return optimize_insn(f, &new);
+                }
+                n = br_table_trim(insn);
+                if (n == 0) {
+                        /* a single destination */
+                        stats->nbranches++;
+                        f->changed = true;
+                        synth(&new, OP_DROP, 0);
+                        ret = optimize_insn(f, &new);
+                        if (ret != 0) {
+                                return ret;
+                        }
+                        synth(&new, OP_BR, insn->deflabel);
+                        return optimize_insn(f, &new);
+                }
+                if (n != insn->ntargets) {
+                        new = *insn;
+                        new.p = NULL;
+                        new.ntargets = n;
+                        stats->nbranches++;
+                        f->changed = true;
+                        return push(f, &new);
+                }
+                break;
+        default:
+                if (fold(f, insn)) {
+                        stats->nconstfolded++;
+                        f->changed = true;
+                        return 0;
+                }
+                break;
+        }
+        return push(f, insn);
+}
+
+static int
+write_bytes(struct opt_func *f, struct opt_bytes *buf, const void *p,
+            size_t sz)
+{
+        int ret;
+        if (sz > UINT32_MAX - buf->lsize) {
+                return EOVERFLOW;
+        }
+        ret = VEC_PREALLOC(f->mctx, (*buf), sz);
+        if (ret != 0) {
+                return ret;
+        }
+        memcpy(&buf->p[buf->lsize], p, sz);
+        buf->lsize += sz;
+        return 0;
+}
+
+static int
+write_leb(struct opt_func *f, struct opt_bytes *buf, uint64_t v, bool sign)
+{
+        uint8_t tmp[10];
+        uint32_t n = 0;
+        while (true) {
+                uint8_t b = v & 0x7f;
+                if (sign) {
+                        v = (uint64_t)((int64_t)v >> 7);
+                        if ((v == 0 && (b & 0x40) == 0) ||
+                            (v == UINT64_MAX && (b & 0x40) != 0)) {
+                                tmp[n++] = b;
+                                break;
+                        }
+                } else {
+                        v >>= 7;
+                        if (v == 0) {
+                                tmp[n++] = b;
+                                break;
+                        }
+                }
+                tmp[n++] = b | 0x80;
+        }
+        return write_bytes(f, buf, tmp, n);
+}
+
+static int
+encode_insn(struct opt_func *f, struct opt_bytes *buf,
+            const struct opt_insn *insn)
+{
+        const uint8_t *p;
+        uint32_t i;
+        int ret;
+
+        if (insn->p != NULL) {
+                return write_bytes(f, buf, insn->p, insn->len);
+        }
+        ret = write_bytes(f, buf, &insn->op, 1);
+        if (ret != 0) {
+                return ret;
+        }
+        switch (insn->op) {
+        case OP_DROP:
+                break;
+        case OP_BR:
+        case OP_LOCAL_SET:
+        case OP_LOCAL_TEE:
+                ret = write_leb(f, buf, insn->u.idx, false);
+                break;
+        case OP_I32_CONST:
+                ret = write_leb(f, buf, (uint64_t)(int32_t)insn->u.c, true);
+                break;
+        case OP_I64_CONST:
+                ret = write_leb(f, buf, insn->u.c, true);
+                break;
+        case OP_BR_TABLE:
+                ret = write_leb(f, buf, insn->ntargets, false);
+                if (ret != 0) {
+                        break;
+                }
+                p = insn->targets;
+                for (i = 0; i < insn->ntargets; i++) {
+                        read_leb_u32_nocheck(&p);
+                }
+                ret = write_bytes(f, buf, insn->targets, p - insn->targets);
+                if (ret != 0) {
+                        break;
+                }
+                ret = write_leb(f, buf, insn->deflabel, false);
+                break;
+        default:
+                assert(false);
+        }
+        return ret;
+}
+
+static int
+optimize_func(struct module_optimizer *o, uint32_t i)
+{
+        struct module *m = o->module;
+        struct func *func = &m->funcs[i];
+        struct optimized_func *of = &VEC_ELEM(o->funcs, i);
+        const struct functype *ft = module_functype(m, m->nimportedfuncs + i);
+        const uint8_t *start = func->e.start;
+        const uint8_t *end = expr_end(&func->e);
+        struct opt_func f;
+        struct opt_bytes buf;
+        struct opt_bytes prev;
+        const struct opt_insn *insn;
+        const uint8_t *p;
+        uint32_t pass;
+        int ret;
+
+        memset(&f, 0, sizeof(f));
+        f.mctx = o->mctx;
+        f.stats = &o->stats;
+        if (ft->parameter.ntypes > UINT32_MAX - func->localtype.nlocals) {
+                return EOVERFLOW;
+        }
+        f.nlocals = ft->parameter.ntypes + func->localtype.nlocals;
+        VEC_INIT(buf);
+        VEC_INIT(prev);
+        ret = bitmap_alloc(f.mctx, &f.live, f.nlocals);
+        if (ret != 0) {
+                return ret;
+        }
+        p = start;
+        for (pass = 0; pass < MAX_PASSES; pass++) {
+                ret = decode_expr(&f, p);
+                if (ret != 0) {
+                        goto fail;
+                }
+                compute_live(&f);
+                f.dead = false;
+                f.changed = false;
+                VEC_FOREACH(insn, f.in) {
+                        ret = optimize_insn(&f, insn);
+                        if (ret != 0) {
+                                goto fail;
+                        }
+                }
+                assert(!f.dead);
+                if (!f.changed) {
+                        break;
+                }
+                /* the new code references the previous one */
+                VEC_FREE(f.mctx, prev);
+                prev = buf;
+                VEC_INIT(buf);
+                ret = VEC_PREALLOC(f.mctx, buf, end - start);
+                if (ret != 0) {
+                        goto fail;
+                }
+                VEC_FOREACH(insn, f.out) {
+                        ret = encode_insn(&f, &buf, insn);
+                        if (ret != 0) {
+                                goto fail;
+                        }
+                }
+                p = buf.p;
+        }
+        o->stats.orig_code_size += end - start;
+        if (p == start) {
+                o->stats.new_code_size += end - start;
+                ret = 0;
+                goto fail;
+        }
+        of->code = mem_alloc(o->mctx, buf.lsize);
+        if (of->code == NULL) {
+                ret = ENOMEM;
+                goto fail;
+        }
+        memcpy(of->code, buf.p, buf.lsize);
+        of->size = buf.lsize;
+        of->orig_start = func->e.start;
+        func->e.start = of->code;
+#if defined(TOYWASM_MAINTAIN_EXPR_END)
+        of->orig_end = func->e.end;
+        func->e.end = of->code + of->size;
+#endif
+        o->stats.new_code_size += of->size;
+        ret = 0;
+fail:
+        VEC_FREE(f.mctx, prev);
+        VEC_FREE(f.mctx, buf);
+        VEC_FREE(f.mctx, f.in);
+        VEC_FREE(f.mctx, f.out);
+        bitmap_free(f.mctx, &f.live, f.nlocals);
+        return ret;
+}
+
+void
+module_optimizer_init(struct module_optimizer *o, struct mem_context *mctx)
+{
+        memset(o, 0, sizeof(*o));
+        o->mctx = mctx;
+}
+
+int
+module_optimize(struct module_optimizer *o, struct module *m)
+{
+        uint32_t i;
+        int ret;
+
+        assert(o->module == NULL);
+        ret = VEC_RESIZE(o->mctx, o->funcs, m->nfuncs);
+        if (ret != 0) {
+                return ret;
+        }
+        o->module = m;
+        for (i = 0; i < m->nfuncs; i++) {
+                ret = optimize_func(o, i);
+                if (ret != 0) {
+                        return ret;
+                }
+        }
+        return 0;
+}
+
+void
+module_optimizer_clear(struct module_optimizer *o)
+{
+        struct module *m = o->module;
+        struct optimized_func *of;
+        uint32_t i;
+
+        VEC_FOREACH_IDX(i, of, o->funcs) {
+                if (of->code == NULL) {
+                        continue;
+                }
+                struct func *func = &m->funcs[i];
+                func->e.start = of->orig_start;
+#if defined(TOYWASM_MAINTAIN_EXPR_END)
+                func->e.end = of->orig_end;
+#endif
+                mem_free(o->mctx, of->code, of->size);
+        }
+        VEC_FREE(o->mctx, o->funcs);
+}
@@ -0,0 +1,86 @@
+#if !defined(_TOYWASM_MODULE_OPTIMIZER_H)
+#define _TOYWASM_MODULE_OPTIMIZER_H
+
+#include <stdint.h>
+
+#include "toywasm_config.h"
+
+#include "platform.h"
+#include "vec.h"
+
+/*
+ * a simple peephole optimizer for function bodies, which is intended
+ * to be used before module_write. (eg. wasm2wasm -O)
+ *
+ * because toywasm interprets the wasm bytecode in place, every
+ * redundant instruction costs real time. this removes some of them:
+ *
+ * - constant folding of integer operations
+ *   "i32.const 1; i32.const 2; i32.add" -> "i32.const 3"
+ *   "X; i32.const 0; i32.add" -> "X"
+ * - dead local.set elimination
+ *   a local.set to a local which is never read becomes a drop.
+ *   a drop of a side-effect free value is removed.
+ * - "local.set X; local.get X" -> "local.tee X"
+ * - removal of unreachable code after br, br_table, return, etc.
+ * - br_if/br_table with a constant operand becomes br.
+ * - br_table canonicalization
+ *   a br_table with a single destination becomes "drop; br".
+ *   trailing targets which are same as the default are removed.
+ *
+ * it works only on straight-line sequences of instructions.
+ * (no control-flow analysis) the transformations are repeated until
+ * nothing changes.
+ *
+ * module_optimize replaces the function bodies of the module in place.
+ * after that, the module is only good for module_write and
+ * module_optimizer_clear, which restores the original bodies.
+ * in particular, the module should not be instantiated because
+ * the information generated by the validation (eg. jump tables)
+ * doesn't match the new bodies.
+ *
+ * it's assumed that the module has already been validated.
+ * (typically by module_create.)
+ */
+
+struct mem_context;
+struct module;
+
+struct module_optimizer_stats {
+        uint32_t nconstfolded;
+        uint32_t ndeadstores;
+        uint32_t ntees;
+        uint32_t ndrops; /* drop of side-effect free values */
+        uint32_t nnops;
+        uint32_t nunreachable; /* instructions removed as unreachable */
+        uint32_t nbranches;    /* br_if/br_table simplified */
+        uint64_t orig_code_size;
+        uint64_t new_code_size;
+};
+
+struct optimized_func {
+        const uint8_t *orig_start;
+#if defined(TOYWASM_MAINTAIN_EXPR_END)
+        const uint8_t *orig_end;
+#endif
+        uint8_t *code; /* NULL if not changed */
+        uint32_t size;
+};
+
+struct module_optimizer {
+        struct mem_context *mctx;
+        struct module *module;
+        VEC(, struct optimized_func) funcs;
+        struct module_optimizer_stats stats;
+};
+
+__BEGIN_EXTERN_C
+
+void module_optimizer_init(struct module_optimizer *o,
+                           struct mem_context *mctx);
+int module_optimize(struct module_optimizer *o, struct module *m);
+void module_optimizer_clear(struct module_optimizer *o);
+
+__END_EXTERN_C
+
+#endif /* !defined(_TOYWASM_MODULE_OPTIMIZER_H) */
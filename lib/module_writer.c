@@ -4,6 +4,8 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "bitmap.h"
+#include "cell.h"
 #include "endian.h"
 #include "module_writer.h"
 #include "type.h"
@@ -14,6 +16,9 @@ struct writer {
         FILE *fp;
         uint32_t size;
         int error;
+
+        /* non-NULL for module_write_snapshot */
+        const struct instance *snapshot;
 };
 
 static void
@@ -35,10 +40,11 @@ count(struct writer *w, const void *p, size_t sz)
 }
 
 static void
-counter_init(struct writer *w)
+counter_init(struct writer *w, const struct writer *parent)
 {
         memset(w, 0, sizeof(*w));
         w->write = count;
+        w->snapshot = parent->snapshot;
 }
 
 static void
@@ -94,7 +100,24 @@ write_leb_u32(struct writer *w, uint32_t u)
                 writer_write(w, &u32, sizeof(u32));                           \
         } while (0)
 
+static void
+write_leb_s64(struct writer *w, int64_t s)
+{
+        while (true) {
+                uint8_t u8 = s & 0x7f;
+                s >>= 7;
+                if ((s == 0 && (u8 & 0x40) == 0) ||
+                    (s == -1 && (u8 & 0x40) != 0)) {
+                        writer_write(w, &u8, sizeof(u8));
+                        break;
+                }
+                u8 |= 0x80;
+                writer_write(w, &u8, sizeof(u8));
+        }
+}
+
 #define WRITE_LEB_U32(v) write_leb_u32(w, (v))
+#define WRITE_LEB_S64(v) write_leb_s64(w, (v))
 
 #define WRITE_BYTES(p, sz) writer_write(w, p, sz)
 
@@ -280,7 +303,7 @@ write_element(struct writer *w, const struct element *e)
         /* suppress warnings */
         type = 0;
 #endif
-        if (e->funcs != NULL) {
+        if (element_has_funcidxes(e)) {
                 switch (e->mode) {
                 case ELEM_MODE_ACTIVE: /* 0, 2 */
                         if (e->table != 0 || e->type != TYPE_funcref) {
@@ -366,8 +389,10 @@ write_element(struct writer *w, const struct element *e)
         case 2:
         case 3:
                 WRITE_LEB_U32(e->init_size);
+                struct element_funcidx_iter it;
+                element_funcidx_iter_init(&it, e, 0);
                 for (i = 0; i < e->init_size; i++) {
-                        WRITE_LEB_U32(e->funcs[i]);
+                        WRITE_LEB_U32(element_funcidx_iter_next(&it));
                 }
                 break;
         case 4:
@@ -378,6 +403,7 @@ write_element(struct writer *w, const struct element *e)
                 for (i = 0; i < e->init_size; i++) {
                         write_expr(w, &e->init_exprs[i]);
                 }
+                break;
         default:
                 assert(0);
         }
@@ -406,7 +432,7 @@ static void
 write_func(struct writer *w, const struct func *func)
 {
         struct writer counter;
-        counter_init(&counter);
+        counter_init(&counter, w);
         write_code(&counter, func);
         if (counter.error != 0) {
                 w->error = counter.error;
@@ -434,6 +460,396 @@ write_data(struct writer *w, const struct data *data)
         WRITE_BYTES(data->init, data->init_size);
 }
 
+/*
+ * snapshot: see module_write_snapshot
+ */
+
+/*
+ * the granularity to skip zeros in memory.
+ * a range of non-zero chunks becomes a data segment.
+ */
+#define SNAPSHOT_CHUNK_SIZE 4096
+
+static bool
+is_zero(const uint8_t *p, size_t sz)
+{
+        size_t i;
+        for (i = 0; i < sz; i++) {
+                if (p[i] != 0) {
+                        return false;
+                }
+        }
+        return true;
+}
+
+/*
+ * find the next non-zero range in [*offp, sz) of the memory.
+ * on success, *offp is updated for the next call.
+ */
+static bool
+snapshot_next_range(const struct meminst *mi, size_t *offp, size_t *startp,
+                    size_t *endp)
+{
+        const uint8_t *data = mi->data;
+        const size_t sz = mi->allocated;
+        size_t off = *offp;
+        size_t start;
+        size_t end;
+        while (off < sz) {
+                size_t csz = sz - off;
+                if (csz > SNAPSHOT_CHUNK_SIZE) {
+                        csz = SNAPSHOT_CHUNK_SIZE;
+                }
+                if (!is_zero(&data[off], csz)) {
+                        break;
+                }
+                off += csz;
+        }
+        if (off >= sz) {
+                *offp = off;
+                return false;
+        }
+        start = off;
+        while (off < sz) {
+                size_t csz = sz - off;
+                if (csz > SNAPSHOT_CHUNK_SIZE) {
+                        csz = SNAPSHOT_CHUNK_SIZE;
+                }
+                if (is_zero(&data[off], csz)) {
+                        break;
+                }
+                off += csz;
+        }
+        end = off;
+        *offp = off;
+        /* trim zeros at the both ends */
+        while (data[start] == 0) {
+                start++;
+        }
+        while (data[end - 1] == 0) {
+                end--;
+        }
+        *startp = start;
+        *endp = end;
+        return true;
+}
+
+static uint32_t
+snapshot_ndatas(const struct instance *inst)
+{
+        const struct module *m = inst->module;
+        uint32_t n = 0;
+        uint32_t i;
+        for (i = 0; i < m->nmems; i++) {
+                const struct meminst *mi = VEC_ELEM(inst->mems, i);
+                size_t off = 0;
+                size_t start;
+                size_t end;
+                while (snapshot_next_range(mi, &off, &start, &end)) {
+                        n++;
+                }
+        }
+        return n;
+}
+
+static void
+write_snapshot_datas(struct writer *w, const struct instance *inst)
+{
+        const struct module *m = inst->module;
+        uint32_t i;
+        for (i = 0; i < m->nmems; i++) {
+                const struct meminst *mi = VEC_ELEM(inst->mems, i);
+                size_t off = 0;
+                size_t start;
+                size_t end;
+                while (snapshot_next_range(mi, &off, &start, &end)) {
+                        if (i == 0) {
+                                WRITE_LEB_U32(0x00);
+                        } else {
+                                WRITE_LEB_U32(0x02);
+                                WRITE_LEB_U32(i);
+                        }
+                        if ((mi->type->flags & MEMTYPE_FLAG_64) != 0) {
+                                WRITE_U8(0x42); /* i64.const */
+                                WRITE_LEB_S64((int64_t)start);
+                        } else {
+                                WRITE_U8(0x41); /* i32.const */
+                                WRITE_LEB_S64((int32_t)(uint32_t)start);
+                        }
+                        WRITE_U8(0x0b); /* end */
+                        WRITE_LEB_U32(end - start);
+                        WRITE_BYTES(&mi->data[start], end - start);
+                }
+        }
+}
+
+/*
+ * a funcref is written as ref.func. it's only possible for
+ * a function in the instance itself.
+ */
+static int
+snapshot_funcidx(const struct instance *inst, const struct funcinst *fi,
+                 uint32_t *funcidxp)
+{
+        uint32_t i;
+        if (!fi->is_host && fi->u.wasm.instance == inst) {
+                i = fi->u.wasm.funcidx;
+                assert(VEC_ELEM(inst->funcs, i) == fi);
+                *funcidxp = i;
+                return 0;
+        }
+        /* imported functions */
+        for (i = 0; i < inst->funcs.lsize; i++) {
+                if (VEC_ELEM(inst->funcs, i) == fi) {
+                        *funcidxp = i;
+                        return 0;
+                }
+        }
+        return ENOTSUP;
+}
+
+static const struct funcinst *
+snapshot_table_func(const struct tableinst *t, uint32_t i)
+{
+        struct val val;
+        uint32_t csz = valtype_cellsize(t->type->et);
+        val_from_cells(&val, &t->cells[i * csz], csz);
+        return val.u.funcref.func;
+}
+
+/*
+ * find the next range of non-null entries in [*offp, size) of
+ * a funcref table.
+ * on success, *offp is updated for the next call.
+ */
+static bool
+snapshot_next_table_range(const struct tableinst *t, uint32_t *offp,
+                          uint32_t *startp, uint32_t *endp)
+{
+        uint32_t off = *offp;
+        assert(t->type->et == TYPE_funcref);
+        while (off < t->size && snapshot_table_func(t, off) == NULL) {
+                off++;
+        }
+        if (off >= t->size) {
+                *offp = off;
+                return false;
+        }
+        *startp = off;
+        while (off < t->size && snapshot_table_func(t, off) != NULL) {
+                off++;
+        }
+        *endp = off;
+        *offp = off;
+        return true;
+}
+
+static uint32_t
+snapshot_nelems(const struct instance *inst)
+{
+        const struct module *m = inst->module;
+        uint32_t n = 0;
+        uint32_t i;
+        for (i = 0; i < m->ntables; i++) {
+                const struct tableinst *t = VEC_ELEM(inst->tables, i);
+                if (t->type->et != TYPE_funcref) {
+                        continue;
+                }
+                uint32_t off = 0;
+                uint32_t start;
+                uint32_t end;
+                while (snapshot_next_table_range(t, &off, &start, &end)) {
+                        n++;
+                }
+        }
+        return n;
+}
+
+static void
+write_snapshot_elems(struct writer *w, const struct instance *inst)
+{
+        const struct module *m = inst->module;
+        uint32_t i;
+        for (i = 0; i < m->ntables; i++) {
+                const struct tableinst *t = VEC_ELEM(inst->tables, i);
+                if (t->type->et != TYPE_funcref) {
+                        continue;
+                }
+                uint32_t off = 0;
+                uint32_t start;
+                uint32_t end;
+                while (snapshot_next_table_range(t, &off, &start, &end)) {
+                        if (i == 0) {
+                                WRITE_LEB_U32(0x00);
+                        } else {
+                                WRITE_LEB_U32(0x02);
+                                WRITE_LEB_U32(i);
+                        }
+                        WRITE_U8(0x41); /* i32.const */
+                        WRITE_LEB_S64((int32_t)start);
+                        WRITE_U8(0x0b); /* end */
+                        if (i != 0) {
+                                WRITE_U8(0x00); /* elemkind funcref */
+                        }
+                        WRITE_LEB_U32(end - start);
+                        uint32_t j;
+                        for (j = start; j < end; j++) {
+                                uint32_t funcidx;
+                                int ret = snapshot_funcidx(
+                                        inst, snapshot_table_func(t, j),
+                                        &funcidx);
+                                assert(ret == 0);
+                                WRITE_LEB_U32(funcidx);
+                        }
+                }
+        }
+}
+
+static int
+snapshot_check_table(const struct instance *inst, const struct tableinst *t)
+{
+        uint32_t i;
+        if (t->type->et == TYPE_funcref) {
+                for (i = 0; i < t->size; i++) {
+                        const struct funcinst *fi = snapshot_table_func(t, i);
+                        uint32_t funcidx;
+                        if (fi != NULL &&
+                            snapshot_funcidx(inst, fi, &funcidx) != 0) {
+                                return ENOTSUP;
+                        }
+                }
+                return 0;
+        }
+        /* other references can't be written. only nulls are ok. */
+        if (t->type->et != TYPE_externref) {
+                return t->size == 0 ? 0 : ENOTSUP;
+        }
+        uint32_t csz = valtype_cellsize(t->type->et);
+        for (i = 0; i < t->size; i++) {
+                struct val val;
+                val_from_cells(&val, &t->cells[i * csz], csz);
+                if (val.u.externref != NULL) {
+                        return ENOTSUP;
+                }
+        }
+        return 0;
+}
+
+static int
+snapshot_check_global(const struct instance *inst,
+                      const struct globalinst *ginst)
+{
+        const struct val *val = &ginst->val;
+        uint32_t funcidx;
+        switch (ginst->type->t) {
+        case TYPE_funcref:
+                if (val->u.funcref.func == NULL) {
+                        return 0;
+                }
+                return snapshot_funcidx(inst, val->u.funcref.func, &funcidx);
+        case TYPE_externref:
+                if (val->u.externref == NULL) {
+                        return 0;
+                }
+                return ENOTSUP;
+#if defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING)
+        case TYPE_exnref:
+                return ENOTSUP;
+#endif
+        default:
+                return 0;
+        }
+}
+
+static void
+write_snapshot_global_init(struct writer *w, const struct instance *inst,
+                           const struct globalinst *ginst)
+{
+        const struct val *val = &ginst->val;
+        const enum valtype t = ginst->type->t;
+        uint32_t funcidx;
+        switch (t) {
+        case TYPE_i32:
+                WRITE_U8(0x41);
+                WRITE_LEB_S64((int32_t)val->u.i32);
+                break;
+        case TYPE_i64:
+                WRITE_U8(0x42);
+                WRITE_LEB_S64((int64_t)val->u.i64);
+                break;
+        case TYPE_f32:
+                WRITE_U8(0x43);
+                WRITE_U32(val->u.i32);
+                break;
+        case TYPE_f64: {
+                uint64_t u64 = host_to_le64(val->u.i64);
+                WRITE_U8(0x44);
+                WRITE_BYTES(&u64, sizeof(u64));
+                break;
+        }
+#if defined(TOYWASM_ENABLE_WASM_SIMD)
+        case TYPE_v128:
+                WRITE_U8(0xfd);
+                WRITE_LEB_U32(12); /* v128.const */
+                /* Note: v128 is in little endian */
+                WRITE_BYTES(&val->u.v128, sizeof(val->u.v128));
+                break;
+#endif
+        case TYPE_funcref:
+                if (val->u.funcref.func == NULL) {
+                        WRITE_U8(0xd0); /* ref.null */
+                        WRITE_U8(t);
+                } else {
+                        int ret = snapshot_funcidx(inst, val->u.funcref.func,
+                                                   &funcidx);
+                        assert(ret == 0);
+                        WRITE_U8(0xd2); /* ref.func */
+                        WRITE_LEB_U32(funcidx);
+                }
+                break;
+        case TYPE_externref:
+                assert(val->u.externref == NULL);
+                WRITE_U8(0xd0); /* ref.null */
+                WRITE_U8(t);
+                break;
+        default:
+                assert(0);
+        }
+        WRITE_U8(0x0b); /* end */
+}
+
+/*
+ * check if the instance can be represented as a module.
+ */
+static int
+snapshot_check(const struct instance *inst)
+{
+        const struct module *m = inst->module;
+        uint32_t i;
+        int ret;
+        /* we can't write the contents of imported memories and tables */
+        if (m->nimportedmems > 0 || m->nimportedtables > 0) {
+                return ENOTSUP;
+        }
+        for (i = 0; i < m->ntables; i++) {
+                ret = snapshot_check_table(inst, VEC_ELEM(inst->tables, i));
+                if (ret != 0) {
+                        return ret;
+                }
+        }
+        for (i = 0; i < m->nglobals; i++) {
+                const struct global *g = &m->globals[i];
+                if (g->type.mut != GLOBAL_VAR) {
+                        continue;
+                }
+                ret = snapshot_check_global(inst, &inst->own_globals[i]);
+                if (ret != 0) {
+                        return ret;
+                }
+        }
+        return 0;
+}
+
 static void
 write_type_section(struct writer *w, const struct module *m)
 {
@@ -482,6 +898,15 @@ write_table_section(struct writer *w, const struct module *m)
         WRITE_LEB_U32(m->ntables);
         uint32_t i;
         for (i = 0; i < m->ntables; i++) {
+                if (w->snapshot != NULL) {
+                        /* the table might have been grown */
+                        const struct tableinst *t =
+                                VEC_ELEM(w->snapshot->tables, i);
+                        struct tabletype tt = m->tables[i];
+                        tt.lim.min = t->size;
+                        write_tabletype(w, &tt);
+                        continue;
+                }
                 write_tabletype(w, &m->tables[i]);
         }
 }
@@ -495,6 +920,15 @@ write_memory_section(struct writer *w, const struct module *m)
         WRITE_LEB_U32(m->nmems);
         uint32_t i;
         for (i = 0; i < m->nmems; i++) {
+                if (w->snapshot != NULL) {
+                        /* the memory might have been grown */
+                        const struct meminst *mi =
+                                VEC_ELEM(w->snapshot->mems, i);
+                        struct memtype mt = m->mems[i];
+                        mt.lim.min = mi->size_in_pages;
+                        write_memtype(w, &mt);
+                        continue;
+                }
                 write_memtype(w, &m->mems[i]);
         }
 }
@@ -523,7 +957,14 @@ write_global_section(struct writer *w, const struct module *m)
         WRITE_LEB_U32(m->nglobals);
         uint32_t i;
         for (i = 0; i < m->nglobals; i++) {
-                write_global(w, &m->globals[i]);
+                const struct global *g = &m->globals[i];
+                if (w->snapshot != NULL && g->type.mut == GLOBAL_VAR) {
+                        write_globaltype(w, &g->type);
+                        write_snapshot_global_init(
+                                w, w->snapshot, &w->snapshot->own_globals[i]);
+                        continue;
+                }
+                write_global(w, g);
         }
 }
 
@@ -543,7 +984,8 @@ write_export_section(struct writer *w, const struct module *m)
 static void
 write_start_section(struct writer *w, const struct module *m)
 {
-        if (!m->has_start) {
+        /* the start function has been executed for a snapshot */
+        if (!m->has_start || w->snapshot != NULL) {
                 return;
         }
         WRITE_LEB_U32(m->start);
@@ -552,23 +994,52 @@ write_start_section(struct writer *w, const struct module *m)
 static void
 write_element_section(struct writer *w, const struct module *m)
 {
-        if (m->nelems == 0) {
+        const struct instance *inst = w->snapshot;
+        uint32_t nelems = m->nelems;
+        if (inst != NULL) {
+                nelems += snapshot_nelems(inst);
+        }
+        if (nelems == 0) {
                 return;
         }
-        WRITE_LEB_U32(m->nelems);
+        WRITE_LEB_U32(nelems);
         uint32_t i;
         for (i = 0; i < m->nelems; i++) {
-                write_element(w, &m->elems[i]);
+                const struct element *e = &m->elems[i];
+                /*
+                 * for a snapshot, the contents of active segments are
+                 * already in the tables. the same for passive segments
+                 * which have been used and dropped.
+                 * replace them with declarative segments, which behave
+                 * same as dropped segments, so that elemidxes in the
+                 * code are kept intact. unlike empty segments, it keeps
+                 * the functions declared for ref.func as well.
+                 */
+                if (inst != NULL && (e->mode == ELEM_MODE_ACTIVE ||
+                                     bitmap_test(&inst->elem_dropped, i))) {
+                        struct element decl = *e;
+                        decl.mode = ELEM_MODE_DECLARATIVE;
+                        write_element(w, &decl);
+                        continue;
+                }
+                write_element(w, e);
+        }
+        if (inst != NULL) {
+                write_snapshot_elems(w, inst);
         }
 }
 
 static void
 write_datacount_section(struct writer *w, const struct module *m)
 {
-        if (m->ndatas == 0) {
+        uint32_t ndatas = m->ndatas;
+        if (w->snapshot != NULL) {
+                ndatas += snapshot_ndatas(w->snapshot);
+        }
+        if (ndatas == 0) {
                 return;
         }
-        WRITE_LEB_U32(m->ndatas);
+        WRITE_LEB_U32(ndatas);
 }
 
 static void
@@ -587,13 +1058,36 @@ write_code_section(struct writer *w, const struct module *m)
 static void
 write_data_section(struct writer *w, const struct module *m)
 {
-        if (m->ndatas == 0) {
+        const struct instance *inst = w->snapshot;
+        uint32_t ndatas = m->ndatas;
+        if (inst != NULL) {
+                ndatas += snapshot_ndatas(inst);
+        }
+        if (ndatas == 0) {
                 return;
         }
-        WRITE_LEB_U32(m->ndatas);
+        WRITE_LEB_U32(ndatas);
         uint32_t i;
         for (i = 0; i < m->ndatas; i++) {
-                write_data(w, &m->datas[i]);
+                const struct data *d = &m->datas[i];
+                /*
+                 * for a snapshot, the contents of active segments are
+                 * already in the memory. the same for passive segments
+                 * which have been used and dropped.
+                 * replace them with empty passive segments, which
+                 * behave same as dropped segments, so that dataidxes
+                 * in the code are kept intact.
+                 */
+                if (inst != NULL && (d->mode == DATA_MODE_ACTIVE ||
+                                     bitmap_test(&inst->data_dropped, i))) {
+                        WRITE_LEB_U32(0x01);
+                        WRITE_LEB_U32(0);
+                        continue;
+                }
+                write_data(w, d);
+        }
+        if (inst != NULL) {
+                write_snapshot_datas(w, inst);
         }
 }
 
@@ -603,7 +1097,7 @@ write_section(struct writer *w, uint8_t id,
               const struct module *m)
 {
         struct writer counter;
-        counter_init(&counter);
+        counter_init(&counter, w);
         fn(&counter, m);
         if (counter.error != 0) {
                 w->error = counter.error;
@@ -647,8 +1141,9 @@ module_write1(struct writer *w, const struct module *m)
         }
 }
 
-int
-module_write(const char *filename, const struct module *m)
+static int
+module_write_file(const char *filename, const struct module *m,
+                  const struct instance *snapshot)
 {
         FILE *fp = fopen(filename, "w");
         int ret;
@@ -659,6 +1154,7 @@ module_write(const char *filename, const struct module *m)
         struct writer writer;
         struct writer *w = &writer;
         writer_stdio_init(w, fp);
+        w->snapshot = snapshot;
         module_write1(w, m);
         ret = fclose(fp);
         if (ret != 0) {
@@ -670,3 +1166,19 @@ module_write(const char *filename, const struct module *m)
         }
         return 0;
 }
+
+int
+module_write(const char *filename, const struct module *m)
+{
+        return module_write_file(filename, m, NULL);
+}
+
+int
+module_write_snapshot(const char *filename, const struct instance *inst)
+{
+        int ret = snapshot_check(inst);
+        if (ret != 0) {
+                return ret;
+        }
+        return module_write_file(filename, inst->module, inst);
+}
@@ -2,7 +2,25 @@
 
 __BEGIN_EXTERN_C
 
+struct instance;
 struct module;
 int module_write(const char *filename, const struct module *m);
 
+/*
+ * module_write_snapshot: write the module of the instance, with its
+ * current state as the initial state. (like Wizer)
+ *
+ * - the contents of memories become active data segments, skipping
+ *   zero-filled chunks. the memory sizes are updated.
+ * - mutable globals get constant initializers.
+ * - the start section is removed.
+ * - the original data segments are replaced with empty passive ones.
+ *
+ * ENOTSUP if the state can't be represented. (eg. imported memories,
+ * grown tables, or a non-null externref in a global)
+ * the contents of tables are not written. a module which modifies
+ * its tables during the initialization is not supported.
+ */
+int module_write_snapshot(const char *filename, const struct instance *inst);
+
 __END_EXTERN_C
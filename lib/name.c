@@ -317,3 +317,9 @@ nametable_lookup_module(struct nametable *table, const struct module *m,
         set_name_cstr(name, unknown_name);
 #endif
 }
+
+bool
+nametable_is_unknown(const struct name *name)
+{
+        return name->data == unknown_name;
+}
@@ -29,4 +29,10 @@ void nametable_lookup_func(struct nametable *table, const struct module *m,
 void nametable_lookup_module(struct nametable *table, const struct module *m,
                              struct name *name);
 
+/*
+ * returns true if the name was filled by the above functions
+ * because the name was not available.
+ */
+bool nametable_is_unknown(const struct name *name);
+
 __END_EXTERN_C
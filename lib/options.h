@@ -15,6 +15,12 @@ struct load_options {
 #if defined(TOYWASM_USE_LOCALTYPE_CELLIDX)
         bool generate_localtype_cellidx;
 #endif
+        /*
+         * allocate the module-lifetime structures from an arena.
+         * it makes loading and unloading cheaper for large modules
+         * at the expense of some wasted memory.
+         */
+        bool use_arena;
 };
 
 struct exec_options {
@@ -0,0 +1,639 @@
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "exec_context.h"
+#include "hash_index.h"
+#include "instance.h"
+#include "lock.h"
+#include "mem.h"
+#include "name.h"
+#include "profiler.h"
+#include "type.h"
+#include "util.h"
+#include "vec.h"
+#include "xlog.h"
+
+int
+profiler_create(struct mem_context *mctx, struct profiler **pp)
+{
+        struct profiler *p = mem_zalloc(mctx, sizeof(*p));
+        if (p == NULL) {
+                return ENOMEM;
+        }
+        toywasm_mutex_init(&p->lock);
+        p->interval_ms = PROFILER_DEFAULT_INTERVAL_MS;
+        VEC_INIT(p->funcs);
+        VEC_INIT(p->stacks);
+        VEC_INIT(p->frames);
+        hash_index_init(&p->funcs_index);
+        hash_index_init(&p->stacks_index);
+        p->mctx = mctx;
+        *pp = p;
+        return 0;
+}
+
+static void
+name_free(struct profiler *p, struct name *name)
+{
+        if (name->nbytes > 0 && !nametable_is_unknown(name)) {
+                mem_free(p->mctx, (void *)name->data, name->nbytes);
+        }
+}
+
+void
+profiler_destroy(struct profiler *p)
+{
+        struct mem_context *mctx = p->mctx;
+        struct profiler_func *f;
+        VEC_FOREACH(f, p->funcs) {
+                if (f->module == NULL) {
+                        name_free(p, &f->fname);
+                        name_free(p, &f->mname);
+                }
+        }
+        VEC_FREE(mctx, p->funcs);
+        VEC_FREE(mctx, p->stacks);
+        VEC_FREE(mctx, p->frames);
+        hash_index_clear(mctx, &p->funcs_index);
+        hash_index_clear(mctx, &p->stacks_index);
+        toywasm_mutex_destroy(&p->lock);
+        mem_free(mctx, p, sizeof(*p));
+}
+
+/*
+ * hash indexes for funcs and stacks.
+ */
+
+static uint32_t
+hash_u32(uint32_t h, uint32_t v)
+{
+        /* FNV-1a, a word at a time */
+        return (h ^ v) * UINT32_C(0x01000193);
+}
+
+static uint32_t
+func_hash(const struct module *m, uint32_t funcidx)
+{
+        uintptr_t v = (uintptr_t)m;
+        uint32_t h = UINT32_C(0x811c9dc5);
+        h = hash_u32(h, (uint32_t)v);
+        h = hash_u32(h, (uint32_t)((uint64_t)v >> 32));
+        return hash_u32(h, funcidx);
+}
+
+static uint32_t
+stack_hash(const uint32_t *frames, uint32_t nframes)
+{
+        uint32_t h = UINT32_C(0x811c9dc5);
+        uint32_t i;
+        for (i = 0; i < nframes; i++) {
+                h = hash_u32(h, frames[i]);
+        }
+        return h;
+}
+
+static uint32_t
+func_entry_hash(const void *arg, uint32_t idx)
+{
+        const struct profiler *p = arg;
+        const struct profiler_func *f = &VEC_ELEM(p->funcs, idx);
+        return func_hash(f->module, f->funcidx);
+}
+
+static uint32_t
+stack_entry_hash(const void *arg, uint32_t idx)
+{
+        const struct profiler *p = arg;
+        return VEC_ELEM(p->stacks, idx).hash;
+}
+
+static int
+intern_func(struct profiler *p, const struct module *m, uint32_t funcidx,
+            uint32_t *idxp)
+{
+        const uint32_t hash = func_hash(m, funcidx);
+        uint32_t pos = hash;
+        uint32_t idx;
+        while (hash_index_next(&p->funcs_index, &pos, &idx)) {
+                const struct profiler_func *f = &VEC_ELEM(p->funcs, idx);
+                if (f->module == m && f->funcidx == funcidx) {
+                        *idxp = idx;
+                        return 0;
+                }
+        }
+        int ret = hash_index_reserve(p->mctx, &p->funcs_index,
+                                     p->funcs.lsize, 1, func_entry_hash, p);
+        if (ret != 0) {
+                return ret;
+        }
+        ret = VEC_PREALLOC(p->mctx, p->funcs, 1);
+        if (ret != 0) {
+                return ret;
+        }
+        idx = p->funcs.lsize;
+        struct profiler_func *f = VEC_PUSH(p->funcs);
+        f->module = m;
+        f->funcidx = funcidx;
+        hash_index_insert(&p->funcs_index, hash, idx);
+        *idxp = idx;
+        return 0;
+}
+
+static int
+record_stack(struct profiler *p, uint32_t frameidx, uint32_t nframes)
+{
+        const uint32_t *frames = &VEC_ELEM(p->frames, frameidx);
+        const uint32_t hash = stack_hash(frames, nframes);
+        uint32_t pos = hash;
+        uint32_t idx;
+        while (hash_index_next(&p->stacks_index, &pos, &idx)) {
+                struct profiler_stack *s = &VEC_ELEM(p->stacks, idx);
+                if (s->hash == hash && s->nframes == nframes &&
+                    !memcmp(&VEC_ELEM(p->frames, s->frameidx), frames,
+                            nframes * sizeof(*frames))) {
+                        s->count++;
+                        /* discard the frames we've just pushed */
+                        p->frames.lsize = frameidx;
+                        return 0;
+                }
+        }
+        int ret = hash_index_reserve(p->mctx, &p->stacks_index,
+                                     p->stacks.lsize, 1, stack_entry_hash, p);
+        if (ret != 0) {
+                return ret;
+        }
+        ret = VEC_PREALLOC(p->mctx, p->stacks, 1);
+        if (ret != 0) {
+                return ret;
+        }
+        idx = p->stacks.lsize;
+        struct profiler_stack *s = VEC_PUSH(p->stacks);
+        s->hash = hash;
+        s->nframes = nframes;
+        s->frameidx = frameidx;
+        s->count = 1;
+        hash_index_insert(&p->stacks_index, hash, idx);
+        return 0;
+}
+
+void
+profiler_sample(struct profiler *p, const struct exec_context *ctx)
+{
+        uint32_t nframes = ctx->frames.lsize;
+        if (nframes == 0) {
+                return;
+        }
+        if (nframes > PROFILER_MAX_DEPTH) {
+                /* keep the innermost frames */
+                nframes = PROFILER_MAX_DEPTH;
+        }
+        toywasm_mutex_lock(&p->lock);
+        p->nsamples++;
+        /*
+         * push the frames to the tail of p->frames.
+         * record_stack() discards them if the stack is not new.
+         */
+        const uint32_t frameidx = p->frames.lsize;
+        int ret = VEC_PREALLOC(p->mctx, p->frames, nframes);
+        if (ret != 0) {
+                goto fail;
+        }
+        uint32_t i;
+        for (i = 0; i < nframes; i++) {
+                const struct funcframe *fp =
+                        &VEC_ELEM(ctx->frames, ctx->frames.lsize - 1 - i);
+                uint32_t idx;
+                ret = intern_func(p, fp->instance->module, fp->funcidx, &idx);
+                if (ret != 0) {
+                        goto fail;
+                }
+                *VEC_PUSH(p->frames) = idx;
+        }
+        ret = record_stack(p, frameidx, nframes);
+        if (ret != 0) {
+                goto fail;
+        }
+        toywasm_mutex_unlock(&p->lock);
+        return;
+fail:
+        p->frames.lsize = frameidx;
+        p->ndropped++;
+        toywasm_mutex_unlock(&p->lock);
+}
+
+/*
+ * copy a name looked up with nametable.
+ * on an allocation failure, the name is left NULL and treated as unknown.
+ */
+static void
+name_copy(struct profiler *p, struct name *dst, const struct name *src)
+{
+        if (nametable_is_unknown(src)) {
+                *dst = *src; /* a static string */
+                return;
+        }
+        if (src->nbytes == 0) {
+                dst->nbytes = 0;
+                dst->data = "";
+                return;
+        }
+        char *data = mem_alloc(p->mctx, src->nbytes);
+        if (data == NULL) {
+                dst->nbytes = 0;
+                dst->data = NULL;
+                return;
+        }
+        memcpy(data, src->data, src->nbytes);
+        dst->nbytes = src->nbytes;
+        dst->data = data;
+}
+
+/*
+ * copy the names of the functions in the module which have been
+ * sampled, so that the module can be destroyed before profiler_write.
+ */
+void
+profiler_forget_module(struct profiler *p, const struct module *m)
+{
+        struct nametable table;
+        struct profiler_func *f;
+        struct name name;
+        toywasm_mutex_lock(&p->lock);
+        nametable_init(&table);
+        VEC_FOREACH(f, p->funcs) {
+                if (f->module != m) {
+                        continue;
+                }
+                nametable_lookup_func(&table, m, f->funcidx, &name);
+                name_copy(p, &f->fname, &name);
+                nametable_lookup_module(&table, m, &name);
+                name_copy(p, &f->mname, &name);
+                /*
+                 * Note: intern_func never matches this entry as
+                 * the module is non-NULL there.
+                 */
+                f->module = NULL;
+        }
+        nametable_clear(&table);
+        toywasm_mutex_unlock(&p->lock);
+}
+
+/*
+ * resolve function names.
+ * process functions module by module because nametable only caches
+ * a single module.
+ */
+static int
+resolve_names(struct profiler *p, struct name **fnamesp,
+              struct name **mnamesp)
+{
+        const uint32_t nfuncs = p->funcs.lsize;
+        struct name *fnames = NULL;
+        struct name *mnames = NULL;
+        if (nfuncs == 0) {
+                goto done;
+        }
+        fnames = mem_calloc(p->mctx, nfuncs, sizeof(*fnames));
+        mnames = mem_calloc(p->mctx, nfuncs, sizeof(*mnames));
+        if (fnames == NULL || mnames == NULL) {
+                mem_free(p->mctx, fnames, nfuncs * sizeof(*fnames));
+                mem_free(p->mctx, mnames, nfuncs * sizeof(*mnames));
+                return ENOMEM;
+        }
+        struct nametable table;
+        nametable_init(&table);
+        uint32_t i;
+        for (i = 0; i < nfuncs; i++) {
+                const struct profiler_func *fi = &VEC_ELEM(p->funcs, i);
+                if (fi->module == NULL) {
+                        fnames[i] = fi->fname;
+                        mnames[i] = fi->mname;
+                        continue;
+                }
+                if (fnames[i].data != NULL) {
+                        continue;
+                }
+                const struct module *m = fi->module;
+                uint32_t j;
+                for (j = i; j < nfuncs; j++) {
+                        const struct profiler_func *f = &VEC_ELEM(p->funcs, j);
+                        if (f->module != m) {
+                                continue;
+                        }
+                        nametable_lookup_func(&table, m, f->funcidx,
+                                              &fnames[j]);
+                        nametable_lookup_module(&table, m, &mnames[j]);
+                }
+        }
+        nametable_clear(&table);
+done:
+        *fnamesp = fnames;
+        *mnamesp = mnames;
+        return 0;
+}
+
+/*
+ * format a function name like "module:func".
+ * the module part is omitted when it's unknown.
+ * for a function without a name, use "func[funcidx]".
+ */
+static int
+format_func_name(char *buf, size_t bufsz, const struct name *fname,
+                 const struct name *mname, uint32_t funcidx)
+{
+        char idxbuf[sizeof("func[4294967295]")];
+        const char *fp = fname->data;
+        int flen = (int)fname->nbytes;
+        if (fp == NULL || nametable_is_unknown(fname)) {
+                flen = snprintf(idxbuf, sizeof(idxbuf), "func[%" PRIu32 "]",
+                                funcidx);
+                fp = idxbuf;
+        }
+        int ret;
+        if (mname->data == NULL || nametable_is_unknown(mname)) {
+                ret = snprintf(buf, bufsz, "%.*s", flen, fp);
+        } else {
+                ret = snprintf(buf, bufsz, "%.*s:%.*s", CSTR(mname), flen, fp);
+        }
+        if (ret < 0) {
+                return 0;
+        }
+        if ((size_t)ret >= bufsz) {
+                return (int)bufsz - 1; /* truncated */
+        }
+        return ret;
+}
+
+#define MAX_FUNC_NAME 256
+
+static int
+write_folded(struct profiler *p, FILE *fp, const struct name *fnames,
+             const struct name *mnames)
+{
+        char buf[MAX_FUNC_NAME];
+        uint32_t i;
+        for (i = 0; i < p->stacks.lsize; i++) {
+                const struct profiler_stack *s = &VEC_ELEM(p->stacks, i);
+                const uint32_t *frames = &VEC_ELEM(p->frames, s->frameidx);
+                uint32_t j;
+                /* root first */
+                for (j = s->nframes; j > 0; j--) {
+                        const uint32_t idx = frames[j - 1];
+                        const struct profiler_func *f =
+                                &VEC_ELEM(p->funcs, idx);
+                        int len = format_func_name(buf, sizeof(buf),
+                                                   &fnames[idx], &mnames[idx],
+                                                   f->funcidx);
+                        fprintf(fp, "%s%.*s", (j == s->nframes) ? "" : ";",
+                                len, buf);
+                }
+                fprintf(fp, " %" PRIu64 "\n", s->count);
+        }
+        return 0;
+}
+
+/*
+ * a minimum protobuf encoder for pprof.
+ */
+
+struct pbuf {
+        VEC(, uint8_t) v;
+        struct mem_context *mctx;
+        int error;
+};
+
+static void
+pb_init(struct pbuf *b, struct mem_context *mctx)
+{
+        VEC_INIT(b->v);
+        b->mctx = mctx;
+        b->error = 0;
+}
+
+static void
+pb_clear(struct pbuf *b)
+{
+        VEC_FREE(b->mctx, b->v);
+}
+
+static void
+pb_put(struct pbuf *b, const void *p, size_t len)
+{
+        if (b->error != 0 || len == 0) {
+                return;
+        }
+        int ret = VEC_PREALLOC(b->mctx, b->v, len);
+        if (ret != 0) {
+                b->error = ret;
+                return;
+        }
+        memcpy(&VEC_NEXTELEM(b->v), p, len);
+        b->v.lsize += len;
+}
+
+static void
+pb_varint(struct pbuf *b, uint64_t v)
+{
+        uint8_t buf[10];
+        size_t len = 0;
+        do {
+                uint8_t x = v & 0x7f;
+                v >>= 7;
+                if (v != 0) {
+                        x |= 0x80;
+                }
+                buf[len++] = x;
+        } while (v != 0);
+        pb_put(b, buf, len);
+}
+
+#define PB_WIRE_VARINT 0
+#define PB_WIRE_LEN 2
+
+static void
+pb_key(struct pbuf *b, uint32_t field, uint32_t wire)
+{
+        pb_varint(b, ((uint64_t)field << 3) | wire);
+}
+
+static void
+pb_uint(struct pbuf *b, uint32_t field, uint64_t v)
+{
+        pb_key(b, field, PB_WIRE_VARINT);
+        pb_varint(b, v);
+}
+
+static void
+pb_bytes(struct pbuf *b, uint32_t field, const void *p, size_t len)
+{
+        pb_key(b, field, PB_WIRE_LEN);
+        pb_varint(b, len);
+        pb_put(b, p, len);
+}
+
+/* append a sub message. consumes sub. */
+static void
+pb_message(struct pbuf *b, uint32_t field, struct pbuf *sub)
+{
+        if (sub->error != 0 && b->error == 0) {
+                b->error = sub->error;
+        }
+        pb_bytes(b, field, sub->v.p, sub->v.lsize);
+        sub->v.lsize = 0;
+}
+
+/* field numbers in profile.proto */
+#define PPROF_PROFILE_SAMPLE_TYPE 1
+#define PPROF_PROFILE_SAMPLE 2
+#define PPROF_PROFILE_LOCATION 4
+#define PPROF_PROFILE_FUNCTION 5
+#define PPROF_PROFILE_STRING_TABLE 6
+#define PPROF_PROFILE_PERIOD_TYPE 11
+#define PPROF_PROFILE_PERIOD 12
+#define PPROF_VALUE_TYPE_TYPE 1
+#define PPROF_VALUE_TYPE_UNIT 2
+#define PPROF_SAMPLE_LOCATION_ID 1
+#define PPROF_SAMPLE_VALUE 2
+#define PPROF_LOCATION_ID 1
+#define PPROF_LOCATION_LINE 4
+#define PPROF_LINE_FUNCTION_ID 1
+#define PPROF_FUNCTION_ID 1
+#define PPROF_FUNCTION_NAME 2
+#define PPROF_FUNCTION_SYSTEM_NAME 3
+
+/* the fixed part of the string table */
+static const char *const pprof_strings[] = {
+        "", "samples", "count", "wall", "nanoseconds",
+};
+#define PPROF_STR_SAMPLES 1
+#define PPROF_STR_COUNT 2
+#define PPROF_STR_WALL 3
+#define PPROF_STR_NANOSECONDS 4
+
+static int
+write_pprof(struct profiler *p, FILE *fp, const struct name *fnames,
+            const struct name *mnames)
+{
+        struct pbuf b;
+        struct pbuf sub;
+        struct pbuf sub2;
+        uint32_t i;
+        int ret;
+
+        pb_init(&b, p->mctx);
+        pb_init(&sub, p->mctx);
+        pb_init(&sub2, p->mctx);
+
+        pb_uint(&sub, PPROF_VALUE_TYPE_TYPE, PPROF_STR_SAMPLES);
+        pb_uint(&sub, PPROF_VALUE_TYPE_UNIT, PPROF_STR_COUNT);
+        pb_message(&b, PPROF_PROFILE_SAMPLE_TYPE, &sub);
+
+        /*
+         * samples.
+         * location ids are 1-based indexes in p->funcs.
+         * the leaf comes first, the same as p->frames.
+         */
+        for (i = 0; i < p->stacks.lsize; i++) {
+                const struct profiler_stack *s = &VEC_ELEM(p->stacks, i);
+                const uint32_t *frames = &VEC_ELEM(p->frames, s->frameidx);
+                uint32_t j;
+                for (j = 0; j < s->nframes; j++) {
+                        pb_varint(&sub2, frames[j] + 1);
+                }
+                pb_message(&sub, PPROF_SAMPLE_LOCATION_ID, &sub2);
+                pb_varint(&sub2, s->count);
+                pb_message(&sub, PPROF_SAMPLE_VALUE, &sub2);
+                pb_message(&b, PPROF_PROFILE_SAMPLE, &sub);
+        }
+
+        /* a location and a function for each p->funcs */
+        for (i = 0; i < p->funcs.lsize; i++) {
+                pb_uint(&sub, PPROF_LOCATION_ID, i + 1);
+                pb_uint(&sub2, PPROF_LINE_FUNCTION_ID, i + 1);
+                pb_message(&sub, PPROF_LOCATION_LINE, &sub2);
+                pb_message(&b, PPROF_PROFILE_LOCATION, &sub);
+        }
+        const uint32_t strbase = ARRAYCOUNT(pprof_strings);
+        for (i = 0; i < p->funcs.lsize; i++) {
+                pb_uint(&sub, PPROF_FUNCTION_ID, i + 1);
+                pb_uint(&sub, PPROF_FUNCTION_NAME, strbase + i);
+                pb_uint(&sub, PPROF_FUNCTION_SYSTEM_NAME, strbase + i);
+                pb_message(&b, PPROF_PROFILE_FUNCTION, &sub);
+        }
+
+        for (i = 0; i < ARRAYCOUNT(pprof_strings); i++) {
+                const char *str = pprof_strings[i];
+                pb_bytes(&b, PPROF_PROFILE_STRING_TABLE, str, strlen(str));
+        }
+        for (i = 0; i < p->funcs.lsize; i++) {
+                const struct profiler_func *f = &VEC_ELEM(p->funcs, i);
+                char buf[MAX_FUNC_NAME];
+                int len = format_func_name(buf, sizeof(buf), &fnames[i],
+                                           &mnames[i], f->funcidx);
+                pb_bytes(&b, PPROF_PROFILE_STRING_TABLE, buf, len);
+        }
+
+        pb_uint(&sub, PPROF_VALUE_TYPE_TYPE, PPROF_STR_WALL);
+        pb_uint(&sub, PPROF_VALUE_TYPE_UNIT, PPROF_STR_NANOSECONDS);
+        pb_message(&b, PPROF_PROFILE_PERIOD_TYPE, &sub);
+        pb_uint(&b, PPROF_PROFILE_PERIOD, (uint64_t)p->interval_ms * 1000000);
+
+        ret = b.error;
+        if (ret == 0 && fwrite(b.v.p, 1, b.v.lsize, fp) != b.v.lsize) {
+                ret = EIO;
+        }
+        pb_clear(&sub2);
+        pb_clear(&sub);
+        pb_clear(&b);
+        return ret;
+}
+
+int
+profiler_write(struct profiler *p, const char *filename,
+               enum profiler_format fmt)
+{
+        struct name *fnames;
+        struct name *mnames;
+        int ret;
+
+        toywasm_mutex_lock(&p->lock);
+        xlog_trace("profiler: %" PRIu64 " samples (%" PRIu64
+                   " dropped) %" PRIu32 " unique stacks %" PRIu32
+                   " functions",
+                   p->nsamples, p->ndropped, p->stacks.lsize,
+                   p->funcs.lsize);
+        ret = resolve_names(p, &fnames, &mnames);
+        if (ret != 0) {
+                goto fail;
+        }
+        FILE *fp = fopen(filename, "w");
+        if (fp == NULL) {
+                assert(errno != 0);
+                ret = errno;
+                goto fail_free;
+        }
+        switch (fmt) {
+        case PROFILER_FORMAT_PPROF:
+                ret = write_pprof(p, fp, fnames, mnames);
+                break;
+        case PROFILER_FORMAT_FOLDED:
+                ret = write_folded(p, fp, fnames, mnames);
+                break;
+        default:
+                ret = EINVAL;
+                break;
+        }
+        if (fclose(fp) != 0 && ret == 0) {
+                assert(errno != 0);
+                ret = errno;
+        }
+fail_free:
+        mem_free(p->mctx, fnames, p->funcs.lsize * sizeof(*fnames));
+        mem_free(p->mctx, mnames, p->funcs.lsize * sizeof(*mnames));
+fail:
+        toywasm_mutex_unlock(&p->lock);
+        return ret;
+}
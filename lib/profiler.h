@@ -0,0 +1,105 @@
+#if !defined(_TOYWASM_PROFILER_H)
+#define _TOYWASM_PROFILER_H
+
+#include <stdint.h>
+
+#include "hash_index.h"
+#include "lock.h"
+#include "platform.h"
+#include "type.h"
+#include "vec.h"
+
+/*
+ * a simple sampling profiler.
+ *
+ * usage:
+ *
+ *   struct profiler *p;
+ *   profiler_create(mctx, &p);
+ *   ctx->profiler = p;   (for each exec_context to profile)
+ *   ... execute wasm functions ...
+ *   profiler_write(p, "out.pb", PROFILER_FORMAT_PPROF);
+ *   profiler_destroy(p);
+ *
+ * samples are taken in check_interrupt(). while a profiler is attached
+ * to an exec_context, check_interrupt() is called about every
+ * profiler::interval_ms.
+ * a sample is a call stack of wasm functions. (host functions are
+ * not included.)
+ *
+ * names of functions are resolved with the name section when writing
+ * a profile. a module destroyed before that should be passed to
+ * profiler_forget_module() first.
+ *
+ * a profiler can be shared among exec_contexts, possibly running on
+ * different threads.
+ */
+
+struct exec_context;
+struct mem_context;
+struct module;
+
+enum profiler_format {
+        /*
+         * uncompressed pprof protobuf.
+         * https://github.com/google/pprof/blob/main/proto/profile.proto
+         */
+        PROFILER_FORMAT_PPROF,
+        /*
+         * collapsed stacks, one line per unique stack.
+         * eg. "main;foo;bar 12"
+         * (the input format of flamegraph.pl)
+         */
+        PROFILER_FORMAT_FOLDED,
+};
+
+struct profiler_func {
+        const struct module *module; /* NULL if forgotten */
+        uint32_t funcidx;
+        /* copies of the names. only valid when forgotten. */
+        struct name fname;
+        struct name mname;
+};
+
+struct profiler_stack {
+        uint32_t hash;
+        uint32_t nframes;
+        uint32_t frameidx; /* the first frame in profiler::frames */
+        uint64_t count;
+};
+
+struct profiler {
+        TOYWASM_MUTEX_DEFINE(lock);
+        uint32_t interval_ms;
+        uint64_t nsamples;
+        uint64_t ndropped; /* samples dropped because of errors */
+
+        /* unique functions seen in samples */
+        VEC(, struct profiler_func) funcs;
+        struct hash_index funcs_index;
+
+        /* unique stacks */
+        VEC(, struct profiler_stack) stacks;
+        struct hash_index stacks_index;
+
+        /* indexes in funcs. leaf first. */
+        VEC(, uint32_t) frames;
+
+        struct mem_context *mctx;
+};
+
+#define PROFILER_DEFAULT_INTERVAL_MS 10
+#define PROFILER_MAX_DEPTH 128
+
+__BEGIN_EXTERN_C
+
+int profiler_create(struct mem_context *mctx, struct profiler **pp);
+void profiler_destroy(struct profiler *p);
+void profiler_sample(struct profiler *p, const struct exec_context *ctx);
+void profiler_forget_module(struct profiler *p, const struct module *m);
+int profiler_write(struct profiler *p, const char *filename,
+                   enum profiler_format fmt);
+
+__END_EXTERN_C
+
+#endif /* !defined(_TOYWASM_PROFILER_H) */
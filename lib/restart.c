@@ -59,3 +59,19 @@ restart_info_is_none(struct exec_context *ctx)
         return ctx->restarts.lsize == ctx->restarts.psize ||
                VEC_NEXTELEM(ctx->restarts).restart_type == RESTART_NONE;
 }
+
+/*
+ * release what a pending restart holds. for exec_context_clear.
+ */
+void
+restart_info_abandon(struct exec_context *ctx)
+{
+        if (ctx->restarts.lsize < ctx->restarts.psize) {
+                struct restart_info *restart = &VEC_NEXTELEM(ctx->restarts);
+                if (restart->restart_type == RESTART_IO) {
+                        restart->restart_u.io.abandon(
+                                restart->restart_u.io.req);
+                }
+                restart->restart_type = RESTART_NONE;
+        }
+}
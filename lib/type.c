@@ -3,8 +3,10 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "leb128.h"
 #include "mem.h"
 #include "type.h"
+#include "util.h"
 #include "xlog.h"
 
 bool
@@ -264,6 +266,15 @@ compare_name(const struct name *a, const struct name *b)
         return memcmp(a->data, b->data, a->nbytes);
 }
 
+/*
+ * seed is usually 0. it can be used to combine hashes of multiple names.
+ */
+uint32_t
+name_hash(const struct name *name, uint32_t seed)
+{
+        return fnv1a32(FNV1A32_INIT ^ seed, name->data, name->nbytes);
+}
+
 static int
 resulttype_from_string(struct mem_context *mctx, const char *p, const char *ep,
                        struct resulttype *t)
@@ -449,3 +460,48 @@ memtype_page_shift(const struct memtype *type)
         return WASM_PAGE_SHIFT;
 #endif
 }
+
+bool
+element_has_funcidxes(const struct element *elem)
+{
+        return elem->funcs != NULL || elem->funcs_bin != NULL;
+}
+
+void
+element_funcidx_iter_init(struct element_funcidx_iter *it,
+                          const struct element *elem, uint32_t start)
+{
+        assert(element_has_funcidxes(elem));
+        assert(start <= elem->init_size);
+        it->elem = elem;
+        it->i = start;
+        it->p = elem->funcs_bin;
+        if (it->p != NULL) {
+                /*
+                 * skip the preceding entries.
+                 * use the index to skip most of them.
+                 */
+                uint32_t i = 0;
+                const uint32_t k = start / ELEMENT_FUNCIDX_INDEX_INTERVAL;
+                if (k > 0 && elem->funcs_bin_index != NULL) {
+                        it->p += elem->funcs_bin_index[k - 1];
+                        i = k * ELEMENT_FUNCIDX_INDEX_INTERVAL;
+                }
+                for (; i < start; i++) {
+                        read_leb_u32_nocheck(&it->p);
+                }
+        }
+}
+
+uint32_t
+element_funcidx_iter_next(struct element_funcidx_iter *it)
+{
+        const struct element *elem = it->elem;
+        assert(it->i < elem->init_size);
+        if (it->p != NULL) {
+                it->i++;
+                /* the encoding has been validated by module_load */
+                return read_leb_u32_nocheck(&it->p);
+        }
+        return elem->funcs[it->i++];
+}
@@ -8,6 +8,7 @@
 
 #include "bitmap.h"
 #include "cell.h"
+#include "hash_index.h"
 #include "lock.h"
 #include "platform.h"
 #include "vec.h"
@@ -25,6 +26,16 @@ struct jump {
         uint32_t targetpc;
 };
 
+/*
+ * the compact form of struct jump, used for small expressions.
+ * (see expr_exec_info::small)
+ * the pcs are relative to the start of the expression.
+ */
+struct jump16 {
+        uint16_t pc;
+        uint16_t targetpc;
+};
+
 /*
  * type annotations. see doc/annotations.md
  */
@@ -33,16 +44,55 @@ struct type_annotation {
         uint32_t size;
 };
 
+/* the compact form of struct type_annotation. see struct jump16. */
+struct type_annotation16 {
+        uint16_t pc;
+        uint16_t size;
+};
+
 struct type_annotations {
         uint32_t default_size;
         uint32_t ntypes;
-        struct type_annotation *types;
+        union {
+                struct type_annotation *types;
+                struct type_annotation16 *types16;
+        } types_u;
 };
 
+#if defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING)
+/*
+ * exception handler table. see doc/annotations.md
+ *
+ * an entry per catch clause of try_table instructions, sorted by pc.
+ * catch clauses of a try_table are stored in the order in the bytecode.
+ */
+struct catch_handler {
+        uint32_t pc;     /* the pc of the try_table instruction */
+        uint32_t tagidx; /* CATCH_HANDLER_ALL for catch_all/catch_all_ref */
+        uint32_t label;  /* the label operand of the catch clause */
+};
+
+#define CATCH_HANDLER_ALL UINT32_MAX
+#endif
+
+/*
+ * the max size of an expression in bytes to use the compact forms of
+ * annotations. (struct jump16 and struct type_annotation16)
+ */
+#define EXPR_SMALL_MAX UINT16_MAX
+
 /* hints for execution */
 struct expr_exec_info {
         uint32_t njumps;
-        struct jump *jumps;
+        /*
+         * if true, jumps16 and types16 are used instead of
+         * jumps and types.
+         */
+        bool small;
+        union {
+                struct jump *jumps;
+                struct jump16 *jumps16;
+        } jumps_u;
 
         uint32_t maxlabels; /* max labels (including the implicit one) */
         uint32_t maxcells;  /* max cells on stack */
@@ -53,6 +103,13 @@ struct expr_exec_info {
          */
         struct type_annotations type_annotations;
 #endif
+#if defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING)
+        /*
+         * catch clauses of try_table instructions in the expression
+         */
+        uint32_t ncatches;
+        struct catch_handler *catches;
+#endif
 };
 
 /*
@@ -163,6 +220,26 @@ ctassert(sizeof(double) == 8);
 ctassert(sizeof(union v128) == 16);
 
 #if defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING)
+#if defined(TOYWASM_USE_HEAP_EXNREF)
+/*
+ * an exception object. exnref is a pointer to this.
+ * see the comment on push_exception.
+ *
+ * Note: the type of exc->cells is taginst_functype(exc->tag)->parameter.
+ */
+struct wasm_exception {
+        const struct taginst *tag;
+        struct instance *owner;
+        struct wasm_exception *next;      /* instance::exceptions */
+        struct wasm_exception *next_free; /* instance::free_exceptions */
+        /* the last exec_context which has exposed this. see exception_expose */
+        const struct exec_context *exposed;
+        uint32_t ncells; /* the size of cells[] */
+        uint32_t refcount;
+        bool marked; /* for exception_gc */
+        struct cell cells[];
+};
+#else /* defined(TOYWASM_USE_HEAP_EXNREF) */
 #if !defined(TOYWASM_USE_SMALL_CELLS)
 #error TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING w/o TOYWASM_USE_SMALL_CELLS is not implemented
 #endif
@@ -179,22 +256,25 @@ ctassert_offset(struct wasm_exception, cells, 0);
  */
 #define exception_tag_ptr(exc)                                                \
         ((uint8_t *)(exc) + toywasm_offsetof(struct wasm_exception, tag))
+#endif /* defined(TOYWASM_USE_HEAP_EXNREF) */
 #endif /* defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING) */
 
 /*
  * calculate how many cells we need in struct val.
  */
 #if defined(TOYWASM_USE_SMALL_CELLS)
-#if defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING)
+#if defined(TOYWASM_USE_HEAP_EXNREF)
+#define EXNREF_NCELLS HOWMANY(sizeof(void *), sizeof(struct cell))
+#elif defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING)
 #define EXNREF_NCELLS                                                         \
         HOWMANY(sizeof(struct wasm_exception), sizeof(struct cell))
 #else
 #define EXNREF_NCELLS 0
 #endif
 #define EXTERNREF_NCELLS HOWMANY(sizeof(void *), sizeof(struct cell))
-#define NUMTYPE_NCELLS 2
+#define NUMTYPE_NCELLS HOWMANY(sizeof(uint64_t), sizeof(struct cell))
 #if defined(TOYWASM_ENABLE_WASM_SIMD)
-#define VECTYPE_NCELLS 4
+#define VECTYPE_NCELLS HOWMANY(sizeof(union v128), sizeof(struct cell))
 #else
 #define VECTYPE_NCELLS 0
 #endif
@@ -227,7 +307,9 @@ struct val {
 #endif
                 struct funcref funcref;
                 void *externref;
-#if defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING)
+#if defined(TOYWASM_USE_HEAP_EXNREF)
+                struct wasm_exception *exnref;
+#elif defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING)
                 /*
                  * Note: Because we don't have GC, we implement exnref as
                  * a copy-able type, rather than a reference to an object.
@@ -241,10 +323,10 @@ struct val {
 /*
  * Note: because the largest member of the union might not have the largest
  * alignment, the union can be a bit larger than what's calculated above.
- * in that case, the last 4 byte of the structure is just an unused padding.
+ * in that case, the last cell of the structure is just an unused padding.
  */
-ctassert(sizeof(struct val) == VAL_NCELLS * 4 ||
-         sizeof(struct val) == (VAL_NCELLS + 1) * 4);
+ctassert(sizeof(struct val) == VAL_NCELLS * sizeof(struct cell) ||
+         sizeof(struct val) == (VAL_NCELLS + 1) * sizeof(struct cell));
 #endif
 
 struct localchunk {
@@ -272,9 +354,28 @@ enum element_mode {
         ELEM_MODE_DECLARATIVE,
 };
 
+/*
+ * an element segment is either vec(expr) or vec(funcidx).
+ *
+ * for vec(funcidx), either of funcs or funcs_bin is used.
+ * module_load leaves the funcidxes encoded in the module binary
+ * (funcs_bin) to avoid decoding and copying them eagerly.
+ * (they can be huge for the indirect function table of a large C program.)
+ * funcs is for modules constructed by other means. (eg. wasm2cstruct)
+ *
+ * funcs_bin_index is a sparse index into funcs_bin to make random
+ * access (eg. table.init) cheap. funcs_bin_index[k - 1] is the byte
+ * offset of the entry k * ELEMENT_FUNCIDX_INDEX_INTERVAL in funcs_bin.
+ * it's NULL for small segments.
+ *
+ * use element_funcidx_iter to access funcidxes.
+ */
+#define ELEMENT_FUNCIDX_INDEX_INTERVAL 64
 struct element {
         struct expr *init_exprs;
         uint32_t *funcs;
+        const uint8_t *funcs_bin; /* LEB128-encoded funcidxes */
+        uint32_t *funcs_bin_index;
         uint32_t init_size; /* entries in init_exprs or funcs */
         enum valtype type;
         enum element_mode mode;
@@ -284,6 +385,12 @@ struct element {
         struct expr offset;
 };
 
+struct element_funcidx_iter {
+        const struct element *elem;
+        const uint8_t *p;
+        uint32_t i;
+};
+
 enum globalmut {
         GLOBAL_CONST = 0x00,
         GLOBAL_VAR = 0x01,
@@ -466,11 +573,29 @@ enum section_id {
  * - exprs
  * - module->bin (currently only used to calculate "pc")
  *
+ * Usually the bytecode is owned by the caller of module_create.
+ * (eg. a mmap'ed file)
+ * In case of module_create_from_reader, the module keeps a copy of
+ * the necessary parts of the bytecode by itself. (module->owned_bin)
+ *
  * This structure and all referenced child structures are read-only
  * until module_destroy().
  * Thus it can be safely shared among threads without any serializations.
  */
 
+#if defined(TOYWASM_ENABLE_AOT)
+struct exec_context;
+struct instance;
+struct cell;
+/*
+ * a function translated to C ahead of time. eg. by wasm2cstruct --aot
+ * it works on the parameters/results on the operand stack in place,
+ * as host_func_t does.
+ */
+typedef int (*aot_func_t)(struct exec_context *ctx, struct instance *inst,
+                          struct cell *cells);
+#endif
+
 struct module {
         uint32_t ntypes;
         struct functype *types;
@@ -516,6 +641,29 @@ struct module {
 
         const uint8_t *bin;
 
+        /*
+         * the copy of the module bytecode owned by the module.
+         * only used by module_create_from_reader.
+         * bin points to the start of this region.
+         *
+         * usually it's an address range reserved with
+         * map_anon_reserve_noaccess, of which only owned_bin_committed
+         * bytes are accessible and accounted to the module's
+         * mem_context. if owned_bin_heap is true, it's a buffer
+         * allocated with mem_alloc instead.
+         */
+        void *owned_bin;
+        size_t owned_bin_size;
+        size_t owned_bin_committed;
+        bool owned_bin_heap;
+
+        /*
+         * the arena which all other allocations for this module
+         * are made from. (except the module structure itself)
+         * only used with load_options::use_arena.
+         */
+        struct module_mem_arena *mem_arena;
+
 #if defined(TOYWASM_ENABLE_WASM_NAME_SECTION)
         /*
          * Unlike other sections, we don't parse the name section
@@ -532,6 +680,15 @@ struct module {
 #if defined(TOYWASM_ENABLE_DYLD)
         struct dylink *dylink;
 #endif
+#if defined(TOYWASM_ENABLE_AOT)
+        /*
+         * native versions of the functions, indexed by
+         * funcidx - nimportedfuncs. a NULL entry means the function
+         * is interpreted. NULL if the module has no such functions.
+         * (see aot.h)
+         */
+        const aot_func_t *aot_funcs;
+#endif
 };
 
 struct exec_context;
@@ -548,6 +705,9 @@ struct funcinst {
                 struct {
                         struct instance *instance;
                         uint32_t funcidx;
+#if defined(TOYWASM_ENABLE_AOT)
+                        aot_func_t aot; /* NULL if interpreted */
+#endif
                 } wasm;
                 struct {
                         struct host_instance *instance;
@@ -631,6 +791,13 @@ struct instance {
         VEC(, struct taginst *) tags;
 #endif
 
+        /*
+         * globalinst for non-imported globals, laid out contiguously.
+         * (module->nglobals entries)
+         * globals[module->nimportedglobals + i] == &own_globals[i]
+         */
+        struct globalinst *own_globals;
+
         /*
          * Track which data/element has been dropped. It's unfortunate
          * that the functionality for space-saving actually just consumes
@@ -640,6 +807,15 @@ struct instance {
         struct bitmap elem_dropped;
 
         struct mem_context *mctx;
+#if defined(TOYWASM_USE_HEAP_EXNREF)
+        /* exception objects created by this instance. see push_exception */
+        struct wasm_exception *exceptions; /* all objects */
+        struct wasm_exception *free_exceptions;
+#endif
+#if defined(TOYWASM_ENABLE_JIT)
+        /* call counters and compiled code. (see jit.h) */
+        struct jit_instance *jit;
+#endif
 };
 
 /*
@@ -678,6 +854,11 @@ struct import_object {
 #endif
         size_t nentries;
         struct import_object_entry *entries;
+        /*
+         * an optional hash index of the entries.
+         * see import_object_build_index.
+         */
+        struct hash_index hash_index;
         void (*dtor)(struct mem_context *mctx, struct import_object *im);
         void *dtor_arg;
         struct import_object *next; /* NULL for the last import_object */
@@ -694,6 +875,7 @@ bool is_valtype(enum valtype vt) __constfunc;
 int compare_resulttype(const struct resulttype *a, const struct resulttype *b);
 int compare_functype(const struct functype *a, const struct functype *b);
 int compare_name(const struct name *a, const struct name *b);
+uint32_t name_hash(const struct name *name, uint32_t seed);
 
 /*
  * note: given inst and idx, the following two are equivalent.
@@ -736,6 +918,11 @@ uint32_t memtype_page_shift(const struct memtype *type);
 
 const uint8_t *expr_end(const struct expr *expr);
 
+bool element_has_funcidxes(const struct element *elem);
+void element_funcidx_iter_init(struct element_funcidx_iter *it,
+                               const struct element *elem, uint32_t start);
+uint32_t element_funcidx_iter_next(struct element_funcidx_iter *it);
+
 __END_EXTERN_C
 
 #endif /* defined(_TOYWASM_TYPE_H) */
@@ -123,3 +123,16 @@ sched_need_resched(struct sched *sched)
         }
         return false;
 }
+
+/*
+ * returns true if there are other threads which can run.
+ *
+ * unlike sched_need_resched, this doesn't care the time slice.
+ * it's intended to be used by a thread which is going to wait for
+ * an event. (eg. an asynchronous i/o completion)
+ */
+bool
+sched_has_other_runnable(struct sched *sched)
+{
+        return SLIST_FIRST(&sched->runq) != NULL;
+}
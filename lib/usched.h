@@ -18,5 +18,6 @@ void sched_run(struct sched *sched, struct exec_context *ctx);
 void sched_init(struct sched *sched);
 void sched_clear(struct sched *sched);
 bool sched_need_resched(struct sched *sched);
+bool sched_has_other_runnable(struct sched *sched);
 
 __END_EXTERN_C
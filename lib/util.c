@@ -87,3 +87,19 @@ xstrnstr(const char *haystack, const char *needle, size_t len)
         return NULL;
 #endif
 }
+
+/*
+ * FNV-1a.
+ * h is FNV1A32_INIT or a hash to continue.
+ */
+uint32_t
+fnv1a32(uint32_t h, const void *p, size_t sz)
+{
+        const uint8_t *cp = p;
+        size_t i;
+        for (i = 0; i < sz; i++) {
+                h ^= cp[i];
+                h *= UINT32_C(0x01000193);
+        }
+        return h;
+}
@@ -24,3 +24,6 @@ int __must_check array_shrink(struct mem_context *ctx, void **p,
 #define HOWMANY(a, b) ((a + (b - 1)) / b)
 
 char *xstrnstr(const char *haystack, const char *needle, size_t len);
+
+#define FNV1A32_INIT UINT32_C(0x811c9dc5)
+uint32_t fnv1a32(uint32_t h, const void *p, size_t sz);
@@ -206,24 +206,25 @@ push_ctrlframe(uint32_t pc, enum ctrlframe_op op, uint32_t jumpslot,
                 nslots = 2;
         }
         if (nslots > 0) {
-                ret = array_extend(validation_mctx(ctx), (void **)&ei->jumps,
-                                   sizeof(*ei->jumps), ei->njumps,
+                struct jump **jumpsp = &ei->jumps_u.jumps;
+                ret = array_extend(validation_mctx(ctx), (void **)jumpsp,
+                                   sizeof(**jumpsp), ei->njumps,
                                    ei->njumps + nslots);
                 if (ret != 0) {
                         return ret;
                 }
                 jumpslot = ei->njumps;
                 ei->njumps += nslots;
-                ei->jumps[jumpslot].pc = pc;
-                ei->jumps[jumpslot].targetpc = 0;
+                ei->jumps_u.jumps[jumpslot].pc = pc;
+                ei->jumps_u.jumps[jumpslot].targetpc = 0;
                 if (nslots == 2) {
                         /*
                          * the slot for "if -> else".
                          * targetpc will be left as 0 if this block has
                          * no "else".
                          */
-                        ei->jumps[jumpslot + 1].pc = pc + 1;
-                        ei->jumps[jumpslot + 1].targetpc = 0;
+                        ei->jumps_u.jumps[jumpslot + 1].pc = pc + 1;
+                        ei->jumps_u.jumps[jumpslot + 1].targetpc = 0;
                 }
         }
         cframe = VEC_PUSH(ctx->cframes);
@@ -261,9 +262,9 @@ pop_ctrlframe(uint32_t pc, bool is_else, struct ctrlframe *cframep,
         }
         if (cframe->op != FRAME_OP_INVOKE &&
             cframe->op != FRAME_OP_EMPTY_ELSE && cframe->op != FRAME_OP_LOOP &&
-            ctx->ei->jumps != NULL) {
+            ctx->ei->jumps_u.jumps != NULL) {
                 struct jump *jump =
-                        &ctx->ei->jumps[cframe->jumpslot + is_else];
+                        &ctx->ei->jumps_u.jumps[cframe->jumpslot + is_else];
                 assert(jump->pc != 0);
                 assert(jump->targetpc == 0);
                 if (cframe->op == FRAME_OP_LOOP) {
@@ -404,20 +405,44 @@ record_type_annotation(struct validation_context *vctx, const uint8_t *p,
                         return 0;
                 }
         } else {
-                assert(an->types[an->ntypes - 1].pc < pc);
-                if (an->types[an->ntypes - 1].size == t) {
+                assert(an->types_u.types[an->ntypes - 1].pc < pc);
+                if (an->types_u.types[an->ntypes - 1].size == csz) {
                         return 0;
                 }
         }
         int ret;
-        ret = array_extend(validation_mctx(vctx), (void **)&an->types,
-                           sizeof(*an->types), an->ntypes, an->ntypes + 1);
+        struct type_annotation **typesp = &an->types_u.types;
+        ret = array_extend(validation_mctx(vctx), (void **)typesp,
+                           sizeof(**typesp), an->ntypes, an->ntypes + 1);
         if (ret != 0) {
                 return ret;
         }
-        an->types[an->ntypes].pc = pc;
-        an->types[an->ntypes].size = csz;
+        an->types_u.types[an->ntypes].pc = pc;
+        an->types_u.types[an->ntypes].size = csz;
         an->ntypes++;
 #endif
         return 0;
 }
+
+#if defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING)
+int
+record_catch_handler(struct validation_context *vctx, uint32_t pc,
+                     uint32_t tagidx, uint32_t label)
+{
+        struct expr_exec_info *ei = vctx->ei;
+        assert(ei->ncatches == 0 || ei->catches[ei->ncatches - 1].pc <= pc);
+        int ret;
+        ret = array_extend(validation_mctx(vctx), (void **)&ei->catches,
+                           sizeof(*ei->catches), ei->ncatches,
+                           ei->ncatches + 1);
+        if (ret != 0) {
+                return ret;
+        }
+        struct catch_handler *h = &ei->catches[ei->ncatches];
+        h->pc = pc;
+        h->tagidx = tagidx;
+        h->label = label;
+        ei->ncatches++;
+        return 0;
+}
+#endif
@@ -99,5 +99,9 @@ int target_label_types(struct validation_context *ctx, uint32_t labelidx,
 
 int record_type_annotation(struct validation_context *vctx, const uint8_t *p,
                            enum valtype t);
+#if defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING)
+int record_catch_handler(struct validation_context *vctx, uint32_t pc,
+                         uint32_t tagidx, uint32_t label);
+#endif
 int fetch_validate_next_insn(const uint8_t *p, const uint8_t *ep,
                              struct validation_context *vctx);
@@ -29,6 +29,7 @@
 #include "load_context.h"
 #include "mem.h"
 #include "module.h"
+#include "profiler.h"
 #include "slist.h"
 #include "type.h"
 #include "util.h"
@@ -157,7 +158,7 @@ global_set_i32(struct globalinst *ginst, uint32_t v)
         global_set(ginst, &val);
 }
 
-static bool
+bool
 is_global_type_i32_const(const struct globaltype *gt)
 {
         return gt->mut == GLOBAL_CONST && gt->t == TYPE_i32;
@@ -437,6 +438,7 @@ dyld_create_got(struct dyld *d, struct dyld_object *obj)
 
         struct globalinst *got = obj->gots;
         struct dyld_plt *plt = obj->plts;
+        uint32_t funcidx = 0;
 
         for (i = 0; i < m->nimports; i++) {
                 const struct import *im = &m->imports[i];
@@ -454,6 +456,7 @@ dyld_create_got(struct dyld *d, struct dyld_object *obj)
                 if (is_env_func_import(m, im)) {
                         plt->sym = &im->name;
                         plt->refobj = obj;
+                        plt->funcidx = funcidx;
 
                         struct funcinst *fi = &plt->pltfi;
                         fi->is_host = true;
@@ -469,12 +472,20 @@ dyld_create_got(struct dyld *d, struct dyld_object *obj)
                         plt++;
                         e++;
                 }
+                if (im->desc.type == EXTERNTYPE_FUNC) {
+                        funcidx++;
+                }
         }
 
         assert(got == obj->gots + ngots);
         assert(plt == obj->plts + nplts);
+        assert(funcidx == m->nimportedfuncs);
         assert(e == obj->local_import_obj->entries +
                             obj->local_import_obj->nentries);
+        ret = import_object_build_index(mctx, obj->local_import_obj);
+        if (ret != 0) {
+                goto fail;
+        }
         return 0;
 fail:
         return ret;
@@ -659,7 +670,14 @@ dyld_object_destroy(struct dyld_object *obj)
         if (obj->instance != NULL) {
                 instance_destroy(obj->instance);
         }
-        if (obj->module != NULL) {
+#if defined(TOYWASM_ENABLE_PROFILER)
+        if (d->opts.profiler != NULL && obj->module != NULL) {
+                profiler_forget_module(d->opts.profiler, obj->module);
+        }
+#endif
+        if (obj->cache_entry != NULL) {
+                dyld_module_cache_put(d->opts.module_cache, obj->cache_entry);
+        } else if (obj->module != NULL) {
                 module_destroy(&obj->module_mctx, obj->module);
         }
         if (obj->bin != NULL) {
@@ -803,21 +821,30 @@ dyld_load_object_from_file(struct dyld *d, const struct name *name,
         obj->instance_mctx.parent = d->mctx;
         obj->dyld = d;
         obj->name = name;
-        ret = map_file(filename, (void *)&obj->bin, &obj->binsz);
-        if (ret != 0) {
-                goto fail;
-        }
-        struct load_context lctx;
-        load_context_init(&lctx, &obj->module_mctx);
-        ret = module_create(&obj->module, obj->bin, obj->bin + obj->binsz,
-                            &lctx);
-        if (ret != 0) {
-                xlog_error("module_create failed with %d: %s", ret,
-                           report_getmessage(&lctx.report));
+        if (d->opts.module_cache != NULL) {
+                ret = dyld_module_cache_get(d->opts.module_cache, filename,
+                                            &obj->cache_entry);
+                if (ret != 0) {
+                        goto fail;
+                }
+                obj->module = obj->cache_entry->module;
+        } else {
+                ret = map_file(filename, (void *)&obj->bin, &obj->binsz);
+                if (ret != 0) {
+                        goto fail;
+                }
+                struct load_context lctx;
+                load_context_init(&lctx, &obj->module_mctx);
+                ret = module_create(&obj->module, obj->bin,
+                                    obj->bin + obj->binsz, &lctx);
+                if (ret != 0) {
+                        xlog_error("module_create failed with %d: %s", ret,
+                                   report_getmessage(&lctx.report));
+                        load_context_clear(&lctx);
+                        goto fail;
+                }
                 load_context_clear(&lctx);
-                goto fail;
         }
-        load_context_clear(&lctx);
         if (obj->module->dylink == NULL) {
                 xlog_error("module %.*s doesn't have dylink.0", CSTR(name));
                 ret = EINVAL;
@@ -900,7 +927,12 @@ dyld_load_object_from_file(struct dyld *d, const struct name *name,
         if (ret != 0) {
                 goto fail;
         }
+        ret = dyld_symtab_reserve(d, obj->module->nexports);
+        if (ret != 0) {
+                goto fail;
+        }
         SLIST_INSERT_TAIL(&d->objs, obj, q);
+        dyld_symtab_add_object(d, obj);
         xlog_trace("dyld: %.*s loaded", CSTR(name));
         if (objp != NULL) {
                 *objp = obj;
@@ -1160,25 +1192,11 @@ symtype_str(enum symtype symtype)
         assert(false);
 }
 
-int
-dyld_resolve_symbol_in_obj(struct dyld_object *refobj, struct dyld_object *obj,
-                           enum symtype symtype, const struct name *sym,
-                           uint32_t *resultp)
+static uint32_t
+dyld_symbol_address(struct dyld_object *refobj, struct dyld_object *obj,
+                    enum symtype symtype, const struct name *sym, uint32_t idx)
 {
         struct dyld *d = refobj->dyld;
-        enum externtype etype;
-        if (symtype == SYM_TYPE_FUNC) {
-                etype = EXTERNTYPE_FUNC;
-        } else {
-                etype = EXTERNTYPE_GLOBAL;
-        }
-        const struct module *m = obj->module;
-        uint32_t idx;
-        int ret;
-        ret = module_find_export(m, sym, etype, &idx);
-        if (ret != 0) {
-                return ENOENT;
-        }
         const struct instance *inst = obj->instance;
         uint32_t addr;
         if (symtype == SYM_TYPE_FUNC) {
@@ -1186,9 +1204,7 @@ dyld_resolve_symbol_in_obj(struct dyld_object *refobj, struct dyld_object *obj,
                 addr = dyld_register_funcinst(d, obj, fi);
         } else {
                 struct globalinst *gi = VEC_ELEM(inst->globals, idx);
-                if (!is_global_type_i32_const(gi->type)) {
-                        return ENOENT;
-                }
+                assert(is_global_type_i32_const(gi->type));
                 /*
                  * TODO: consult WASM_DYLINK_EXPORT_INFO
                  * subsection to check TLS.
@@ -1200,7 +1216,32 @@ dyld_resolve_symbol_in_obj(struct dyld_object *refobj, struct dyld_object *obj,
                    " addr %08" PRIx32,
                    symtype_str(symtype), CSTR(refobj->name), CSTR(sym),
                    CSTR(obj->name), idx, addr);
-        *resultp = addr;
+        return addr;
+}
+
+int
+dyld_resolve_symbol_in_obj(struct dyld_object *refobj, struct dyld_object *obj,
+                           enum symtype symtype, const struct name *sym,
+                           uint32_t *resultp)
+{
+        enum externtype etype;
+        if (symtype == SYM_TYPE_FUNC) {
+                etype = EXTERNTYPE_FUNC;
+        } else {
+                etype = EXTERNTYPE_GLOBAL;
+        }
+        const struct module *m = obj->module;
+        uint32_t idx;
+        int ret;
+        ret = module_find_export(m, sym, etype, &idx);
+        if (ret != 0) {
+                return ENOENT;
+        }
+        if (symtype == SYM_TYPE_MEM &&
+            !is_global_type_i32_const(module_globaltype(m, idx))) {
+                return ENOENT;
+        }
+        *resultp = dyld_symbol_address(refobj, obj, symtype, sym, idx);
         return 0;
 }
 
@@ -1208,14 +1249,12 @@ int
 dyld_resolve_symbol(struct dyld_object *refobj, enum symtype symtype,
                     const struct name *sym, uint32_t *resultp)
 {
-        struct dyld *d = refobj->dyld;
-        struct dyld_object *obj;
-        SLIST_FOREACH(obj, &d->objs, q) {
-                int ret = dyld_resolve_symbol_in_obj(refobj, obj, symtype, sym,
-                                                     resultp);
-                if (ret == 0) {
-                        return 0;
-                }
+        const struct dyld_symbol *s =
+                dyld_symtab_lookup(refobj->dyld, symtype, sym);
+        if (s != NULL) {
+                *resultp = dyld_symbol_address(refobj, s->obj, symtype, sym,
+                                               s->idx);
+                return 0;
         }
         if (is_binding_weak(refobj->module, sym)) {
                 *resultp = 0;
@@ -1401,6 +1440,7 @@ dyld_clear(struct dyld *d)
                 SLIST_REMOVE_HEAD(&d->objs, obj, q);
                 dyld_object_destroy(obj);
         }
+        dyld_symtab_clear(d);
         if (d->pie) {
                 if (d->meminst != NULL) {
                         memory_instance_destroy(mctx, d->meminst);
@@ -1,14 +1,48 @@
 #include <stdint.h>
 
+#include "hash_index.h"
 #include "host_instance.h"
+#include "lock.h"
 #include "platform.h"
 #include "slist.h"
 #include "toywasm_config.h"
 #include "type.h"
 #include "vec.h"
 
+struct dyld_module_cache_entry;
 struct dyld_object;
+struct dyld_symbol;
 struct mem_context;
+struct profiler;
+
+/*
+ * a cache of loaded modules, which can be shared among multiple
+ * struct dyld. (possibly running on different threads)
+ *
+ * the cache owns the mapped files and the loaded modules.
+ * it should outlive all struct dyld using it.
+ */
+struct dyld_module_cache {
+        TOYWASM_MUTEX_DEFINE(lock);
+        /* least recently released first */
+        SLIST_HEAD(struct dyld_module_cache_entry) entries;
+        struct mem_context *mctx;
+
+        /*
+         * the max number of the entries kept while nobody uses them.
+         * the least recently released ones are evicted first.
+         */
+        uint32_t max_unused;
+        uint32_t nunused;
+
+        /* statistics */
+        uint64_t nhits;
+        uint64_t ncompared_hits; /* hits after comparing the contents */
+        uint64_t nmisses;
+        uint64_t nevictions;
+};
+
+#define DYLD_MODULE_CACHE_DEFAULT_MAX_UNUSED 16
 
 struct dyld_options {
         struct import_object *base_import_obj;
@@ -36,9 +70,31 @@ struct dyld_options {
          */
         bool bindnow;
 
+        /*
+         * a cache of loaded modules.
+         * NULL means to load modules for each struct dyld.
+         */
+        struct dyld_module_cache *module_cache;
+
 #if defined(TOYWASM_ENABLE_DYLD_DLFCN)
         bool enable_dlfcn;
 #endif
+
+#if defined(TOYWASM_ENABLE_PROFILER)
+        /*
+         * a profiler which might have samples from the objects.
+         * the objects are passed to profiler_forget_module on unload.
+         */
+        struct profiler *profiler;
+#endif
+};
+
+/*
+ * a hash table of symbols exported by the loaded objects.
+ */
+struct dyld_symtab {
+        VEC(, struct dyld_symbol) syms;
+        struct hash_index index; /* indexes in syms */
 };
 
 struct dyld {
@@ -73,6 +129,7 @@ struct dyld {
         } u;
 
         SLIST_HEAD(struct dyld_object) objs;
+        struct dyld_symtab symtab;
 
         struct dyld_options opts;
 
@@ -102,4 +159,9 @@ int import_object_create_for_dyld(struct mem_context *mctx, struct dyld *d,
                                   struct import_object **impp);
 void dyld_print_stats(struct dyld *d);
 
+void dyld_module_cache_init(struct dyld_module_cache *c,
+                            struct mem_context *mctx);
+void dyld_module_cache_clear(struct dyld_module_cache *c);
+void dyld_module_cache_print_stats(struct dyld_module_cache *c);
+
 __END_EXTERN_C
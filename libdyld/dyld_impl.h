@@ -15,6 +15,7 @@ struct dyld_plt {
         const struct funcinst *finst;
         const struct name *sym;
         struct dyld_object *refobj;
+        uint32_t funcidx; /* the index of the import in refobj */
         struct funcinst pltfi;
 };
 
@@ -40,6 +41,7 @@ struct dyld_object {
         size_t binsz;
         struct module *module;
         struct instance *instance;
+        struct dyld_module_cache_entry *cache_entry;
 
         struct mem_context module_mctx;
         struct mem_context instance_mctx;
@@ -52,11 +54,59 @@ struct dyld_object {
         SLIST_ENTRY(struct dyld_object) tq;
 };
 
+/* identifies a version of a file. see dyld_module_cache_get */
+struct dyld_file_id {
+        uint64_t dev;
+        uint64_t ino;
+        uint64_t size;
+        uint64_t mtime_ns;
+};
+
+struct dyld_module_cache_entry {
+        char *path;
+        size_t pathlen;
+        struct dyld_file_id id;
+        const uint8_t *bin;
+        size_t binsz;
+        struct module *module;
+        uint32_t refcount;
+        struct mem_context module_mctx;
+        SLIST_ENTRY(struct dyld_module_cache_entry) q;
+};
+
+/*
+ * an entry in struct dyld_symtab.
+ *
+ * when multiple objects export the same symbol, the first loaded one
+ * wins, the same as the linear search of the objects in load order.
+ */
+struct dyld_symbol {
+        const struct name *name;
+        struct dyld_object *obj;
+        uint32_t hash;
+        uint32_t idx; /* funcidx or globalidx in obj */
+        enum symtype symtype;
+};
+
 struct dyld_dynamic_object {
         struct name name;
         struct dyld_object *obj;
 };
 
+int dyld_module_cache_get(struct dyld_module_cache *c, const char *path,
+                          struct dyld_module_cache_entry **ep);
+void dyld_module_cache_put(struct dyld_module_cache *c,
+                           struct dyld_module_cache_entry *e);
+
+bool is_global_type_i32_const(const struct globaltype *gt);
+
+int dyld_symtab_reserve(struct dyld *d, uint32_t n);
+void dyld_symtab_add_object(struct dyld *d, struct dyld_object *obj);
+const struct dyld_symbol *dyld_symtab_lookup(const struct dyld *d,
+                                             enum symtype symtype,
+                                             const struct name *name);
+void dyld_symtab_clear(struct dyld *d);
+
 int dyld_resolve_dependencies(struct dyld *d, struct dyld_object *obj,
                               bool bindnow);
 int dyld_execute_all_init_funcs(struct dyld *d, struct dyld_object *start);
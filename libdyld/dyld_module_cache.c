@@ -0,0 +1,352 @@
+#define _DARWIN_C_SOURCE /* st_mtimespec */
+#define _GNU_SOURCE      /* st_mtim */
+#define _NETBSD_SOURCE   /* st_mtim */
+
+#include <sys/stat.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "dyld.h"
+#include "dyld_impl.h"
+#include "fileio.h"
+#include "load_context.h"
+#include "lock.h"
+#include "mem.h"
+#include "module.h"
+#include "report.h"
+#include "xlog.h"
+
+/*
+ * a cache of loaded modules.
+ *
+ * a cache entry is keyed by the file path and the file id (dev, ino,
+ * size and mtime) from stat. a cache hit doesn't read the file.
+ * when the file id has changed, the file contents are compared with
+ * the cached ones. if they are the same, (eg. touched) the entry is
+ * updated with the new file id and reused.
+ *
+ * Note: we don't keep a hash of the contents. the stat identity is
+ * enough for the common case. when it doesn't match, we need to read
+ * the file anyway. comparing it with the cached copy with memcmp costs
+ * about the same as hashing it, and has no false positives.
+ *
+ * an entry is kept in the cache even after its reference count drops to
+ * zero so that later dyld_load can reuse it. up to max_unused of such
+ * entries are kept. beyond that, the least recently released one is
+ * destroyed. an unused entry is also destroyed when the cache is cleared
+ * or when we notice the file has been changed.
+ *
+ * Note: as the cache maps the files, a file should be replaced with
+ * a new one (eg. rename) rather than modified in place, as is usual
+ * for native shared libraries.
+ *
+ * the lock is not held while loading a module. when two threads load
+ * the same file at the same time, the first one inserted wins and
+ * the other one discards its module.
+ */
+
+static int
+get_file_id(const char *path, struct dyld_file_id *id)
+{
+        struct stat st;
+        if (stat(path, &st) == -1) {
+                int ret = errno;
+                assert(ret != 0);
+                return ret;
+        }
+        memset(id, 0, sizeof(*id));
+        id->dev = st.st_dev;
+        id->ino = st.st_ino;
+        id->size = st.st_size;
+#if defined(__APPLE__)
+        id->mtime_ns = (uint64_t)st.st_mtimespec.tv_sec * 1000000000 +
+                       st.st_mtimespec.tv_nsec;
+#else
+        id->mtime_ns =
+                (uint64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+        return 0;
+}
+
+static bool
+file_id_eq(const struct dyld_file_id *a, const struct dyld_file_id *b)
+{
+        return a->dev == b->dev && a->ino == b->ino && a->size == b->size &&
+               a->mtime_ns == b->mtime_ns;
+}
+
+void
+dyld_module_cache_init(struct dyld_module_cache *c, struct mem_context *mctx)
+{
+        toywasm_mutex_init(&c->lock);
+        SLIST_HEAD_INIT(&c->entries);
+        c->mctx = mctx;
+        c->max_unused = DYLD_MODULE_CACHE_DEFAULT_MAX_UNUSED;
+        c->nunused = 0;
+        c->nhits = 0;
+        c->ncompared_hits = 0;
+        c->nmisses = 0;
+        c->nevictions = 0;
+}
+
+static void
+cache_entry_destroy(struct dyld_module_cache *c,
+                    struct dyld_module_cache_entry *e)
+{
+        assert(e->refcount == 0);
+        xlog_trace("dyld: module cache: destroying %s", e->path);
+        if (e->module != NULL) {
+                module_destroy(&e->module_mctx, e->module);
+        }
+        if (e->bin != NULL) {
+                unmap_file((void *)e->bin, e->binsz);
+        }
+        mem_context_clear(&e->module_mctx);
+        mem_free(c->mctx, e->path, e->pathlen + 1);
+        mem_free(c->mctx, e, sizeof(*e));
+}
+
+void
+dyld_module_cache_clear(struct dyld_module_cache *c)
+{
+        struct dyld_module_cache_entry *e;
+        while ((e = SLIST_FIRST(&c->entries)) != NULL) {
+                SLIST_REMOVE_HEAD(&c->entries, e, q);
+                cache_entry_destroy(c, e);
+        }
+        toywasm_mutex_destroy(&c->lock);
+}
+
+static int
+cache_entry_create(struct dyld_module_cache *c, const char *path,
+                   size_t pathlen, const struct dyld_file_id *id,
+                   const uint8_t *bin, size_t binsz,
+                   struct dyld_module_cache_entry **ep)
+{
+        struct dyld_module_cache_entry *e;
+        int ret;
+        e = mem_zalloc(c->mctx, sizeof(*e));
+        if (e == NULL) {
+                return ENOMEM;
+        }
+        mem_context_init(&e->module_mctx);
+        e->module_mctx.parent = c->mctx;
+        e->path = mem_alloc(c->mctx, pathlen + 1);
+        if (e->path == NULL) {
+                mem_context_clear(&e->module_mctx);
+                mem_free(c->mctx, e, sizeof(*e));
+                return ENOMEM;
+        }
+        memcpy(e->path, path, pathlen + 1);
+        e->pathlen = pathlen;
+        e->id = *id;
+        e->bin = bin;
+        e->binsz = binsz;
+        struct load_context lctx;
+        load_context_init(&lctx, &e->module_mctx);
+        ret = module_create(&e->module, bin, bin + binsz, &lctx);
+        if (ret != 0) {
+                xlog_error("module_create failed with %d: %s", ret,
+                           report_getmessage(&lctx.report));
+                load_context_clear(&lctx);
+                /* the caller unmaps the file */
+                e->bin = NULL;
+                cache_entry_destroy(c, e);
+                return ret;
+        }
+        load_context_clear(&lctx);
+        *ep = e;
+        return 0;
+}
+
+/*
+ * look up an entry for the path.
+ * unused entries for other versions of the file are purged.
+ *
+ * if bin is not NULL, an entry with the same contents is accepted
+ * as well. its file id is updated.
+ */
+static struct dyld_module_cache_entry *
+cache_lookup(struct dyld_module_cache *c, const char *path, size_t pathlen,
+             const struct dyld_file_id *id, const uint8_t *bin, size_t binsz)
+{
+        struct dyld_module_cache_entry *e;
+        struct dyld_module_cache_entry *prev = NULL;
+        e = SLIST_FIRST(&c->entries);
+        while (e != NULL) {
+                struct dyld_module_cache_entry *next = SLIST_NEXT(e, q);
+                if (e->pathlen == pathlen && !memcmp(e->path, path, pathlen)) {
+                        if (file_id_eq(&e->id, id)) {
+                                return e;
+                        }
+                        if (bin != NULL && e->binsz == binsz &&
+                            !memcmp(e->bin, bin, binsz)) {
+                                e->id = *id;
+                                return e;
+                        }
+                        if (bin != NULL && e->refcount == 0) {
+                                /* the file has been changed. */
+                                SLIST_REMOVE(&c->entries, prev, e, q);
+                                assert(c->nunused > 0);
+                                c->nunused--;
+                                c->nevictions++;
+                                cache_entry_destroy(c, e);
+                                e = next;
+                                continue;
+                        }
+                }
+                prev = e;
+                e = next;
+        }
+        return NULL;
+}
+
+static void
+cache_entry_ref(struct dyld_module_cache *c, struct dyld_module_cache_entry *e)
+{
+        if (e->refcount == 0) {
+                assert(c->nunused > 0);
+                c->nunused--;
+        }
+        e->refcount++;
+}
+
+int
+dyld_module_cache_get(struct dyld_module_cache *c, const char *path,
+                      struct dyld_module_cache_entry **ep)
+{
+        struct dyld_module_cache_entry *e;
+        struct dyld_module_cache_entry *ne;
+        struct dyld_file_id id;
+        const uint8_t *bin;
+        size_t binsz;
+        int ret;
+
+        /*
+         * Note: stat before map_file. if the file is replaced in
+         * between, the entry gets the old id with the new contents,
+         * which is only a false miss for the next lookup.
+         */
+        ret = get_file_id(path, &id);
+        if (ret != 0) {
+                return ret;
+        }
+        const size_t pathlen = strlen(path);
+        toywasm_mutex_lock(&c->lock);
+        e = cache_lookup(c, path, pathlen, &id, NULL, 0);
+        if (e != NULL) {
+                cache_entry_ref(c, e);
+                c->nhits++;
+        }
+        toywasm_mutex_unlock(&c->lock);
+        if (e != NULL) {
+                xlog_trace("dyld: module cache hit: %s", path);
+                *ep = e;
+                return 0;
+        }
+
+        ret = map_file(path, (void *)&bin, &binsz);
+        if (ret != 0) {
+                return ret;
+        }
+        toywasm_mutex_lock(&c->lock);
+        e = cache_lookup(c, path, pathlen, &id, bin, binsz);
+        if (e != NULL) {
+                cache_entry_ref(c, e);
+                c->ncompared_hits++;
+        }
+        toywasm_mutex_unlock(&c->lock);
+        if (e != NULL) {
+                xlog_trace("dyld: module cache hit after comparing the "
+                           "contents: %s",
+                           path);
+                unmap_file((void *)bin, binsz);
+                *ep = e;
+                return 0;
+        }
+        xlog_trace("dyld: module cache miss: %s", path);
+        ret = cache_entry_create(c, path, pathlen, &id, bin, binsz, &ne);
+        if (ret != 0) {
+                unmap_file((void *)bin, binsz);
+                return ret;
+        }
+        toywasm_mutex_lock(&c->lock);
+        /* another thread might have loaded it meanwhile */
+        e = cache_lookup(c, path, pathlen, &id, NULL, 0);
+        if (e == NULL) {
+                SLIST_INSERT_TAIL(&c->entries, ne, q);
+                ne->refcount++;
+                e = ne;
+                ne = NULL;
+                c->nmisses++;
+        } else {
+                cache_entry_ref(c, e);
+                c->nhits++;
+        }
+        toywasm_mutex_unlock(&c->lock);
+        if (ne != NULL) {
+                xlog_trace("dyld: module cache lost a race: %s", path);
+                cache_entry_destroy(c, ne);
+        }
+        *ep = e;
+        return 0;
+}
+
+static void
+cache_remove(struct dyld_module_cache *c, struct dyld_module_cache_entry *e)
+{
+        struct dyld_module_cache_entry *prev = NULL;
+        struct dyld_module_cache_entry *it;
+        SLIST_FOREACH(it, &c->entries, q) {
+                if (it == e) {
+                        SLIST_REMOVE(&c->entries, prev, e, q);
+                        return;
+                }
+                prev = it;
+        }
+        assert(false);
+}
+
+/*
+ * destroy the least recently released unused entries
+ * to keep the number of them <= max_unused.
+ */
+static void
+cache_evict(struct dyld_module_cache *c)
+{
+        while (c->nunused > c->max_unused) {
+                struct dyld_module_cache_entry *e;
+                SLIST_FOREACH(e, &c->entries, q) {
+                        if (e->refcount == 0) {
+                                break;
+                        }
+                }
+                assert(e != NULL);
+                xlog_trace("dyld: module cache evicting %s", e->path);
+                cache_remove(c, e);
+                c->nunused--;
+                c->nevictions++;
+                cache_entry_destroy(c, e);
+        }
+}
+
+void
+dyld_module_cache_put(struct dyld_module_cache *c,
+                      struct dyld_module_cache_entry *e)
+{
+        toywasm_mutex_lock(&c->lock);
+        assert(e->refcount > 0);
+        e->refcount--;
+        if (e->refcount == 0) {
+                /* move to the tail to keep the list in the lru order */
+                cache_remove(c, e);
+                SLIST_INSERT_TAIL(&c->entries, e, q);
+                c->nunused++;
+                cache_evict(c);
+        }
+        toywasm_mutex_unlock(&c->lock);
+}
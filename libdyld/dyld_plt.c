@@ -1,5 +1,6 @@
 #include <assert.h>
 #include <inttypes.h>
+#include <stdint.h>
 
 #include "dyld.h"
 #include "dyld_impl.h"
@@ -8,6 +9,36 @@
 #include "instance.h"
 #include "xlog.h"
 
+/*
+ * self-patching PLT
+ *
+ * once the symbol is resolved, replace the importing instance's funcinst
+ * slot for the import with the resolved function. after that,
+ * "call" instructions in the importing instance call the resolved
+ * function directly without the PLT trampoline.
+ *
+ * Note: references to the PLT funcinst which have been taken before
+ * the patching (eg. exports, table elements) keep using the PLT.
+ * it's still correct, just slower.
+ *
+ * Note: as dyld doesn't support threads, we don't bother to make
+ * this atomic.
+ */
+static void
+dyld_patch_plt(struct dyld_plt *plt)
+{
+        struct instance *inst = plt->refobj->instance;
+        if (inst == NULL) {
+                return;
+        }
+        struct funcinst **fip = &VEC_ELEM(inst->funcs, plt->funcidx);
+        assert(*fip == &plt->pltfi || *fip == plt->finst);
+        /* cast away the const. we never modify the funcinst itself. */
+        *fip = (struct funcinst *)(uintptr_t)plt->finst;
+        xlog_trace("dyld: PLT patched %.*s %.*s funcidx %" PRIu32,
+                   CSTR(plt->refobj->name), CSTR(plt->sym), plt->funcidx);
+}
+
 int
 dyld_resolve_plt(struct exec_context *ectx, struct dyld_plt *plt)
 {
@@ -30,6 +61,7 @@ dyld_resolve_plt(struct exec_context *ectx, struct dyld_plt *plt)
         xlog_trace("dyld: PLT resolved %.*s %.*s to addr %08" PRIx32
                    " finst %p",
                    CSTR(refobj->name), CSTR(sym), addr, (void *)plt->finst);
+        dyld_patch_plt(plt);
         return 0;
 }
 
@@ -50,15 +82,6 @@ dyld_plt(struct exec_context *ctx, struct host_instance *hi,
                 }
         }
 
-#if 0 /* a bit dirty */
-        /*
-         * modify our funcinst so that next call will have no PLT overhead.
-         * if you enable this, you need to relax the assertion in
-         * funcinst_func.
-         */
-        plt->pltfi = *plt->finst;
-#endif
-
         /*
          * set up a call to the resolved function.
          *
@@ -1,6 +1,9 @@
+#include <inttypes.h>
+
 #include "dyld.h"
 #include "dyld_impl.h"
 #include "escape.h"
+#include "lock.h"
 #include "mem.h"
 #include "nbio.h"
 
@@ -11,6 +14,11 @@ dyld_print_stats(struct dyld *d)
         SLIST_FOREACH(obj, &d->objs, q) {
                 struct escaped_string e;
                 escape_name(&e, obj->name);
+                /* Note: a cached module can be shared with other dylds */
+                const struct mem_context *module_mctx =
+                        (obj->cache_entry != NULL)
+                                ? &obj->cache_entry->module_mctx
+                                : &obj->module_mctx;
 
                 nbio_printf("%12.*s"
 #if defined(TOYWASM_ENABLE_HEAP_TRACKING)
@@ -29,10 +37,10 @@ dyld_print_stats(struct dyld *d)
                             ECSTR(&e)
 #if defined(TOYWASM_ENABLE_HEAP_TRACKING)
                                     ,
-                            obj->module_mctx.allocated
+                            module_mctx->allocated
 #if defined(TOYWASM_ENABLE_HEAP_TRACKING_PEAK)
                             ,
-                            obj->module_mctx.peak
+                            module_mctx->peak
 #endif
 #endif
 #if defined(TOYWASM_ENABLE_HEAP_TRACKING)
@@ -47,3 +55,15 @@ dyld_print_stats(struct dyld *d)
                 escaped_string_clear(&e);
         }
 }
+
+void
+dyld_module_cache_print_stats(struct dyld_module_cache *c)
+{
+        toywasm_mutex_lock(&c->lock);
+        nbio_printf("dyld module cache: hits %" PRIu64
+                    " compared_hits %" PRIu64 " misses %" PRIu64
+                    " evictions %" PRIu64 " unused %" PRIu32 "\n",
+                    c->nhits, c->ncompared_hits, c->nmisses, c->nevictions,
+                    c->nunused);
+        toywasm_mutex_unlock(&c->lock);
+}
@@ -0,0 +1,130 @@
+#include <errno.h>
+#include <stdint.h>
+
+#include "dyld.h"
+#include "dyld_impl.h"
+#include "hash_index.h"
+#include "mem.h"
+#include "type.h"
+#include "vec.h"
+
+/*
+ * a global symbol table for dyld_resolve_symbol.
+ *
+ * it's built incrementally as objects are loaded. it maps
+ * (symtype, name) to the first loaded object exporting the symbol.
+ * this makes a lookup O(1) instead of O(number of objects).
+ */
+
+static uint32_t
+symbol_hash(enum symtype symtype, const struct name *name)
+{
+        return name_hash(name, (uint32_t)symtype);
+}
+
+static uint32_t
+symtab_entry_hash(const void *arg, uint32_t idx)
+{
+        const struct dyld_symtab *tab = arg;
+        return VEC_ELEM(tab->syms, idx).hash;
+}
+
+static struct dyld_symbol *
+symtab_find(const struct dyld_symtab *tab, enum symtype symtype,
+            const struct name *name, uint32_t hash)
+{
+        uint32_t pos = hash;
+        uint32_t idx;
+        while (hash_index_next(&tab->index, &pos, &idx)) {
+                struct dyld_symbol *s = &VEC_ELEM(tab->syms, idx);
+                if (s->hash == hash && s->symtype == symtype &&
+                    !compare_name(s->name, name)) {
+                        return s;
+                }
+        }
+        return NULL;
+}
+
+/*
+ * make room for n more symbols.
+ */
+int
+dyld_symtab_reserve(struct dyld *d, uint32_t n)
+{
+        struct dyld_symtab *tab = &d->symtab;
+        int ret = hash_index_reserve(d->mctx, &tab->index, tab->syms.lsize,
+                                     n, symtab_entry_hash, tab);
+        if (ret != 0) {
+                return ret;
+        }
+        return VEC_PREALLOC(d->mctx, tab->syms, n);
+}
+
+static void
+symtab_add(struct dyld_symtab *tab, struct dyld_object *obj,
+           enum symtype symtype, const struct name *name, uint32_t idx)
+{
+        uint32_t hash = symbol_hash(symtype, name);
+        if (symtab_find(tab, symtype, name, hash) != NULL) {
+                /* an earlier object has the symbol. it wins. */
+                return;
+        }
+        uint32_t symidx = tab->syms.lsize;
+        struct dyld_symbol *s = VEC_PUSH(tab->syms);
+        s->name = name;
+        s->obj = obj;
+        s->hash = hash;
+        s->idx = idx;
+        s->symtype = symtype;
+        hash_index_insert(&tab->index, hash, symidx);
+}
+
+/*
+ * add the exports of obj.
+ * the caller should have reserved the room with dyld_symtab_reserve.
+ */
+void
+dyld_symtab_add_object(struct dyld *d, struct dyld_object *obj)
+{
+        struct dyld_symtab *tab = &d->symtab;
+        const struct module *m = obj->module;
+        uint32_t i;
+        for (i = 0; i < m->nexports; i++) {
+                const struct wasm_export *ex = &m->exports[i];
+                const struct exportdesc *exd = &ex->desc;
+                if (exd->type == EXTERNTYPE_FUNC) {
+                        /*
+                         * a re-export of an imported function is not
+                         * a definition. eg. a PLT. resolving a symbol
+                         * to it would make the PLT call itself.
+                         */
+                        if (exd->idx < m->nimportedfuncs) {
+                                continue;
+                        }
+                        symtab_add(tab, obj, SYM_TYPE_FUNC, &ex->name,
+                                   exd->idx);
+                } else if (exd->type == EXTERNTYPE_GLOBAL &&
+                           is_global_type_i32_const(
+                                   module_globaltype(m, exd->idx))) {
+                        symtab_add(tab, obj, SYM_TYPE_MEM, &ex->name,
+                                   exd->idx);
+                }
+        }
+}
+
+const struct dyld_symbol *
+dyld_symtab_lookup(const struct dyld *d, enum symtype symtype,
+                   const struct name *name)
+{
+        const struct dyld_symtab *tab = &d->symtab;
+        uint32_t hash = symbol_hash(symtype, name);
+        return symtab_find(tab, symtype, name, hash);
+}
+
+void
+dyld_symtab_clear(struct dyld *d)
+{
+        struct dyld_symtab *tab = &d->symtab;
+        VEC_FREE(d->mctx, tab->syms);
+        hash_index_clear(d->mctx, &tab->index);
+}
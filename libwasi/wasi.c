@@ -34,6 +34,7 @@
 #include "mem.h"
 #include "nbio.h"
 #include "wasi.h"
+#include "wasi_host_aio.h"
 #include "wasi_impl.h"
 #include "xlog.h"
 
@@ -301,6 +302,11 @@ wasi_instance_destroy(struct wasi_instance *inst)
         for (i = 0; i < WASI_NTABLES; i++) {
                 wasi_table_clear(inst, i);
         }
+#if defined(TOYWASM_ENABLE_WASI_IO_URING)
+        if (inst->aio != NULL) {
+                wasi_aio_destroy(inst->aio);
+        }
+#endif
         toywasm_cv_destroy(&inst->cv);
         toywasm_mutex_destroy(&inst->lock);
         mem_free(inst->mctx, inst, sizeof(*inst));
@@ -7,6 +7,7 @@
 
 #include "endian.h"
 #include "nbio.h"
+#include "wasi_host_aio.h"
 #include "wasi_impl.h"
 #include "wasi_poll_subr.h"
 #include "wasi_subr.h"
@@ -197,6 +198,15 @@ wasi_fd_write(struct exec_context *ctx, struct host_instance *hi,
                 goto fail;
         }
         size_t n;
+#if defined(TOYWASM_ENABLE_WASI_IO_URING)
+        if (wasi_aio_rw(ctx, wasi, fdinfo, true, hostiov, iov_count, -1, &n,
+                        &host_ret, &ret)) {
+                if (host_ret != 0 || ret != 0) {
+                        goto fail;
+                }
+                goto done;
+        }
+#endif
 retry:
         ret = wasi_vfs_fd_writev(fdinfo, hostiov, iov_count, &n);
         if (ret != 0) {
@@ -206,6 +216,9 @@ retry:
                 }
                 goto fail;
         }
+#if defined(TOYWASM_ENABLE_WASI_IO_URING)
+done:
+#endif
         if (n > UINT32_MAX) {
                 ret = EOVERFLOW;
                 goto fail;
@@ -215,6 +228,9 @@ retry:
                                 WASI_U32_ALIGN);
         ret = 0;
 fail:
+#if defined(TOYWASM_ENABLE_WASI_IO_URING)
+        wasi_aio_fail(ctx, host_ret);
+#endif
         wasi_fdinfo_release(wasi, fdinfo);
         if (host_ret == 0) {
                 HOST_FUNC_RESULT_SET(ft, results, 0, i32,
@@ -256,6 +272,16 @@ wasi_fd_pwrite(struct exec_context *ctx, struct host_instance *hi,
                 goto fail;
         }
         size_t n;
+#if defined(TOYWASM_ENABLE_WASI_IO_URING)
+        if (offset <= INT64_MAX &&
+            wasi_aio_rw(ctx, wasi, fdinfo, true, hostiov, iov_count,
+                        (int64_t)offset, &n, &host_ret, &ret)) {
+                if (host_ret != 0 || ret != 0) {
+                        goto fail;
+                }
+                goto done;
+        }
+#endif
 retry:
         ret = wasi_vfs_fd_pwritev(fdinfo, hostiov, iov_count, offset, &n);
         if (ret != 0) {
@@ -265,6 +291,9 @@ retry:
                 }
                 goto fail;
         }
+#if defined(TOYWASM_ENABLE_WASI_IO_URING)
+done:
+#endif
         if (n > UINT32_MAX) {
                 ret = EOVERFLOW;
                 goto fail;
@@ -274,6 +303,9 @@ retry:
                                 WASI_U32_ALIGN);
         ret = 0;
 fail:
+#if defined(TOYWASM_ENABLE_WASI_IO_URING)
+        wasi_aio_fail(ctx, host_ret);
+#endif
         wasi_fdinfo_release(wasi, fdinfo);
         if (host_ret == 0) {
                 HOST_FUNC_RESULT_SET(ft, results, 0, i32,
@@ -315,6 +347,16 @@ wasi_fd_read(struct exec_context *ctx, struct host_instance *hi,
         }
         size_t n;
 
+#if defined(TOYWASM_ENABLE_WASI_IO_URING)
+        if (wasi_aio_rw(ctx, wasi, fdinfo, false, hostiov, iov_count, -1, &n,
+                        &host_ret, &ret)) {
+                if (host_ret != 0 || ret != 0) {
+                        goto fail;
+                }
+                goto done;
+        }
+#endif
+
         if (wasi_fdinfo_is_host(fdinfo)) {
                 /* hack for tty. see the comment in wasi_instance_create. */
                 uint16_t fflags;
@@ -340,6 +382,9 @@ tty_hack:
                 }
                 goto fail;
         }
+#if defined(TOYWASM_ENABLE_WASI_IO_URING)
+done:
+#endif
         if (n > UINT32_MAX) {
                 ret = EOVERFLOW;
                 goto fail;
@@ -349,6 +394,9 @@ tty_hack:
                                 WASI_U32_ALIGN);
         ret = 0;
 fail:
+#if defined(TOYWASM_ENABLE_WASI_IO_URING)
+        wasi_aio_fail(ctx, host_ret);
+#endif
         wasi_fdinfo_release(wasi, fdinfo);
         if (host_ret == 0) {
                 HOST_FUNC_RESULT_SET(ft, results, 0, i32,
@@ -390,6 +438,16 @@ wasi_fd_pread(struct exec_context *ctx, struct host_instance *hi,
                 goto fail;
         }
         size_t n;
+#if defined(TOYWASM_ENABLE_WASI_IO_URING)
+        if (offset <= INT64_MAX &&
+            wasi_aio_rw(ctx, wasi, fdinfo, false, hostiov, iov_count,
+                        (int64_t)offset, &n, &host_ret, &ret)) {
+                if (host_ret != 0 || ret != 0) {
+                        goto fail;
+                }
+                goto done;
+        }
+#endif
 retry:
         ret = wasi_vfs_fd_preadv(fdinfo, hostiov, iov_count, offset, &n);
         if (ret != 0) {
@@ -399,6 +457,9 @@ retry:
                 }
                 goto fail;
         }
+#if defined(TOYWASM_ENABLE_WASI_IO_URING)
+done:
+#endif
         if (n > UINT32_MAX) {
                 ret = EOVERFLOW;
                 goto fail;
@@ -408,6 +469,9 @@ retry:
                                 WASI_U32_ALIGN);
         ret = 0;
 fail:
+#if defined(TOYWASM_ENABLE_WASI_IO_URING)
+        wasi_aio_fail(ctx, host_ret);
+#endif
         wasi_fdinfo_release(wasi, fdinfo);
         if (host_ret == 0) {
                 HOST_FUNC_RESULT_SET(ft, results, 0, i32,
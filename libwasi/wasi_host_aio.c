@@ -0,0 +1,616 @@
+/*
+ * asynchronous file i/o for the host vfs, using linux io_uring.
+ *
+ * regular files are always "ready" for poll(2). thus our non-blocking
+ * i/o emulation (emulate_blocking) doesn't help them and a read from
+ * a slow file simply blocks the calling host thread.
+ *
+ * with TOYWASM_ENABLE_WASI_IO_URING, fd_read/fd_write and friends on
+ * a regular file are submitted to an io_uring instead. while the request
+ * is in flight, the host function returns a restartable error with
+ * RESTART_IO. it allows the user scheduler (TOYWASM_USE_USER_SCHED) to
+ * run other threads in the meantime. when the execution is restarted,
+ * the host function picks up the request from the restart_info.
+ *
+ * - we don't use liburing to avoid the dependency. the subset of
+ *   io_uring we need here is small.
+ *
+ * - the data is staged in a bounce buffer owned by the request,
+ *   rather than the wasm linear memory, because the latter can be
+ *   moved while the request is in flight. (eg. memory.grow on a shared
+ *   memory w/o TOYWASM_PREALLOC_SHARED_MEMORY)
+ *   because of this, a request is limited to WASI_AIO_MAX_BYTES.
+ *   larger requests end up with short reads/writes. (see wasi_aio_rw)
+ *
+ * - if io_uring is not available on the host (eg. old kernels, seccomp),
+ *   we silently fall back to the synchronous path.
+ *
+ * - an io_uring is shared by all threads using the wasi instance.
+ *   it's created on the first use.
+ *
+ * - when an exec_context waiting for a request is cleared without
+ *   restarting, the request is orphaned via restart_u.io.abandon.
+ *   thus exec_contexts should be cleared before the wasi instance
+ *   is destroyed.
+ */
+
+#define _GNU_SOURCE
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#include <linux/io_uring.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "exec.h"
+#include "list.h"
+#include "lock.h"
+#include "mem.h"
+#include "restart.h"
+#include "timeutil.h"
+#include "usched.h"
+#include "wasi_host_aio.h"
+#include "wasi_host_subr.h"
+#include "wasi_impl.h"
+#include "wasi_vfs_impl_host.h"
+#include "xlog.h"
+
+#define WASI_AIO_NENTRIES 64
+#define WASI_AIO_MAX_BYTES (1024 * 1024)
+
+struct wasi_aio_req {
+        LIST_ENTRY(struct wasi_aio_req) q;
+        struct wasi_aio *aio;
+        size_t bufsize;
+        bool done;
+        bool orphaned; /* nobody is interested in the result */
+        int32_t res;   /* cqe->res */
+        struct iovec iov;
+        uint8_t buf[];
+};
+
+struct wasi_aio {
+        struct mem_context *mctx;
+        TOYWASM_MUTEX_DEFINE(lock);
+        TOYWASM_CV_DEFINE(cv);
+        bool polling; /* a thread is polling ringfd */
+        uint32_t ninflight;
+        LIST_HEAD(struct wasi_aio_req) reqs;
+
+        int ringfd;
+        uint32_t nentries;
+
+        /* submission queue */
+        void *sq_ring;
+        size_t sq_ring_size;
+        _Atomic uint32_t *sq_head;
+        _Atomic uint32_t *sq_tail;
+        uint32_t sq_mask;
+        uint32_t *sq_array;
+        struct io_uring_sqe *sqes;
+        size_t sqes_size;
+
+        /* completion queue */
+        void *cq_ring;
+        size_t cq_ring_size;
+        _Atomic uint32_t *cq_head;
+        _Atomic uint32_t *cq_tail;
+        uint32_t cq_mask;
+        struct io_uring_cqe *cqes;
+};
+
+static int
+sys_io_uring_setup(unsigned int entries, struct io_uring_params *p)
+{
+        return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int
+sys_io_uring_enter(int fd, unsigned int to_submit, unsigned int min_complete,
+                   unsigned int flags)
+{
+        return syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+                       flags, NULL, 0);
+}
+
+static void
+wasi_aio_unmap(struct wasi_aio *aio)
+{
+        if (aio->sqes != NULL) {
+                munmap(aio->sqes, aio->sqes_size);
+        }
+        if (aio->cq_ring != NULL && aio->cq_ring != aio->sq_ring) {
+                munmap(aio->cq_ring, aio->cq_ring_size);
+        }
+        if (aio->sq_ring != NULL) {
+                munmap(aio->sq_ring, aio->sq_ring_size);
+        }
+        if (aio->ringfd != -1) {
+                close(aio->ringfd);
+        }
+}
+
+static int
+wasi_aio_create(struct mem_context *mctx,
+                struct wasi_aio **aiop) NO_THREAD_SAFETY_ANALYSIS
+{
+        struct io_uring_params p;
+        struct wasi_aio *aio;
+        void *vp;
+        int ret;
+
+        aio = mem_zalloc(mctx, sizeof(*aio));
+        if (aio == NULL) {
+                return ENOMEM;
+        }
+        aio->mctx = mctx;
+        aio->ringfd = -1;
+        memset(&p, 0, sizeof(p));
+        ret = sys_io_uring_setup(WASI_AIO_NENTRIES, &p);
+        if (ret == -1) {
+                ret = errno;
+                goto fail;
+        }
+        aio->ringfd = ret;
+        /*
+         * IORING_FEAT_RW_CUR_POS is necessary to implement fd_read and
+         * fd_write, which use the current file offset.
+         */
+        if ((p.features & IORING_FEAT_RW_CUR_POS) == 0) {
+                ret = ENOTSUP;
+                goto fail;
+        }
+        aio->nentries = p.sq_entries;
+        aio->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+        aio->cq_ring_size =
+                p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+        if ((p.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+                if (aio->cq_ring_size > aio->sq_ring_size) {
+                        aio->sq_ring_size = aio->cq_ring_size;
+                }
+                aio->cq_ring_size = aio->sq_ring_size;
+        }
+        vp = mmap(NULL, aio->sq_ring_size, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, aio->ringfd, IORING_OFF_SQ_RING);
+        if (vp == MAP_FAILED) {
+                ret = errno;
+                goto fail;
+        }
+        aio->sq_ring = vp;
+        if ((p.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+                aio->cq_ring = aio->sq_ring;
+        } else {
+                vp = mmap(NULL, aio->cq_ring_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, aio->ringfd,
+                          IORING_OFF_CQ_RING);
+                if (vp == MAP_FAILED) {
+                        ret = errno;
+                        goto fail;
+                }
+                aio->cq_ring = vp;
+        }
+        aio->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+        vp = mmap(NULL, aio->sqes_size, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, aio->ringfd, IORING_OFF_SQES);
+        if (vp == MAP_FAILED) {
+                ret = errno;
+                goto fail;
+        }
+        aio->sqes = vp;
+
+        uint8_t *sq = aio->sq_ring;
+        aio->sq_head = (void *)(sq + p.sq_off.head);
+        aio->sq_tail = (void *)(sq + p.sq_off.tail);
+        aio->sq_mask = *(uint32_t *)(sq + p.sq_off.ring_mask);
+        aio->sq_array = (void *)(sq + p.sq_off.array);
+        uint8_t *cq = aio->cq_ring;
+        aio->cq_head = (void *)(cq + p.cq_off.head);
+        aio->cq_tail = (void *)(cq + p.cq_off.tail);
+        aio->cq_mask = *(uint32_t *)(cq + p.cq_off.ring_mask);
+        aio->cqes = (void *)(cq + p.cq_off.cqes);
+
+        toywasm_mutex_init(&aio->lock);
+        toywasm_cv_init(&aio->cv);
+        LIST_HEAD_INIT(&aio->reqs);
+        xlog_trace("%s: io_uring created fd %d entries %" PRIu32, __func__,
+                   aio->ringfd, aio->nentries);
+        *aiop = aio;
+        return 0;
+fail:
+        assert(ret > 0);
+        wasi_aio_unmap(aio);
+        mem_free(mctx, aio, sizeof(*aio));
+        return ret;
+}
+
+static void
+wasi_aio_req_free(struct wasi_aio *aio, struct wasi_aio_req *req)
+        REQUIRES(aio->lock)
+{
+        LIST_REMOVE(&aio->reqs, req, q);
+        mem_free(aio->mctx, req, sizeof(*req) + req->bufsize);
+}
+
+/*
+ * consume the completion queue.
+ */
+static void
+wasi_aio_reap(struct wasi_aio *aio) REQUIRES(aio->lock)
+{
+        uint32_t head = atomic_load_explicit(aio->cq_head, memory_order_relaxed);
+        const uint32_t tail =
+                atomic_load_explicit(aio->cq_tail, memory_order_acquire);
+        while (head != tail) {
+                const struct io_uring_cqe *cqe = &aio->cqes[head & aio->cq_mask];
+                struct wasi_aio_req *req = (void *)(uintptr_t)cqe->user_data;
+                assert(!req->done);
+                req->res = cqe->res;
+                req->done = true;
+                assert(aio->ninflight > 0);
+                aio->ninflight--;
+                head++;
+                if (req->orphaned) {
+                        wasi_aio_req_free(aio, req);
+                }
+        }
+        atomic_store_explicit(aio->cq_head, head, memory_order_release);
+}
+
+static int
+wasi_aio_submit(struct wasi_aio *aio, struct wasi_aio_req *req, int hostfd,
+                bool is_write, int64_t off)
+{
+        int ret;
+
+        toywasm_mutex_lock(&aio->lock);
+        /*
+         * limit the number of requests in flight so that the completion
+         * queue (which is at least as large as the submission queue)
+         * never overflows.
+         */
+        if (aio->ninflight >= aio->nentries) {
+                ret = EBUSY;
+                goto fail;
+        }
+        const uint32_t tail =
+                atomic_load_explicit(aio->sq_tail, memory_order_relaxed);
+        const uint32_t idx = tail & aio->sq_mask;
+        struct io_uring_sqe *sqe = &aio->sqes[idx];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = is_write ? IORING_OP_WRITEV : IORING_OP_READV;
+        sqe->fd = hostfd;
+        sqe->off = (uint64_t)off;
+        sqe->addr = (uintptr_t)&req->iov;
+        sqe->len = 1;
+        sqe->user_data = (uintptr_t)req;
+        aio->sq_array[idx] = idx;
+        atomic_store_explicit(aio->sq_tail, tail + 1, memory_order_release);
+        ret = sys_io_uring_enter(aio->ringfd, 1, 0, 0);
+        if (ret != 1) {
+                /*
+                 * the sqe has not been consumed. take it back.
+                 */
+                ret = (ret == -1) ? errno : EIO;
+                atomic_store_explicit(aio->sq_tail, tail,
+                                      memory_order_relaxed);
+                goto fail;
+        }
+        aio->ninflight++;
+        LIST_INSERT_TAIL(&aio->reqs, req, q);
+        ret = 0;
+fail:
+        toywasm_mutex_unlock(&aio->lock);
+        return ret;
+}
+
+/*
+ * wait for the completion of the request.
+ *
+ * returns 0 when the request is completed.
+ * otherwise, returns a non-zero value from check_interrupt or
+ * ETOYWASMRESTART to yield the cpu to other threads.
+ */
+static int
+wasi_aio_wait(struct exec_context *ctx, struct wasi_aio *aio,
+              struct wasi_aio_req *req)
+{
+        const int interval_ms = check_interrupt_interval_ms(ctx);
+        int host_ret = 0;
+
+        toywasm_mutex_lock(&aio->lock);
+        while (true) {
+                wasi_aio_reap(aio);
+                if (req->done) {
+                        break;
+                }
+#if defined(TOYWASM_USE_USER_SCHED)
+                if (ctx->sched != NULL &&
+                    sched_has_other_runnable(ctx->sched)) {
+                        xlog_trace("%s: yielding", __func__);
+                        host_ret = ETOYWASMRESTART;
+                        break;
+                }
+#endif
+                if (!aio->polling) {
+                        /*
+                         * wait for the ring to have completions.
+                         * other threads can wait for us with the cv.
+                         */
+                        struct pollfd pfd;
+                        pfd.fd = aio->ringfd;
+                        pfd.events = POLLIN;
+                        aio->polling = true;
+                        toywasm_mutex_unlock(&aio->lock);
+                        int ret = poll(&pfd, 1, interval_ms);
+                        if (ret == -1) {
+                                xlog_trace("%s: poll failed with %d",
+                                           __func__, errno);
+                        }
+                        toywasm_mutex_lock(&aio->lock);
+                        aio->polling = false;
+                        wasi_aio_reap(aio);
+                        toywasm_cv_broadcast(&aio->cv, &aio->lock);
+                } else {
+                        struct timespec abstimeout;
+                        int ret = abstime_from_reltime_ms(
+                                CLOCK_REALTIME, &abstimeout, interval_ms);
+                        if (ret != 0) {
+                                host_ret = ret;
+                                break;
+                        }
+                        toywasm_cv_timedwait(&aio->cv, &aio->lock,
+                                             &abstimeout);
+                }
+                if (req->done) {
+                        break;
+                }
+                toywasm_mutex_unlock(&aio->lock);
+                host_ret = check_interrupt(ctx);
+                toywasm_mutex_lock(&aio->lock);
+                if (host_ret != 0) {
+                        break;
+                }
+        }
+        toywasm_mutex_unlock(&aio->lock);
+        return host_ret;
+}
+
+/*
+ * forget about the request. if it's still in flight, wasi_aio_reap
+ * frees it when it completes.
+ *
+ * also used as restart_info::restart_u.io.abandon, which is called
+ * when an exec_context is cleared while waiting for the request.
+ */
+static void
+wasi_aio_abandon(void *vp)
+{
+        struct wasi_aio_req *req = vp;
+        struct wasi_aio *aio = req->aio;
+        toywasm_mutex_lock(&aio->lock);
+        if (req->done) {
+                wasi_aio_req_free(aio, req);
+        } else {
+                xlog_trace("%s: orphaning req %p", __func__, (void *)req);
+                req->orphaned = true;
+        }
+        toywasm_mutex_unlock(&aio->lock);
+}
+
+static struct wasi_aio *
+wasi_aio_get(struct wasi_instance *wasi)
+{
+        struct wasi_aio *aio;
+        toywasm_mutex_lock(&wasi->lock);
+        aio = wasi->aio;
+        if (aio == NULL && !wasi->aio_unavailable) {
+                int ret = wasi_aio_create(wasi->mctx, &aio);
+                if (ret != 0) {
+                        xlog_trace("%s: io_uring is not available (%d)",
+                                   __func__, ret);
+                        wasi->aio_unavailable = true;
+                        aio = NULL;
+                } else {
+                        wasi->aio = aio;
+                }
+        }
+        toywasm_mutex_unlock(&wasi->lock);
+        return aio;
+}
+
+static bool
+fd_is_aio_capable(struct wasi_fdinfo *fdinfo)
+{
+        if (!wasi_fdinfo_is_host(fdinfo)) {
+                return false;
+        }
+        struct wasi_fdinfo_host *fdinfo_host = wasi_fdinfo_to_host(fdinfo);
+        if (fdinfo_host->hostfd == -1 || !fdinfo_host->user.blocking) {
+                return false;
+        }
+        if (fdinfo_host->aio == WASI_AIO_FD_UNKNOWN) {
+                /*
+                 * only regular files. for others, like pipes and sockets,
+                 * emulate_blocking works better.
+                 */
+                struct stat st;
+                if (fstat(fdinfo_host->hostfd, &st) == 0 &&
+                    S_ISREG(st.st_mode)) {
+                        fdinfo_host->aio = WASI_AIO_FD_CAPABLE;
+                } else {
+                        fdinfo_host->aio = WASI_AIO_FD_INCAPABLE;
+                }
+        }
+        return fdinfo_host->aio == WASI_AIO_FD_CAPABLE;
+}
+
+bool
+wasi_aio_rw(struct exec_context *ctx, struct wasi_instance *wasi,
+            struct wasi_fdinfo *fdinfo, bool is_write, const struct iovec *iov,
+            int iovcnt, int64_t off, size_t *resultp, int *host_retp,
+            int *retp)
+{
+        struct wasi_aio_req *req;
+        struct wasi_aio *aio;
+        struct restart_info *restart;
+        int host_ret = 0;
+        int ret;
+        int i;
+
+        if (!restart_info_is_none(ctx)) {
+                restart = &VEC_NEXTELEM(ctx->restarts);
+                assert(restart->restart_type == RESTART_IO);
+                req = restart->restart_u.io.req;
+                restart->restart_type = RESTART_NONE;
+                aio = wasi_aio_get(wasi);
+                assert(aio != NULL);
+                xlog_trace("%s: restarting req %p", __func__, (void *)req);
+        } else {
+                if (!fd_is_aio_capable(fdinfo)) {
+                        return false;
+                }
+                size_t len = 0;
+                for (i = 0; i < iovcnt && len < WASI_AIO_MAX_BYTES; i++) {
+                        len += iov[i].iov_len;
+                }
+                if (len > WASI_AIO_MAX_BYTES) {
+                        len = WASI_AIO_MAX_BYTES;
+                }
+                if (len == 0) {
+                        return false;
+                }
+                aio = wasi_aio_get(wasi);
+                if (aio == NULL) {
+                        return false;
+                }
+                /* to record the request in flight on a restart */
+                if (restart_info_prealloc(ctx) != 0) {
+                        return false;
+                }
+                restart = &VEC_NEXTELEM(ctx->restarts);
+                req = mem_alloc(aio->mctx, sizeof(*req) + len);
+                if (req == NULL) {
+                        return false;
+                }
+                req->aio = aio;
+                req->bufsize = len;
+                req->done = false;
+                req->orphaned = false;
+                req->iov.iov_base = req->buf;
+                req->iov.iov_len = len;
+                if (is_write) {
+                        size_t copied = 0;
+                        for (i = 0; i < iovcnt && copied < len; i++) {
+                                size_t n = iov[i].iov_len;
+                                if (n > len - copied) {
+                                        n = len - copied;
+                                }
+                                memcpy(req->buf + copied, iov[i].iov_base, n);
+                                copied += n;
+                        }
+                }
+                ret = wasi_aio_submit(aio, req, wasi_fdinfo_hostfd(fdinfo),
+                                      is_write, off);
+                if (ret != 0) {
+                        xlog_trace("%s: submit failed with %d", __func__,
+                                   ret);
+                        mem_free(aio->mctx, req, sizeof(*req) + len);
+                        return false;
+                }
+        }
+        host_ret = wasi_aio_wait(ctx, aio, req);
+        if (host_ret != 0) {
+                if (IS_RESTARTABLE(host_ret)) {
+                        restart->restart_type = RESTART_IO;
+                        restart->restart_u.io.req = req;
+                        restart->restart_u.io.abandon = wasi_aio_abandon;
+                } else {
+                        /* we are not going to restart. */
+                        wasi_aio_abandon(req);
+                }
+                ret = 0;
+                goto done;
+        }
+        assert(req->done);
+        if (req->res < 0) {
+                ret = -req->res;
+        } else {
+                size_t n = req->res;
+                assert(n <= req->iov.iov_len);
+                if (!is_write) {
+                        size_t copied = 0;
+                        for (i = 0; i < iovcnt && copied < n; i++) {
+                                size_t sz = iov[i].iov_len;
+                                if (sz > n - copied) {
+                                        sz = n - copied;
+                                }
+                                memcpy(iov[i].iov_base, req->buf + copied,
+                                       sz);
+                                copied += sz;
+                        }
+                }
+                *resultp = n;
+                ret = 0;
+        }
+        toywasm_mutex_lock(&aio->lock);
+        wasi_aio_req_free(aio, req);
+        toywasm_mutex_unlock(&aio->lock);
+done:
+        assert(IS_RESTARTABLE(host_ret) ||
+               restart_info_is_none(ctx));
+        *host_retp = host_ret;
+        *retp = ret;
+        return true;
+}
+
+void
+wasi_aio_fail(struct exec_context *ctx, int host_ret)
+{
+        if (IS_RESTARTABLE(host_ret) || restart_info_is_none(ctx)) {
+                return;
+        }
+        struct restart_info *restart = &VEC_NEXTELEM(ctx->restarts);
+        if (restart->restart_type == RESTART_IO) {
+                xlog_trace("%s: abandoning req %p", __func__,
+                           restart->restart_u.io.req);
+                wasi_aio_abandon(restart->restart_u.io.req);
+                restart->restart_type = RESTART_NONE;
+        }
+}
+
+void
+wasi_aio_destroy(struct wasi_aio *aio) NO_THREAD_SAFETY_ANALYSIS
+{
+        /*
+         * the kernel might still be accessing the buffers of
+         * the requests in flight. wait for them.
+         */
+        while (aio->ninflight > 0) {
+                int ret = sys_io_uring_enter(aio->ringfd, 0, 1,
+                                             IORING_ENTER_GETEVENTS);
+                if (ret == -1 && errno != EINTR) {
+                        xlog_error("%s: io_uring_enter failed with %d",
+                                   __func__, errno);
+                        break;
+                }
+                wasi_aio_reap(aio);
+        }
+        struct wasi_aio_req *req;
+        while ((req = LIST_FIRST(&aio->reqs)) != NULL) {
+                wasi_aio_req_free(aio, req);
+        }
+        toywasm_cv_destroy(&aio->cv);
+        toywasm_mutex_destroy(&aio->lock);
+        wasi_aio_unmap(aio);
+        mem_free(aio->mctx, aio, sizeof(*aio));
+}
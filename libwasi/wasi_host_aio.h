@@ -0,0 +1,48 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct exec_context;
+struct iovec;
+struct wasi_aio;
+struct wasi_fdinfo;
+struct wasi_instance;
+
+/*
+ * values for wasi_fdinfo_host::aio
+ */
+#define WASI_AIO_FD_UNKNOWN 0
+#define WASI_AIO_FD_CAPABLE 1
+#define WASI_AIO_FD_INCAPABLE 2
+
+/*
+ * wasi_aio_rw: perform fd_read/fd_write like operations asynchronously.
+ *
+ * off: the file offset. -1 means the current file offset.
+ *
+ * returns false if the request is not suitable for the asynchronous path.
+ * in that case, the caller should fall back to the synchronous path.
+ * (eg. wasi_vfs_fd_readv)
+ *
+ * otherwise, returns true and sets *host_retp and *retp.
+ * the meaning of *host_retp and *retp is same as emulate_blocking.
+ *
+ * Note: a request transfers at most 1MiB. (WASI_AIO_MAX_BYTES)
+ * a larger request results in a short read/write, which is valid for
+ * fd_read/fd_write on a regular file. applications which don't expect
+ * it need to retry the rest themselves, as they would for other fd types.
+ */
+bool wasi_aio_rw(struct exec_context *ctx, struct wasi_instance *wasi,
+                 struct wasi_fdinfo *fdinfo, bool is_write,
+                 const struct iovec *iov, int iovcnt, int64_t off,
+                 size_t *resultp, int *host_retp, int *retp);
+
+/*
+ * wasi_aio_fail: for the error paths of the callers of wasi_aio_rw.
+ *
+ * on a restart, the caller can fail before calling wasi_aio_rw.
+ * (eg. the fd has been closed by another thread meanwhile)
+ * in that case, this abandons the request pending in the restart_info.
+ */
+void wasi_aio_fail(struct exec_context *ctx, int host_ret);
+void wasi_aio_destroy(struct wasi_aio *aio);
@@ -34,6 +34,9 @@ struct wasi_fdinfo_host {
         struct wasi_fdinfo_user user;
         int hostfd;
         void *dir; /* DIR * */
+#if defined(TOYWASM_ENABLE_WASI_IO_URING)
+        uint8_t aio; /* WASI_AIO_FD_xxx */
+#endif
 };
 
 struct wasi_table {
@@ -61,6 +64,12 @@ struct wasi_instance {
 
         uint32_t exit_code;
 
+#if defined(TOYWASM_ENABLE_WASI_IO_URING)
+        /* created on demand. see wasi_host_aio.c */
+        struct wasi_aio *aio GUARDED_VAR(lock);
+        bool aio_unavailable GUARDED_VAR(lock);
+#endif
+
         struct mem_context *mctx;
 };
 
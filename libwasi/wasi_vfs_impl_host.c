@@ -1,6 +1,7 @@
 #include <errno.h>
 #include <stdlib.h>
 
+#include "wasi_host_aio.h"
 #include "wasi_host_dirent.h"
 #include "wasi_host_fdop.h"
 #include "wasi_host_pathop.h"
@@ -65,6 +66,9 @@ wasi_fdinfo_alloc_host(struct wasi_fdinfo **fdinfop)
         fdinfo_host->user.vfs = &wasi_host_vfs;
         fdinfo_host->hostfd = -1;
         fdinfo_host->dir = NULL;
+#if defined(TOYWASM_ENABLE_WASI_IO_URING)
+        fdinfo_host->aio = WASI_AIO_FD_UNKNOWN;
+#endif
         *fdinfop = &fdinfo_host->user.fdinfo;
         return 0;
 }
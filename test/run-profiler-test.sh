@@ -0,0 +1,39 @@
+#! /bin/sh
+
+# usage: run-profiler-test.sh WASM_DIR
+#
+# WASM_DIR: the directory containing infiniteloop.wasm and
+# infiniteloop_in_start.wasm
+#
+# TOYWASM: the toywasm cli
+
+set -e
+set -x
+TOYWASM=${TOYWASM:-${TEST_RUNTIME_EXE:-toywasm}}
+WASM_DIR=$1
+
+OUT=$(mktemp -d)
+trap "rm -rf ${OUT}" EXIT
+
+# run until the timeout. the profile should be written anyway.
+profile() {
+    fmt=$1
+    wasm=$2
+    rm -f ${OUT}/profile
+    if ${TOYWASM} --timeout=300 --profile ${OUT}/profile \
+        --profile-format ${fmt} ${WASM_DIR}/${wasm}; then
+        exit 1
+    fi
+    test -s ${OUT}/profile
+}
+
+profile folded infiniteloop.wasm
+grep '^func\[0\] [1-9][0-9]*$' ${OUT}/profile
+
+# the module is unloaded before the profile is written
+# because the start function fails.
+profile folded infiniteloop_in_start.wasm
+grep '^func\[0\] [1-9][0-9]*$' ${OUT}/profile
+
+profile pprof infiniteloop.wasm
+grep -a 'func\[0\]' ${OUT}/profile
@@ -0,0 +1,22 @@
+#! /bin/sh
+
+# usage: run-stdin-test.sh WASM_DIR
+#
+# WASM_DIR: the directory containing spectest.wasm
+#
+# TOYWASM: the toywasm cli
+
+set -e
+set -x
+TOYWASM=${TOYWASM:-${TEST_RUNTIME_EXE:-toywasm}}
+WASM_DIR=$1
+
+${TOYWASM} --load=- "--invoke=print_i32 123" < ${WASM_DIR}/spectest.wasm
+
+# make the address space reservation fail to exercise the buffered loader.
+# skip it if the cli itself can't run with the limit. (eg. asan)
+LIMIT=1048576
+if (ulimit -v ${LIMIT} && ${TOYWASM} --version > /dev/null); then
+    (ulimit -v ${LIMIT} && ${TOYWASM} --load=- "--invoke=print_i32 123" \
+        < ${WASM_DIR}/spectest.wasm)
+fi
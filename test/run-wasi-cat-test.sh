@@ -0,0 +1,29 @@
+#! /bin/sh
+
+# usage: run-wasi-cat-test.sh WASM_DIR
+#
+# WASM_DIR: the directory containing cat.wasm
+#
+# TOYWASM: the toywasm cli
+#
+# copy files with cat.wasm. with TOYWASM_ENABLE_WASI_IO_URING,
+# fd_read/fd_write on regular files use io_uring.
+
+set -e
+set -x
+TOYWASM=${TOYWASM:-${TEST_RUNTIME_EXE:-toywasm}}
+WASM_DIR=$1
+
+OUT=$(mktemp -d)
+trap "rm -rf ${OUT}" EXIT
+
+# larger than WASI_AIO_MAX_BYTES (1MiB) to involve short reads
+dd if=/dev/urandom of=${OUT}/in bs=1024 count=3000
+
+# regular files
+${TOYWASM} --wasi ${WASM_DIR}/cat.wasm < ${OUT}/in > ${OUT}/out
+cmp ${OUT}/in ${OUT}/out
+
+# pipes, which always take the synchronous path
+cat ${OUT}/in | ${TOYWASM} --wasi ${WASM_DIR}/cat.wasm | cat > ${OUT}/out
+cmp ${OUT}/in ${OUT}/out
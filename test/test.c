@@ -8,6 +8,7 @@
 #include <cmocka.h>
 
 #include "endian.h"
+#include "hash_index.h"
 #include "idalloc.h"
 #include "leb128.h"
 #include "list.h"
@@ -520,6 +521,74 @@ test_idalloc(void **state)
         mem_context_clear(mctx);
 }
 
+static uint32_t
+test_hash_index_hash(const void *arg, uint32_t idx)
+{
+        const uint32_t *hashes = arg;
+        return hashes[idx];
+}
+
+void
+test_hash_index(void **state)
+{
+        struct mem_context mctx0;
+        struct mem_context *mctx = &mctx0;
+        struct hash_index hi;
+        uint32_t hashes[100];
+        uint32_t pos;
+        uint32_t idx;
+        uint32_t n;
+        uint32_t i;
+        int ret;
+
+        mem_context_init(mctx);
+        hash_index_init(&hi);
+
+        /* an empty index */
+        pos = 1;
+        assert_false(hash_index_next(&hi, &pos, &idx));
+
+        /*
+         * add entries one by one to exercise resizes.
+         * even entries share the same hash.
+         */
+        for (i = 0; i < 100; i++) {
+                hashes[i] = (i % 2 == 0) ? 12345 : i * 7;
+                ret = hash_index_reserve(mctx, &hi, i, 1,
+                                         test_hash_index_hash, hashes);
+                assert_int_equal(ret, 0);
+                assert_true(hi.size >= (i + 1) * 2);
+                hash_index_insert(&hi, hashes[i], i);
+        }
+
+        /* the entries with the same hash come in the insertion order */
+        pos = 12345;
+        n = 0;
+        while (hash_index_next(&hi, &pos, &idx)) {
+                if (hashes[idx] != 12345) {
+                        continue;
+                }
+                assert_int_equal(idx, n * 2);
+                n++;
+        }
+        assert_int_equal(n, 50);
+
+        /* every entry is reachable */
+        for (i = 0; i < 100; i++) {
+                pos = hashes[i];
+                while (true) {
+                        assert_true(hash_index_next(&hi, &pos, &idx));
+                        if (idx == i) {
+                                break;
+                        }
+                }
+        }
+
+        hash_index_clear(mctx, &hi);
+        assert_int_equal(hi.size, 0);
+        mem_context_clear(mctx);
+}
+
 void
 test_timeutil(void **state)
 {
@@ -1186,6 +1255,7 @@ main(int argc, char **argv)
                 cmocka_unit_test(test_endian),
                 cmocka_unit_test(test_functype),
                 cmocka_unit_test(test_idalloc),
+                cmocka_unit_test(test_hash_index),
                 cmocka_unit_test(test_timeutil),
                 cmocka_unit_test(test_timeutil_int64),
                 cmocka_unit_test(test_list),
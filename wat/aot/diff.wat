@@ -0,0 +1,565 @@
+;; a module to compare the interpreter and the functions translated by
+;; "wasm2cstruct --aot". see test.sh.
+;;
+;; for each input, _start prints the results of the $test_* functions
+;; in hex. the $test_* functions only use instructions which the
+;; translator supports.
+(module
+  (func $fd_write (import "wasi_snapshot_preview1" "fd_write")
+    (param i32 i32 i32 i32) (result i32))
+  (memory (export "memory") 1)
+  (global $pos (mut i32) (i32.const 0x100))
+  (global $acc (mut i32) (i32.const 0x1234))
+  (global $acc64 (mut i64) (i64.const 0x1111_2222_3333_4444))
+
+  (func $fib (param $n i32) (result i32)
+    local.get $n
+    i32.const 2
+    i32.lt_u
+    if (result i32)
+      local.get $n
+    else
+      local.get $n
+      i32.const 1
+      i32.sub
+      call $fib
+      local.get $n
+      i32.const 2
+      i32.sub
+      call $fib
+      i32.add
+    end
+  )
+  (func $sum3 (param i32 i32 i32) (result i32)
+    local.get 0
+    local.get 1
+    i32.sub
+    local.get 2
+    i32.xor
+  )
+
+  (func $test_fib (param $x i32) (result i32)
+    local.get $x
+    i32.const 15
+    i32.and
+    call $fib
+  )
+  (func $test_div (param $x i32) (result i32)
+    local.get $x
+    i32.const 7
+    i32.div_s
+    local.get $x
+    i32.const 3
+    i32.div_u
+    i32.xor
+    local.get $x
+    i32.const -5
+    i32.rem_s
+    i32.xor
+    local.get $x
+    i32.const 10
+    i32.rem_u
+    i32.xor
+    local.get $x
+    i64.extend_i32_s
+    i64.const -3
+    i64.div_s
+    i32.wrap_i64
+    i32.xor
+    local.get $x
+    i32.eqz
+    if (result i32)
+      i32.const 0
+    else
+      i32.const 0x12345678
+      local.get $x
+      i32.div_u
+    end
+    i32.add
+  )
+  (func $test_bits (param $x i32) (result i32)
+    local.get $x
+    i32.clz
+    local.get $x
+    i32.ctz
+    i32.const 8
+    i32.shl
+    i32.or
+    local.get $x
+    i32.popcnt
+    i32.const 16
+    i32.shl
+    i32.or
+    local.get $x
+    i32.const 13
+    i32.rotl
+    i32.xor
+    local.get $x
+    local.get $x
+    i32.rotr
+    i32.add
+    local.get $x
+    i32.extend8_s
+    i32.xor
+    local.get $x
+    i32.extend16_s
+    i32.const 3
+    i32.shr_s
+    i32.add
+    local.get $x
+    i32.const 35 ;; shift counts are modulo 32
+    i32.shr_u
+    i32.xor
+  )
+  (func $test_cmp (param $x i32) (result i32)
+    ;; a bitmask of comparisons
+    local.get $x
+    i32.const 100
+    i32.lt_s
+    local.get $x
+    i32.const 100
+    i32.lt_u
+    i32.const 1
+    i32.shl
+    i32.or
+    local.get $x
+    i32.const 100
+    i32.gt_s
+    i32.const 2
+    i32.shl
+    i32.or
+    local.get $x
+    i32.const 100
+    i32.gt_u
+    i32.const 3
+    i32.shl
+    i32.or
+    local.get $x
+    i32.const 100
+    i32.le_s
+    i32.const 4
+    i32.shl
+    i32.or
+    local.get $x
+    i32.const 100
+    i32.le_u
+    i32.const 5
+    i32.shl
+    i32.or
+    local.get $x
+    i32.const 100
+    i32.ge_s
+    i32.const 6
+    i32.shl
+    i32.or
+    local.get $x
+    i32.const 100
+    i32.ge_u
+    i32.const 7
+    i32.shl
+    i32.or
+    local.get $x
+    i32.const 100
+    i32.eq
+    i32.const 8
+    i32.shl
+    i32.or
+    local.get $x
+    i32.const 100
+    i32.ne
+    i32.const 9
+    i32.shl
+    i32.or
+    local.get $x
+    i32.eqz
+    i32.const 10
+    i32.shl
+    i32.or
+    local.get $x
+    i64.extend_i32_u
+    i64.eqz
+    i32.const 11
+    i32.shl
+    i32.or
+    local.get $x
+    i64.extend_i32_s
+    i64.const -1
+    i64.lt_s
+    i32.const 12
+    i32.shl
+    i32.or
+    local.get $x
+    i64.extend_i32_s
+    i64.const 100
+    i64.gt_u
+    i32.const 13
+    i32.shl
+    i32.or
+  )
+  (func $test_i64 (param $x i32) (result i32) (local $a i64) (local $b i64)
+    local.get $x
+    i64.extend_i32_s
+    local.set $a
+    local.get $x
+    i64.extend_i32_u
+    local.set $b
+    local.get $a
+    local.get $b
+    i64.mul
+    local.get $a
+    i64.const 13
+    i64.rotl
+    i64.add
+    local.get $a
+    i64.const 3
+    i64.shr_s
+    i64.xor
+    local.get $a
+    i64.clz
+    i64.xor
+    local.get $b
+    i64.popcnt
+    i64.const 40
+    i64.shl
+    i64.xor
+    local.get $a
+    i64.const 0x7fff_ffff_ffff
+    i64.and
+    local.get $b
+    i64.const 1
+    i64.or
+    i64.rem_u
+    i64.add
+    local.tee $a
+    local.get $a
+    i64.const 32
+    i64.shr_u
+    i64.xor
+    i32.wrap_i64
+  )
+  (func $test_mem (param $x i32) (result i32) (local $i i32) (local $sum i64)
+    ;; store a pattern at 0x1000 and read it back in various widths
+    loop
+      local.get $i
+      i32.const 0x1000
+      i32.add
+      local.get $x
+      local.get $i
+      i32.mul
+      local.get $i
+      i32.xor
+      i32.store8
+      local.get $i
+      i32.const 1
+      i32.add
+      local.tee $i
+      i32.const 64
+      i32.lt_u
+      br_if 0
+    end
+    i32.const 0x1001
+    local.get $x
+    i32.store16 offset=8
+    i32.const 0x1000
+    local.get $x
+    i64.extend_i32_u
+    i64.const 0x0101_0101
+    i64.mul
+    i64.store offset=32
+    i32.const 0
+    local.set $i
+    loop
+      local.get $sum
+      i64.const 5
+      i64.rotl
+      local.get $i
+      i32.const 0x1000
+      i32.add
+      i64.load
+      i64.xor
+      local.set $sum
+      local.get $i
+      i32.const 3
+      i32.add
+      local.tee $i
+      i32.const 56
+      i32.lt_u
+      br_if 0
+    end
+    local.get $sum
+    i32.wrap_i64
+    i32.const 0x1003
+    i32.load8_s
+    i32.add
+    i32.const 0x1005
+    i32.load16_s
+    i32.xor
+    i32.const 0x1007
+    i32.load16_u
+    i32.add
+    i32.const 0x1002
+    i64.load32_s
+    i32.wrap_i64
+    i32.xor
+    i32.const 0x1021
+    i64.load8_u
+    i32.wrap_i64
+    i32.add
+  )
+  (func $test_br_table (param $x i32) (result i32)
+    block $d
+      block $c
+        block $b
+          block $a
+            local.get $x
+            i32.const 7
+            i32.and
+            br_table $a $b $c $a $d $b
+          end
+          i32.const 100
+          local.get $x
+          i32.add
+          return
+        end
+        i32.const 200
+        return
+      end
+      local.get $x
+      i32.const 300
+      i32.mul
+      return
+    end
+    i32.const 400
+  )
+  (func $test_select (param $x i32) (result i32)
+    local.get $x
+    i32.const 1
+    i32.add
+    local.get $x
+    i32.const 1
+    i32.sub
+    local.get $x
+    i32.const 1
+    i32.and
+    select
+    i64.const 5
+    i64.const 6
+    local.get $x
+    i32.const 1000
+    i32.gt_s
+    select
+    i32.wrap_i64
+    i32.add
+    local.get $x
+    i32.const 0
+    i32.lt_s
+    if (result i32)
+      local.get $x
+      i32.const 3
+      i32.and
+      if (result i32)
+        i32.const 7
+      else
+        i32.const 11
+      end
+    else
+      i32.const 13
+    end
+    i32.mul
+  )
+  (func $test_global (param $x i32) (result i32)
+    global.get $acc
+    i32.const 31
+    i32.mul
+    local.get $x
+    i32.add
+    global.set $acc
+    global.get $acc64
+    local.get $x
+    i64.extend_i32_u
+    i64.add
+    i64.const 17
+    i64.rotl
+    global.set $acc64
+    global.get $acc
+    global.get $acc64
+    i32.wrap_i64
+    i32.xor
+  )
+  (func $test_loop (param $x i32) (result i32) (local $n i32) (local $steps i32)
+    ;; the number of steps for the collatz sequence to reach 1
+    local.get $x
+    i32.const 0xffff
+    i32.and
+    i32.const 1
+    i32.add
+    local.set $n
+    block $done
+      loop $next
+        local.get $n
+        i32.const 1
+        i32.eq
+        br_if $done
+        local.get $steps
+        i32.const 1
+        i32.add
+        local.set $steps
+        local.get $n
+        i32.const 1
+        i32.and
+        if
+          local.get $n
+          i32.const 3
+          i32.mul
+          i32.const 1
+          i32.add
+          local.set $n
+        else
+          local.get $n
+          i32.const 1
+          i32.shr_u
+          local.set $n
+        end
+        br $next
+      end
+    end
+    local.get $steps
+  )
+  (func $test_calls (param $x i32) (result i32)
+    block (result i32)
+      local.get $x
+      i32.const 1
+      i32.add
+      local.get $x
+      i32.const 100
+      i32.gt_u
+      br_if 0
+      drop
+      local.get $x
+      local.get $x
+      i32.const 5
+      i32.shl
+      i32.const 12345
+      call $sum3
+    end
+    local.get $x
+    i32.const 3
+    i32.and
+    call $fib
+    i32.add
+  )
+
+  ;; append "%08x " to the line buffer
+  (func $put (param $v i32) (local $shift i32)
+    i32.const 32
+    local.set $shift
+    loop
+      global.get $pos
+      local.get $v
+      local.get $shift
+      i32.const 4
+      i32.sub
+      local.tee $shift
+      i32.shr_u
+      i32.const 0xf
+      i32.and
+      i32.load8_u offset=0x200
+      i32.store8
+      global.get $pos
+      i32.const 1
+      i32.add
+      global.set $pos
+      local.get $shift
+      br_if 0
+    end
+    global.get $pos
+    i32.const 0x20 ;; ' '
+    i32.store8
+    global.get $pos
+    i32.const 1
+    i32.add
+    global.set $pos
+  )
+  ;; replace the last space with a newline and write the line to stdout
+  (func $flush
+    global.get $pos
+    i32.const 1
+    i32.sub
+    i32.const 0x0a
+    i32.store8
+    i32.const 4
+    global.get $pos
+    i32.const 0x100
+    i32.sub
+    i32.store
+    i32.const 1 ;; stdout
+    i32.const 0 ;; iov
+    i32.const 1 ;; iovcnt
+    i32.const 8 ;; nwritten
+    call $fd_write
+    if
+      unreachable
+    end
+    i32.const 0x100
+    global.set $pos
+  )
+  (func (export "_start") (local $i i32) (local $x i32)
+    loop
+      local.get $i
+      i32.load offset=0x300
+      local.tee $x
+      call $put
+      local.get $x
+      call $test_fib
+      call $put
+      local.get $x
+      call $test_div
+      call $put
+      local.get $x
+      call $test_bits
+      call $put
+      local.get $x
+      call $test_cmp
+      call $put
+      local.get $x
+      call $test_i64
+      call $put
+      local.get $x
+      call $test_mem
+      call $put
+      local.get $x
+      call $test_br_table
+      call $put
+      local.get $x
+      call $test_select
+      call $put
+      local.get $x
+      call $test_global
+      call $put
+      local.get $x
+      call $test_loop
+      call $put
+      local.get $x
+      call $test_calls
+      call $put
+      call $flush
+      local.get $i
+      i32.const 4
+      i32.add
+      local.tee $i
+      i32.const 64
+      i32.lt_u
+      br_if 0
+    end
+  )
+
+  ;; iov_base = 0x100, iov_len is set by $flush
+  (data (i32.const 0) "\00\01\00\00")
+  (data (i32.const 0x200) "0123456789abcdef")
+  ;; the inputs
+  (data (i32.const 0x300)
+    "\00\00\00\00" "\01\00\00\00" "\02\00\00\00" "\07\00\00\00"
+    "\1f\00\00\00" "\64\00\00\00" "\65\00\00\00" "\e8\03\00\00"
+    "\39\30\00\00" "\ff\ff\ff\7f" "\00\00\00\80" "\ff\ff\ff\ff"
+    "\f9\ff\ff\ff" "\ef\be\ad\de" "\00\00\01\00" "\ff\ff\00\00")
+)
@@ -0,0 +1,31 @@
+#! /bin/sh
+
+# run diff.wasm with the interpreter and with its functions translated
+# by "wasm2cstruct --aot", and compare the outputs.
+#
+# TOYWASM: the toywasm cli
+# WASM2CSTRUCT: the wasm2cstruct example, built with TOYWASM_ENABLE_AOT
+# TGZ: the toywasm tarball to build the runwasi_cstruct example with
+#
+# Note: this overwrites examples/runwasi_cstruct/module.c.
+
+set -e
+set -x
+TOYWASM=${TOYWASM:-${TEST_RUNTIME_EXE:-toywasm}}
+WASM2CSTRUCT=${WASM2CSTRUCT:-wasm2cstruct}
+TOP=$(cd ../.. && pwd)
+
+OUT=$(mktemp -d)
+trap "rm -rf ${OUT}" EXIT
+
+MODULE_C=${TOP}/examples/runwasi_cstruct/module.c
+${WASM2CSTRUCT} --aot g_wasm_module diff.wasm > ${MODULE_C}
+# all the functions but $flush and _start, which call an import,
+# should be translated.
+grep '^/\* 14 of 16 functions translated \*/$' ${MODULE_C}
+(cd ${TOP} && ./test/build-example.sh runwasi_cstruct ${TGZ} build-aot)
+
+${TOYWASM} --wasi diff.wasm > ${OUT}/expected
+${TOP}/examples/runwasi_cstruct/build-aot/runwasi_cstruct -- diff \
+> ${OUT}/result
+cmp ${OUT}/expected ${OUT}/result
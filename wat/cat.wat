@@ -0,0 +1,68 @@
+;; a wasi program which copies stdin to stdout.
+;; see test/run-wasi-cat-test.sh
+(module
+  (func $fd_read (import "wasi_snapshot_preview1" "fd_read")
+    (param i32 i32 i32 i32) (result i32))
+  (func $fd_write (import "wasi_snapshot_preview1" "fd_write")
+    (param i32 i32 i32 i32) (result i32))
+  (memory (export "memory") 33)
+  (func (export "_start") (local $n i32)
+    block $eof
+      loop $read
+        ;; iov = { 0x10000, 0x200000 }
+        i32.const 0
+        i32.const 0x10000
+        i32.store
+        i32.const 4
+        i32.const 0x200000
+        i32.store
+        i32.const 0 ;; stdin
+        i32.const 0 ;; iov
+        i32.const 1 ;; iovcnt
+        i32.const 8 ;; nread
+        call $fd_read
+        if
+          unreachable
+        end
+        i32.const 8
+        i32.load
+        local.tee $n
+        i32.eqz
+        br_if $eof
+        ;; iov = { 0x10000, n }
+        i32.const 4
+        local.get $n
+        i32.store
+        loop $write
+          i32.const 1 ;; stdout
+          i32.const 0 ;; iov
+          i32.const 1 ;; iovcnt
+          i32.const 12 ;; nwritten
+          call $fd_write
+          if
+            unreachable
+          end
+          ;; advance the iov by nwritten
+          i32.const 0
+          i32.const 0
+          i32.load
+          i32.const 12
+          i32.load
+          i32.add
+          i32.store
+          i32.const 4
+          i32.const 4
+          i32.load
+          i32.const 12
+          i32.load
+          i32.sub
+          local.tee $n
+          i32.store
+          local.get $n
+          br_if $write
+        end
+        br $read
+      end
+    end
+  )
+)
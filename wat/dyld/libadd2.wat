@@ -0,0 +1,12 @@
+;; the same as libadd.wat, but with different bytes.
+(module
+  (@dylink.0
+    (mem-info (memory 0 0) (table 0 0))
+  )
+  (import "env" "memory" (memory 0))
+  (func (export "add") (param i32 i32) (result i32)
+    local.get 1
+    local.get 0
+    i32.add
+  )
+)
@@ -0,0 +1,19 @@
+;; a pie main module calling "add" in libadd.so.
+(module
+  (@dylink.0
+    (mem-info (memory 0 0) (table 0 0))
+    (needed "libadd.so")
+  )
+  (import "env" "memory" (memory 0))
+  (import "env" "add" (func $add (param i32 i32) (result i32)))
+  (func (export "_start")
+    i32.const 1
+    i32.const 2
+    call $add
+    i32.const 3
+    i32.ne
+    if
+      unreachable
+    end
+  )
+)
@@ -0,0 +1,16 @@
+;; a pie main module calling "add" in libadd.so via a PLT entry.
+;; it also re-exports the import as "add".
+(module
+  (@dylink.0
+    (mem-info (memory 0 0) (table 0 0))
+    (needed "libadd.so")
+  )
+  (import "env" "memory" (memory 0))
+  (import "env" "add" (func $add (param i32 i32) (result i32)))
+  (export "add" (func $add))
+  (func (export "call_add") (param i32 i32) (result i32)
+    local.get 0
+    local.get 1
+    call $add
+  )
+)
@@ -0,0 +1,38 @@
+#! /bin/sh
+
+set -e
+set -x
+TOYWASM=${TOYWASM:-${TEST_RUNTIME_EXE:-toywasm}}
+
+OUT=$(mktemp -d)
+trap 'rm -rf ${OUT}' EXIT
+
+cp plt.wasm ${OUT}/plt.wasm
+cp libadd.wasm ${OUT}/libadd.so
+
+# call_add calls "add" via a PLT entry.
+# the first call goes through the PLT, which is a host function.
+# it resolves the symbol and patches the entry.
+# the later calls call libadd.so directly.
+# "add" is a re-export of the import. it should not be taken as
+# the definition of the symbol.
+run() {
+    printf ':load %s/plt.wasm\n' ${OUT} > ${OUT}/in
+    printf ':invoke call_add 1 2\n:invoke call_add 3 4\n' >> ${OUT}/in
+    printf ':invoke add 5 6\n' >> ${OUT}/in
+    ${TOYWASM} --dyld --dyld-path ${OUT} "$@" --print-stats \
+        --repl --repl-prompt= < ${OUT}/in > ${OUT}/out 2>&1
+    cat ${OUT}/out
+    grep -E '^(> )*Result: ' ${OUT}/out | sed 's/^[> ]*//' > ${OUT}/result
+    printf 'Result: 3:i32\nResult: 7:i32\nResult: 11:i32\n' \
+    | cmp - ${OUT}/result
+    grep -E ' host_call +[0-9]+$' ${OUT}/out | awk '{print $2}' \
+    | tr '\n' ' ' > ${OUT}/host_call
+}
+
+run
+test "$(cat ${OUT}/host_call)" = "1 0 0 "
+
+# with --dyld-bindnow, the entry is patched before any calls.
+run --dyld-bindnow
+test "$(cat ${OUT}/host_call)" = "0 0 0 "
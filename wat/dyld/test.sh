@@ -0,0 +1,61 @@
+#! /bin/sh
+
+set -e
+set -x
+TOYWASM=${TOYWASM:-${TEST_RUNTIME_EXE:-toywasm}}
+
+OUT=$(mktemp -d)
+PID=
+trap 'test -n "${PID}" && kill ${PID} 2> /dev/null; rm -rf ${OUT}' EXIT
+
+cp main.wasm ${OUT}/main.wasm
+cp libadd.wasm ${OUT}/libadd.so
+
+# feed repl commands one by one so that we can modify the files
+# in between.
+mkfifo ${OUT}/in
+${TOYWASM} --dyld --dyld-path ${OUT} --print-stats --repl --repl-prompt= \
+    < ${OUT}/in > ${OUT}/out 2>&1 &
+PID=$!
+exec 3> ${OUT}/in
+
+NLOADS=0
+load() {
+    NLOADS=$((NLOADS + 1))
+    printf ':load %s/main.wasm\n:invoke _start\n' ${OUT} >&3
+    i=0
+    while [ $(grep -c 'Result: <Empty Stack>$' ${OUT}/out) -lt ${NLOADS} ]; do
+        if grep -q Error ${OUT}/out || ! kill -0 ${PID}; then
+            cat ${OUT}/out
+            exit 1
+        fi
+        i=$((i + 1))
+        test ${i} -lt 300
+        sleep 0.1
+    done
+}
+
+# miss: main.wasm and libadd.so
+load
+# hit: both
+load
+# the same contents with a different mtime: a hit after comparing them
+touch -t 200001010000 ${OUT}/libadd.so
+load
+# replaced: miss
+# Note: replace the file with rename as the cache maps the file.
+cp libadd2.wasm ${OUT}/tmp.so
+mv ${OUT}/tmp.so ${OUT}/libadd.so
+load
+# release everything and replace the file back.
+# the unused entry for the previous contents is reused.
+echo ":init" >&3
+cp libadd.wasm ${OUT}/tmp.so
+mv ${OUT}/tmp.so ${OUT}/libadd.so
+load
+
+exec 3>&-
+wait ${PID}
+PID=
+cat ${OUT}/out
+grep "dyld module cache: hits 5 compared_hits 2 misses 3 " ${OUT}/out
@@ -2,7 +2,7 @@
 
 set -e
 set -x
-for wat in *.wat; do
+for wat in *.wat xinst/*.wat; do
     wasm=${wat%%.wat}.wasm
     wasm-tools parse -o ${wasm} ${wat}
     wasm-tools validate -f all ${wasm}
@@ -0,0 +1,57 @@
+(module
+  (tag $e (param i32))
+  (global $g (mut exnref) (ref.null exn))
+  (func $wrap (param i32) (result exnref)
+    try_table (catch_all_ref 0)
+      local.get 0
+      throw $e
+    end
+    unreachable
+  )
+  (func $unwrap (param exnref) (result i32)
+    try_table (catch $e 0)
+      local.get 0
+      throw_ref
+    end
+    unreachable
+  )
+  (func $store (export "store") (param i32)
+    local.get 0
+    call $wrap
+    global.set $g
+  )
+  (func $load (export "load") (result i32)
+    global.get $g
+    call $unwrap
+  )
+  (func $churn (param $n i32)
+    loop
+      local.get $n
+      call $store
+      local.get $n
+      i32.const 1
+      i32.sub
+      local.tee $n
+      br_if 0
+    end
+  )
+  (func (export "_start")
+    i32.const 1234
+    call $store
+    call $load
+    i32.const 1234
+    i32.ne
+    if
+      unreachable
+    end
+    ;; overwritten exnrefs should be released
+    i32.const 100000
+    call $churn
+    call $load
+    i32.const 1
+    i32.ne
+    if
+      unreachable
+    end
+  )
+)
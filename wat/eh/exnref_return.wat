@@ -0,0 +1,40 @@
+(module
+  (tag $e (param i32))
+  (func $wrap (export "wrap") (param i32) (result exnref)
+    try_table (catch_all_ref 0)
+      local.get 0
+      throw $e
+    end
+    unreachable
+  )
+  (func $unwrap (export "unwrap") (param exnref) (result i32)
+    try_table (catch $e 0)
+      local.get 0
+      throw_ref
+    end
+    unreachable
+  )
+  (func (export "_start") (local $n i32)
+    ;; exnrefs which are dropped right away should not pile up
+    i32.const 100000
+    local.set $n
+    loop
+      local.get $n
+      call $wrap
+      drop
+      local.get $n
+      i32.const 1
+      i32.sub
+      local.tee $n
+      br_if 0
+    end
+    i32.const 1234
+    call $wrap
+    call $unwrap
+    i32.const 1234
+    i32.ne
+    if
+      unreachable
+    end
+  )
+)
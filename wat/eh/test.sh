@@ -9,7 +9,28 @@ for wat in *.wat; do
     ${TOYWASM} ${wasm}
 done
 
+# exnref results and globals outlive the exec_context of an invocation
+${TOYWASM} --load exnref_return.wasm --invoke "wrap 1" | grep ':exnref$'
+${TOYWASM} --load exnref_global.wasm --invoke "store 42" --invoke load \
+| grep '^Result: 42:i32$'
+
 for wat in trap/*.wat; do
     wasm=${wat%%.wat}.wasm
     ${TOYWASM} ${wasm} 2>&1 | grep '\[trap\]'
 done
+
+# with heap exnref, globals, tables and exception parameters can't hold
+# exnrefs of other instances.
+xinst() {
+    printf ':load xinst/exporter.wasm\n:register exporter\n:load xinst/importer.wasm\n:invoke %s\n' $1 \
+    | ${TOYWASM} --repl --repl-prompt=
+}
+if ${TOYWASM} --print-build-options | grep -q "TOYWASM_USE_HEAP_EXNREF = ON"; then
+    for f in own_global own_table; do
+        xinst $f | grep 'Result: <Empty Stack>$'
+    done
+    for f in foreign_global foreign_table imported_global imported_table \
+             foreign_param; do
+        xinst $f | grep 'storing an exnref of another instance'
+    done
+fi
@@ -0,0 +1,15 @@
+;; exports an exnref global and table, and a function returning
+;; an exnref owned by this instance. see importer.wat.
+(module
+  (tag $e)
+  (global (export "g") (mut exnref) (ref.null exn))
+  (table (export "t") 1 exnref)
+  (func (export "make") (result exnref)
+    block (result exnref)
+      try_table (catch_all_ref 0)
+        throw $e
+      end
+      unreachable
+    end
+  )
+)
@@ -0,0 +1,52 @@
+;; globals, tables and exception parameters can only hold exnrefs
+;; owned by their instance. storing others traps.
+(module
+  (func $make (import "exporter" "make") (result exnref))
+  (global $ig (import "exporter" "g") (mut exnref))
+  (table $it (import "exporter" "t") 1 exnref)
+  (tag $e)
+  (tag $p (param exnref))
+  (global $g (mut exnref) (ref.null exn))
+  (table $t 1 exnref)
+  (func $own (result exnref)
+    block (result exnref)
+      try_table (catch_all_ref 0)
+        throw $e
+      end
+      unreachable
+    end
+  )
+  ;; ok
+  (func (export "own_global")
+    call $own
+    global.set $g
+  )
+  (func (export "own_table")
+    i32.const 0
+    call $own
+    table.set $t
+  )
+  ;; traps
+  (func (export "foreign_global")
+    call $make
+    global.set $g
+  )
+  (func (export "foreign_table")
+    i32.const 0
+    call $make
+    table.set $t
+  )
+  (func (export "imported_global")
+    call $own
+    global.set $ig
+  )
+  (func (export "imported_table")
+    i32.const 0
+    call $own
+    table.set $it
+  )
+  (func (export "foreign_param")
+    call $make
+    throw $p
+  )
+)
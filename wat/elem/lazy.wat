@@ -0,0 +1,48 @@
+;; funcidx element segments are kept encoded in the module binary
+;; and decoded when used. (see element_funcidx_iter)
+;; the entry i of the segments refers to $f(i % 3).
+;; 130 entries span more than one ELEMENT_FUNCIDX_INDEX_INTERVAL.
+(module
+  (type $r (func (result i32)))
+  (func $f0 (type $r) i32.const 0)
+  (func $f1 (type $r) i32.const 1)
+  (func $f2 (type $r) i32.const 2)
+  ;; only initialized by table.init
+  (table $lazy 200 funcref)
+  ;; initialized on instantiation
+  (table $active 200 funcref)
+  (elem $passive func
+    $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2
+    $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2
+    $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2
+    $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2
+    $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2
+    $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2
+    $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2
+    $f0 $f1 $f2 $f0
+  )
+  (elem (table $active) (i32.const 0) func
+    $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2
+    $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2
+    $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2
+    $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2
+    $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2
+    $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2
+    $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2 $f0 $f1 $f2
+    $f0 $f1 $f2 $f0
+  )
+  (func (export "init") (param $dst i32) (param $src i32) (param $n i32)
+    local.get $dst
+    local.get $src
+    local.get $n
+    table.init $lazy $passive
+  )
+  (func (export "call_lazy") (param i32) (result i32)
+    local.get 0
+    call_indirect $lazy (type $r)
+  )
+  (func (export "call_active") (param i32) (result i32)
+    local.get 0
+    call_indirect $active (type $r)
+  )
+)
@@ -0,0 +1,26 @@
+#! /bin/sh
+
+set -e
+set -x
+TOYWASM=${TOYWASM:-${TEST_RUNTIME_EXE:-toywasm}}
+
+# the table initialized by an active segment on instantiation
+${TOYWASM} --load lazy.wasm --invoke "call_active 0" | grep 'Result: 0:i32$'
+${TOYWASM} --load lazy.wasm --invoke "call_active 64" | grep 'Result: 1:i32$'
+${TOYWASM} --load lazy.wasm --invoke "call_active 129" | grep 'Result: 0:i32$'
+
+# the table never touched
+${TOYWASM} --load lazy.wasm --invoke "call_lazy 5" 2>&1 \
+| grep 'uninitialized element'
+
+# touched by table.init in the middle of the segment
+${TOYWASM} --load lazy.wasm --invoke "init 10 70 60" \
+    --invoke "call_lazy 10" --invoke "call_lazy 69" 2>&1 \
+| tr '\n' ' ' | grep 'Result: 1:i32 .*Result: 0:i32 $'
+${TOYWASM} --load lazy.wasm --invoke "init 10 70 60" --invoke "call_lazy 9" \
+2>&1 | grep 'uninitialized element'
+
+# the whole segment
+${TOYWASM} --load lazy.wasm --invoke "init 0 0 130" \
+    --invoke "call_lazy 65" --invoke "call_lazy 129" 2>&1 \
+| tr '\n' ' ' | grep 'Result: 2:i32 .*Result: 0:i32 $'
@@ -0,0 +1,94 @@
+;; br_table and br_if simplification
+
+(module
+  (func $check (param i32 i32)
+    local.get 0
+    local.get 1
+    i32.ne
+    if
+      unreachable
+    end
+  )
+  ;; the trailing targets same as the default are trimmed
+  (func $trim (param i32) (result i32)
+    block $b2
+      block $b1
+        block $b0
+          local.get 0
+          br_table $b0 $b1 $b2 $b2 $b2
+        end
+        i32.const 10
+        return
+      end
+      i32.const 11
+      return
+    end
+    i32.const 12
+  )
+  ;; a single destination
+  (func $single (param i32) (result i32)
+    block $b0
+      local.get 0
+      br_table $b0 $b0 $b0
+    end
+    i32.const 13
+  )
+  ;; constant operands
+  (func $const (result i32)
+    block $b1
+      block $b0
+        i32.const 1
+        br_table $b0 $b1 $b0
+      end
+      i32.const 14
+      return
+    end
+    block $b2
+      i32.const 0
+      br_if $b2
+      i32.const 15
+      return
+    end
+    i32.const 16
+  )
+  (func (export "_start")
+    i32.const 0
+    call $trim
+    i32.const 10
+    call $check
+
+    i32.const 1
+    call $trim
+    i32.const 11
+    call $check
+
+    i32.const 2
+    call $trim
+    i32.const 12
+    call $check
+
+    i32.const 3
+    call $trim
+    i32.const 12
+    call $check
+
+    i32.const 100
+    call $trim
+    i32.const 12
+    call $check
+
+    i32.const 0
+    call $single
+    i32.const 13
+    call $check
+
+    i32.const 5
+    call $single
+    i32.const 13
+    call $check
+
+    call $const
+    i32.const 15
+    call $check
+  )
+)
@@ -0,0 +1,103 @@
+;; constant folding
+
+(module
+  (func $check (param i32 i32)
+    local.get 0
+    local.get 1
+    i32.ne
+    if
+      unreachable
+    end
+  )
+  (func $check64 (param i64 i64)
+    local.get 0
+    local.get 1
+    i64.ne
+    if
+      unreachable
+    end
+  )
+  (func $add_zero (param i32) (result i32)
+    local.get 0
+    i32.const 0
+    i32.add
+  )
+  (func (export "_start")
+    i32.const 7
+    i32.const 3
+    i32.add
+    i32.const 10
+    call $check
+
+    i32.const -7
+    i32.const 2
+    i32.div_s
+    i32.const -3
+    call $check
+
+    i32.const -7
+    i32.const 2
+    i32.rem_s
+    i32.const -1
+    call $check
+
+    ;; doesn't trap unlike div_s
+    i32.const 0x80000000
+    i32.const -1
+    i32.rem_s
+    i32.const 0
+    call $check
+
+    i32.const 0x80000000
+    i32.const 1
+    i32.div_s
+    i32.const 0x80000000
+    call $check
+
+    i64.const -7
+    i64.const 2
+    i64.div_s
+    i64.const -3
+    call $check64
+
+    i64.const 0x8000000000000000
+    i64.const -1
+    i64.rem_s
+    i64.const 0
+    call $check64
+
+    i32.const 1
+    i32.const 2
+    i32.lt_s
+    i32.const 1
+    call $check
+
+    i32.const 5
+    call $add_zero
+    i32.const 5
+    call $check
+  )
+
+  ;; the following should trap even after the optimization
+
+  (func (export "div_overflow") (result i32)
+    i32.const 0x80000000
+    i32.const -1
+    i32.div_s
+  )
+  (func (export "div_zero") (result i32)
+    i32.const 1
+    i32.const 0
+    i32.div_s
+  )
+  (func (export "rem_zero") (result i32)
+    i32.const 1
+    i32.const 0
+    i32.rem_s
+  )
+  (func (export "div_overflow64") (result i64)
+    i64.const 0x8000000000000000
+    i64.const -1
+    i64.div_s
+  )
+)
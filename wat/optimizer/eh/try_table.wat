@@ -0,0 +1,33 @@
+;; removal of unreachable code in try_table
+
+(module
+  (tag $e (param i32))
+  (func $check (param i32 i32)
+    local.get 0
+    local.get 1
+    i32.ne
+    if
+      unreachable
+    end
+  )
+  (func $try (param i32) (result i32)
+    block $h (result i32)
+      try_table (catch $e $h)
+        local.get 0
+        throw $e
+        i32.const 99
+        drop
+        block
+          unreachable
+        end
+      end
+      i32.const -1
+    end
+  )
+  (func (export "_start")
+    i32.const 7
+    call $try
+    i32.const 7
+    call $check
+  )
+)
@@ -0,0 +1,52 @@
+;; dead local.set elimination and local.tee
+
+(module
+  (func $check (param i32 i32)
+    local.get 0
+    local.get 1
+    i32.ne
+    if
+      unreachable
+    end
+  )
+  ;; a store to a local which is never read
+  (func $dead (param i32) (result i32) (local i32)
+    local.get 0
+    i32.const 1
+    i32.add
+    local.set 1
+    local.get 0
+  )
+  ;; local.set + local.get -> local.tee
+  (func $tee (param i32) (result i32) (local i32)
+    local.get 0
+    i32.const 2
+    i32.mul
+    local.set 1
+    local.get 1
+    local.get 1
+    i32.add
+  )
+  ;; local.get + local.set of the same local is a no-op
+  (func $self (param i32) (result i32)
+    local.get 0
+    local.set 0
+    local.get 0
+  )
+  (func (export "_start")
+    i32.const 5
+    call $dead
+    i32.const 5
+    call $check
+
+    i32.const 3
+    call $tee
+    i32.const 12
+    call $check
+
+    i32.const 9
+    call $self
+    i32.const 9
+    call $check
+  )
+)
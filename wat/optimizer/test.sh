@@ -0,0 +1,82 @@
+#! /bin/sh
+
+# run modules before and after "wasm2wasm -O" and compare.
+#
+# WASM2WASM: the wasm2wasm example
+# TOYWASM: the toywasm cli
+#
+# the fixtures in this directory trap in "_start" if something is wrong.
+# the ones in eh/ are skipped if toywasm can't load them.
+# (ie. built without TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING)
+
+set -e
+set -x
+TOYWASM=${TOYWASM:-${TEST_RUNTIME_EXE:-toywasm}}
+WASM2WASM=${WASM2WASM:-wasm2wasm}
+TOP=$(cd ../.. && pwd)
+
+OUT=$(mktemp -d)
+trap "rm -rf ${OUT}" EXIT
+
+# optimize $1 to ${OUT}/opt.wasm.
+# the rest of the arguments are the stats which should be non-zero.
+optimize() {
+    wasm=$1
+    shift
+    ${WASM2WASM} -O ${wasm} ${OUT}/opt.wasm 2> ${OUT}/stats
+    cat ${OUT}/stats
+    for stat in "$@"; do
+        grep "^${stat}: [1-9]" ${OUT}/stats
+    done
+}
+
+loadable() {
+    ${TOYWASM} --load $1 > /dev/null 2>&1
+}
+
+optimize const.wasm "constants folded"
+${TOYWASM} const.wasm
+${TOYWASM} ${OUT}/opt.wasm
+for f in div_overflow div_zero rem_zero div_overflow64; do
+    ${TOYWASM} --load ${OUT}/opt.wasm --invoke $f 2>&1 | grep '\[trap\]'
+done
+
+optimize locals.wasm "dead stores removed" "local.tee merged"
+${TOYWASM} locals.wasm
+${TOYWASM} ${OUT}/opt.wasm
+
+optimize unreachable.wasm "unreachable instructions removed"
+${TOYWASM} unreachable.wasm
+${TOYWASM} ${OUT}/opt.wasm
+${TOYWASM} --load ${OUT}/opt.wasm --invoke trap 2>&1 | grep '\[trap\]'
+
+optimize br_table.wasm "branches simplified"
+${TOYWASM} br_table.wasm
+${TOYWASM} ${OUT}/opt.wasm
+
+if loadable eh/try_table.wasm; then
+    optimize eh/try_table.wasm "unreachable instructions removed"
+    ${TOYWASM} eh/try_table.wasm
+    ${TOYWASM} ${OUT}/opt.wasm
+fi
+
+# other modules in the tree
+for wasm in ${TOP}/wat/eh/*.wasm; do
+    if loadable ${wasm}; then
+        optimize ${wasm}
+        ${TOYWASM} ${OUT}/opt.wasm
+    fi
+done
+
+optimize ${TOP}/wat/snapshot/table.wasm
+${TOYWASM} --load ${OUT}/opt.wasm --invoke init --invoke check
+
+for k in call branch memory simd call_indirect atomics; do
+    wasm=${TOP}/benchmark/suite/${k}.wasm
+    if loadable ${wasm}; then
+        optimize ${wasm}
+        ${TOYWASM} --load ${wasm} --invoke "run 1000" > ${OUT}/expected
+        ${TOYWASM} --load ${OUT}/opt.wasm --invoke "run 1000" > ${OUT}/result
+        cmp ${OUT}/expected ${OUT}/result
+    fi
+done
@@ -0,0 +1,66 @@
+;; removal of unreachable code
+
+(module
+  (func $check (param i32 i32)
+    local.get 0
+    local.get 1
+    i32.ne
+    if
+      unreachable
+    end
+  )
+  (func $if (param i32) (result i32)
+    local.get 0
+    if (result i32)
+      i32.const 1
+      return
+      i32.const 2
+      drop
+      block
+        unreachable
+      end
+      i32.const 3
+    else
+      i32.const 4
+      br 0
+      nop
+      loop
+        br 0
+      end
+      i32.const 5
+    end
+  )
+  (func $unreachable (param i32) (result i32)
+    local.get 0
+    if
+      unreachable
+      i32.const 6
+      drop
+    end
+    local.get 0
+    i32.const 1
+    i32.add
+  )
+  (func (export "_start")
+    i32.const 1
+    call $if
+    i32.const 1
+    call $check
+
+    i32.const 0
+    call $if
+    i32.const 4
+    call $check
+
+    i32.const 0
+    call $unreachable
+    i32.const 1
+    call $check
+  )
+  ;; should trap even after the optimization
+  (func (export "trap")
+    i32.const 1
+    call $unreachable
+    drop
+  )
+)
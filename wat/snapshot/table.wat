@@ -0,0 +1,117 @@
+;; the state made by "init" should survive a snapshot:
+;;   toywasm --load table.wasm --invoke init --snapshot out.wasm
+;;   toywasm --load out.wasm --invoke check
+
+(module
+  (type $i (func (result i32)))
+  (func $f0 (result i32)
+    i32.const 100
+  )
+  (func $f1 (result i32)
+    i32.const 101
+  )
+  (func $f2 (result i32)
+    i32.const 102
+  )
+  (func (export "init")
+    ;; memory
+    i32.const 16
+    i32.const 0x12345678
+    i32.store
+
+    ;; global
+    i32.const 42
+    global.set $g
+
+    ;; table: [f0 f1 null null] -> [f2 f1 f2 null f1 f1]
+    i32.const 0
+    ref.func $f2
+    table.set $t
+    i32.const 2
+    i32.const 0
+    i32.const 1
+    table.init $t $p
+    elem.drop $p
+    ref.func $f1
+    i32.const 2
+    table.grow $t
+    drop
+  )
+  (func (export "check")
+    i32.const 16
+    i32.load
+    i32.const 0x12345678
+    i32.ne
+    if
+      unreachable
+    end
+
+    global.get $g
+    i32.const 42
+    i32.ne
+    if
+      unreachable
+    end
+
+    table.size $t
+    i32.const 6
+    i32.ne
+    if
+      unreachable
+    end
+
+    i32.const 0
+    call_indirect $t (type $i)
+    i32.const 102
+    i32.ne
+    if
+      unreachable
+    end
+
+    i32.const 1
+    call_indirect $t (type $i)
+    i32.const 101
+    i32.ne
+    if
+      unreachable
+    end
+
+    i32.const 2
+    call_indirect $t (type $i)
+    i32.const 102
+    i32.ne
+    if
+      unreachable
+    end
+
+    i32.const 4
+    call_indirect $t (type $i)
+    i32.const 101
+    i32.ne
+    if
+      unreachable
+    end
+
+    i32.const 5
+    call_indirect $t (type $i)
+    i32.const 101
+    i32.ne
+    if
+      unreachable
+    end
+
+    i32.const 3
+    table.get $t
+    ref.is_null
+    i32.const 1
+    i32.ne
+    if
+      unreachable
+    end
+  )
+  (memory 1)
+  (global $g (mut i32) (i32.const 0))
+  (table $t 4 funcref)
+  (elem (i32.const 0) $f0 $f1)
+  (elem $p func $f2)
+)
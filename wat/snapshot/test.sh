@@ -0,0 +1,19 @@
+#! /bin/sh
+
+set -e
+set -x
+TOYWASM=${TOYWASM:-${TEST_RUNTIME_EXE:-toywasm}}
+
+OUT=$(mktemp)
+trap "rm -f ${OUT}" EXIT
+
+for wat in *.wat; do
+    wasm=${wat%%.wat}.wasm
+    # "check" should fail without "init"
+    if ${TOYWASM} --load ${wasm} --invoke check; then
+        exit 1
+    fi
+    ${TOYWASM} --load ${wasm} --invoke init --invoke check
+    ${TOYWASM} --load ${wasm} --invoke init --snapshot ${OUT}
+    ${TOYWASM} --load ${OUT} --invoke check
+done